@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "argument_parser.h"
+#include "property_set.h"
+#include "bench_results.h"
+#include "db_bench.h"
+#include "storage_bench.h"
+#include "fs_storage_system.h"
+#include "mirror_storage_system.h"
+#include "s3_storage_system.h"
+#include "utils.h"
+#include "OSUtils.h"
+#include "StrUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+static const string DEFAULT_ROWS = "10000,100000,1000000";
+static const string DEFAULT_STORAGE = "fs,mirror";
+
+//*****************************************************************************
+
+static void show_usage() {
+   printf("usage: bench_cpp_cloud_jukebox [options]\n");
+   printf("\n");
+   printf("  --storage <list>        backends to measure: fs, mirror, s3 (default %s)\n",
+          DEFAULT_STORAGE.c_str());
+   printf("  --objects <n>           objects per storage operation (default 200)\n");
+   printf("  --object-kb <n>         size of each object (default 256)\n");
+   printf("  --rows <list>           catalog sizes to measure (default %s)\n",
+          DEFAULT_ROWS.c_str());
+   printf("  --lookups <n>           song lookups per catalog size (default 10000)\n");
+   printf("  --no-storage            skip the storage benchmarks\n");
+   printf("  --no-db                 skip the catalog benchmarks\n");
+   printf("  --work-dir <dir>        scratch directory (default ./bench-work)\n");
+   printf("  --output <file>         append JSON results to file (default stdout)\n");
+   printf("  --s3-host <host:port>   S3 endpoint, e.g. a local MinIO (required for s3)\n");
+   printf("  --s3-protocol <proto>   http or https (default http)\n");
+   printf("  --s3-access-key <key>\n");
+   printf("  --s3-secret-key <key>\n");
+}
+
+//*****************************************************************************
+
+static vector<string> split_list(const string& list) {
+   vector<string> items;
+   for (const auto& item : StrUtils::split(list, ",")) {
+      string trimmed = StrUtils::strip(item);
+      if (!trimmed.empty()) {
+         items.push_back(trimmed);
+      }
+   }
+   return items;
+}
+
+//*****************************************************************************
+
+static StorageSystem* create_storage_system(const string& backend,
+                                            const string& work_dir,
+                                            const PropertySet& args) {
+   if (backend == "fs") {
+      return new FSStorageSystem(OSUtils::pathJoin(work_dir, "fs"));
+   } else if (backend == "mirror") {
+      return new MirrorStorageSystem(
+         new FSStorageSystem(OSUtils::pathJoin(work_dir, "mirror-primary")),
+         new FSStorageSystem(OSUtils::pathJoin(work_dir, "mirror-secondary")));
+   } else if (backend == "s3") {
+      if (!args.contains("s3_host")) {
+         printf("error: --s3-host is required to benchmark s3\n");
+         return nullptr;
+      }
+      string protocol = "http";
+      if (args.contains("s3_protocol")) {
+         protocol = args.get_string_value("s3_protocol");
+      }
+      string access_key;
+      string secret_key;
+      if (args.contains("s3_access_key")) {
+         access_key = args.get_string_value("s3_access_key");
+      }
+      if (args.contains("s3_secret_key")) {
+         secret_key = args.get_string_value("s3_secret_key");
+      }
+      return new S3StorageSystem(access_key,
+                                 secret_key,
+                                 protocol,
+                                 args.get_string_value("s3_host"),
+                                 "");
+   }
+
+   printf("error: unknown storage backend '%s'\n", backend.c_str());
+   return nullptr;
+}
+
+//*****************************************************************************
+
+int main(int argc, char* argv[]) {
+   vector<string> console_args;
+   for (int i = 1; i < argc; i++) {
+      console_args.push_back(string(argv[i]));
+   }
+
+   ArgumentParser opt_parser;
+   opt_parser.addOptionalBoolFlag("--help", "show usage");
+   opt_parser.addOptionalStringArgument("--storage", "backends to measure");
+   opt_parser.addOptionalIntArgument("--objects", "objects per storage operation");
+   opt_parser.addOptionalIntArgument("--object-kb", "size of each object");
+   opt_parser.addOptionalStringArgument("--rows", "catalog sizes to measure");
+   opt_parser.addOptionalIntArgument("--lookups", "song lookups per catalog size");
+   opt_parser.addOptionalBoolFlag("--no-storage", "skip the storage benchmarks");
+   opt_parser.addOptionalBoolFlag("--no-db", "skip the catalog benchmarks");
+   opt_parser.addOptionalStringArgument("--work-dir", "scratch directory");
+   opt_parser.addOptionalStringArgument("--output", "file to append JSON results to");
+   opt_parser.addOptionalStringArgument("--s3-host", "S3 endpoint");
+   opt_parser.addOptionalStringArgument("--s3-protocol", "http or https");
+   opt_parser.addOptionalStringArgument("--s3-access-key", "S3 access key");
+   opt_parser.addOptionalStringArgument("--s3-secret-key", "S3 secret key");
+
+   unique_ptr<PropertySet> args(opt_parser.parse_args(console_args));
+   if (!args) {
+      printf("error: unable to obtain command-line arguments\n");
+      return 1;
+   }
+   if (args->contains("help")) {
+      show_usage();
+      return 0;
+   }
+
+   string work_dir = OSUtils::pathJoin(OSUtils::getCurrentDirectory(), "bench-work");
+   if (args->contains("work_dir")) {
+      work_dir = args->get_string_value("work_dir");
+   }
+   if (!OSUtils::directoryExists(work_dir) && !OSUtils::createDirectory(work_dir)) {
+      printf("error: unable to create %s\n", work_dir.c_str());
+      return 1;
+   }
+
+   BenchReporter reporter;
+   if (args->contains("output") &&
+       !reporter.open(args->get_string_value("output"))) {
+      return 1;
+   }
+
+   bool success = true;
+
+   if (!args->contains("no_storage")) {
+      StorageBenchConfig storage_config;
+      storage_config.work_dir = work_dir;
+      if (args->contains("objects") && args->get_int_value("objects") > 0) {
+         storage_config.num_objects = args->get_int_value("objects");
+      }
+      if (args->contains("object_kb") && args->get_int_value("object_kb") > 0) {
+         storage_config.object_bytes = (size_t) args->get_int_value("object_kb") * 1024;
+         storage_config.range_bytes = std::min(storage_config.range_bytes,
+                                               storage_config.object_bytes / 2);
+      }
+
+      string backends = DEFAULT_STORAGE;
+      if (args->contains("storage")) {
+         backends = args->get_string_value("storage");
+      }
+      for (const auto& backend : split_list(backends)) {
+         unique_ptr<StorageSystem> storage_system(
+            create_storage_system(backend, work_dir, *args));
+         if (!storage_system || !storage_system->enter()) {
+            printf("error: unable to connect to %s\n", backend.c_str());
+            success = false;
+            continue;
+         }
+         if (!run_storage_bench(*storage_system, backend, storage_config, reporter)) {
+            success = false;
+         }
+         storage_system->exit();
+      }
+   }
+
+   if (!args->contains("no_db")) {
+      DBBenchConfig db_config;
+      db_config.work_dir = work_dir;
+      if (args->contains("lookups") && args->get_int_value("lookups") > 0) {
+         db_config.num_lookups = args->get_int_value("lookups");
+      }
+
+      string rows = DEFAULT_ROWS;
+      if (args->contains("rows")) {
+         rows = args->get_string_value("rows");
+      }
+      for (const auto& row_count : split_list(rows)) {
+         int64_t num_rows = StrUtils::parseLong(row_count);
+         if (num_rows <= 0) {
+            printf("error: invalid row count '%s'\n", row_count.c_str());
+            success = false;
+            continue;
+         }
+         if (!run_db_bench(num_rows, db_config, reporter)) {
+            success = false;
+         }
+      }
+   }
+
+   return success ? 0 : 1;
+}
+
+//*****************************************************************************
+
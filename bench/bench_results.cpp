@@ -0,0 +1,145 @@
+#include <time.h>
+#include <chrono>
+
+#include "bench_results.h"
+
+using namespace std;
+
+//*****************************************************************************
+
+static string json_string(const string& s) {
+   string quoted = "\"";
+   for (char ch : s) {
+      if (ch == '"' || ch == '\\') {
+         quoted += '\\';
+      }
+      quoted += ch;
+   }
+   quoted += "\"";
+   return quoted;
+}
+
+//*****************************************************************************
+
+BenchResult::BenchResult(const string& the_suite,
+                         const string& the_target,
+                         const string& the_operation,
+                         int64_t the_rows) :
+   suite(the_suite),
+   target(the_target),
+   operation(the_operation),
+   rows(the_rows),
+   errors(0),
+   bytes(0),
+   seconds(0.0) {
+}
+
+//*****************************************************************************
+
+bool BenchResult::measure(const function<bool()>& op) {
+   const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   bool success = false;
+   try {
+      success = op();
+   } catch (const exception& e) {
+      printf("%s %s exception: %s\n", target.c_str(), operation.c_str(), e.what());
+   }
+   const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   latency.record(elapsed.count());
+   seconds += elapsed.count();
+   if (!success) {
+      ++errors;
+   }
+   return success;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+BenchReporter::BenchReporter() :
+   m_json_file(stdout),
+   m_owns_file(false),
+   m_run_id(to_string((long long) ::time(nullptr))) {
+}
+
+//*****************************************************************************
+
+BenchReporter::~BenchReporter() {
+   if (m_owns_file) {
+      fclose(m_json_file);
+   }
+}
+
+//*****************************************************************************
+
+bool BenchReporter::open(const string& json_path) {
+   if (json_path.empty() || json_path == "-") {
+      return true;
+   }
+
+   FILE* f = fopen(json_path.c_str(), "a");
+   if (f == nullptr) {
+      printf("error: unable to open %s\n", json_path.c_str());
+      return false;
+   }
+   m_json_file = f;
+   m_owns_file = true;
+   return true;
+}
+
+//*****************************************************************************
+
+void BenchReporter::report(const BenchResult& result) {
+   fprintf(m_json_file, "%s\n", to_json(result, m_run_id).c_str());
+   fflush(m_json_file);
+
+   if (m_json_file != stdout) {
+      uint64_t ops = result.latency.count();
+      printf("%-8s %-10s %-22s %9lld %8llu %6llu %10.1f/s %8.2f %8.2f %8.2f ms\n",
+             result.suite.c_str(),
+             result.target.c_str(),
+             result.operation.c_str(),
+             (long long) result.rows,
+             (unsigned long long) ops,
+             (unsigned long long) result.errors,
+             result.seconds > 0.0 ? ops / result.seconds : 0.0,
+             result.latency.percentile_micros(0.50) / 1000.0,
+             result.latency.percentile_micros(0.90) / 1000.0,
+             result.latency.percentile_micros(0.99) / 1000.0);
+   }
+}
+
+//*****************************************************************************
+
+string BenchReporter::to_json(const BenchResult& result, const string& run_id) {
+   uint64_t ops = result.latency.count();
+   double ops_per_sec = result.seconds > 0.0 ? ops / result.seconds : 0.0;
+   double mb_per_sec =
+      result.seconds > 0.0 ? result.bytes / result.seconds / (1024.0 * 1024.0) : 0.0;
+
+   char numbers[512];
+   snprintf(numbers, sizeof(numbers),
+            "\"rows\": %lld, \"ops\": %llu, \"errors\": %llu, \"bytes\": %llu, "
+            "\"seconds\": %.6f, \"ops_per_sec\": %.3f, \"mb_per_sec\": %.3f, "
+            "\"p50_us\": %llu, \"p90_us\": %llu, \"p99_us\": %llu, \"max_us\": %llu",
+            (long long) result.rows,
+            (unsigned long long) ops,
+            (unsigned long long) result.errors,
+            (unsigned long long) result.bytes,
+            result.seconds,
+            ops_per_sec,
+            mb_per_sec,
+            (unsigned long long) result.latency.percentile_micros(0.50),
+            (unsigned long long) result.latency.percentile_micros(0.90),
+            (unsigned long long) result.latency.percentile_micros(0.99),
+            (unsigned long long) result.latency.max_micros());
+
+   return "{\"run\": " + json_string(run_id) +
+          ", \"suite\": " + json_string(result.suite) +
+          ", \"target\": " + json_string(result.target) +
+          ", \"operation\": " + json_string(result.operation) +
+          ", " + numbers + "}";
+}
+
+//*****************************************************************************
+
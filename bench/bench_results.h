@@ -0,0 +1,62 @@
+#ifndef BENCH_RESULTS_H
+#define BENCH_RESULTS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <string>
+
+#include "latency_histogram.h"
+
+
+// One measured operation against one target (a storage backend, or a
+// catalog DB of a given size).
+struct BenchResult {
+   std::string suite;
+   std::string target;
+   std::string operation;
+   // catalog rows the operation ran against; 0 for storage results
+   int64_t rows;
+   uint64_t errors;
+   uint64_t bytes;
+   // wall-clock time for all of the operations
+   double seconds;
+   LatencyHistogram latency;
+
+   BenchResult(const std::string& the_suite,
+               const std::string& the_target,
+               const std::string& the_operation,
+               int64_t the_rows=0);
+
+   // times one operation, counting it as an error if it returns false
+   bool measure(const std::function<bool()>& op);
+};
+
+
+// Writes each result as one JSON object per line (so runs can be appended
+// to one file and compared across releases), and a readable summary line
+// to stdout when the JSON goes elsewhere.
+class BenchReporter {
+private:
+   FILE* m_json_file;
+   bool m_owns_file;
+   std::string m_run_id;
+
+   BenchReporter(const BenchReporter&);
+   BenchReporter& operator=(const BenchReporter&);
+
+public:
+   BenchReporter();
+   ~BenchReporter();
+
+   // empty or "-" writes to stdout; otherwise appends to json_path
+   bool open(const std::string& json_path);
+
+   void report(const BenchResult& result);
+
+   static std::string to_json(const BenchResult& result,
+                              const std::string& run_id);
+};
+
+#endif
+
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "db_bench.h"
+#include "bench_results.h"
+#include "jukebox_db.h"
+#include "library_generator.h"
+#include "song_metadata.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+//*****************************************************************************
+
+// the catalog is a generated library sized to num_rows: every album has
+// songs_per_album tracks, and the albums are shared out over the artists
+// with the generator's Zipf skew, albums_per_artist apiece on average
+static LibraryConfig library_config(int64_t num_rows,
+                                    const DBBenchConfig& config) {
+   LibraryConfig library_config;
+   library_config.num_albums =
+      (num_rows + config.songs_per_album - 1) / config.songs_per_album;
+   library_config.num_artists =
+      (library_config.num_albums + config.albums_per_artist - 1) /
+      config.albums_per_artist;
+   library_config.min_tracks = config.songs_per_album;
+   library_config.max_tracks = config.songs_per_album;
+   library_config.num_playlists = 0;
+   return library_config;
+}
+
+//*****************************************************************************
+
+static SongMetadata make_song(const LibraryGenerator& library,
+                              const GeneratedSong& generated_song) {
+   SongMetadata song = library.song_metadata(generated_song);
+   song.set_file_time("2024-01-01 00:00:00.000");
+   song.set_md5_hash("d41d8cd98f00b204e9800998ecf8427e");
+   song.set_container_name("a-artist-songs");
+   return song;
+}
+
+//*****************************************************************************
+
+bool run_db_bench(int64_t num_rows,
+                  const DBBenchConfig& config,
+                  BenchReporter& reporter) {
+   string target = to_string((long long) num_rows);
+   string db_file = OSUtils::pathJoin(config.work_dir,
+                                      "bench_" + target + ".sqlite3");
+   Utils::file_delete(db_file);
+
+   const LibraryGenerator library(library_config(num_rows, config));
+   const vector<GeneratedSong>& library_songs = library.get_songs();
+   if ((int64_t) library_songs.size() < num_rows) {
+      printf("error: generated library has only %zu songs\n",
+             library_songs.size());
+      return false;
+   }
+
+   JukeboxDB jukebox_db(db_file);
+   if (!jukebox_db.open()) {
+      printf("error: unable to open %s\n", db_file.c_str());
+      return false;
+   }
+
+   // lookups pick songs at random so they aren't all served from the same
+   // few cached pages
+   std::default_random_engine rng(42);
+   std::uniform_int_distribution<int64_t> pick_song(0, num_rows - 1);
+
+   BenchResult insert_result("db", target, "insert_song", num_rows);
+   // commits are part of the cost of inserting, though not of any one insert
+   auto commit_batch = [&]() {
+      const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      if (!jukebox_db.commit_transaction()) {
+         ++insert_result.errors;
+      }
+      const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      insert_result.seconds += elapsed.count();
+   };
+   for (int64_t n = 0; n < num_rows; ++n) {
+      if (n % config.insert_batch_size == 0) {
+         if (jukebox_db.in_transaction()) {
+            commit_batch();
+         }
+         jukebox_db.begin_transaction();
+      }
+      SongMetadata song = make_song(library, library_songs[n]);
+      insert_result.measure([&]() {
+         return jukebox_db.insert_song(song);
+      });
+   }
+   if (jukebox_db.in_transaction()) {
+      commit_batch();
+   }
+   reporter.report(insert_result);
+
+   BenchResult retrieve_result("db", target, "retrieve_song", num_rows);
+   for (unsigned int i = 0; i < config.num_lookups; ++i) {
+      string song_uid = library_songs[pick_song(rng)].file_name;
+      SongMetadata song;
+      retrieve_result.measure([&]() {
+         return jukebox_db.retrieve_song(song_uid, song);
+      });
+   }
+   reporter.report(retrieve_result);
+
+   unsigned int num_listings = config.num_lookups / 10 > 0 ?
+                               config.num_lookups / 10 : 1;
+   vector<SongMetadata> songs;
+
+   BenchResult album_result("db", target, "retrieve_album_songs", num_rows);
+   for (unsigned int i = 0; i < num_listings; ++i) {
+      const GeneratedSong& song = library_songs[pick_song(rng)];
+      album_result.measure([&]() {
+         return jukebox_db.retrieve_album_songs(song.artist, song.album, songs) &&
+                !songs.empty();
+      });
+   }
+   reporter.report(album_result);
+
+   BenchResult artist_result("db", target, "retrieve_artist_songs", num_rows);
+   // artists are picked in proportion to their songs, so the few with
+   // the most albums are listed most
+   for (unsigned int i = 0; i < num_listings; ++i) {
+      const GeneratedSong& song = library_songs[pick_song(rng)];
+      artist_result.measure([&]() {
+         return jukebox_db.retrieve_album_songs(song.artist, "", songs) &&
+                !songs.empty();
+      });
+   }
+   reporter.report(artist_result);
+
+   jukebox_db.close();
+   Utils::file_delete(db_file);
+
+   return insert_result.errors == 0 &&
+          retrieve_result.errors == 0 &&
+          album_result.errors == 0 &&
+          artist_result.errors == 0;
+}
+
+//*****************************************************************************
+
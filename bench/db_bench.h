@@ -0,0 +1,37 @@
+#ifndef DB_BENCH_H
+#define DB_BENCH_H
+
+#include <stdint.h>
+#include <string>
+
+class BenchReporter;
+
+
+struct DBBenchConfig {
+   // songs per album and average albums per artist of the generated
+   // catalog
+   unsigned int songs_per_album;
+   unsigned int albums_per_artist;
+   // songs inserted per transaction, as import_songs batches them
+   unsigned int insert_batch_size;
+   unsigned int num_lookups;
+   std::string work_dir;
+
+   DBBenchConfig() :
+      songs_per_album(12),
+      albums_per_artist(8),
+      insert_batch_size(2000),
+      num_lookups(10000) {
+   }
+};
+
+
+// Builds a catalog DB in work_dir from the first num_rows songs of a
+// generated library, timing the inserts, then times song lookups, album
+// and artist listings against it. The DB file is removed afterwards.
+bool run_db_bench(int64_t num_rows,
+                  const DBBenchConfig& config,
+                  BenchReporter& reporter);
+
+#endif
+
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "argument_parser.h"
+#include "property_set.h"
+#include "library_generator.h"
+#include "OSUtils.h"
+#include "StrUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+//*****************************************************************************
+
+static void show_usage() {
+   LibraryConfig defaults;
+   printf("usage: gen_library [options]\n");
+   printf("\n");
+   printf("Writes a synthetic music library to song-import, playlist-import and\n");
+   printf("album-import under the output directory.\n");
+   printf("\n");
+   printf("  --output-dir <dir>      where to write the library (default ./jukebox-library)\n");
+   printf("  --artists <n>           number of artists (default %u)\n", defaults.num_artists);
+   printf("  --albums <n>            number of albums (default %u)\n", defaults.num_albums);
+   printf("  --zipf <s>              skew of albums per artist (default %.1f)\n",
+          defaults.zipf_exponent);
+   printf("  --min-tracks <n>        fewest tracks per album (default %u)\n", defaults.min_tracks);
+   printf("  --max-tracks <n>        most tracks per album (default %u)\n", defaults.max_tracks);
+   printf("  --min-kb <n>            smallest song file (default %lld)\n",
+          (long long) defaults.min_file_bytes / 1000);
+   printf("  --max-kb <n>            largest song file (default %lld)\n",
+          (long long) defaults.max_file_bytes / 1000);
+   printf("  --real-bytes            fill song files instead of leaving them sparse\n");
+   printf("  --extensions <list>     song file extensions (default .flac,.m4a,.mp3)\n");
+   printf("  --playlists <n>         number of playlists (default %u)\n", defaults.num_playlists);
+   printf("  --playlist-songs <n>    songs per playlist (default %u)\n",
+          defaults.songs_per_playlist);
+   printf("  --seed <n>              random seed (default %u)\n", defaults.seed);
+}
+
+//*****************************************************************************
+
+int main(int argc, char* argv[]) {
+   vector<string> console_args;
+   for (int i = 1; i < argc; i++) {
+      console_args.push_back(string(argv[i]));
+   }
+
+   ArgumentParser opt_parser;
+   opt_parser.addOptionalBoolFlag("--help", "show usage");
+   opt_parser.addOptionalStringArgument("--output-dir", "where to write the library");
+   opt_parser.addOptionalIntArgument("--artists", "number of artists");
+   opt_parser.addOptionalIntArgument("--albums", "number of albums");
+   opt_parser.addOptionalStringArgument("--zipf", "skew of albums per artist");
+   opt_parser.addOptionalIntArgument("--min-tracks", "fewest tracks per album");
+   opt_parser.addOptionalIntArgument("--max-tracks", "most tracks per album");
+   opt_parser.addOptionalIntArgument("--min-kb", "smallest song file");
+   opt_parser.addOptionalIntArgument("--max-kb", "largest song file");
+   opt_parser.addOptionalBoolFlag("--real-bytes", "fill song files");
+   opt_parser.addOptionalStringArgument("--extensions", "song file extensions");
+   opt_parser.addOptionalIntArgument("--playlists", "number of playlists");
+   opt_parser.addOptionalIntArgument("--playlist-songs", "songs per playlist");
+   opt_parser.addOptionalIntArgument("--seed", "random seed");
+
+   unique_ptr<PropertySet> args(opt_parser.parse_args(console_args));
+   if (!args) {
+      printf("error: unable to obtain command-line arguments\n");
+      return 1;
+   }
+   if (args->contains("help")) {
+      show_usage();
+      return 0;
+   }
+
+   // counts that can't be zero (or negative, which would wrap around to
+   // billions) are refused rather than generating a nonsensical library
+   const vector<pair<string, string>> count_args = {
+      {"artists", "--artists"},
+      {"albums", "--albums"},
+      {"playlist_songs", "--playlist-songs"}
+   };
+   for (const auto& count_arg : count_args) {
+      if (args->contains(count_arg.first) &&
+          args->get_int_value(count_arg.first) <= 0) {
+         printf("error: %s must be greater than 0\n", count_arg.second.c_str());
+         return 1;
+      }
+   }
+
+   LibraryConfig config;
+   if (args->contains("artists")) {
+      config.num_artists = args->get_int_value("artists");
+   }
+   if (args->contains("albums")) {
+      config.num_albums = args->get_int_value("albums");
+   }
+   if (args->contains("zipf")) {
+      config.zipf_exponent = atof(args->get_string_value("zipf").c_str());
+   }
+   if (args->contains("min_tracks")) {
+      config.min_tracks = args->get_int_value("min_tracks");
+   }
+   if (args->contains("max_tracks")) {
+      config.max_tracks = args->get_int_value("max_tracks");
+   }
+   if (args->contains("min_kb")) {
+      config.min_file_bytes = (int64_t) args->get_int_value("min_kb") * 1000;
+   }
+   if (args->contains("max_kb")) {
+      config.max_file_bytes = (int64_t) args->get_int_value("max_kb") * 1000;
+   }
+   if (args->contains("real_bytes")) {
+      config.sparse_files = false;
+   }
+   if (args->contains("extensions")) {
+      config.extensions.clear();
+      for (const auto& item : StrUtils::split(args->get_string_value("extensions"), ",")) {
+         string extension = StrUtils::strip(item);
+         if (!extension.empty()) {
+            if (extension[0] != '.') {
+               extension = "." + extension;
+            }
+            config.extensions.push_back(extension);
+         }
+      }
+   }
+   if (args->contains("playlists")) {
+      config.num_playlists = args->get_int_value("playlists");
+   }
+   if (args->contains("playlist_songs")) {
+      config.songs_per_playlist = args->get_int_value("playlist_songs");
+   }
+   if (args->contains("seed")) {
+      config.seed = args->get_int_value("seed");
+   }
+
+   string output_dir = OSUtils::pathJoin(OSUtils::getCurrentDirectory(),
+                                         "jukebox-library");
+   if (args->contains("output_dir")) {
+      output_dir = args->get_string_value("output_dir");
+   }
+   if (!OSUtils::directoryExists(output_dir) && !OSUtils::createDirectory(output_dir)) {
+      printf("error: unable to create %s\n", output_dir.c_str());
+      return 1;
+   }
+
+   LibraryGenerator generator(config);
+   if (!generator.write(output_dir)) {
+      return 1;
+   }
+
+   int64_t total_bytes = 0;
+   for (const auto& song : generator.get_songs()) {
+      total_bytes += song.file_size;
+   }
+   printf("%zu songs (%.1f MB), %zu albums, %zu playlists written to %s\n",
+          generator.get_songs().size(),
+          total_bytes / 1000000.0,
+          generator.num_albums(),
+          generator.get_playlist_names().size(),
+          output_dir.c_str());
+   return 0;
+}
+
+//*****************************************************************************
+
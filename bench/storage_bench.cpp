@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <vector>
+
+#include "storage_bench.h"
+#include "bench_results.h"
+#include "storage_system.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+//*****************************************************************************
+
+static string bench_object_name(unsigned int i) {
+   char name[64];
+   snprintf(name, sizeof(name), "bench-object-%06u", i);
+   return name;
+}
+
+//*****************************************************************************
+
+bool run_storage_bench(StorageSystem& storage_system,
+                       const string& target,
+                       const StorageBenchConfig& config,
+                       BenchReporter& reporter) {
+   if (!storage_system.has_container(config.container) &&
+       !storage_system.create_container(config.container)) {
+      printf("error: unable to create container %s on %s\n",
+             config.container.c_str(), target.c_str());
+      return false;
+   }
+
+   // contents vary per object so that nothing can dedupe or compress them
+   vector<unsigned char> contents(config.object_bytes);
+   for (size_t i = 0; i < contents.size(); ++i) {
+      contents[i] = (unsigned char) ((i * 2654435761u) >> 24);
+   }
+
+   BenchResult put_result("storage", target, "put_object");
+   for (unsigned int i = 0; i < config.num_objects; ++i) {
+      contents[0] = (unsigned char) i;
+      if (put_result.measure([&]() {
+         return storage_system.put_object(config.container,
+                                          bench_object_name(i),
+                                          contents);
+      })) {
+         put_result.bytes += contents.size();
+      }
+   }
+   reporter.report(put_result);
+
+   string local_file = OSUtils::pathJoin(config.work_dir, "bench-object.download");
+   BenchResult get_result("storage", target, "get_object");
+   for (unsigned int i = 0; i < config.num_objects; ++i) {
+      int64_t bytes_retrieved = 0;
+      get_result.measure([&]() {
+         bytes_retrieved = storage_system.get_object(config.container,
+                                                     bench_object_name(i),
+                                                     local_file);
+         return bytes_retrieved > 0;
+      });
+      if (bytes_retrieved > 0) {
+         get_result.bytes += bytes_retrieved;
+      }
+   }
+   Utils::file_delete(local_file);
+   reporter.report(get_result);
+
+   // from the middle of each object, as a seek during playback would
+   BenchResult range_result("storage", target, "get_object_range");
+   ObjectSink discard_sink = [](const unsigned char*, size_t) { return true; };
+   for (unsigned int i = 0; i < config.num_objects; ++i) {
+      int64_t bytes_retrieved = 0;
+      range_result.measure([&]() {
+         bytes_retrieved =
+            storage_system.get_object_range(config.container,
+                                            bench_object_name(i),
+                                            config.object_bytes / 2,
+                                            config.range_bytes,
+                                            discard_sink);
+         return bytes_retrieved > 0;
+      });
+      if (bytes_retrieved > 0) {
+         range_result.bytes += bytes_retrieved;
+      }
+   }
+   reporter.report(range_result);
+
+   BenchResult list_result("storage", target, "list_container_contents");
+   for (unsigned int i = 0; i < config.list_iterations; ++i) {
+      list_result.measure([&]() {
+         return storage_system.list_container_contents(config.container).size() >=
+                config.num_objects;
+      });
+   }
+   reporter.report(list_result);
+
+   BenchResult delete_result("storage", target, "delete_object");
+   for (unsigned int i = 0; i < config.num_objects; ++i) {
+      delete_result.measure([&]() {
+         return storage_system.delete_object(config.container,
+                                             bench_object_name(i));
+      });
+   }
+   reporter.report(delete_result);
+
+   return put_result.errors == 0 &&
+          get_result.errors == 0 &&
+          range_result.errors == 0 &&
+          list_result.errors == 0 &&
+          delete_result.errors == 0;
+}
+
+//*****************************************************************************
+
@@ -0,0 +1,39 @@
+#ifndef STORAGE_BENCH_H
+#define STORAGE_BENCH_H
+
+#include <string>
+
+class BenchReporter;
+class StorageSystem;
+
+
+struct StorageBenchConfig {
+   unsigned int num_objects;
+   size_t object_bytes;
+   // bytes read by each range request
+   size_t range_bytes;
+   unsigned int list_iterations;
+   std::string container;
+   // scratch directory for downloaded objects
+   std::string work_dir;
+
+   StorageBenchConfig() :
+      num_objects(200),
+      object_bytes(256 * 1024),
+      range_bytes(64 * 1024),
+      list_iterations(20),
+      container("jukebox-bench") {
+   }
+};
+
+
+// Times put, get, range get, list and delete of num_objects objects on a
+// storage system that has already been entered. The objects are removed
+// afterwards, but the container is left for the next run.
+bool run_storage_bench(StorageSystem& storage_system,
+                       const std::string& target,
+                       const StorageBenchConfig& config,
+                       BenchReporter& reporter);
+
+#endif
+
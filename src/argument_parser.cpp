@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "argument_parser.h"
 #include "property_set.h"
 #include "StrUtils.h"
@@ -81,7 +83,10 @@ PropertySet* ArgumentParser::parse_args(const vector<string>& args) {
       auto it = m_dict_all_reserved_words.find(arg);
       if (it != m_dict_all_reserved_words.end()) {
          const string& arg_type = it->second;
+         // like python's argparse, "--file-cache-count" is stored as
+         // "file_cache_count"
          string the_arg = arg.substr(2, arg.length()-2);
+         std::replace(the_arg.begin(), the_arg.end(), '-', '_');
          if (arg_type == TYPE_BOOL) {
             pset->add(the_arg, new BoolPropertyValue(true));
          } else if (arg_type == TYPE_INT) {
@@ -0,0 +1,77 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+
+// Blocking FIFO with a fixed capacity for handing work between pipeline
+// stages. Producers block while the queue is full, so a fast stage can't
+// run arbitrarily far ahead of a slow one. Once closed, push fails and
+// pop drains whatever is left before failing.
+template <typename T>
+class BoundedQueue {
+private:
+   std::mutex m_mutex;
+   std::condition_variable m_cond_not_empty;
+   std::condition_variable m_cond_not_full;
+   std::deque<T> m_items;
+   size_t m_capacity;
+   bool m_closed;
+
+   BoundedQueue();
+   BoundedQueue(const BoundedQueue&);
+   BoundedQueue& operator=(const BoundedQueue&);
+
+public:
+   explicit BoundedQueue(size_t capacity) :
+      m_capacity(capacity > 0 ? capacity : 1),
+      m_closed(false) {
+   }
+
+   // returns false if the queue was closed
+   bool push(const T& item) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond_not_full.wait(lock, [this] {
+         return m_closed || m_items.size() < m_capacity;
+      });
+      if (m_closed) {
+         return false;
+      }
+      m_items.push_back(item);
+      m_cond_not_empty.notify_one();
+      return true;
+   }
+
+   // returns false once the queue is closed and empty
+   bool pop(T& item) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond_not_empty.wait(lock, [this] {
+         return m_closed || !m_items.empty();
+      });
+      if (m_items.empty()) {
+         return false;
+      }
+      item = m_items.front();
+      m_items.pop_front();
+      m_cond_not_full.notify_one();
+      return true;
+   }
+
+   void close() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+      m_cond_not_empty.notify_all();
+      m_cond_not_full.notify_all();
+   }
+
+   size_t size() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_items.size();
+   }
+};
+
+#endif
+
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "content_hash.h"
+
+using namespace std;
+
+static const string XXH64_TAG = "xxh64:";
+
+//*****************************************************************************
+
+static string to_hex(const unsigned char* bytes, size_t length) {
+   static const char hex_chars[] = "0123456789abcdef";
+   string hex;
+   hex.reserve(length * 2);
+   for (size_t i = 0; i < length; ++i) {
+      hex += hex_chars[bytes[i] >> 4];
+      hex += hex_chars[bytes[i] & 0x0f];
+   }
+   return hex;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+ContentHash::ContentHash(Algorithm algorithm) :
+   m_algorithm(algorithm) {
+}
+
+//*****************************************************************************
+
+ContentHash::~ContentHash() {
+}
+
+//*****************************************************************************
+
+string ContentHash::tagged_digest() {
+   if (m_algorithm == MD5) {
+      return hex_digest();
+   } else {
+      return algorithm_name(m_algorithm) + ":" + hex_digest();
+   }
+}
+
+//*****************************************************************************
+
+bool ContentHash::update_from_file(const string& file_path) {
+   FILE* f = fopen(file_path.c_str(), "rb");
+   if (f == nullptr) {
+      printf("error: unable to open %s\n", file_path.c_str());
+      return false;
+   }
+
+   ObjectSink sink = [this](const unsigned char* data, size_t length) {
+      update(data, length);
+      return true;
+   };
+   int64_t bytes_read = ObjectStream::pump(ObjectStream::file_source(f), sink);
+   fclose(f);
+
+   return bytes_read >= 0;
+}
+
+//*****************************************************************************
+
+unique_ptr<ContentHash> ContentHash::create(Algorithm algorithm) {
+   if (algorithm == XXH64) {
+      return unique_ptr<ContentHash>(new XXH64Hash());
+   } else {
+      return unique_ptr<ContentHash>(new MD5Hash());
+   }
+}
+
+//*****************************************************************************
+
+unique_ptr<ContentHash> ContentHash::create_for_tagged_digest(const string& tagged_digest) {
+   if (tagged_digest.compare(0, XXH64_TAG.length(), XXH64_TAG) == 0) {
+      return create(XXH64);
+   } else {
+      return create(MD5);
+   }
+}
+
+//*****************************************************************************
+
+string ContentHash::algorithm_name(Algorithm algorithm) {
+   if (algorithm == XXH64) {
+      return "xxh64";
+   } else {
+      return "md5";
+   }
+}
+
+//*****************************************************************************
+
+bool ContentHash::algorithm_from_name(const string& name,
+                                      Algorithm& algorithm) {
+   if (name == "md5") {
+      algorithm = MD5;
+      return true;
+   } else if (name == "xxh64") {
+      algorithm = XXH64;
+      return true;
+   }
+   return false;
+}
+
+//*****************************************************************************
+
+string ContentHash::hash_file(const string& file_path, Algorithm algorithm) {
+   unique_ptr<ContentHash> hash = create(algorithm);
+   if (hash->update_from_file(file_path)) {
+      return hash->hex_digest();
+   }
+   return "";
+}
+
+//*****************************************************************************
+
+ObjectSource ContentHash::hashing_source(ContentHash& hash,
+                                         const ObjectSource& source) {
+   return [&hash, source](unsigned char* buffer, size_t max_bytes) -> int64_t {
+      int64_t bytes_read = source(buffer, max_bytes);
+      if (bytes_read > 0) {
+         hash.update(buffer, bytes_read);
+      }
+      return bytes_read;
+   };
+}
+
+//*****************************************************************************
+
+ObjectSink ContentHash::hashing_sink(ContentHash& hash,
+                                     const ObjectSink& sink) {
+   return [&hash, sink](const unsigned char* data, size_t length) -> bool {
+      hash.update(data, length);
+      return sink(data, length);
+   };
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+// per-round shift amounts
+static const uint32_t MD5_S[64] = {
+   7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+   5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+   4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+   6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+// floor(abs(sin(i + 1)) * 2^32)
+static const uint32_t MD5_K[64] = {
+   0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+   0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+   0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+   0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+   0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+   0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+   0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+   0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+   0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+   0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+   0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+   0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+   0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+   0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+   0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+   0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static inline uint32_t rotl32(uint32_t x, uint32_t n) {
+   return (x << n) | (x >> (32 - n));
+}
+
+//*****************************************************************************
+
+MD5Hash::MD5Hash() :
+   ContentHash(MD5),
+   m_total_length(0),
+   m_buffer_length(0) {
+   m_state[0] = 0x67452301;
+   m_state[1] = 0xefcdab89;
+   m_state[2] = 0x98badcfe;
+   m_state[3] = 0x10325476;
+}
+
+//*****************************************************************************
+
+MD5Hash::~MD5Hash() {
+}
+
+//*****************************************************************************
+
+void MD5Hash::transform(const unsigned char* block) {
+   uint32_t m[16];
+   for (int i = 0; i < 16; ++i) {
+      m[i] = (uint32_t) block[i*4] |
+             ((uint32_t) block[i*4+1] << 8) |
+             ((uint32_t) block[i*4+2] << 16) |
+             ((uint32_t) block[i*4+3] << 24);
+   }
+
+   uint32_t a = m_state[0];
+   uint32_t b = m_state[1];
+   uint32_t c = m_state[2];
+   uint32_t d = m_state[3];
+
+   for (uint32_t i = 0; i < 64; ++i) {
+      uint32_t f;
+      uint32_t g;
+      if (i < 16) {
+         f = (b & c) | (~b & d);
+         g = i;
+      } else if (i < 32) {
+         f = (d & b) | (~d & c);
+         g = (5 * i + 1) % 16;
+      } else if (i < 48) {
+         f = b ^ c ^ d;
+         g = (3 * i + 5) % 16;
+      } else {
+         f = c ^ (b | ~d);
+         g = (7 * i) % 16;
+      }
+      uint32_t tmp = d;
+      d = c;
+      c = b;
+      b = b + rotl32(a + f + MD5_K[i] + m[g], MD5_S[i]);
+      a = tmp;
+   }
+
+   m_state[0] += a;
+   m_state[1] += b;
+   m_state[2] += c;
+   m_state[3] += d;
+}
+
+//*****************************************************************************
+
+void MD5Hash::update(const unsigned char* data, size_t length) {
+   m_total_length += length;
+
+   if (m_buffer_length > 0) {
+      size_t fill = std::min(length, sizeof(m_buffer) - m_buffer_length);
+      memcpy(m_buffer + m_buffer_length, data, fill);
+      m_buffer_length += fill;
+      data += fill;
+      length -= fill;
+      if (m_buffer_length < sizeof(m_buffer)) {
+         return;
+      }
+      transform(m_buffer);
+      m_buffer_length = 0;
+   }
+
+   while (length >= sizeof(m_buffer)) {
+      transform(data);
+      data += sizeof(m_buffer);
+      length -= sizeof(m_buffer);
+   }
+
+   if (length > 0) {
+      memcpy(m_buffer, data, length);
+      m_buffer_length = length;
+   }
+}
+
+//*****************************************************************************
+
+string MD5Hash::hex_digest() {
+   uint64_t total_bits = m_total_length * 8;
+
+   // pad with 0x80 then zeros up to 56 bytes mod 64, then the bit length
+   unsigned char padding[72];
+   memset(padding, 0, sizeof(padding));
+   padding[0] = 0x80;
+   size_t pad_length = (m_buffer_length < 56) ? (56 - m_buffer_length)
+                                              : (120 - m_buffer_length);
+   for (int i = 0; i < 8; ++i) {
+      padding[pad_length + i] = (unsigned char) (total_bits >> (8 * i));
+   }
+   update(padding, pad_length + 8);
+
+   unsigned char digest[16];
+   for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 4; ++j) {
+         digest[i*4+j] = (unsigned char) (m_state[i] >> (8 * j));
+      }
+   }
+   return to_hex(digest, sizeof(digest));
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+static const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int n) {
+   return (x << n) | (x >> (64 - n));
+}
+
+static inline uint64_t read_le64(const unsigned char* p) {
+   uint64_t v = 0;
+   for (int i = 7; i >= 0; --i) {
+      v = (v << 8) | p[i];
+   }
+   return v;
+}
+
+static inline uint32_t read_le32(const unsigned char* p) {
+   return (uint32_t) p[0] |
+          ((uint32_t) p[1] << 8) |
+          ((uint32_t) p[2] << 16) |
+          ((uint32_t) p[3] << 24);
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+   acc += input * XXH_PRIME64_2;
+   acc = rotl64(acc, 31);
+   return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val) {
+   acc ^= xxh64_round(0, val);
+   return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+//*****************************************************************************
+
+XXH64Hash::XXH64Hash(uint64_t seed) :
+   ContentHash(XXH64),
+   m_total_length(0),
+   m_buffer_length(0) {
+   m_acc[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+   m_acc[1] = seed + XXH_PRIME64_2;
+   m_acc[2] = seed;
+   m_acc[3] = seed - XXH_PRIME64_1;
+}
+
+//*****************************************************************************
+
+XXH64Hash::~XXH64Hash() {
+}
+
+//*****************************************************************************
+
+void XXH64Hash::update(const unsigned char* data, size_t length) {
+   m_total_length += length;
+
+   if (m_buffer_length > 0) {
+      size_t fill = std::min(length, sizeof(m_buffer) - m_buffer_length);
+      memcpy(m_buffer + m_buffer_length, data, fill);
+      m_buffer_length += fill;
+      data += fill;
+      length -= fill;
+      if (m_buffer_length < sizeof(m_buffer)) {
+         return;
+      }
+      for (int i = 0; i < 4; ++i) {
+         m_acc[i] = xxh64_round(m_acc[i], read_le64(m_buffer + i*8));
+      }
+      m_buffer_length = 0;
+   }
+
+   while (length >= sizeof(m_buffer)) {
+      for (int i = 0; i < 4; ++i) {
+         m_acc[i] = xxh64_round(m_acc[i], read_le64(data + i*8));
+      }
+      data += sizeof(m_buffer);
+      length -= sizeof(m_buffer);
+   }
+
+   if (length > 0) {
+      memcpy(m_buffer, data, length);
+      m_buffer_length = length;
+   }
+}
+
+//*****************************************************************************
+
+string XXH64Hash::hex_digest() {
+   uint64_t h;
+
+   if (m_total_length >= sizeof(m_buffer)) {
+      h = rotl64(m_acc[0], 1) + rotl64(m_acc[1], 7) +
+          rotl64(m_acc[2], 12) + rotl64(m_acc[3], 18);
+      for (int i = 0; i < 4; ++i) {
+         h = xxh64_merge_round(h, m_acc[i]);
+      }
+   } else {
+      // m_acc[2] still holds the seed
+      h = m_acc[2] + XXH_PRIME64_5;
+   }
+
+   h += m_total_length;
+
+   const unsigned char* p = m_buffer;
+   size_t remaining = m_buffer_length;
+
+   while (remaining >= 8) {
+      h ^= xxh64_round(0, read_le64(p));
+      h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+      p += 8;
+      remaining -= 8;
+   }
+
+   if (remaining >= 4) {
+      h ^= (uint64_t) read_le32(p) * XXH_PRIME64_1;
+      h = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+      p += 4;
+      remaining -= 4;
+   }
+
+   while (remaining > 0) {
+      h ^= (*p) * XXH_PRIME64_5;
+      h = rotl64(h, 11) * XXH_PRIME64_1;
+      ++p;
+      --remaining;
+   }
+
+   h ^= h >> 33;
+   h *= XXH_PRIME64_2;
+   h ^= h >> 29;
+   h *= XXH_PRIME64_3;
+   h ^= h >> 32;
+
+   // canonical (big-endian) representation
+   unsigned char digest[8];
+   for (int i = 0; i < 8; ++i) {
+      digest[i] = (unsigned char) (h >> (56 - 8 * i));
+   }
+   return to_hex(digest, sizeof(digest));
+}
+
+//*****************************************************************************
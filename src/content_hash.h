@@ -0,0 +1,107 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+#include "object_stream.h"
+
+
+// Streaming content hashes computed in-process. Data is fed in with
+// update() as it's read or downloaded, so a file never has to be read a
+// second time just to hash it.
+//
+// Song metadata stores hashes as "tagged" digests: MD5 digests are stored
+// as plain hex (as they always have been) and other algorithms are
+// prefixed with their name, e.g. "xxh64:ef46db3751d8e999". This lets each
+// song record which algorithm its hash was made with.
+class ContentHash {
+public:
+   enum Algorithm {
+      MD5,
+      XXH64
+   };
+
+private:
+   Algorithm m_algorithm;
+
+   ContentHash(const ContentHash&);
+   ContentHash& operator=(const ContentHash&);
+
+protected:
+   ContentHash(Algorithm algorithm);
+
+public:
+   virtual ~ContentHash();
+
+   virtual void update(const unsigned char* data, size_t length) = 0;
+
+   // completes the hash. no more data may be added afterwards.
+   virtual std::string hex_digest() = 0;
+
+   Algorithm get_algorithm() const {
+      return m_algorithm;
+   }
+
+   std::string tagged_digest();
+   bool update_from_file(const std::string& file_path);
+
+   static std::unique_ptr<ContentHash> create(Algorithm algorithm);
+
+   // creates a hash of the same algorithm used to make tagged_digest
+   static std::unique_ptr<ContentHash> create_for_tagged_digest(const std::string& tagged_digest);
+
+   static std::string algorithm_name(Algorithm algorithm);
+   static bool algorithm_from_name(const std::string& name,
+                                   Algorithm& algorithm);
+
+   // hex digest of a file's contents, or empty string on error
+   static std::string hash_file(const std::string& file_path,
+                                Algorithm algorithm);
+
+   // pass data through unchanged while feeding it to hash
+   static ObjectSource hashing_source(ContentHash& hash,
+                                      const ObjectSource& source);
+   static ObjectSink hashing_sink(ContentHash& hash,
+                                  const ObjectSink& sink);
+};
+
+
+// MD5 (RFC 1321)
+class MD5Hash : public ContentHash {
+private:
+   uint32_t m_state[4];
+   uint64_t m_total_length;
+   unsigned char m_buffer[64];
+   size_t m_buffer_length;
+
+   void transform(const unsigned char* block);
+
+public:
+   MD5Hash();
+   virtual ~MD5Hash();
+
+   virtual void update(const unsigned char* data, size_t length);
+   virtual std::string hex_digest();
+};
+
+
+// XXH64, a non-cryptographic hash that runs several times faster than MD5.
+// Good for catching corrupt or truncated downloads, not for tamper checks.
+class XXH64Hash : public ContentHash {
+private:
+   uint64_t m_acc[4];
+   uint64_t m_total_length;
+   unsigned char m_buffer[32];
+   size_t m_buffer_length;
+
+public:
+   XXH64Hash(uint64_t seed=0);
+   virtual ~XXH64Hash();
+
+   virtual void update(const unsigned char* data, size_t length);
+   virtual std::string hex_digest();
+};
+
+#endif
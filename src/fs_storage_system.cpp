@@ -34,6 +34,18 @@ void FSStorageSystem::exit() {
 
 //*****************************************************************************
 
+bool FSStorageSystem::supports_concurrent_reads() const {
+   return true;
+}
+
+//*****************************************************************************
+
+bool FSStorageSystem::supports_concurrent_writes() const {
+   return true;
+}
+
+//*****************************************************************************
+
 vector<string> FSStorageSystem::list_account_containers() {
    return OSUtils::listDirsInDirectory(m_root_dir);
 }
@@ -240,11 +252,85 @@ int64_t FSStorageSystem::get_object(const string& container_name,
       string container_dir = OSUtils::pathJoin(m_root_dir, container_name);
       string object_path = OSUtils::pathJoin(container_dir, object_name);
       if (Utils::file_exists(object_path)) {
-         vector<unsigned char> obj_file_contents;
-         if (Utils::file_read_all_bytes(object_path, obj_file_contents)) {
-            if (Utils::file_write_all_bytes(local_file_path, obj_file_contents)) {
-               bytes_retrieved = obj_file_contents.size();
+         // a whole-file copy lets the kernel move (or share) the data
+         // rather than pumping it through our buffers
+         if (Utils::file_copy(object_path, local_file_path)) {
+            bytes_retrieved = Utils::get_file_size(local_file_path);
+         }
+         if (bytes_retrieved <= 0) {
+            bytes_retrieved = 0;
+            Utils::file_delete(local_file_path);
+         }
+      }
+   }
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
+
+bool FSStorageSystem::put_object_stream(const string& container_name,
+                                        const string& object_name,
+                                        const ObjectSource& source,
+                                        const PropertySet* headers) {
+   bool object_added = false;
+   if (!container_name.empty() && !object_name.empty()) {
+
+      string container_dir = OSUtils::pathJoin(m_root_dir, container_name);
+      if (OSUtils::directoryExists(container_dir)) {
+         string object_path = OSUtils::pathJoin(container_dir, object_name);
+         int64_t bytes_written = ObjectStream::source_to_file(source, object_path);
+         if (bytes_written > 0) {
+            object_added = true;
+            if (debug_mode()) {
+               printf("object added: %s/%s\n", container_name.c_str(), object_name.c_str());
+            }
+            if (headers != nullptr) {
+               if (headers->count() > 0) {
+                  string meta_path = object_path + ".meta";
+                  headers->write_to_file(meta_path);
+               }
             }
+         } else {
+            if (bytes_written == 0) {
+               Utils::file_delete(object_path);
+               if (debug_mode()) {
+                  printf("object content is empty, can't put object\n");
+               }
+            } else {
+               printf("unable to write object contents, put failed\n");
+            }
+         }
+      } else {
+         if (debug_mode()) {
+            printf("container doesn't exist, can't put object\n");
+         }
+      }
+   } else {
+      if (debug_mode()) {
+         if (container_name.empty()) {
+            printf("container name is missing, can't put object\n");
+         }
+         if (object_name.empty()) {
+            printf("object name is missing, can't put object\n");
+         }
+      }
+   }
+   return object_added;
+}
+
+//*****************************************************************************
+
+int64_t FSStorageSystem::get_object_stream(const string& container_name,
+                                           const string& object_name,
+                                           const ObjectSink& sink) {
+   int64_t bytes_retrieved = 0;
+   if (!container_name.empty() && !object_name.empty()) {
+      string container_dir = OSUtils::pathJoin(m_root_dir, container_name);
+      string object_path = OSUtils::pathJoin(container_dir, object_name);
+      if (Utils::file_exists(object_path)) {
+         bytes_retrieved = ObjectStream::file_to_sink(object_path, sink);
+         if (bytes_retrieved < 0) {
+            bytes_retrieved = 0;
          }
       }
    }
@@ -253,3 +339,43 @@ int64_t FSStorageSystem::get_object(const string& container_name,
 
 //*****************************************************************************
 
+int64_t FSStorageSystem::get_object_range(const string& container_name,
+                                          const string& object_name,
+                                          int64_t offset,
+                                          int64_t length,
+                                          const ObjectSink& sink) {
+   int64_t bytes_retrieved = 0;
+   if (!container_name.empty() && !object_name.empty() && offset >= 0) {
+      string container_dir = OSUtils::pathJoin(m_root_dir, container_name);
+      string object_path = OSUtils::pathJoin(container_dir, object_name);
+      FILE* f = fopen(object_path.c_str(), "rb");
+      if (f != nullptr) {
+         if (fseeko(f, offset, SEEK_SET) == 0) {
+            int64_t bytes_remaining = length;
+            ObjectSource source = ObjectStream::file_source(f);
+            ObjectSource range_source =
+               [&](unsigned char* buffer, size_t max_bytes) -> int64_t {
+                  if (length > 0) {
+                     if (bytes_remaining <= 0) {
+                        return 0;
+                     }
+                     max_bytes = std::min((int64_t) max_bytes, bytes_remaining);
+                  }
+                  int64_t bytes_read = source(buffer, max_bytes);
+                  if (bytes_read > 0) {
+                     bytes_remaining -= bytes_read;
+                  }
+                  return bytes_read;
+               };
+            bytes_retrieved = ObjectStream::pump(range_source, sink);
+            if (bytes_retrieved < 0) {
+               bytes_retrieved = 0;
+            }
+         }
+         fclose(f);
+      }
+   }
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
@@ -23,6 +23,9 @@ public:
    bool enter();
    void exit();
 
+   bool supports_concurrent_reads() const;
+   bool supports_concurrent_writes() const;
+
    std::vector<std::string> list_account_containers();
 
    bool create_container(const std::string& container_name);
@@ -51,6 +54,21 @@ public:
    int64_t get_object(const std::string& container_name,
                       const std::string& object_name,
                       const std::string& local_file_path);
+
+   bool put_object_stream(const std::string& container_name,
+                          const std::string& object_name,
+                          const ObjectSource& source,
+                          const PropertySet* headers=nullptr);
+
+   int64_t get_object_stream(const std::string& container_name,
+                             const std::string& object_name,
+                             const ObjectSink& sink);
+
+   int64_t get_object_range(const std::string& container_name,
+                            const std::string& object_name,
+                            int64_t offset,
+                            int64_t length,
+                            const ObjectSink& sink);
 };
 
 #endif
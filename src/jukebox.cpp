@@ -1,8 +1,11 @@
 // jukebox.cpp
 
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <random>
@@ -10,9 +13,14 @@
 
 #include "jukebox.h"
 #include "jukebox_db.h"
+#include "metadata_sync.h"
 #include "file_metadata.h"
 #include "song_metadata.h"
 #include "song_downloader.h"
+#include "song_importer.h"
+#include "signal_listener.h"
+#include "parallel_download.h"
+#include "content_hash.h"
 #include "jb_utils.h"
 #include "utils.h"
 #include "IniReader.h"
@@ -26,41 +34,80 @@ using namespace std;
 using json = nlohmann::json;
 using namespace chaudiere;
 
-static Jukebox* g_jukebox_instance = nullptr;
-
 static const string JSON_FILE_EXT = ".json";
 static const string ini_file_name = "audio_player.ini";
+// number of imported songs written to the database per transaction
+static const unsigned int IMPORT_METADATA_BATCH_SIZE = 2000;
+// most songs listed for a search
+static const int SEARCH_MAX_RESULTS = 50;
+// number of metadata deltas published before they're compacted into a
+// new snapshot of the metadata DB
+static const unsigned int METADATA_COMPACTION_INTERVAL = 50;
+
+// metrics kept in m_stats (see define_stats)
+static const string STAT_DOWNLOAD_QUEUE_DEPTH = "jukebox_download_queue_depth";
+static const string STAT_DOWNLOADS_IN_FLIGHT = "jukebox_downloads_in_flight";
+static const string STAT_DOWNLOAD_BYTES = "jukebox_download_bytes_total";
+static const string STAT_SONGS_DOWNLOADED = "jukebox_songs_downloaded_total";
+static const string STAT_CACHE_HITS = "jukebox_song_cache_hits_total";
+static const string STAT_CACHE_MISSES = "jukebox_song_cache_misses_total";
+static const string STAT_CACHE_HIT_RATIO = "jukebox_song_cache_hit_ratio";
+static const string STAT_PLAYER_STARTS = "jukebox_player_starts_total";
+static const string STAT_PLAYER_RESTARTS = "jukebox_player_restarts_total";
+static const string STAT_PLAYER_FAILURES = "jukebox_player_failures_total";
+static const string STAT_SUCCESSIVE_PLAY_FAILURES = "jukebox_successive_play_failures";
+static const string STAT_IMPORT_SONGS = "jukebox_import_songs_total";
+static const string STAT_UPLOAD_BYTES = "jukebox_upload_bytes_total";
+static const string STAT_IMPORT_SECONDS = "jukebox_import_seconds_total";
+static const string STAT_IMPORT_UPLOAD_SECONDS = "jukebox_import_upload_stage_seconds_total";
+static const string STAT_IMPORT_METADATA_SECONDS = "jukebox_import_metadata_stage_seconds_total";
 
+//*****************************************************************************
 //*****************************************************************************
 
-void signal_handler(int signum) {
-   if (g_jukebox_instance != nullptr) {
-      if (signum == SIGUSR1) {
-         g_jukebox_instance->toggle_pause_play();
-      } else if (signum == SIGUSR2) {
-         g_jukebox_instance->advance_to_next_song();
-      } else if (signum == SIGINT) {
-         g_jukebox_instance->prepare_for_termination();
-      } else if (signum == SIGWINCH) {
-         g_jukebox_instance->display_info();
-      }
+// runs one part of startup on its own thread
+class StartupTask : public Runnable {
+private:
+   std::function<void()> m_task;
+   std::mutex m_mutex;
+   std::condition_variable m_cond_done;
+   bool m_done;
+
+   StartupTask(const StartupTask&);
+   StartupTask& operator=(const StartupTask&);
+
+public:
+   explicit StartupTask(const std::function<void()>& task) :
+      m_task(task),
+      m_done(false) {
    }
-}
 
-//*****************************************************************************
+   virtual void run() {
+      m_task();
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_done = true;
+      }
+      m_cond_done.notify_all();
+   }
 
-void install_signal_handlers() {
-   signal(SIGUSR1, signal_handler);
-   signal(SIGUSR2, signal_handler);
-   signal(SIGINT, signal_handler);
-   signal(SIGWINCH, signal_handler);
-}
+   void wait() {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond_done.wait(lock, [this] { return m_done; });
+   }
+};
 
+//*****************************************************************************
 //*****************************************************************************
 
 Jukebox::Jukebox(const JukeboxOptions& jb_options,
                  StorageSystem& storage_sys,
                  bool debugging) :
+   m_song_cache_loaded(false),
+   m_tail_download_active(false),
+   m_tail_bytes_on_disk(0),
+   m_stream_feeder_active(false),
+   m_stream_stopping(false),
    m_jukebox_options(jb_options),
    m_storage_system(storage_sys),
    m_debug_print(debugging),
@@ -72,7 +119,10 @@ Jukebox::Jukebox(const JukeboxOptions& jb_options,
    m_album_art_container("album-art"),
    m_number_songs(0),
    m_song_index(-1),
+   m_audio_player_config_read(false),
+   m_audio_player_configured(false),
    m_audio_player_process(-1),
+   m_player_stopped(false),
    m_cumulative_download_bytes(0),
    m_cumulative_download_time(0.0),
    m_exit_requested(false),
@@ -80,13 +130,10 @@ Jukebox::Jukebox(const JukeboxOptions& jb_options,
    m_song_start_time(0.0),
    m_song_seconds_offset(0),
    m_player_active(false),
-   m_downloader_ready_to_delete(false),
    m_num_successive_play_failures(0),
    m_song_play_is_resume(false),
    m_is_repeat_mode(false)
 {
-   g_jukebox_instance = this;
-
    m_current_dir = OSUtils::getCurrentDirectory();
    m_song_import_dir = OSUtils::pathJoin(m_current_dir, "song-import");
    m_playlist_import_dir = OSUtils::pathJoin(m_current_dir, "playlist-import");
@@ -98,6 +145,8 @@ Jukebox::Jukebox(const JukeboxOptions& jb_options,
       m_debug_print = true;
    }
 
+   define_stats();
+
    if (m_debug_print) {
       printf("current_dir = %s\n", m_current_dir.c_str());
       printf("song_import_dir = %s\n", m_song_import_dir.c_str());
@@ -108,69 +157,74 @@ Jukebox::Jukebox(const JukeboxOptions& jb_options,
 //*****************************************************************************
 
 Jukebox::~Jukebox() {
-   g_jukebox_instance = nullptr;
-
    exit();
 }
 
 //*****************************************************************************
 
-bool Jukebox::enter() {
+bool Jukebox::enter(unsigned int startup_plan) {
    if (m_debug_print) {
       printf("Jukebox.enter\n");
    }
 
-   // look for stored metadata in the storage system
-   if (m_storage_system.has_container(m_metadata_container) &&
-       !m_jukebox_options.get_suppress_metadata_download()) {
+   if (!m_stats_exporter &&
+       (!m_jukebox_options.get_stats_prometheus_file().empty() ||
+        !m_jukebox_options.get_stats_json_file().empty())) {
+      m_stats_exporter.reset(
+         new StatsExporter(m_stats,
+                           m_jukebox_options.get_stats_prometheus_file(),
+                           m_jukebox_options.get_stats_json_file(),
+                           m_jukebox_options.get_stats_interval_secs()));
+      if (!m_stats_exporter->start()) {
+         m_stats_exporter.reset();
+      }
+   }
 
-      // metadata container exists, retrieve container listing
-      vector<string> container_contents =
-         m_storage_system.list_container_contents(m_metadata_container);
+   // the audio player config is local, so it's read while the catalog
+   // waits on the storage system
+   unique_ptr<StartupTask> player_setup;
+   unique_ptr<PthreadsThread> player_thread;
+   if (startup_plan & STARTUP_AUDIO_PLAYER) {
+      player_setup.reset(new StartupTask([this]() {
+         read_audio_player_config();
+      }));
+      player_thread.reset(new PthreadsThread(player_setup.get()));
+      if (!player_thread->start()) {
+         player_setup->run();
+      }
+   }
 
-      bool metadata_db_file_found = false;
+   bool success = true;
+   if (startup_plan & STARTUP_CATALOG) {
+      success = enter_catalog();
+   }
 
-      for (const auto& object_name : container_contents) {
-         if (object_name == m_metadata_db_file) {
-            metadata_db_file_found = true;
-            break;
-         }
-      }
+   if (player_setup) {
+      player_setup->wait();
+      player_thread.reset();
+   }
 
-      // does our metadata DB file exist in the metadata container?
-      if (metadata_db_file_found) {
-         //printf("metadata DB file exists in container, attempting to download\n");
+   return success;
+}
 
-         // download it
-         string metadata_db_file_path = get_metadata_db_file_path();
-         string download_file = metadata_db_file_path + ".download";
+//*****************************************************************************
 
-         //printf("downloading metadata DB to %s\n", download_file.c_str());
-         if (m_storage_system.get_object(m_metadata_container,
-                                         m_metadata_db_file,
-                                         download_file) > 0) {
-            // have an existing metadata DB file?
-            if (Utils::path_exists(metadata_db_file_path)) {
-               if (m_debug_print) {
-                  printf("deleting existing metadata DB file\n");
-               }
-               OSUtils::deleteFile(metadata_db_file_path);
-            }
-            // rename downloaded file
-            if (m_debug_print) {
-               printf("renaming %s to %s\n",
-                      download_file.c_str(),
-                      metadata_db_file_path.c_str());
-            }
-            Utils::rename_file(download_file, metadata_db_file_path);
-         } else {
-            if (m_debug_print) {
-               printf("error: unable to retrieve metadata DB file\n");
-            }
-         }
-      } else {
+bool Jukebox::enter_catalog() {
+   m_jukebox_db.reset(new JukeboxDB(get_metadata_db_file_path()));
+   m_metadata_sync.reset(new MetadataSync(m_storage_system,
+                                          m_metadata_container,
+                                          m_metadata_db_file,
+                                          get_metadata_db_file_path(),
+                                          METADATA_COMPACTION_INTERVAL,
+                                          m_debug_print));
+
+   // bring the local metadata DB up to date with the one in the storage
+   // system, downloading only the changes it hasn't seen
+   if (m_storage_system.has_container(m_metadata_container) &&
+       !m_jukebox_options.get_suppress_metadata_download()) {
+      if (!m_metadata_sync->pull(*m_jukebox_db)) {
          if (m_debug_print) {
-            printf("no metadata DB file in metadata container\n");
+            printf("error: unable to retrieve metadata DB\n");
          }
       }
    } else {
@@ -179,8 +233,7 @@ bool Jukebox::enter() {
       }
    }
 
-   m_jukebox_db.reset(new JukeboxDB(get_metadata_db_file_path()));
-   if (!m_jukebox_db->open()) {
+   if (!m_jukebox_db->is_open() && !m_jukebox_db->open()) {
       printf("unable to connect to database\n");
       return false;
    }
@@ -195,17 +248,42 @@ void Jukebox::exit() {
       printf("Jukebox.exit\n");
    }
 
+   if (m_signal_listener) {
+      m_signal_listener->stop();
+      m_signal_listener.reset();
+   }
+
+   if (m_download_pool) {
+      m_download_pool->stop();
+      m_download_pool.reset();
+   }
+
+   wait_for_tail_download();
+
+   if (m_song_cache_loaded) {
+      m_cache_index.save(m_song_play_dir);
+   }
+
    if (m_jukebox_db) {
       if (m_jukebox_db->is_open()) {
          m_jukebox_db->close();
       }
       m_jukebox_db.reset();
    }
+   m_metadata_sync.reset();
+
+   // the downloads have stopped, so these are the session's totals
+   if (m_stats_exporter) {
+      m_stats_exporter->stop();
+      m_stats_exporter.reset();
+   }
+   m_storage_system.show_stats();
 }
 
 //*****************************************************************************
 
 void Jukebox::toggle_pause_play() {
+   std::lock_guard<std::mutex> lock(m_event_mutex);
    m_is_paused = !m_is_paused;
    m_num_successive_play_failures = 0;
    if (m_is_paused) {
@@ -214,20 +292,24 @@ void Jukebox::toggle_pause_play() {
          // capture current song position (seconds into song)
          kill(m_audio_player_process, SIGTERM);
          m_audio_player_process = -1;
+         m_player_stopped = true;
       }
    } else {
       printf("resuming play\n");
       m_song_play_is_resume = true;
    }
+   m_event_cv.notify_all();
 }
 
 //*****************************************************************************
 
 void Jukebox::advance_to_next_song() {
    printf("advancing to next song\n");
+   std::lock_guard<std::mutex> lock(m_event_mutex);
    if (m_audio_player_process > 0) {
       kill(m_audio_player_process, SIGTERM);
       m_audio_player_process = -1;
+      m_player_stopped = true;
       m_num_successive_play_failures = 0;
       m_song_play_is_resume = false;
    }
@@ -329,17 +411,7 @@ void Jukebox::vector_to_string(const vector<unsigned char>& v, string& s) {
 //*****************************************************************************
 
 bool Jukebox::store_song_metadata(const SongMetadata& fs_song) {
-   SongMetadata db_song;
-   if (m_jukebox_db->retrieve_song(fs_song.get_file_uid(), db_song)) {
-      if (fs_song != db_song) {
-         return m_jukebox_db->update_song(fs_song);
-      } else {
-         return true;  // no insert or update needed (already up-to-date)
-      }
-   } else {
-      // song is not in the database, insert it
-      return m_jukebox_db->insert_song(fs_song);
-   }
+   return m_jukebox_db->store_song_metadata(fs_song);
 }
 
 //*****************************************************************************
@@ -421,7 +493,7 @@ void Jukebox::import_songs() {
       float num_entries = (float) dir_listing.size();
       double progressbar_chars = 0.0;
       int progressbar_width = 40;
-      int progress_chars_per_iteration = (int) (progressbar_width / num_entries);
+      double progress_chars_per_iteration = progressbar_width / num_entries;
       char progressbar_char = '#';
       int bar_chars = 0;
 
@@ -442,131 +514,28 @@ void Jukebox::import_songs() {
       //   encryption = nullptr;
       //}
 
-      double cumulative_upload_time = 0.0;
-      int cumulative_upload_bytes = 0;
-      int file_import_count = 0;
-
-      for (const auto& listing_entry : dir_listing) {
-         string full_path = OSUtils::pathJoin(m_song_import_dir,
-                                              listing_entry);
-         // ignore it if it's not a file
-         if (Utils::path_isfile(full_path)) {
-            string file_name = listing_entry;
-            vector<string> path_elems;
-            Utils::path_splitext(full_path, path_elems);
-            const string& extension = path_elems[1];
-            if (!extension.empty()) {
-               long file_size = Utils::get_file_size(full_path);
-               string artist = artist_from_file_name(file_name);
-               string album = album_from_file_name(file_name);
-               string song = song_from_file_name(file_name);
-               if (file_size > 0 &&
-                   !artist.empty() &&
-                   !album.empty() &&
-                   !song.empty()) {
-
-                  string object_name = file_name + object_file_suffix();
-                  SongMetadata fs_song;
-                  fs_song.set_file_uid(object_name);
-                  fs_song.set_album_uid("");
-                  fs_song.set_origin_file_size((int) file_size);
-                  fs_song.set_file_time(
-                     Utils::datetime_datetime_fromtimestamp(Utils::path_getmtime(full_path)));
-                  fs_song.set_artist_name(artist);
-                  fs_song.set_song_name(song);
-                  fs_song.set_md5_hash(Utils::md5_for_file(ini_file_name, full_path));
-                  fs_song.set_compressed(m_jukebox_options.get_use_compression() ? 1 : 0);
-                  fs_song.set_encrypted(m_jukebox_options.get_use_encryption() ? 1 : 0);
-                  fs_song.set_object_name(object_name);
-                  fs_song.set_pad_char_count(0);
-
-                  fs_song.set_container_name(container_for_song(file_name));
-
-                  // read file contents
-                  bool file_read = false;
-                  vector<unsigned char> file_contents;
-
-                  if (Utils::file_read_all_bytes(full_path, file_contents)) {
-                     file_read = true;
-                  } else {
-                     printf("error: unable to read file %s\n", full_path.c_str());
-                  }
-
-                  if (file_read && !file_contents.empty()) {
-                     if (!file_contents.empty()) {
-                        // for general purposes, it might be useful or helpful to have
-                        // a minimum size for compressing
-                        if (m_jukebox_options.get_use_compression()) {
-                           if (m_debug_print) {
-                              printf("compressing file\n");
-                           }
-
-                           //FUTURE: compression (import_songs)
-                           //file_bytes = bytes(file_contents, 'utf-8');
-                           //file_contents = zlib.compress(file_bytes, 9);
-                        }
+      // songs are uploaded by the importer's worker threads while this
+      // thread keeps scanning; metadata is stored on the importer's
+      // metadata thread, which is the only one touching the database
+      // until finish() returns
+      SongImporter importer(m_storage_system,
+                            m_jukebox_options,
+                            [this](const SongMetadata& fs_song) -> bool {
+                               if (!m_jukebox_db->in_transaction()) {
+                                  m_jukebox_db->begin_transaction();
+                               }
+                               return store_song_metadata(fs_song);
+                            });
+
+      // one commit per batch rather than one per song
+      importer.set_metadata_commit([this]() -> bool {
+                                      return m_jukebox_db->commit_transaction();
+                                   },
+                                   IMPORT_METADATA_BATCH_SIZE);
 
-                        if (m_jukebox_options.get_use_encryption()) {
-                           if (m_debug_print) {
-                              printf("encrypting file\n");
-                           }
-
-                           //FUTURE: encryption (import_songs)
-
-                           // the length of the data to encrypt must be a multiple of 16
-                           //num_extra_chars = file_contents.Length % 16;
-                           //if (num_extra_chars > 0) {
-                           //   if (debug_print) {
-                           //      printf("padding file for encryption\n");
-                           //   }
-                           //   num_pad_chars = 16 - num_extra_chars;
-                           //   file_contents += "".ljust(num_pad_chars, ' ');
-                           //   fs_song.fm.pad_char_count = num_pad_chars;
-                           //}
-
-                           //file_contents = encryption.encrypt(file_contents);
-                        }
-                     }
-
-                     // now that we have the data that will be stored, set the file size for
-                     // what's being stored
-                     fs_song.set_stored_file_size(file_contents.size());
-                     double start_upload_time = Utils::time_time();
-
-                     // store song file to storage system
-                     if (m_storage_system.put_object(fs_song.get_container_name(),
-                                                     fs_song.get_object_name(),
-                                                     file_contents,
-                                                     nullptr)) {
-                        double end_upload_time = Utils::time_time();
-                        double upload_elapsed_time = end_upload_time - start_upload_time;
-                        cumulative_upload_time += upload_elapsed_time;
-                        cumulative_upload_bytes += file_contents.size();
-
-                        // store song metadata in local database
-                        if (!store_song_metadata(fs_song)) {
-                           // we stored the song to the storage system, but were unable to store
-                           // the metadata in the local database. we need to delete the song
-                           // from the storage system since we won't have any way to access it
-                           // since we can't store the song metadata locally.
-                           printf("unable to store metadata, deleting obj %s\n",
-                                  fs_song.get_object_name().c_str());
-
-                           m_storage_system.delete_object(fs_song.get_container_name(),
-                                                          fs_song.get_object_name());
-                        } else {
-                           file_import_count += 1;
-                        }
-                     } else {
-                        printf("error: unable to upload %s to %s\n",
-                               fs_song.get_object_name().c_str(),
-                               fs_song.get_container_name().c_str());
-                     }
-                  }
-               }
-            }
-
-            if (!m_debug_print) {
+      if (!m_debug_print) {
+         importer.set_progress_callback(
+            [&](const SongMetadata& fs_song, bool imported) {
                progressbar_chars += progress_chars_per_iteration;
                if (progressbar_chars > bar_chars) {
                   int num_new_chars = (int) (progressbar_chars - bar_chars);
@@ -579,10 +548,67 @@ void Jukebox::import_songs() {
                      bar_chars += num_new_chars;
                   }
                }
+            });
+      }
+
+      if (m_debug_print) {
+         printf("importing with %u upload workers\n",
+                importer.get_num_upload_workers());
+      }
+
+      if (importer.start()) {
+         for (const auto& listing_entry : dir_listing) {
+            string full_path = OSUtils::pathJoin(m_song_import_dir,
+                                                 listing_entry);
+            // ignore it if it's not a file
+            if (Utils::path_isfile(full_path)) {
+               string file_name = listing_entry;
+               vector<string> path_elems;
+               Utils::path_splitext(full_path, path_elems);
+               const string& extension = path_elems[1];
+               if (!extension.empty()) {
+                  long file_size = Utils::get_file_size(full_path);
+                  string artist = artist_from_file_name(file_name);
+                  string album = album_from_file_name(file_name);
+                  string song = song_from_file_name(file_name);
+                  if (file_size > 0 &&
+                      !artist.empty() &&
+                      !album.empty() &&
+                      !song.empty()) {
+
+                     string object_name = file_name + object_file_suffix();
+                     SongMetadata fs_song;
+                     fs_song.set_file_uid(object_name);
+                     fs_song.set_artist_uid(JBUtils::encode_value(artist));
+                     fs_song.set_album_uid(JBUtils::encode_artist_album(artist, album));
+                     fs_song.set_origin_file_size((int) file_size);
+                     fs_song.set_file_time(
+                        Utils::datetime_datetime_fromtimestamp(Utils::path_getmtime(full_path)));
+                     fs_song.set_artist_name(artist);
+                     fs_song.set_song_name(song);
+                     fs_song.set_compressed(m_jukebox_options.get_use_compression() ? 1 : 0);
+                     fs_song.set_encrypted(m_jukebox_options.get_use_encryption() ? 1 : 0);
+                     fs_song.set_object_name(object_name);
+                     fs_song.set_pad_char_count(0);
+
+                     fs_song.set_container_name(container_for_song(file_name));
+
+                     // blocks while the upload workers are busy
+                     importer.add(fs_song, full_path);
+                  }
+               }
             }
          }
       }
 
+      importer.finish();
+
+      m_stats.add(STAT_IMPORT_SONGS, importer.get_import_count());
+      m_stats.add(STAT_UPLOAD_BYTES, importer.get_upload_bytes());
+      m_stats.add(STAT_IMPORT_SECONDS, importer.get_elapsed_time());
+      m_stats.add(STAT_IMPORT_UPLOAD_SECONDS, importer.get_upload_stage_time());
+      m_stats.add(STAT_IMPORT_METADATA_SECONDS, importer.get_metadata_stage_time());
+
       if (!m_debug_print) {
          // if we haven't filled up the progress bar, fill it now
          if (bar_chars < progressbar_width) {
@@ -595,6 +621,8 @@ void Jukebox::import_songs() {
          printf("\n");
       }
 
+      int file_import_count = importer.get_import_count();
+
       if (file_import_count > 0) {
          upload_metadata_db();
       } else {
@@ -603,8 +631,9 @@ void Jukebox::import_songs() {
 
       printf("%d song files imported\n", file_import_count);
 
-      if (cumulative_upload_time > 0) {
-         double cumulative_upload_kb = cumulative_upload_bytes / 1000.0;
+      double cumulative_upload_time = importer.get_elapsed_time();
+      if (file_import_count > 0 && cumulative_upload_time > 0) {
+         double cumulative_upload_kb = importer.get_upload_bytes() / 1000.0;
          int avg = (int) (cumulative_upload_kb / cumulative_upload_time);
          printf("average upload throughput = %d KB/sec\n", avg);
       }
@@ -619,7 +648,8 @@ string Jukebox::song_path_in_playlist(const SongMetadata& song) {
 
 //*****************************************************************************
 
-bool Jukebox::check_file_integrity(const SongMetadata& song) {
+bool Jukebox::check_file_integrity(const SongMetadata& song,
+                                   ContentHash* download_hash) {
    bool file_integrity_passed = true;
 
    if (m_jukebox_options.get_check_data_integrity()) {
@@ -629,8 +659,20 @@ bool Jukebox::check_file_integrity(const SongMetadata& song) {
             printf("checking integrity for %s\n", song.get_file_uid().c_str());
          }
 
-         string playlist_md5 = Utils::md5_for_file(ini_file_name, file_path);
-         if (playlist_md5 == song.get_md5_hash()) {
+         // use the hash computed during the download if there is one,
+         // otherwise read the file back with the song's hash algorithm
+         string playlist_hash;
+         if (download_hash != nullptr) {
+            playlist_hash = download_hash->tagged_digest();
+         } else {
+            unique_ptr<ContentHash> file_hash =
+               ContentHash::create_for_tagged_digest(song.get_md5_hash());
+            if (file_hash->update_from_file(file_path)) {
+               playlist_hash = file_hash->tagged_digest();
+            }
+         }
+
+         if (!playlist_hash.empty() && playlist_hash == song.get_md5_hash()) {
             if (m_debug_print) {
                printf("integrity check SUCCESS\n");
             }
@@ -657,6 +699,7 @@ bool Jukebox::check_file_integrity(const SongMetadata& song) {
 //*****************************************************************************
 
 void Jukebox::batch_download_start() {
+   std::lock_guard<std::mutex> lock(m_download_stats_mutex);
    m_cumulative_download_bytes = 0;
    m_cumulative_download_time = 0.0;
 }
@@ -664,6 +707,7 @@ void Jukebox::batch_download_start() {
 //*****************************************************************************
 
 void Jukebox::batch_download_complete() {
+   std::lock_guard<std::mutex> lock(m_download_stats_mutex);
    if (!m_exit_requested) {
       if (m_cumulative_download_time > 0) {
          double cumulative_download_kb = m_cumulative_download_bytes / 1000.0;
@@ -678,9 +722,81 @@ void Jukebox::batch_download_complete() {
 
 //*****************************************************************************
 
+void Jukebox::download_queue_changed(size_t queued, size_t in_flight) {
+   m_stats.set(STAT_DOWNLOAD_QUEUE_DEPTH, queued);
+   m_stats.set(STAT_DOWNLOADS_IN_FLIGHT, in_flight);
+}
+
+//*****************************************************************************
+
+void Jukebox::download_cancelled(const SongMetadata& song) {
+   // so that it's downloaded again the next time it's needed
+   m_cache_index.set_state(song.get_file_uid(), SongCacheIndex::NOT_PRESENT);
+}
+
+//*****************************************************************************
+
+const StatsRegistry& Jukebox::get_stats() const {
+   return m_stats;
+}
+
+//*****************************************************************************
+
+void Jukebox::define_stats() {
+   m_stats.define(STAT_DOWNLOAD_QUEUE_DEPTH, StatsRegistry::GAUGE,
+                  "Songs waiting for a download worker");
+   m_stats.define(STAT_DOWNLOADS_IN_FLIGHT, StatsRegistry::GAUGE,
+                  "Songs queued or downloading");
+   m_stats.define(STAT_DOWNLOAD_BYTES, StatsRegistry::COUNTER,
+                  "Song bytes downloaded");
+   m_stats.define(STAT_SONGS_DOWNLOADED, StatsRegistry::COUNTER,
+                  "Songs downloaded in full");
+   m_stats.define(STAT_CACHE_HITS, StatsRegistry::COUNTER,
+                  "Songs already on disk when their turn to play came");
+   m_stats.define(STAT_CACHE_MISSES, StatsRegistry::COUNTER,
+                  "Songs still to be downloaded when their turn to play came");
+   m_stats.define(STAT_CACHE_HIT_RATIO, StatsRegistry::GAUGE,
+                  "Song cache hits over all lookups");
+   m_stats.define(STAT_PLAYER_STARTS, StatsRegistry::COUNTER,
+                  "Audio player launches to play a song from its start");
+   m_stats.define(STAT_PLAYER_RESTARTS, StatsRegistry::COUNTER,
+                  "Audio player relaunches to resume a paused song");
+   m_stats.define(STAT_PLAYER_FAILURES, StatsRegistry::COUNTER,
+                  "Audio player launches that failed or exited with an error");
+   m_stats.define(STAT_SUCCESSIVE_PLAY_FAILURES, StatsRegistry::GAUGE,
+                  "Audio player failures since the last song played");
+   m_stats.define(STAT_IMPORT_SONGS, StatsRegistry::COUNTER,
+                  "Songs imported");
+   m_stats.define(STAT_UPLOAD_BYTES, StatsRegistry::COUNTER,
+                  "Song bytes uploaded by imports");
+   m_stats.define(STAT_IMPORT_SECONDS, StatsRegistry::COUNTER,
+                  "Wall-clock seconds spent importing");
+   m_stats.define(STAT_IMPORT_UPLOAD_SECONDS, StatsRegistry::COUNTER,
+                  "Seconds import upload workers spent uploading, summed over workers");
+   m_stats.define(STAT_IMPORT_METADATA_SECONDS, StatsRegistry::COUNTER,
+                  "Seconds the import metadata stage spent storing songs");
+}
+
+//*****************************************************************************
+
+void Jukebox::count_song_cache_lookup(bool hit) {
+   m_stats.add(hit ? STAT_CACHE_HITS : STAT_CACHE_MISSES);
+   double hits = m_stats.get(STAT_CACHE_HITS);
+   double misses = m_stats.get(STAT_CACHE_MISSES);
+   m_stats.set(STAT_CACHE_HIT_RATIO, hits / (hits + misses));
+}
+
+//*****************************************************************************
+
 void Jukebox::notifyRunComplete(Runnable* runnable) {
-   if (runnable == m_downloader.get()) {
-      m_downloader_ready_to_delete = true;
+   if (runnable == m_tail_downloader.get()) {
+      std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+      m_tail_download_active = false;
+      m_tail_download_cv.notify_all();
+   } else if (runnable == m_stream_feeder.get()) {
+      std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+      m_stream_feeder_active = false;
+      m_tail_download_cv.notify_all();
    }
 }
 
@@ -700,14 +816,51 @@ bool Jukebox::download_song(const SongMetadata& song) {
 
    string file_path = song_path_in_playlist(song);
    double download_start_time = Utils::time_time();
-   unsigned long song_bytes_retrieved =
-      m_storage_system.retrieve_file(song.get_file_metadata(), m_song_play_dir);
+   unsigned long song_bytes_retrieved = 0;
+   unique_ptr<ContentHash> download_hash;
+   int64_t parallel_download_bytes =
+      (int64_t) m_jukebox_options.get_parallel_download_mb() * 1024 * 1024;
+   if (parallel_download_bytes > 0 &&
+       (int64_t) song.get_stored_file_size() >= parallel_download_bytes) {
+      song_bytes_retrieved =
+         ParallelDownload::get_object(m_storage_system,
+                                      song.get_container_name(),
+                                      song.get_object_name(),
+                                      file_path,
+                                      song.get_stored_file_size(),
+                                      m_jukebox_options.get_parallel_download_ranges());
+   } else if (m_jukebox_options.get_check_data_integrity()) {
+      // hash the song as it arrives so it doesn't have to be read back
+      download_hash = ContentHash::create_for_tagged_digest(song.get_md5_hash());
+      FILE* f = fopen(file_path.c_str(), "wb");
+      if (f != nullptr) {
+         ObjectSink sink =
+            ContentHash::hashing_sink(*download_hash, ObjectStream::file_sink(f));
+         int64_t bytes_retrieved =
+            m_storage_system.get_object_stream(song.get_container_name(),
+                                               song.get_object_name(),
+                                               sink);
+         fclose(f);
+         if (bytes_retrieved > 0) {
+            song_bytes_retrieved = bytes_retrieved;
+         }
+      } else {
+         printf("error: unable to open %s\n", file_path.c_str());
+      }
+   } else {
+      song_bytes_retrieved =
+         m_storage_system.retrieve_file(song.get_file_metadata(), m_song_play_dir);
+   }
    if (m_debug_print) {
       printf("song_bytes_retrieved = %ld\n", song_bytes_retrieved);
    }
 
    if (m_exit_requested) {
       printf("download_song returning false because exit_requested\n");
+      if (song_bytes_retrieved != song.get_stored_file_size() &&
+          Utils::file_exists(file_path)) {
+         Utils::file_delete(file_path);
+      }
       return false;
    }
 
@@ -718,8 +871,13 @@ bool Jukebox::download_song(const SongMetadata& song) {
    if (song_bytes_retrieved > 0) {
       double download_end_time = Utils::time_time();
       double download_elapsed_time = download_end_time - download_start_time;
-      m_cumulative_download_time += download_elapsed_time;
-      m_cumulative_download_bytes += song_bytes_retrieved;
+      {
+         std::lock_guard<std::mutex> lock(m_download_stats_mutex);
+         m_cumulative_download_time += download_elapsed_time;
+         m_cumulative_download_bytes += song_bytes_retrieved;
+      }
+      m_stats.add(STAT_DOWNLOAD_BYTES, song_bytes_retrieved);
+      m_stats.add(STAT_SONGS_DOWNLOADED);
 
       // are we checking data integrity?
       // if so, verify that the storage system retrieved the same length that
@@ -733,6 +891,9 @@ bool Jukebox::download_song(const SongMetadata& song) {
          if (song_bytes_retrieved != song.get_stored_file_size()) {
             printf("error: data integrity check failed for %s\n",
                    file_path.c_str());
+            Utils::file_delete(file_path);
+            m_cache_index.set_state(song.get_file_uid(),
+                                    SongCacheIndex::NOT_PRESENT);
             return false;
          }
       }
@@ -767,26 +928,325 @@ bool Jukebox::download_song(const SongMetadata& song) {
       //         return false
       //}
 
-      if (check_file_integrity(song)) {
+      if (check_file_integrity(song, download_hash.get())) {
          if (m_debug_print) {
             printf("check_file_integrity returned true\n");
          }
+         m_cache_index.set_downloaded(song.get_file_uid(),
+                                      song_bytes_retrieved);
          return true;
       } else {
          // we retrieved the file, but it failed our integrity check
-         // if file exists, remove it
          printf("integrity check failed, deleting file\n");
-         if (Utils::file_exists(file_path)) {
-            OSUtils::deleteFile(file_path);
-         }
       }
    }
 
+   // play_song only checks that the file exists, so a failed download
+   // mustn't leave an empty or partial one behind
+   if (Utils::file_exists(file_path)) {
+      Utils::file_delete(file_path);
+   }
+   m_cache_index.set_state(song.get_file_uid(), SongCacheIndex::NOT_PRESENT);
    return false;
 }
 
 //*****************************************************************************
 
+bool Jukebox::download_song_head(const SongMetadata& song) {
+   if (m_cache_index.is_downloaded(song.get_file_uid())) {
+      // still in the song cache from an earlier session
+      m_cache_index.touch(song.get_file_uid());
+      return true;
+   }
+
+   // progressive download: fetch just enough of the song to start the
+   // player and fill in the rest in the background
+   int64_t head_bytes =
+      (int64_t) m_jukebox_options.get_progressive_download_kb() * 1024;
+   int64_t song_size = song.get_stored_file_size();
+
+   if (head_bytes <= 0 ||
+       song_size <= head_bytes ||
+       song.get_encrypted() != 0 ||
+       song.get_compressed() != 0 ||
+       m_tail_downloader) {
+      return download_song(song);
+   }
+
+   if (m_debug_print) {
+      printf("downloading first %ld bytes of '%s'\n",
+             (long) head_bytes, song.get_file_uid().c_str());
+   }
+
+   string file_path = song_path_in_playlist(song);
+   FILE* f = fopen(file_path.c_str(), "wb");
+   if (f == nullptr) {
+      printf("error: unable to open %s\n", file_path.c_str());
+      return false;
+   }
+
+   // the song stays DOWNLOADING until the tail is in too, so nothing
+   // treats the partial file as the whole song
+   m_cache_index.set_state(song.get_file_uid(), SongCacheIndex::DOWNLOADING);
+
+   double download_start_time = Utils::time_time();
+   int64_t bytes_retrieved =
+      m_storage_system.get_object_range(song.get_container_name(),
+                                        song.get_object_name(),
+                                        0,
+                                        head_bytes,
+                                        ObjectStream::file_sink(f));
+   fclose(f);
+
+   if (bytes_retrieved != head_bytes) {
+      // storage system couldn't give us the range; take the whole song
+      OSUtils::deleteFile(file_path);
+      return download_song(song);
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_download_stats_mutex);
+      m_cumulative_download_time += Utils::time_time() - download_start_time;
+      m_cumulative_download_bytes += bytes_retrieved;
+   }
+   m_stats.add(STAT_DOWNLOAD_BYTES, bytes_retrieved);
+
+   {
+      std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+      m_tail_download_active = true;
+      m_tail_download_uid = song.get_file_uid();
+      m_tail_bytes_on_disk = head_bytes;
+   }
+
+   m_tail_downloader.reset(new SongTailDownloader(*this, song, head_bytes));
+   m_tail_download_thread.reset(new PthreadsThread(m_tail_downloader.get()));
+   m_tail_downloader->setCompletionObserver(this);
+   if (!m_tail_download_thread->start()) {
+      printf("error: unable to start download thread, downloading synchronously\n");
+      m_tail_download_thread.reset();
+      m_tail_downloader.reset();
+      {
+         std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+         m_tail_download_active = false;
+      }
+      return download_song_tail(song, head_bytes);
+   }
+
+   return true;
+}
+
+//*****************************************************************************
+
+bool Jukebox::download_song_tail(const SongMetadata& song, int64_t offset) {
+   string file_path = song_path_in_playlist(song);
+   FILE* f = fopen(file_path.c_str(), "ab");
+   if (f == nullptr) {
+      printf("error: unable to open %s\n", file_path.c_str());
+      return false;
+   }
+
+   // each chunk is flushed and counted so that a song being streamed to
+   // the player can follow the download
+   ObjectSink file_sink = ObjectStream::file_sink(f);
+   ObjectSink tail_sink = [this, &file_sink, f](const unsigned char* data,
+                                                size_t num_bytes) -> bool {
+      if (!file_sink(data, num_bytes) || fflush(f) != 0) {
+         return false;
+      }
+      std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+      m_tail_bytes_on_disk += num_bytes;
+      m_tail_download_cv.notify_all();
+      return true;
+   };
+
+   int64_t bytes_retrieved =
+      m_storage_system.get_object_range(song.get_container_name(),
+                                        song.get_object_name(),
+                                        offset,
+                                        0,
+                                        tail_sink);
+   fclose(f);
+
+   if (m_debug_print) {
+      printf("downloaded remaining %ld bytes of '%s'\n",
+             (long) bytes_retrieved, song.get_file_uid().c_str());
+   }
+
+   if (bytes_retrieved <= 0 ||
+       (unsigned long) (offset + bytes_retrieved) != song.get_stored_file_size()) {
+      printf("error: unable to download remainder of %s\n",
+             song.get_file_uid().c_str());
+      m_cache_index.set_state(song.get_file_uid(), SongCacheIndex::NOT_PRESENT);
+      return false;
+   }
+
+   // integrity can only be verified once the whole song is present
+   if (!check_file_integrity(song)) {
+      m_cache_index.set_state(song.get_file_uid(), SongCacheIndex::NOT_PRESENT);
+      return false;
+   }
+
+   m_cache_index.set_downloaded(song.get_file_uid(),
+                                song.get_stored_file_size());
+   return true;
+}
+
+//*****************************************************************************
+
+void Jukebox::wait_for_tail_download() {
+   if (m_tail_downloader) {
+      std::unique_lock<std::mutex> lock(m_tail_download_mutex);
+      m_tail_download_cv.wait(lock, [this] { return !m_tail_download_active; });
+      lock.unlock();
+
+      m_tail_download_thread.reset();
+      m_tail_downloader.reset();
+   }
+}
+
+//*****************************************************************************
+
+bool Jukebox::is_tail_downloading(const string& file_uid) {
+   std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+   return m_tail_download_active && m_tail_download_uid == file_uid;
+}
+
+//*****************************************************************************
+
+string Jukebox::start_song_stream(const SongMetadata& song) {
+   string pipe_path = song_path_in_playlist(song) + ".stream";
+   OSUtils::deleteFile(pipe_path);
+   if (mkfifo(pipe_path.c_str(), 0600) != 0) {
+      printf("error: unable to create pipe %s, errno=%d\n",
+             pipe_path.c_str(), errno);
+      return "";
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+      m_stream_feeder_active = true;
+      m_stream_stopping = false;
+   }
+
+   m_stream_feeder.reset(new SongStreamFeeder(*this, song, pipe_path));
+   m_stream_feeder_thread.reset(new PthreadsThread(m_stream_feeder.get()));
+   m_stream_feeder->setCompletionObserver(this);
+   if (!m_stream_feeder_thread->start()) {
+      m_stream_feeder_thread.reset();
+      m_stream_feeder.reset();
+      {
+         std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+         m_stream_feeder_active = false;
+      }
+      OSUtils::deleteFile(pipe_path);
+      return "";
+   }
+
+   return pipe_path;
+}
+
+//*****************************************************************************
+
+void Jukebox::stop_song_stream(const string& pipe_path) {
+   if (m_stream_feeder) {
+      std::unique_lock<std::mutex> lock(m_tail_download_mutex);
+      m_stream_stopping = true;
+      m_tail_download_cv.notify_all();
+      m_tail_download_cv.wait(lock, [this] { return !m_stream_feeder_active; });
+      lock.unlock();
+
+      m_stream_feeder_thread.reset();
+      m_stream_feeder.reset();
+   }
+   OSUtils::deleteFile(pipe_path);
+}
+
+//*****************************************************************************
+
+void Jukebox::stream_song(const SongMetadata& song, const string& pipe_path) {
+   // a player that stops reading (on a pause or skip) must only end the
+   // stream, not raise SIGPIPE for the whole jukebox
+   sigset_t sigpipe_set;
+   sigemptyset(&sigpipe_set);
+   sigaddset(&sigpipe_set, SIGPIPE);
+   pthread_sigmask(SIG_BLOCK, &sigpipe_set, nullptr);
+
+   // the player might never open the pipe (if it fails to start), so
+   // don't block waiting for it
+   int pipe_fd = -1;
+   while (pipe_fd == -1) {
+      pipe_fd = open(pipe_path.c_str(), O_WRONLY | O_NONBLOCK);
+      if (pipe_fd == -1) {
+         std::lock_guard<std::mutex> lock(m_tail_download_mutex);
+         if (errno != ENXIO || m_stream_stopping) {
+            return;
+         }
+      }
+      if (pipe_fd == -1) {
+         Utils::time_sleep_millis(50);
+      }
+   }
+   fcntl(pipe_fd, F_SETFL, fcntl(pipe_fd, F_GETFL) & ~O_NONBLOCK);
+
+   string song_file_path = song_path_in_playlist(song);
+   int song_fd = open(song_file_path.c_str(), O_RDONLY);
+   if (song_fd == -1) {
+      printf("error: unable to open %s\n", song_file_path.c_str());
+      close(pipe_fd);
+      return;
+   }
+
+   vector<char> buffer(ObjectStream::BUFFER_SIZE);
+   int64_t offset = 0;
+   bool stopped = false;
+   for (;;) {
+      int64_t bytes_on_disk;
+      {
+         std::unique_lock<std::mutex> lock(m_tail_download_mutex);
+         m_tail_download_cv.wait(lock, [this, offset] {
+            return m_stream_stopping ||
+                   !m_tail_download_active ||
+                   m_tail_bytes_on_disk > offset;
+         });
+         stopped = m_stream_stopping;
+         bytes_on_disk = m_tail_bytes_on_disk;
+      }
+      if (stopped || offset >= bytes_on_disk) {
+         break;
+      }
+
+      bool write_failed = false;
+      while (offset < bytes_on_disk && !write_failed) {
+         size_t chunk_size = (size_t) std::min((int64_t) buffer.size(),
+                                               bytes_on_disk - offset);
+         ssize_t bytes_read = pread(song_fd, buffer.data(), chunk_size, offset);
+         if (bytes_read <= 0 ||
+             write(pipe_fd, buffer.data(), bytes_read) != bytes_read) {
+            write_failed = true;
+         } else {
+            offset += bytes_read;
+         }
+      }
+      if (write_failed) {
+         // the player has gone away
+         stopped = true;
+         break;
+      }
+   }
+
+   if (!stopped && (unsigned long) offset != song.get_stored_file_size()) {
+      printf("warning: download of %s failed, playback stops after %ld of %lu bytes\n",
+             song.get_file_uid().c_str(),
+             (long) offset,
+             song.get_stored_file_size());
+   }
+
+   close(song_fd);
+   close(pipe_fd);
+}
+
+//*****************************************************************************
+
 void Jukebox::play_song(const SongMetadata& song) {
    if (m_player_active) {
       return;
@@ -797,6 +1257,22 @@ void Jukebox::play_song(const SongMetadata& song) {
    if (Utils::path_exists(song_file_path)) {
       printf("playing %s\n", song.get_file_uid().c_str());
 
+      // a song still downloading is played through a pipe that can't get
+      // ahead of the download; resuming seeks, which a pipe can't do, so
+      // that waits for the download instead
+      string player_file_path = song_file_path;
+      string stream_pipe_path;
+      if (is_tail_downloading(song.get_file_uid())) {
+         if (!m_song_play_is_resume) {
+            stream_pipe_path = start_song_stream(song);
+         }
+         if (!stream_pipe_path.empty()) {
+            player_file_path = stream_pipe_path;
+         } else {
+            wait_for_tail_download();
+         }
+      }
+
       if (!m_audio_player_exe_file_name.empty()) {
          bool did_resume = false;
          string command_args;
@@ -828,7 +1304,7 @@ void Jukebox::play_song(const SongMetadata& song) {
                                     song_start_time);
                StrUtils::replaceAll(command_args,
                                     "%%AUDIO_FILE_PATH%%",
-                                    song_file_path);
+                                    player_file_path);
                did_resume = true;
                //printf("command_args: '%s'\n", command_args.c_str());
             }
@@ -838,24 +1314,41 @@ void Jukebox::play_song(const SongMetadata& song) {
             command_args = m_audio_player_command_args;
             StrUtils::replaceAll(command_args,
                                  "%%AUDIO_FILE_PATH%%",
-                                 song_file_path);
+                                 player_file_path);
          }
 
          vector<string> vec_args = StrUtils::split(command_args, " ");
          int child_process_id = 0;
          pid_t pid;
          int exit_code = -1;
+         bool player_stopped = false;
 
          bool started_audio_player = Utils::launch_program(m_audio_player_exe_file_name,
                                                            vec_args,
                                                            child_process_id);
          if (started_audio_player) {
+            m_stats.add(did_resume ? STAT_PLAYER_RESTARTS : STAT_PLAYER_STARTS);
             pid = child_process_id;
             m_player_active = true;
             m_song_start_time = Utils::time_time();
             int status = 0;
             int options = 0;
-            m_audio_player_process = pid;
+            {
+               std::lock_guard<std::mutex> lock(m_event_mutex);
+               m_audio_player_process = pid;
+               m_player_stopped = false;
+            }
+            // wait for the player to exit without reaping it, so a pause or
+            // skip arriving at the same moment can't signal a recycled pid
+            siginfo_t player_info;
+            while (waitid(P_PID, pid, &player_info, WEXITED | WNOWAIT) != 0 &&
+                   errno == EINTR) {
+            }
+            {
+               std::lock_guard<std::mutex> lock(m_event_mutex);
+               m_audio_player_process = -1;
+               player_stopped = m_player_stopped;
+            }
             pid_t rc_pid = waitpid(pid, &status, options);
             if (rc_pid == pid) {
                if (WIFEXITED(status)) {
@@ -880,15 +1373,16 @@ void Jukebox::play_song(const SongMetadata& song) {
                       rc_pid);
                printf("errno = %d\n", errno);
             }
-            m_audio_player_process = -1;
             m_player_active = false;
          } else {
             printf("error: unable to start audio player\n");
             ::exit(1);
          }
 
-         // audio player failed or is not present?
-         if (!started_audio_player || exit_code != 0) {
+         // audio player failed or is not present? (a player we stopped
+         // ourselves for a pause or skip hasn't failed)
+         if (!started_audio_player || (exit_code != 0 && !player_stopped)) {
+            m_stats.add(STAT_PLAYER_FAILURES);
             ++m_num_successive_play_failures;
             if (m_num_successive_play_failures >= 3) {
                // we've had at least 3 successive play failures.
@@ -898,6 +1392,7 @@ void Jukebox::play_song(const SongMetadata& song) {
                ::exit(1);
             }
          }
+         m_stats.set(STAT_SUCCESSIVE_PLAY_FAILURES, m_num_successive_play_failures);
       } else {
          // we don't know about an audio player, so there's nothing
          // left to do
@@ -905,9 +1400,24 @@ void Jukebox::play_song(const SongMetadata& song) {
          ::exit(1);
       }
 
+      if (!stream_pipe_path.empty()) {
+         stop_song_stream(stream_pipe_path);
+      }
+
+      // don't pull the file out from under a background download
+      wait_for_tail_download();
+
       if (!m_is_paused) {
-         // delete the song file from the play list directory
-         OSUtils::deleteFile(song_file_path);
+         if (m_song_cache_loaded) {
+            // keep it for next time, making room if the cache is full
+            m_cache_index.touch(song.get_file_uid());
+            trim_song_cache();
+         } else {
+            // delete the song file from the play list directory
+            OSUtils::deleteFile(song_file_path);
+            m_cache_index.set_state(song.get_file_uid(),
+                                    SongCacheIndex::PLAYED);
+         }
       }
    } else {
       printf("file not found: %s\n", song.get_file_uid().c_str());
@@ -918,79 +1428,74 @@ void Jukebox::play_song(const SongMetadata& song) {
 //*****************************************************************************
 
 void Jukebox::download_songs() {
-   // scan the play list directory to see if we need to download more songs
-   vector<string> dir_listing =
-      OSUtils::listFilesInDirectory(m_song_play_dir);
-   unsigned int song_file_count = 0;
-
-   for (const auto& listing_entry : dir_listing) {
-      string full_path =
-         OSUtils::pathJoin(m_song_play_dir, listing_entry);
-      if (Utils::path_isfile(full_path)) {
-         vector<string> path_elems;
-         Utils::path_splitext(full_path, path_elems);
-         const string& extension = path_elems[1];
-         if (!extension.empty() && extension != m_download_extension) {
-            song_file_count += 1;
-         }
+   if (!m_download_pool) {
+      if (m_debug_print) {
+         printf("creating download pool with %u workers\n",
+                m_jukebox_options.get_download_workers());
+      }
+      m_download_pool.reset(new SongDownloadPool(*this,
+                                                 m_jukebox_options.get_download_workers()));
+      if (!m_download_pool->start()) {
+         printf("error: unable to start download pool\n");
+         m_download_pool.reset();
+         return;
       }
    }
 
+   // keep the current song and the next file_cache_count songs either on
+   // disk or on their way. only the cache index is consulted, so each
+   // call costs O(file_cache_count) regardless of playlist size.
    unsigned int file_cache_count = m_jukebox_options.get_file_cache_count();
+   int check_index = m_song_index;
 
-   if (song_file_count < file_cache_count) {
-      vector<SongMetadata> dl_songs;
-      // start looking at the next song in the list
-      int check_index = m_song_index + 1;
-
-      for (int j = 0; j < m_number_songs; j++) {
-         if (check_index >= m_number_songs) {
-            check_index = 0;
-         }
-         if (check_index != m_song_index) {
-            const SongMetadata& si = m_song_list[check_index];
-            string file_path = song_path_in_playlist(si);
-            if (!Utils::file_exists(file_path)) {
-               dl_songs.push_back(si);
-               if (dl_songs.size() >= file_cache_count) {
-                  break;
-               }
-            }
-         }
-         check_index++;
+   for (unsigned int j = 0;
+        j <= file_cache_count && j < (unsigned int) m_number_songs;
+        j++) {
+      if (check_index >= m_number_songs) {
+         check_index = 0;
       }
-
-      if (!dl_songs.empty()) {
-         if (!m_downloader && !m_download_thread) {
-            if (m_debug_print) {
-               printf("creating SongDownloader and download thread\n");
-            }
-            m_downloader.reset(new SongDownloader(*this, dl_songs));
-            m_download_thread.reset(new PthreadsThread(m_downloader.get()));
-            m_downloader->setCompletionObserver(this);
-            m_download_thread->start();
-         } else {
-            if (m_debug_print) {
-               printf("Not downloading more songs b/c downloader != nullptr or download_thread != nullptr\n");
-            }
+      const SongMetadata& si = m_song_list[check_index];
+      if (m_cache_index.begin_download(si.get_file_uid())) {
+         if (!m_download_pool->enqueue(si)) {
+            m_cache_index.set_state(si.get_file_uid(),
+                                    SongCacheIndex::NOT_PRESENT);
          }
       }
+      check_index++;
    }
 }
 
 //*****************************************************************************
 
-void Jukebox::downloader_cleanup() {
-   if (m_downloader_ready_to_delete) {
-      if (m_downloader && m_download_thread) {
-         //printf("deleting downloader and download thread\n");
-         m_downloader_ready_to_delete = false;
-         m_downloader.reset();
-         m_download_thread.reset();
-      } else {
-         printf("NOT deleting b/c 1 or both is nullptr\n");
+void Jukebox::trim_song_cache() {
+   int64_t byte_budget =
+      (int64_t) m_jukebox_options.get_song_cache_mb() * 1024 * 1024;
+
+   // never evict the songs we're about to play
+   unordered_set<string> pinned;
+   if (m_number_songs > 0 && m_song_index >= 0) {
+      unsigned int file_cache_count = m_jukebox_options.get_file_cache_count();
+      int check_index = m_song_index;
+      for (unsigned int j = 0;
+           j <= file_cache_count && j < (unsigned int) m_number_songs;
+           j++) {
+         if (check_index >= m_number_songs) {
+            check_index = 0;
+         }
+         pinned.insert(m_song_list[check_index].get_file_uid());
+         check_index++;
       }
    }
+
+   vector<string> evicted = m_cache_index.evict(byte_budget, pinned);
+   for (const auto& file_uid : evicted) {
+      if (m_debug_print) {
+         printf("evicting %s from song cache\n", file_uid.c_str());
+      }
+      OSUtils::deleteFile(OSUtils::pathJoin(m_song_play_dir, file_uid));
+   }
+
+   m_cache_index.save(m_song_play_dir);
 }
 
 //*****************************************************************************
@@ -1030,6 +1535,124 @@ void Jukebox::play_songs(bool shuffle, string artist, string album) {
 
 //*****************************************************************************
 
+bool Jukebox::read_audio_player_config() {
+   m_audio_player_config_read = true;
+   m_audio_player_configured = false;
+
+   string os_identifier = Utils::get_platform_identifier();
+   if (os_identifier == "unknown") {
+      printf("error: no audio-player specific lookup defined for this OS (unknown)\n");
+      return false;
+   }
+
+   m_audio_player_exe_file_name = "";
+   m_audio_player_command_args = "";
+   m_audio_player_resume_args = "";
+
+   try {
+      IniReader ini_reader(ini_file_name);
+      KeyValuePairs kvpAudioPlayer;
+      if (!ini_reader.readSection(os_identifier, kvpAudioPlayer)) {
+         printf("error: no config section present for '%s'\n",
+                os_identifier.c_str());
+         return false;
+      }
+
+      string key = "audio_player_exe_file_name";
+      if (kvpAudioPlayer.hasKey(key)) {
+         m_audio_player_exe_file_name = kvpAudioPlayer.getValue(key);
+         if (StrUtils::startsAndEndsWith(m_audio_player_exe_file_name, "\"")) {
+            StrUtils::strip(m_audio_player_exe_file_name, '"');
+         }
+         StrUtils::strip(m_audio_player_exe_file_name);
+         if (m_audio_player_exe_file_name.empty()) {
+            printf("error: no value given for '%s' within [%s]\n",
+                   key.c_str(),
+                   os_identifier.c_str());
+            return false;
+         }
+      } else {
+         printf("error: audio_player.ini missing value for '%s' within [%s]\n",
+                key.c_str(),
+                os_identifier.c_str());
+         return false;
+      }
+
+      key = "audio_player_command_args";
+      if (kvpAudioPlayer.hasKey(key)) {
+         m_audio_player_command_args = kvpAudioPlayer.getValue(key);
+         if (StrUtils::startsAndEndsWith(m_audio_player_command_args, "\"")) {
+
+            StrUtils::strip(m_audio_player_command_args, '"');
+         }
+         StrUtils::strip(m_audio_player_command_args);
+         if (m_audio_player_command_args.empty()) {
+            printf("error: no value given for '%s' within [%s]\n",
+                   key.c_str(),
+                   os_identifier.c_str());
+            return false;
+         }
+
+         string placeholder = "%%AUDIO_FILE_PATH%%";
+         string::size_type pos_placeholder =
+            m_audio_player_command_args.find(placeholder);
+         if (pos_placeholder == string::npos) {
+            printf("error: %s value does not contain placeholder '%s'\n",
+                   key.c_str(),
+                   placeholder.c_str());
+            return false;
+         }
+
+      } else {
+         printf("error: audio_player.ini missing value for '%s' within [%s]\n",
+                key.c_str(),
+                os_identifier.c_str());
+         return false;
+      }
+
+      key = "audio_player_resume_args";
+      if (kvpAudioPlayer.hasKey(key)) {
+         m_audio_player_resume_args = kvpAudioPlayer.getValue(key);
+         if (StrUtils::startsAndEndsWith(m_audio_player_resume_args, "\"")) {
+            StrUtils::strip(m_audio_player_resume_args, '"');
+         }
+         StrUtils::strip(m_audio_player_resume_args);
+         if (!m_audio_player_resume_args.empty()) {
+            string placeholder = "%%START_SONG_TIME_OFFSET%%";
+            string::size_type pos_placeholder =
+               m_audio_player_resume_args.find(placeholder);
+            if (pos_placeholder == string::npos) {
+               printf("error: %s value does not contain placeholder '%s'\n",
+                      key.c_str(),
+                      placeholder.c_str());
+               printf("ignoring '%s', using 'audio_player_command_args' for song resume\n",
+                      key.c_str());
+               m_audio_player_resume_args = "";
+            }
+         }
+      }
+
+      if (m_audio_player_resume_args.empty()) {
+         m_audio_player_resume_args = m_audio_player_command_args;
+      }
+   } catch (const exception& e) {
+      printf("error: unable to read %s - %s\n", ini_file_name.c_str(), e.what());
+      return false;
+   }
+
+   if (m_debug_print) {
+      printf("audio_player_exe_file_name = '%s'\n",
+             m_audio_player_exe_file_name.c_str());
+      printf("audio_player_command_args = '%s'\n",
+             m_audio_player_command_args.c_str());
+   }
+
+   m_audio_player_configured = true;
+   return true;
+}
+
+//*****************************************************************************
+
 void Jukebox::play_retrieved_songs(bool shuffle) {
    if (!m_song_list.empty()) {
       m_number_songs = m_song_list.size();
@@ -1045,6 +1668,16 @@ void Jukebox::play_retrieved_songs(bool shuffle) {
             printf("song-play directory does not exist, creating it\n");
          }
          OSUtils::createDirectory(m_song_play_dir);
+      } else if (m_jukebox_options.get_song_cache_mb() > 0) {
+         // songs from earlier sessions are kept as a cache
+         m_cache_index.load(m_song_play_dir);
+         m_song_cache_loaded = true;
+         trim_song_cache();
+         if (m_debug_print) {
+            printf("song cache holds %u songs (%ld bytes)\n",
+                   m_cache_index.count(SongCacheIndex::DOWNLOADED),
+                   (long) m_cache_index.get_bytes_cached());
+         }
       } else {
          // play list directory exists, delete any files in it
          if (m_debug_print) {
@@ -1062,115 +1695,23 @@ void Jukebox::play_retrieved_songs(bool shuffle) {
          }
       }
 
-      m_song_index = 0;
-      install_signal_handlers();
-
-      string os_identifier = Utils::get_platform_identifier();
-      if (os_identifier == "unknown") {
-         printf("error: no audio-player specific lookup defined for this OS (unknown)\n");
-         return;
+      if (!m_song_cache_loaded) {
+         m_cache_index.reconcile(m_song_play_dir);
+         m_song_cache_loaded = m_jukebox_options.get_song_cache_mb() > 0;
       }
 
-      m_audio_player_exe_file_name = "";
-      m_audio_player_command_args = "";
-      m_audio_player_resume_args = "";
-
-      try {
-         IniReader ini_reader(ini_file_name);
-         KeyValuePairs kvpAudioPlayer;
-         if (!ini_reader.readSection(os_identifier, kvpAudioPlayer)) {
-            printf("error: no config section present for '%s'\n",
-                   os_identifier.c_str());
-            return;
-         }
-
-         string key = "audio_player_exe_file_name";
-         if (kvpAudioPlayer.hasKey(key)) {
-            m_audio_player_exe_file_name = kvpAudioPlayer.getValue(key);
-            if (StrUtils::startsAndEndsWith(m_audio_player_exe_file_name, "\"")) {
-               StrUtils::strip(m_audio_player_exe_file_name, '"');
-            }
-            StrUtils::strip(m_audio_player_exe_file_name);
-            if (m_audio_player_exe_file_name.empty()) {
-               printf("error: no value given for '%s' within [%s]\n",
-                      key.c_str(),
-                      os_identifier.c_str());
-               return;
-            }
-         } else {
-            printf("error: audio_player.ini missing value for '%s' within [%s]\n",
-                   key.c_str(),
-                   os_identifier.c_str());
-            return;
-         }
-
-         key = "audio_player_command_args";
-         if (kvpAudioPlayer.hasKey(key)) {
-            m_audio_player_command_args = kvpAudioPlayer.getValue(key);
-            if (StrUtils::startsAndEndsWith(m_audio_player_command_args, "\"")) {
-
-               StrUtils::strip(m_audio_player_command_args, '"');
-            }
-            StrUtils::strip(m_audio_player_command_args);
-            if (m_audio_player_command_args.empty()) {
-               printf("error: no value given for '%s' within [%s]\n",
-                      key.c_str(),
-                      os_identifier.c_str());
-               return;
-            }
-
-            string placeholder = "%%AUDIO_FILE_PATH%%";
-            string::size_type pos_placeholder =
-               m_audio_player_command_args.find(placeholder);
-            if (pos_placeholder == string::npos) {
-               printf("error: %s value does not contain placeholder '%s'\n",
-                      key.c_str(),
-                      placeholder.c_str());
-               return;
-            }
-
-         } else {
-            printf("error: audio_player.ini missing value for '%s' within [%s]\n",
-                   key.c_str(),
-                   os_identifier.c_str());
-            return;
-         }
-
-         key = "audio_player_resume_args";
-         if (kvpAudioPlayer.hasKey(key)) {
-            m_audio_player_resume_args = kvpAudioPlayer.getValue(key);
-            if (StrUtils::startsAndEndsWith(m_audio_player_resume_args, "\"")) {
-               StrUtils::strip(m_audio_player_resume_args, '"');
-            }
-            StrUtils::strip(m_audio_player_resume_args);
-            if (!m_audio_player_resume_args.empty()) {
-               string placeholder = "%%START_SONG_TIME_OFFSET%%";
-               string::size_type pos_placeholder =
-                  m_audio_player_resume_args.find(placeholder);
-               if (pos_placeholder == string::npos) {
-                  printf("error: %s value does not contain placeholder '%s'\n",
-                         key.c_str(),
-                         placeholder.c_str());
-                  printf("ignoring '%s', using 'audio_player_command_args' for song resume\n",
-                         key.c_str());
-                  m_audio_player_resume_args = "";
-               }
-            }
-         }
-
-         if (m_audio_player_resume_args.empty()) {
-            m_audio_player_resume_args = m_audio_player_command_args;
-         }
-      } catch (const exception& e) {
-         printf("error: unable to read %s - %s\n", ini_file_name.c_str(), e.what());
-         return;
+      m_song_index = 0;
+      m_signal_listener.reset(new SignalListener(*this));
+      if (!m_signal_listener->start()) {
+         m_signal_listener.reset();
       }
 
-      if (m_debug_print) {
-         printf("audio_player_exe_file_name = '%s'\n",
-                m_audio_player_exe_file_name.c_str());
-         printf("audio_player_command_args = '%s'\n",
-                m_audio_player_command_args.c_str());
+      // normally read during startup, alongside the catalog
+      if (!m_audio_player_config_read) {
+         read_audio_player_config();
+      }
+      if (!m_audio_player_configured) {
+         return;
       }
 
       printf("downloading first song...\n");
@@ -1183,7 +1724,7 @@ void Jukebox::play_retrieved_songs(bool shuffle) {
 
       try
       {
-         if (download_song(m_song_list[0])) {
+         if (download_song_head(m_song_list[0])) {
             printf("first song downloaded. starting playing now.\n");
 
             // write PID to "jukebox.pid"
@@ -1195,26 +1736,30 @@ void Jukebox::play_retrieved_songs(bool shuffle) {
             Utils::file_write_all_text("jukebox.pid", str_pid_text);
 
             while (!m_exit_requested) {
-               downloader_cleanup();
-
                if (!m_is_paused) {
-                  if (!m_downloader && !m_download_thread) {
-                     if (m_debug_print) {
-                        printf("calling download_songs\n");
-                     }
-                     download_songs();
-                     if (!m_player_active) {
-                        play_song(m_song_list[m_song_index]);
-                     }
-                     downloader_cleanup();
-                  } else {
-                     if (m_debug_print) {
-                        printf("have downloader so not downloading\n");
-                     }
+                  if (m_debug_print) {
+                     printf("calling download_songs\n");
+                  }
+                  download_songs();
+                  const SongMetadata& song = m_song_list[m_song_index];
+                  count_song_cache_lookup(m_cache_index.is_downloaded(song.get_file_uid()));
+                  if (m_download_pool) {
+                     // the current song may still be coming down
+                     const string& file_uid = song.get_file_uid();
+                     wait_for_playback_event([this, &file_uid] {
+                        return m_is_paused ||
+                               !m_cache_index.is_downloading(file_uid) ||
+                               is_tail_downloading(file_uid);
+                     });
+                  }
+                  if (!m_is_paused && !m_exit_requested && !m_player_active) {
+                     play_song(song);
                   }
                }
 
-               if (!m_is_paused) {
+               if (m_exit_requested) {
+                  break;
+               } else if (!m_is_paused) {
                   m_song_index++;
                   m_song_play_is_resume = false;
                   m_song_seconds_offset = 0;
@@ -1226,7 +1771,8 @@ void Jukebox::play_retrieved_songs(bool shuffle) {
                      }
                   }
                } else {
-                  Utils::time_sleep(1);
+                  // sleep until resumed (or told to quit)
+                  wait_for_playback_event([this] { return !m_is_paused; });
                }
             }
             OSUtils::deleteFile("jukebox.pid");
@@ -1266,6 +1812,27 @@ void Jukebox::show_listings() {
 
 //*****************************************************************************
 
+void Jukebox::search_songs(const string& query) {
+   if (m_jukebox_db) {
+      vector<SongMetadata> songs;
+      if (m_jukebox_db->search_songs(query, songs, SEARCH_MAX_RESULTS)) {
+         for (const auto& song : songs) {
+            printf("%s, %s (%s)\n",
+                   song.get_artist_name().c_str(),
+                   song.get_song_name().c_str(),
+                   song.get_file_uid().c_str());
+         }
+         if (songs.empty()) {
+            printf("no songs match '%s'\n", query.c_str());
+         }
+      } else {
+         printf("error: unable to search for '%s'\n", query.c_str());
+      }
+   }
+}
+
+//*****************************************************************************
+
 void Jukebox::show_artists() {
    if (m_jukebox_db) {
       m_jukebox_db->show_artists();
@@ -1346,35 +1913,27 @@ ReadFileResults Jukebox::read_file_contents(const string& file_path,
 
 //*****************************************************************************
 
-bool Jukebox::upload_metadata_db() {
+bool Jukebox::upload_metadata_db(bool force_snapshot) {
    bool metadata_db_upload = false;
 
    if (m_debug_print) {
-      printf("uploading metadata db file to storage system\n");
+      printf("uploading metadata db changes to storage system\n");
    }
 
-   m_jukebox_db->close();
-   m_jukebox_db.reset();
-
-   // upload metadata DB file
-   vector<unsigned char> db_file_contents;
-   if (Utils::file_read_all_bytes(get_metadata_db_file_path(),
-                                  db_file_contents)) {
-      printf("uploading metadata DB to storage system\n");
-      metadata_db_upload = m_storage_system.put_object(m_metadata_container,
-                                                       m_metadata_db_file,
-                                                       db_file_contents,
-                                                       nullptr);
+   if (m_jukebox_db && m_jukebox_db->is_open() && m_metadata_sync) {
+      printf("uploading metadata to storage system\n");
+      metadata_db_upload = m_metadata_sync->push(*m_jukebox_db,
+                                                 force_snapshot);
 
       if (m_debug_print) {
          if (metadata_db_upload) {
-            printf("metadata db file uploaded\n");
+            printf("metadata db changes uploaded\n");
          } else {
-            printf("unable to upload metadata db file\n");
+            printf("unable to upload metadata db changes\n");
          }
       }
    } else {
-      printf("file read of metadata DB file failed\n");
+      printf("error: metadata DB is not open\n");
    }
 
    return metadata_db_upload;
@@ -1620,14 +2179,19 @@ bool Jukebox::delete_artist(const string& artist) {
          printf("no artist songs in jukebox\n");
          return false;
       } else {
+         // songs already deleted from storage are committed (and published)
+         // even if a later one fails
+         is_deleted = true;
+         m_jukebox_db->begin_transaction();
          for (const auto& song : artist_song_list) {
             if (!delete_song(song.get_object_name(), false)) {
                printf("error deleting song %s\n", song.get_object_name().c_str());
-               return false;
+               is_deleted = false;
+               break;
             }
          }
+         m_jukebox_db->commit_transaction();
          upload_metadata_db();
-         is_deleted = true;
       }
    }
 
@@ -1646,6 +2210,7 @@ bool Jukebox::delete_album(const string& album) {
       m_jukebox_db->retrieve_album_songs(artist, album_name, list_album_songs);
       if (!list_album_songs.empty()) {
          int num_songs_deleted = 0;
+         m_jukebox_db->begin_transaction();
          for (const auto& song : list_album_songs) {
             printf("%s %s\n",
                    song.get_container_name().c_str(),
@@ -1662,6 +2227,7 @@ bool Jukebox::delete_album(const string& album) {
                //FUTURE: delete song metadata if we got 404? (delete_album)
             }
          }
+         m_jukebox_db->commit_transaction();
          if (num_songs_deleted > 0) {
             // upload metadata db
             upload_metadata_db();
@@ -1740,6 +2306,8 @@ void Jukebox::import_album_art() {
 void Jukebox::prepare_for_termination() {
    printf("Ctrl-C detected, shutting down\n");
 
+   std::lock_guard<std::mutex> lock(m_event_mutex);
+
    // indicate that it's time to shutdown
    m_exit_requested = true;
 
@@ -1747,7 +2315,9 @@ void Jukebox::prepare_for_termination() {
    if (m_audio_player_process > 0) {
       kill(m_audio_player_process, SIGTERM);
       m_audio_player_process = -1;
+      m_player_stopped = true;
    }
+   m_event_cv.notify_all();
 }
 
 //*****************************************************************************
@@ -1766,6 +2336,8 @@ void Jukebox::display_info() const {
          printf("-------------------------\n");
       }
    }
+
+   m_storage_system.show_stats();
 }
 
 //*****************************************************************************
@@ -1866,3 +2438,17 @@ bool Jukebox::is_exit_requested() const {
 
 //*****************************************************************************
 
+void Jukebox::notify_playback_event() {
+   std::lock_guard<std::mutex> lock(m_event_mutex);
+   m_event_cv.notify_all();
+}
+
+//*****************************************************************************
+
+void Jukebox::wait_for_playback_event(const std::function<bool()>& ready) {
+   std::unique_lock<std::mutex> lock(m_event_mutex);
+   m_event_cv.wait(lock, [this, &ready] { return m_exit_requested || ready(); });
+}
+
+//*****************************************************************************
+
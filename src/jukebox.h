@@ -1,21 +1,32 @@
 #ifndef JUKEBOX_H
 #define JUKEBOX_H
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "jukebox_options.h"
+#include "song_cache_index.h"
 #include "song_metadata.h"
+#include "stats_registry.h"
 #include "storage_system.h"
 #include "PthreadsThread.h"
 #include "Runnable.h"
 #include "RunCompletionObserver.h"
 
+class ContentHash;
 class JukeboxDB;
-class SongDownloader;
+class MetadataSync;
+class SignalListener;
+class SongDownloadPool;
+class SongTailDownloader;
+class SongStreamFeeder;
 
 
 class ReadFileResults {
@@ -87,8 +98,26 @@ public:
 class Jukebox : public chaudiere::RunCompletionObserver {
 private:
    std::unique_ptr<JukeboxDB> m_jukebox_db;
-   std::unique_ptr<SongDownloader> m_downloader;
-   std::unique_ptr<chaudiere::PthreadsThread> m_download_thread;
+   std::unique_ptr<MetadataSync> m_metadata_sync;
+   std::unique_ptr<SongDownloadPool> m_download_pool;
+   std::unique_ptr<SignalListener> m_signal_listener;
+   StatsRegistry m_stats;
+   std::unique_ptr<StatsExporter> m_stats_exporter;
+   SongCacheIndex m_cache_index;
+   bool m_song_cache_loaded;
+   std::unique_ptr<SongTailDownloader> m_tail_downloader;
+   std::unique_ptr<chaudiere::PthreadsThread> m_tail_download_thread;
+   std::mutex m_tail_download_mutex;
+   std::condition_variable m_tail_download_cv;
+   bool m_tail_download_active;
+   // the song whose tail is downloading and how much of it is on disk
+   std::string m_tail_download_uid;
+   int64_t m_tail_bytes_on_disk;
+   // feeds a song that's still downloading to the player through a pipe
+   std::unique_ptr<SongStreamFeeder> m_stream_feeder;
+   std::unique_ptr<chaudiere::PthreadsThread> m_stream_feeder_thread;
+   bool m_stream_feeder_active;
+   bool m_stream_stopping;
    JukeboxOptions m_jukebox_options;
    StorageSystem& m_storage_system;
    bool m_debug_print;
@@ -109,22 +138,35 @@ private:
    std::string m_audio_player_exe_file_name;
    std::string m_audio_player_command_args;
    std::string m_audio_player_resume_args;
+   bool m_audio_player_config_read;
+   bool m_audio_player_configured;
    pid_t m_audio_player_process;
-   int m_cumulative_download_bytes;
+   // set (under m_event_mutex) when the jukebox itself stops the player to
+   // pause, skip or quit, so that isn't taken for the player failing
+   bool m_player_stopped;
+   std::mutex m_download_stats_mutex;
+   int64_t m_cumulative_download_bytes;
    double m_cumulative_download_time;
-   bool m_exit_requested;
-   bool m_is_paused;
+   // pause/skip/quit arrive on the signal listener thread and download
+   // completions on the pool's workers; the play loop waits on m_event_cv
+   std::mutex m_event_mutex;
+   std::condition_variable m_event_cv;
+   std::atomic<bool> m_exit_requested;
+   std::atomic<bool> m_is_paused;
    double m_song_start_time;
    int m_song_seconds_offset;
    bool m_player_active;
-   bool m_downloader_ready_to_delete;
-   int m_num_successive_play_failures;
-   bool m_song_play_is_resume;
+   std::atomic<int> m_num_successive_play_failures;
+   std::atomic<bool> m_song_play_is_resume;
    bool m_is_repeat_mode;
 
    Jukebox(const Jukebox&);
    Jukebox& operator=(const Jukebox&);
 
+   bool enter_catalog();
+   void define_stats();
+   void count_song_cache_lookup(bool hit);
+
 
 public:
    Jukebox(const JukeboxOptions& jb_options,
@@ -132,7 +174,15 @@ public:
            bool debug_print = false);
    ~Jukebox();
 
-   bool enter();
+   // What a command needs set up by enter. Whatever isn't asked for is
+   // never touched. When both are asked for, the audio player config is
+   // read on a separate thread while the catalog is entered. The storage
+   // system's container list isn't listed here since it's loaded the
+   // first time anything (such as the catalog) needs it.
+   static const unsigned int STARTUP_CATALOG = 0x01;
+   static const unsigned int STARTUP_AUDIO_PLAYER = 0x02;
+
+   bool enter(unsigned int startup_plan=STARTUP_CATALOG);
    void exit();
 
    void toggle_pause_play();
@@ -160,17 +210,40 @@ public:
 
    std::string song_path_in_playlist(const SongMetadata& song);
 
-   bool check_file_integrity(const SongMetadata& song);
+   // download_hash, if given, already holds the hash of the song's contents
+   bool check_file_integrity(const SongMetadata& song,
+                             ContentHash* download_hash=nullptr);
 
    void batch_download_start();
    void batch_download_complete();
+   // called by the download pool (under its lock) as songs come and go
+   void download_queue_changed(size_t queued, size_t in_flight);
+   // called by the download pool for a queued song it drops unfetched
+   void download_cancelled(const SongMetadata& song);
+
+   const StatsRegistry& get_stats() const;
 
    virtual void notifyRunComplete(chaudiere::Runnable* runnable);
 
    bool download_song(const SongMetadata& song);
+   bool download_song_head(const SongMetadata& song);
+   bool download_song_tail(const SongMetadata& song, int64_t offset);
+   void wait_for_tail_download();
+   // true while file_uid's tail is still being downloaded in the background
+   bool is_tail_downloading(const std::string& file_uid);
+   // Copies a song whose tail is still downloading into the pipe at
+   // pipe_path as it arrives, so the player can start on the head but
+   // never reads past what's on disk. Returns when the whole song has
+   // been fed, the player stops reading or stop_song_stream is called.
+   void stream_song(const SongMetadata& song, const std::string& pipe_path);
+   // returns the pipe for the player to read, or "" if streaming isn't
+   // possible
+   std::string start_song_stream(const SongMetadata& song);
+   void stop_song_stream(const std::string& pipe_path);
    void play_song(const SongMetadata& song);
    void download_songs();
-   void downloader_cleanup();
+   void trim_song_cache();
+   bool read_audio_player_config();
    void play_retrieved_songs(bool shuffle);
    void play_songs(bool shuffle=false,
                    std::string artist="",
@@ -178,6 +251,7 @@ public:
 
    void show_list_containers();
    void show_listings();
+   void search_songs(const std::string& query);
    void show_artists();
    void show_genres();
    void show_albums();
@@ -185,7 +259,8 @@ public:
    ReadFileResults read_file_contents(const std::string& file_path,
                                       bool allow_encryption = true);
 
-   bool upload_metadata_db();
+   // publishes catalog changes; with force_snapshot, the whole DB too
+   bool upload_metadata_db(bool force_snapshot=false);
 
    void import_playlists();
    void show_playlists();
@@ -208,6 +283,10 @@ public:
                                          const std::string& album,
                                          std::vector<std::string>& list_track_objects);
    bool is_exit_requested() const;
+
+   // wakes the play loop so it re-evaluates what to do next
+   void notify_playback_event();
+   void wait_for_playback_event(const std::function<bool()>& ready);
 };
 
 #endif
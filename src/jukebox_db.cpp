@@ -1,20 +1,68 @@
-#include <string.h>
+#include <ctype.h>
+#include <sqlite3.h>
 #include "jukebox_db.h"
-#include "SQLiteDatabase.h"
-#include "DBStatementArgs.h"
-#include "DBInt.h"
-#include "DBLong.h"
-#include "DBString.h"
 #include "jb_utils.h"
+#include "StrUtils.h"
 
 using namespace std;
-using namespace chapeau;
+using namespace chaudiere;
+
+static const string DOUBLE_DASHES = "--";
+
+// Full-text index of artist, album and song names. Each row shares its
+// rowid with the song it indexes. Prefixes of 2 and 3 characters are
+// indexed too so that short prefix queries don't scan the term list.
+static const string CREATE_SONG_SEARCH_TABLE =
+   "CREATE VIRTUAL TABLE song_search USING fts5("
+      "artist_name,"
+      "album_name,"
+      "song_name,"
+      "prefix='2 3')";
+
+// the searchable names for songs, with the album name from the album table
+static const string SELECT_SONG_SEARCH_VALUES =
+   "SELECT song.rowid,"
+          "COALESCE(NULLIF(song.artist_name, ''), artist.artist_name),"
+          "album.album_name,"
+          "song.song_name "
+   "FROM song "
+   "LEFT JOIN artist ON artist.artist_uid = song.artist_uid "
+   "LEFT JOIN album ON album.album_uid = song.album_uid";
+
+// Songs changed locally since the catalog was last published, so that
+// only those need to be sent (see MetadataSync). A song changed more than
+// once is recorded once, with whether its last change was a delete.
+static const string CREATE_CHANGELOG_TABLE =
+   "CREATE TABLE changelog ("
+      "song_uid TEXT PRIMARY KEY,"
+      "deleted INTEGER NOT NULL)";
+
+static const string CREATE_SYNC_STATE_TABLE =
+   "CREATE TABLE sync_state ("
+      "name TEXT PRIMARY KEY,"
+      "value INTEGER NOT NULL)";
+
+//*****************************************************************************
+
+// an empty uid is stored as NULL so that it isn't checked as a foreign key
+static void bind_text_or_null(SQLiteStatement& stmt,
+                              int index,
+                              const string& value) {
+   if (value.empty()) {
+      stmt.bind_null(index);
+   } else {
+      stmt.bind_text(index, value);
+   }
+}
 
 //*****************************************************************************
 
 JukeboxDB::JukeboxDB(const string& db_file_path, bool debug) :
    m_debug_print(debug),
-   m_db_is_open(false) {
+   m_db_is_open(false),
+   m_in_transaction(false),
+   m_log_changes(true),
+   m_db_connection(nullptr) {
 
    if (!db_file_path.empty()) {
       m_metadata_db_file_path = db_file_path;
@@ -39,12 +87,17 @@ bool JukeboxDB::is_open() const {
 
 bool JukeboxDB::open_db() {
    bool was_opened = false;
-   m_db_connection.reset(new SQLiteDatabase(m_metadata_db_file_path));
-   if (m_db_connection->open()) {
+   int rc = sqlite3_open_v2(m_metadata_db_file_path.c_str(),
+                            &m_db_connection,
+                            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                            nullptr);
+   if (rc == SQLITE_OK) {
       m_db_is_open = true;
       was_opened = true;
    } else {
-      m_db_connection.reset();
+      // a handle is returned even when the open fails
+      sqlite3_close(m_db_connection);
+      m_db_connection = nullptr;
       m_db_is_open = false;
    }
    return was_opened;
@@ -66,9 +119,21 @@ bool JukeboxDB::open() {
             //}
             close();
          }
+      } else if (schema_version() < SCHEMA_VERSION) {
+         open_success = migrate_tables();
+         if (!open_success) {
+            printf("error: unable to migrate tables\n");
+            close();
+         }
       } else {
          open_success = true;
       }
+
+      if (open_success) {
+         // sqlite leaves foreign key enforcement off unless asked, and it
+         // can only be changed outside of a transaction
+         execute_script("PRAGMA foreign_keys = ON");
+      }
    } else {
       //if (m_debug_print) {
          printf("error: unable to open database\n");
@@ -83,8 +148,14 @@ bool JukeboxDB::close() {
    bool did_close = false;
    if (m_db_connection) {
       //printf("*** DB closed\n");
-      m_db_connection->close();
-      m_db_connection.reset();
+      if (m_in_transaction) {
+         // uncommitted writes are discarded
+         rollback_transaction();
+      }
+      // statements must be finalized before the connection can close
+      m_statements.clear();
+      sqlite3_close(m_db_connection);
+      m_db_connection = nullptr;
       m_db_is_open = false;
       did_close = true;
    }
@@ -93,6 +164,56 @@ bool JukeboxDB::close() {
 
 //*****************************************************************************
 
+SQLiteStatement* JukeboxDB::prepared_statement(const string& sql) {
+   if (!m_db_connection) {
+      return nullptr;
+   }
+
+   auto it = m_statements.find(sql);
+   if (it != m_statements.end()) {
+      it->second->reset();
+      return it->second.get();
+   }
+
+   unique_ptr<SQLiteStatement> stmt =
+      SQLiteStatement::prepare(m_db_connection, sql);
+   if (!stmt) {
+      return nullptr;
+   }
+
+   SQLiteStatement* prepared = stmt.get();
+   m_statements[sql] = std::move(stmt);
+   return prepared;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::execute(const string& sql) {
+   SQLiteStatement* stmt = prepared_statement(sql);
+   return stmt != nullptr && stmt->execute();
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::execute_script(const string& sql) {
+   if (!m_db_connection) {
+      return false;
+   }
+   char* error_msg = nullptr;
+   bool success = (sqlite3_exec(m_db_connection,
+                                sql.c_str(),
+                                nullptr,
+                                nullptr,
+                                &error_msg) == SQLITE_OK);
+   if (error_msg != nullptr) {
+      printf("SQL error: %s\n", error_msg);
+      sqlite3_free(error_msg);
+   }
+   return success;
+}
+
+//*****************************************************************************
+
 bool JukeboxDB::create_table(const string& sql) {
    //printf("inside create_table\n");
    if (!m_db_connection) {
@@ -101,10 +222,10 @@ bool JukeboxDB::create_table(const string& sql) {
       //}
       return false;
    }
-   unsigned long rowsAffectedCount = 0L;
-   //printf("calling executeUpdate\n");
-   bool table_created = m_db_connection->executeUpdate(sql, rowsAffectedCount);
-   //printf("back from executeUpdate\n");
+   // DDL runs once, so it isn't worth keeping a prepared statement for
+   //printf("calling sqlite3_exec\n");
+   bool table_created = execute_script(sql);
+   //printf("back from sqlite3_exec\n");
    if (!table_created) {
       //if (m_debug_print) {
          //printf("create_table failed: %s\n", sql.c_str());
@@ -133,9 +254,10 @@ bool JukeboxDB::create_tables() {
                                       "artist_name TEXT UNIQUE NOT NULL,"
                                       "artist_description TEXT)";
 
+      // album names aren't unique across artists ("Greatest Hits")
       string create_album_table = "CREATE TABLE album ("
                                      "album_uid TEXT UNIQUE NOT NULL,"
-                                     "album_name TEXT UNIQUE NOT NULL,"
+                                     "album_name TEXT NOT NULL,"
                                      "album_description TEXT,"
                                      "artist_uid TEXT NOT NULL REFERENCES artist(artist_uid),"
                                      "genre_uid TEXT REFERENCES genre(genre_uid))";
@@ -156,10 +278,17 @@ bool JukeboxDB::create_tables() {
                                     "object_name TEXT NOT NULL,"
                                     "album_uid TEXT REFERENCES album(album_uid))";
 
+      string create_song_search_table = CREATE_SONG_SEARCH_TABLE;
+
       return create_table(create_genre_table) &&
              create_table(create_artist_table) &&
              create_table(create_album_table) &&
-             create_table(create_song_table);
+             create_table(create_song_table) &&
+             create_table(create_song_search_table) &&
+             create_table(CREATE_CHANGELOG_TABLE) &&
+             create_table(CREATE_SYNC_STATE_TABLE) &&
+             create_indexes() &&
+             set_schema_version(SCHEMA_VERSION);
    } else {
       printf("create_tables: db_is_open is false\n");
       return false;
@@ -168,20 +297,167 @@ bool JukeboxDB::create_tables() {
 
 //*****************************************************************************
 
+bool JukeboxDB::create_indexes() {
+   // genre, artist and album uids and names already have the implicit
+   // indexes that come with their UNIQUE constraints. song lookups also
+   // filter on encrypted and compressed (see sql_where_clause), so those
+   // trail the lookup column; otherwise the planner may prefer the
+   // (encrypted, compressed) index, which matches nearly every song.
+   string sql =
+      "CREATE INDEX IF NOT EXISTS song_artist_name "
+         "ON song(artist_name, encrypted, compressed);"
+      "CREATE INDEX IF NOT EXISTS song_artist_uid "
+         "ON song(artist_uid, encrypted, compressed);"
+      "CREATE INDEX IF NOT EXISTS song_album_uid "
+         "ON song(album_uid, encrypted, compressed);"
+      "CREATE INDEX IF NOT EXISTS song_container_name ON song(container_name);"
+      "CREATE INDEX IF NOT EXISTS song_encrypted_compressed "
+         "ON song(encrypted, compressed);"
+      "CREATE INDEX IF NOT EXISTS album_album_name ON album(album_name);"
+      "CREATE INDEX IF NOT EXISTS album_artist_uid "
+         "ON album(artist_uid, album_name);";
+   return execute_script(sql);
+}
+
+//*****************************************************************************
+
+int JukeboxDB::schema_version() {
+   int version = 0;
+   SQLiteStatement* stmt = prepared_statement("PRAGMA user_version");
+   if (stmt != nullptr && stmt->next()) {
+      version = stmt->column_int(0);
+      stmt->reset();
+   }
+   return version;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::set_schema_version(int version) {
+   return execute_script("PRAGMA user_version = " + to_string(version));
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::migrate_tables() {
+   const int from_version = schema_version();
+   if (m_debug_print) {
+      printf("migrating tables from schema version %d to %d\n",
+             from_version,
+             SCHEMA_VERSION);
+   }
+
+   // foreign keys aren't enforced yet, so the album table can be
+   // rebuilt underneath the songs that reference it
+   if (!begin_transaction()) {
+      return false;
+   }
+
+   bool success = true;
+
+   if (from_version < 2) {
+      // version 1 required album names to be unique
+      string rebuild_album_table =
+         "CREATE TABLE album_v2 ("
+            "album_uid TEXT UNIQUE NOT NULL,"
+            "album_name TEXT NOT NULL,"
+            "album_description TEXT,"
+            "artist_uid TEXT NOT NULL REFERENCES artist(artist_uid),"
+            "genre_uid TEXT REFERENCES genre(genre_uid));"
+         "INSERT INTO album_v2 "
+            "SELECT album_uid, album_name, album_description, artist_uid, genre_uid "
+            "FROM album;"
+         "DROP TABLE album;"
+         "ALTER TABLE album_v2 RENAME TO album;";
+      success = execute_script(rebuild_album_table);
+
+      // version 1 never populated the artist and album tables, and
+      // songs that were imported have no artist or album uid
+      vector<SongMetadata> songs;
+      if (success) {
+         SQLiteStatement* stmt =
+            prepared_statement("SELECT song_uid, artist_name, artist_uid, album_uid "
+                               "FROM song");
+         success = (stmt != nullptr);
+         while (success && stmt->next()) {
+            SongMetadata song;
+            string value;
+            if (stmt->column_text(0, value)) {
+               song.set_file_uid(value);
+            }
+            if (stmt->column_text(1, value)) {
+               song.set_artist_name(value);
+            }
+            if (stmt->column_text(2, value)) {
+               song.set_artist_uid(value);
+            }
+            if (stmt->column_text(3, value)) {
+               song.set_album_uid(value);
+            }
+            songs.push_back(song);
+         }
+      }
+
+      for (auto& song : songs) {
+         if (!success) {
+            break;
+         }
+         success = false;
+         if (store_artist_album(song)) {
+            SQLiteStatement* stmt =
+               prepared_statement("UPDATE song "
+                                  "SET artist_uid = ?, album_uid = ? "
+                                  "WHERE song_uid = ?");
+            if (stmt != nullptr) {
+               bind_text_or_null(*stmt, 1, song.get_artist_uid());
+               bind_text_or_null(*stmt, 2, song.get_album_uid());
+               stmt->bind_text(3, song.get_file_uid());
+               success = stmt->execute();
+            }
+         }
+      }
+   }
+
+   if (success && from_version < 3) {
+      success = create_table(CREATE_SONG_SEARCH_TABLE) &&
+                rebuild_search_index();
+   }
+
+   if (success && from_version < 4) {
+      // everything already in the DB came from the published catalog
+      success = create_table(CREATE_CHANGELOG_TABLE) &&
+                create_table(CREATE_SYNC_STATE_TABLE);
+   }
+
+   success = success &&
+             create_indexes() &&
+             set_schema_version(SCHEMA_VERSION);
+
+   if (success) {
+      return commit_transaction();
+   } else {
+      rollback_transaction();
+      return false;
+   }
+}
+
+//*****************************************************************************
+
 bool JukeboxDB::have_tables() {
    bool have_tables_in_db = false;
    if (m_db_is_open && m_db_connection) {
       string sql = "SELECT name "
                    "FROM sqlite_master "
                    "WHERE type='table' AND name='song'";
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql));
-      if (rs) {
-         if (rs->next()) {
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         if (stmt->next()) {
             string name;
-            rs->stringForColumnIndex(0, name);
+            stmt->column_text(0, name);
             if (!name.empty()) {
                have_tables_in_db = true;
             }
+            stmt->reset();
          }
       }
    }
@@ -191,61 +467,112 @@ bool JukeboxDB::have_tables() {
 
 //*****************************************************************************
 
-bool JukeboxDB::songs_for_query(DBResultSet* rs,
+bool JukeboxDB::begin_transaction() {
+   if (!m_db_is_open || m_in_transaction) {
+      return false;
+   }
+
+   if (!execute("BEGIN TRANSACTION")) {
+      printf("error: unable to begin transaction\n");
+      return false;
+   }
+
+   m_in_transaction = true;
+   return true;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::commit_transaction() {
+   if (!m_db_is_open || !m_in_transaction) {
+      return false;
+   }
+
+   if (!execute("COMMIT TRANSACTION")) {
+      printf("error: unable to commit transaction\n");
+      rollback_transaction();
+      return false;
+   }
+
+   m_in_transaction = false;
+   return true;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::rollback_transaction() {
+   if (!m_db_is_open || !m_in_transaction) {
+      return false;
+   }
+
+   m_in_transaction = false;
+
+   return execute("ROLLBACK TRANSACTION");
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::in_transaction() const {
+   return m_in_transaction;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::songs_for_query(SQLiteStatement& stmt,
                                 vector<SongMetadata>& vec_songs) {
    int num_songs = 0;
-   while (rs->next()) {
+   while (stmt.next()) {
       SongMetadata song;
 
       string file_uid;
-      if (rs->stringForColumnIndex(0, file_uid)) {
+      if (stmt.column_text(0, file_uid)) {
          song.set_file_uid(file_uid);
       }
 
       string file_time;
-      if (rs->stringForColumnIndex(1, file_time)) {
+      if (stmt.column_text(1, file_time)) {
          song.set_file_time(file_time);
       }
 
-      song.set_origin_file_size(rs->longForColumnIndex(2));
-      song.set_stored_file_size(rs->longForColumnIndex(3));
-      song.set_pad_char_count(rs->longForColumnIndex(4));
+      song.set_origin_file_size(stmt.column_int64(2));
+      song.set_stored_file_size(stmt.column_int64(3));
+      song.set_pad_char_count(stmt.column_int64(4));
 
       string artist_name;
-      if (rs->stringForColumnIndex(5, artist_name)) {
+      if (stmt.column_text(5, artist_name)) {
          song.set_artist_name(artist_name);
       }
 
       string artist_uid;
-      if (rs->stringForColumnIndex(6, artist_uid)) {
+      if (stmt.column_text(6, artist_uid)) {
          song.set_artist_uid(artist_uid);
       }
 
       string song_name;
-      if (rs->stringForColumnIndex(7, song_name)) {
+      if (stmt.column_text(7, song_name)) {
          song.set_song_name(song_name);
       }
 
       string md5_hash;
-      if (rs->stringForColumnIndex(8, md5_hash)) {
+      if (stmt.column_text(8, md5_hash)) {
          song.set_md5_hash(md5_hash);
       }
 
-      song.set_compressed(rs->intForColumnIndex(9));
-      song.set_encrypted(rs->intForColumnIndex(10));
+      song.set_compressed(stmt.column_int(9));
+      song.set_encrypted(stmt.column_int(10));
 
       string container_name;
-      if (rs->stringForColumnIndex(11, container_name)) {
+      if (stmt.column_text(11, container_name)) {
          song.set_container_name(container_name);
       }
 
       string object_name;
-      if (rs->stringForColumnIndex(12, object_name)) {
+      if (stmt.column_text(12, object_name)) {
          song.set_object_name(object_name);
       }
 
       string album_uid;
-      if (rs->stringForColumnIndex(13, album_uid)) {
+      if (stmt.column_text(13, album_uid)) {
          song.set_album_uid(album_uid);
       } else {
          song.set_album_uid("");
@@ -278,12 +605,11 @@ bool JukeboxDB::retrieve_song(const string& file_name, SongMetadata& song) {
                    "     album_uid "
                    "FROM song "
                    "WHERE song_uid = ?";
-      DBStatementArgs args;
-      args.add(new DBString(file_name));
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql, args));
-      if (rs) {
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         stmt->bind_text(1, file_name);
          vector<SongMetadata> song_results;
-         if (songs_for_query(rs.get(), song_results)) {
+         if (songs_for_query(*stmt, song_results)) {
             if (!song_results.empty()) {
                song = song_results[0];
                success = true;
@@ -297,10 +623,117 @@ bool JukeboxDB::retrieve_song(const string& file_name, SongMetadata& song) {
 
 //*****************************************************************************
 
+// binds the song's columns in table order
+static void bind_song_values(SQLiteStatement& stmt, const SongMetadata& song) {
+   stmt.bind_text(1, song.get_file_uid());
+   stmt.bind_text(2, song.get_file_time());
+   stmt.bind_int64(3, song.get_origin_file_size());
+   stmt.bind_int64(4, song.get_stored_file_size());
+   stmt.bind_int64(5, song.get_pad_char_count());
+   stmt.bind_text(6, song.get_artist_name());
+   bind_text_or_null(stmt, 7, song.get_artist_uid());
+   stmt.bind_text(8, song.get_song_name());
+   stmt.bind_text(9, song.get_md5_hash());
+   stmt.bind_int(10, song.get_compressed());
+   stmt.bind_int(11, song.get_encrypted());
+   stmt.bind_text(12, song.get_container_name());
+   stmt.bind_text(13, song.get_object_name());
+   bind_text_or_null(stmt, 14, song.get_album_uid());
+}
+
+//*****************************************************************************
+
+// song uids are "artist--album--song" plus an extension, all encoded
+static void components_from_song_uid(const string& song_uid,
+                                     vector<string>& components) {
+   components.clear();
+   string base_name = song_uid.substr(0, song_uid.find('.'));
+   vector<string> tokens = StrUtils::split(base_name, DOUBLE_DASHES);
+   if (tokens.size() == 3) {
+      components = tokens;
+   }
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::store_artist_album(SongMetadata& song) {
+   vector<string> components;
+   components_from_song_uid(song.get_file_uid(), components);
+
+   string artist_uid = song.get_artist_uid();
+   string album_uid = song.get_album_uid();
+
+   if (artist_uid.empty() && !components.empty()) {
+      artist_uid = components[0];
+   }
+
+   if (album_uid.empty() && !components.empty()) {
+      album_uid = components[0] + DOUBLE_DASHES + components[1];
+   }
+
+   if (artist_uid.empty()) {
+      // an album can't be stored without its artist
+      song.set_artist_uid("");
+      song.set_album_uid("");
+      return true;
+   }
+
+   // album uids are qualified by the artist so that two artists can
+   // each have an album with the same name
+   string album_name = album_uid;
+   size_t pos_dashes = album_uid.find(DOUBLE_DASHES);
+   if (pos_dashes != string::npos) {
+      album_name = album_uid.substr(pos_dashes + DOUBLE_DASHES.length());
+   } else if (!album_uid.empty()) {
+      album_uid = artist_uid + DOUBLE_DASHES + album_uid;
+   }
+
+   song.set_artist_uid(artist_uid);
+   song.set_album_uid(album_uid);
+
+   string artist_name = song.get_artist_name();
+   if (artist_name.empty()) {
+      artist_name = JBUtils::unencode_value(artist_uid);
+   }
+
+   SQLiteStatement* stmt =
+      prepared_statement("INSERT INTO artist (artist_uid, artist_name) "
+                         "VALUES (?, ?) "
+                         "ON CONFLICT DO NOTHING");
+   if (stmt == nullptr) {
+      return false;
+   }
+   stmt->bind_text(1, artist_uid);
+   stmt->bind_text(2, artist_name);
+   if (!stmt->execute()) {
+      return false;
+   }
+
+   if (!album_uid.empty()) {
+      stmt = prepared_statement("INSERT INTO album (album_uid, album_name, artist_uid) "
+                                "VALUES (?, ?, ?) "
+                                "ON CONFLICT DO NOTHING");
+      if (stmt == nullptr) {
+         return false;
+      }
+      stmt->bind_text(1, album_uid);
+      stmt->bind_text(2, JBUtils::unencode_value(album_name));
+      stmt->bind_text(3, artist_uid);
+      if (!stmt->execute()) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//*****************************************************************************
+
 bool JukeboxDB::insert_song(const SongMetadata& song) {
    bool insert_success = false;
 
-   if (m_db_is_open) {
+   SongMetadata db_song(song);
+   if (m_db_is_open && begin_song_write()) {
       string sql = "INSERT INTO song "
                    "VALUES (?,"
                            "?,"
@@ -317,31 +750,24 @@ bool JukeboxDB::insert_song(const SongMetadata& song) {
                            "?,"
                            "?)";
 
-      DBStatementArgs args;
-      args.add(new DBString(song.get_file_uid()));
-      args.add(new DBString(song.get_file_time()));
-      args.add(new DBLong(song.get_origin_file_size()));
-      args.add(new DBLong(song.get_stored_file_size()));
-      args.add(new DBLong(song.get_pad_char_count()));
-      args.add(new DBString(song.get_artist_name()));
-      args.add(new DBString(song.get_artist_uid()));
-      args.add(new DBString(song.get_song_name()));
-      args.add(new DBString(song.get_md5_hash()));
-      args.add(new DBInt(song.get_compressed()));
-      args.add(new DBInt(song.get_encrypted()));
-      args.add(new DBString(song.get_container_name()));
-      args.add(new DBString(song.get_object_name()));
-      args.add(new DBString(song.get_album_uid()));
-
-      unsigned long rowsAffectedCount = 0L;
-      bool success = m_db_connection->executeUpdate(sql, args, rowsAffectedCount);
-      if (success) {
-         if (rowsAffectedCount == 1L) {
-            insert_success = true;
+      bool success = false;
+      SQLiteStatement* stmt = nullptr;
+      if (store_artist_album(db_song)) {
+         stmt = prepared_statement(sql);
+      }
+      if (stmt != nullptr) {
+         bind_song_values(*stmt, db_song);
+         if (stmt->execute()) {
+            if (sqlite3_changes(m_db_connection) == 1) {
+               success = index_song_for_search(db_song.get_file_uid()) &&
+                         record_change(db_song.get_file_uid(), false);
+            }
+         } else {
+            //printf("error inserting song\n");
          }
-      } else {
-         //printf("error inserting song\n");
       }
+
+      insert_success = end_song_write(success);
    }
 
    return insert_success;
@@ -352,7 +778,10 @@ bool JukeboxDB::insert_song(const SongMetadata& song) {
 bool JukeboxDB::update_song(const SongMetadata& song) {
    bool update_success = false;
 
-   if (m_db_is_open && !song.get_file_uid().empty()) {
+   SongMetadata db_song(song);
+   if (m_db_is_open &&
+       !song.get_file_uid().empty() &&
+       begin_song_write()) {
       string sql = "UPDATE song "
                    "SET file_time = ?,"
                        "origin_file_size = ?,"
@@ -368,31 +797,40 @@ bool JukeboxDB::update_song(const SongMetadata& song) {
                        "object_name = ?,"
                        "album_uid = ? "
                    "WHERE song_uid = ?";
-      DBStatementArgs args;
-      args.add(new DBString(song.get_file_time()));
-      args.add(new DBLong(song.get_origin_file_size()));
-      args.add(new DBLong(song.get_stored_file_size()));
-      args.add(new DBLong(song.get_pad_char_count()));
-      args.add(new DBString(song.get_artist_name()));
-      args.add(new DBString(""));
-      args.add(new DBString(song.get_song_name()));
-      args.add(new DBString(song.get_md5_hash()));
-      args.add(new DBInt(song.get_compressed()));
-      args.add(new DBInt(song.get_encrypted()));
-      args.add(new DBString(song.get_container_name()));
-      args.add(new DBString(song.get_object_name()));
-      args.add(new DBString(song.get_album_uid()));
-      args.add(new DBString(song.get_file_uid()));
-
-      unsigned long rowsAffectedCount = 0L;
-      bool success = m_db_connection->executeUpdate(sql, args, rowsAffectedCount);
-      if (success) {
-         if (rowsAffectedCount == 1L) {
-            update_success = true;
+
+      bool success = false;
+      SQLiteStatement* stmt = nullptr;
+      if (store_artist_album(db_song) &&
+          unindex_song_for_search(db_song.get_file_uid())) {
+         stmt = prepared_statement(sql);
+      }
+      if (stmt != nullptr) {
+         stmt->bind_text(1, db_song.get_file_time());
+         stmt->bind_int64(2, db_song.get_origin_file_size());
+         stmt->bind_int64(3, db_song.get_stored_file_size());
+         stmt->bind_int64(4, db_song.get_pad_char_count());
+         stmt->bind_text(5, db_song.get_artist_name());
+         bind_text_or_null(*stmt, 6, db_song.get_artist_uid());
+         stmt->bind_text(7, db_song.get_song_name());
+         stmt->bind_text(8, db_song.get_md5_hash());
+         stmt->bind_int(9, db_song.get_compressed());
+         stmt->bind_int(10, db_song.get_encrypted());
+         stmt->bind_text(11, db_song.get_container_name());
+         stmt->bind_text(12, db_song.get_object_name());
+         bind_text_or_null(*stmt, 13, db_song.get_album_uid());
+         stmt->bind_text(14, db_song.get_file_uid());
+
+         if (stmt->execute()) {
+            if (sqlite3_changes(m_db_connection) == 1) {
+               success = index_song_for_search(db_song.get_file_uid()) &&
+                         record_change(db_song.get_file_uid(), false);
+            }
+         } else {
+            printf("error updating song\n");
          }
-      } else {
-         printf("error updating song\n");
       }
+
+      update_success = end_song_write(success);
    }
 
    return update_success;
@@ -400,19 +838,227 @@ bool JukeboxDB::update_song(const SongMetadata& song) {
 
 //*****************************************************************************
 
-bool JukeboxDB::store_song_metadata(const SongMetadata& song) {
-   SongMetadata db_song;
-   if (retrieve_song(song.get_file_uid(), db_song)) {
-      bool is_same_song = (song == db_song);
-      if (!is_same_song) {
-         return update_song(song);
+bool JukeboxDB::upsert_song(const SongMetadata& song) {
+   bool upsert_success = false;
+
+   SongMetadata db_song(song);
+   if (m_db_is_open &&
+       !song.get_file_uid().empty() &&
+       begin_song_write()) {
+      string sql = "INSERT INTO song "
+                   "VALUES (?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?,"
+                           "?) "
+                   "ON CONFLICT(song_uid) DO UPDATE "
+                   "SET file_time = excluded.file_time,"
+                       "origin_file_size = excluded.origin_file_size,"
+                       "stored_file_size = excluded.stored_file_size,"
+                       "pad_char_count = excluded.pad_char_count,"
+                       "artist_name = excluded.artist_name,"
+                       "artist_uid = excluded.artist_uid,"
+                       "song_name = excluded.song_name,"
+                       "md5_hash = excluded.md5_hash,"
+                       "compressed = excluded.compressed,"
+                       "encrypted = excluded.encrypted,"
+                       "container_name = excluded.container_name,"
+                       "object_name = excluded.object_name,"
+                       "album_uid = excluded.album_uid";
+
+      bool success = false;
+      SQLiteStatement* stmt = nullptr;
+      if (store_artist_album(db_song) &&
+          unindex_song_for_search(db_song.get_file_uid())) {
+         stmt = prepared_statement(sql);
+      }
+      if (stmt != nullptr) {
+         bind_song_values(*stmt, db_song);
+         if (stmt->execute()) {
+            if (sqlite3_changes(m_db_connection) == 1) {
+               success = index_song_for_search(db_song.get_file_uid()) &&
+                         record_change(db_song.get_file_uid(), false);
+            }
+         } else {
+            printf("error storing song %s\n", song.get_file_uid().c_str());
+         }
+      }
+
+      upsert_success = end_song_write(success);
+   }
+
+   return upsert_success;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::begin_song_write() {
+   // a savepoint behaves as a transaction of its own when there's no
+   // transaction open, and nests inside one when there is
+   return execute("SAVEPOINT song_write");
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::end_song_write(bool success) {
+   if (!success) {
+      execute("ROLLBACK TO song_write");
+   }
+   return execute("RELEASE song_write") && success;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::index_song_for_search(const string& song_uid) {
+   SQLiteStatement* stmt =
+      prepared_statement("INSERT INTO song_search "
+                            "(rowid, artist_name, album_name, song_name) " +
+                         SELECT_SONG_SEARCH_VALUES +
+                         " WHERE song.song_uid = ?");
+   if (stmt == nullptr) {
+      return false;
+   }
+   stmt->bind_text(1, song_uid);
+   return stmt->execute();
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::unindex_song_for_search(const string& song_uid) {
+   SQLiteStatement* stmt =
+      prepared_statement("DELETE FROM song_search "
+                         "WHERE rowid = (SELECT rowid "
+                                        "FROM song "
+                                        "WHERE song_uid = ?)");
+   if (stmt == nullptr) {
+      return false;
+   }
+   stmt->bind_text(1, song_uid);
+   return stmt->execute();
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::record_change(const string& song_uid, bool deleted) {
+   if (!m_log_changes) {
+      return true;
+   }
+   SQLiteStatement* stmt =
+      prepared_statement("INSERT INTO changelog (song_uid, deleted) "
+                         "VALUES (?, ?) "
+                         "ON CONFLICT(song_uid) DO UPDATE "
+                         "SET deleted = excluded.deleted");
+   if (stmt == nullptr) {
+      return false;
+   }
+   stmt->bind_text(1, song_uid);
+   stmt->bind_int(2, deleted ? 1 : 0);
+   return stmt->execute();
+}
+
+//*****************************************************************************
+
+void JukeboxDB::set_change_logging(bool log_changes) {
+   m_log_changes = log_changes;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::get_changes(vector<string>& stored_song_uids,
+                            vector<string>& deleted_song_uids) {
+   stored_song_uids.clear();
+   deleted_song_uids.clear();
+   if (!m_db_is_open) {
+      return false;
+   }
+
+   SQLiteStatement* stmt =
+      prepared_statement("SELECT song_uid, deleted FROM changelog");
+   if (stmt == nullptr) {
+      return false;
+   }
+   while (stmt->next()) {
+      string song_uid;
+      stmt->column_text(0, song_uid);
+      if (stmt->column_int(1)) {
+         deleted_song_uids.push_back(song_uid);
       } else {
-         return true;  // no insert or update needed (already up-to-date)
+         stored_song_uids.push_back(song_uid);
       }
-   } else {
-      // song is not in the database, insert it
-      return insert_song(song);
    }
+   return true;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::clear_changes() {
+   return m_db_is_open && execute("DELETE FROM changelog");
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::get_sync_value(const string& name, int64_t& value) {
+   bool found = false;
+   if (m_db_is_open) {
+      SQLiteStatement* stmt =
+         prepared_statement("SELECT value FROM sync_state WHERE name = ?");
+      if (stmt != nullptr) {
+         stmt->bind_text(1, name);
+         if (stmt->next()) {
+            value = stmt->column_int64(0);
+            found = true;
+            stmt->reset();
+         }
+      }
+   }
+   return found;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::set_sync_value(const string& name, int64_t value) {
+   if (!m_db_is_open) {
+      return false;
+   }
+   SQLiteStatement* stmt =
+      prepared_statement("INSERT INTO sync_state (name, value) "
+                         "VALUES (?, ?) "
+                         "ON CONFLICT(name) DO UPDATE "
+                         "SET value = excluded.value");
+   if (stmt == nullptr) {
+      return false;
+   }
+   stmt->bind_text(1, name);
+   stmt->bind_int64(2, value);
+   return stmt->execute();
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::rebuild_search_index() {
+   if (!m_db_is_open) {
+      return false;
+   }
+   return execute_script("DELETE FROM song_search;"
+                         "INSERT INTO song_search "
+                            "(rowid, artist_name, album_name, song_name) " +
+                         SELECT_SONG_SEARCH_VALUES + ";");
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::store_song_metadata(const SongMetadata& song) {
+   // an upsert rather than a lookup followed by an insert or update
+   return upsert_song(song);
 }
 
 //*****************************************************************************
@@ -471,39 +1117,38 @@ bool JukeboxDB::retrieve_album_songs(const string& artist,
 
       const bool haveArtist = !artist.empty();
       const bool haveAlbum = !album.empty();
-      string encoded_artist;
-      string encoded_album;
-
-      if (haveArtist) {
-         encoded_artist = JBUtils::encode_value(artist);
-      }
-
-      if (haveAlbum) {
-         encoded_album = JBUtils::encode_value(album);
-      }
 
-      char like_clause[4096];
-      memset(like_clause, 0, sizeof(like_clause));
+      // artist and album names may arrive encoded (from a file or
+      // command argument) or not; uids are encoded, names are not
+      const string artist_uid = JBUtils::encode_value(artist);
+      const string album_name =
+         JBUtils::unencode_value(JBUtils::encode_value(album));
 
+      // each lookup is an index seek on the album table or song columns
       if (haveArtist && haveAlbum) {
-         snprintf(like_clause, 4096, " AND song_uid LIKE '%s--%s%%'",
-                  encoded_artist.c_str(),
-                  encoded_album.c_str());
+         sql += " AND album_uid IN (SELECT album_uid "
+                                   "FROM album "
+                                   "WHERE artist_uid = ? "
+                                   "AND album_name = ?)";
       } else if (haveArtist) {
-         snprintf(like_clause, 4096, " AND song_uid LIKE '%s--%%'",
-                  encoded_artist.c_str());
+         sql += " AND artist_uid = ?";
       } else if (haveAlbum) {
-         snprintf(like_clause, 4096, " AND song_uid LIKE '%%--%s'",
-                  encoded_album.c_str());
+         sql += " AND album_uid IN (SELECT album_uid "
+                                   "FROM album "
+                                   "WHERE album_name = ?)";
       }
 
-      if (strlen(like_clause) > 0) {
-         sql += string(like_clause);
-      }
-
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql));
-      if (rs) {
-         songs_for_query(rs.get(), songs);
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         if (haveArtist && haveAlbum) {
+            stmt->bind_text(1, artist_uid);
+            stmt->bind_text(2, album_name);
+         } else if (haveArtist) {
+            stmt->bind_text(1, artist_uid);
+         } else if (haveAlbum) {
+            stmt->bind_text(1, album_name);
+         }
+         songs_for_query(*stmt, songs);
          success = true;
       }
    }
@@ -533,12 +1178,79 @@ bool JukeboxDB::songs_for_artist(const string& artist_name,
                           "album_uid "
                    "FROM song";
       sql += sql_where_clause();
-      sql += " AND artist = ?";
-      DBStatementArgs args;
-      args.add(new DBString(artist_name));
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql, args));
-      if (rs) {
-         songs_for_query(rs.get(), songs);
+      sql += " AND artist_name = ?";
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         stmt->bind_text(1, artist_name);
+         songs_for_query(*stmt, songs);
+         success = true;
+      }
+   }
+
+   return success;
+}
+
+//*****************************************************************************
+
+// Turns free text into an FTS5 query that matches songs having every word
+// as a prefix of some word in their artist, album or song name. Each word
+// is quoted so that FTS5 operators and punctuation are taken literally.
+static string search_match_expression(const string& query) {
+   string expression;
+   string word;
+   for (size_t i = 0; i <= query.length(); ++i) {
+      const char ch = (i < query.length()) ? query[i] : ' ';
+      if (isspace((unsigned char) ch)) {
+         if (!word.empty()) {
+            if (!expression.empty()) {
+               expression += " ";
+            }
+            expression += "\"" + word + "\"*";
+            word.clear();
+         }
+      } else if (ch == '"') {
+         word += "\"\"";
+      } else {
+         word += ch;
+      }
+   }
+   return expression;
+}
+
+//*****************************************************************************
+
+bool JukeboxDB::search_songs(const string& query,
+                             vector<SongMetadata>& songs,
+                             int max_results) {
+   songs.clear();
+   bool success = false;
+
+   const string match_expression = search_match_expression(query);
+   if (m_db_is_open && !match_expression.empty() && max_results > 0) {
+      string sql = "SELECT song.song_uid,"
+                          "song.file_time,"
+                          "song.origin_file_size,"
+                          "song.stored_file_size,"
+                          "song.pad_char_count,"
+                          "song.artist_name,"
+                          "song.artist_uid,"
+                          "song.song_name,"
+                          "song.md5_hash,"
+                          "song.compressed,"
+                          "song.encrypted,"
+                          "song.container_name,"
+                          "song.object_name,"
+                          "song.album_uid "
+                   "FROM song_search "
+                   "JOIN song ON song.rowid = song_search.rowid "
+                   "WHERE song_search MATCH ? "
+                   "ORDER BY song_search.rank "
+                   "LIMIT ?";
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         stmt->bind_text(1, match_expression);
+         stmt->bind_int(2, max_results);
+         songs_for_query(*stmt, songs);
          success = true;
       }
    }
@@ -553,13 +1265,13 @@ void JukeboxDB::show_listings() {
       string sql = "SELECT artist_name, song_name "
                    "FROM song "
                    "ORDER BY artist_name, song_name";
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql));
-      if (rs) {
-         while (rs->next()) {
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         while (stmt->next()) {
             string artist_name;
             string song_name;
-            rs->stringForColumnIndex(0, artist_name);
-            rs->stringForColumnIndex(1, song_name);
+            stmt->column_text(0, artist_name);
+            stmt->column_text(1, song_name);
             if (!artist_name.empty() && !song_name.empty()) {
                printf("%s, %s\n", artist_name.c_str(), song_name.c_str());
             }
@@ -575,11 +1287,11 @@ void JukeboxDB::show_artists() {
       string sql = "SELECT DISTINCT artist_name "
                    "FROM song "
                    "ORDER BY artist_name";
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql));
-      if (rs) {
-         while (rs->next()) {
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         while (stmt->next()) {
             string artist_name;
-            rs->stringForColumnIndex(0, artist_name);
+            stmt->column_text(0, artist_name);
             if (!artist_name.empty()) {
                printf("%s\n", artist_name.c_str());
             }
@@ -595,11 +1307,11 @@ void JukeboxDB::show_genres() {
       string sql = "SELECT genre_name "
                    "FROM genre "
                    "ORDER BY genre_name";
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql));
-      if (rs) {
-         while (rs->next()) {
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         while (stmt->next()) {
             string genre_name;
-            rs->stringForColumnIndex(0, genre_name);
+            stmt->column_text(0, genre_name);
             if (!genre_name.empty()) {
                printf("%s\n", genre_name.c_str());
             }
@@ -616,13 +1328,12 @@ void JukeboxDB::show_artist_albums(const string& artist_name) {
                    "FROM artist a, album b "
                    "WHERE a.artist_uid = b.artist_uid "
                    "AND a.artist_name = ?";
-      DBStatementArgs args;
-      args.add(new DBString(artist_name));
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql, args));
-      if (rs) {
-         while (rs->next()) {
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         stmt->bind_text(1, artist_name);
+         while (stmt->next()) {
             string album_name;
-            rs->stringForColumnIndex(0, album_name);
+            stmt->column_text(0, album_name);
             if (!album_name.empty()) {
                printf("%s\n", album_name.c_str());
             }
@@ -641,13 +1352,13 @@ void JukeboxDB::show_albums() {
                    "FROM album, artist "
                    "WHERE album.artist_uid = artist.artist_uid "
                    "ORDER BY album.album_name";
-      unique_ptr<DBResultSet> rs(m_db_connection->executeQuery(sql));
-      if (rs) {
-         while (rs->next()) {
+      SQLiteStatement* stmt = prepared_statement(sql);
+      if (stmt != nullptr) {
+         while (stmt->next()) {
             string album_name;
             string artist_name;
-            rs->stringForColumnIndex(0, album_name);
-            rs->stringForColumnIndex(1, artist_name);
+            stmt->column_text(0, album_name);
+            stmt->column_text(1, artist_name);
             if (!album_name.empty() && !artist_name.empty()) {
                printf("%s (%s)\n", album_name.c_str(), artist_name.c_str());
             }
@@ -663,17 +1374,27 @@ bool JukeboxDB::delete_song(const string& song_uid) {
    if (m_db_is_open) {
       if (!song_uid.empty()) {
          string sql = "DELETE FROM song WHERE song_uid = ?";
-         DBStatementArgs args;
-         args.add(new DBString(song_uid));
-         unsigned long rowsAffectedCount = 0L;
-         bool sql_success = m_db_connection->executeUpdate(sql, args, rowsAffectedCount);
+         if (!begin_song_write()) {
+            return false;
+         }
+         bool sql_success = false;
+         bool success = false;
+         SQLiteStatement* stmt = nullptr;
+         if (unindex_song_for_search(song_uid)) {
+            stmt = prepared_statement(sql);
+         }
+         if (stmt != nullptr) {
+            stmt->bind_text(1, song_uid);
+            sql_success = stmt->execute();
+         }
          if (sql_success) {
-            if (rowsAffectedCount == 1L) {
-               was_deleted = true;
+            if (sqlite3_changes(m_db_connection) == 1) {
+               success = record_change(song_uid, true);
             }
          } else {
             printf("error deleting song %s\n", song_uid.c_str());
          }
+         was_deleted = end_song_write(success);
       }
    }
 
@@ -1,25 +1,58 @@
 #ifndef JUKEBOX_DB_H
 #define JUKEBOX_DB_H
 
+#include <stdint.h>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-#include "Database.h"
 #include "song_metadata.h"
+#include "sqlite_statement.h"
+
+struct sqlite3;
 
 
 class JukeboxDB {
 private:
    bool m_debug_print;
    bool m_db_is_open;
-   std::unique_ptr<chapeau::Database> m_db_connection;
+   bool m_in_transaction;
+   bool m_log_changes;
+   sqlite3* m_db_connection;
    std::string m_metadata_db_file_path;
+   // prepared statements kept for the life of the connection, keyed by SQL
+   std::unordered_map<std::string, std::unique_ptr<SQLiteStatement>> m_statements;
 
    JukeboxDB(const JukeboxDB&);
    JukeboxDB& operator=(const JukeboxDB&);
 
+   // returns the cached statement for sql (preparing it on first use),
+   // reset and ready for binding; nullptr if sql doesn't compile
+   SQLiteStatement* prepared_statement(const std::string& sql);
+   bool execute(const std::string& sql);
+   // runs one-off SQL (DDL, pragmas) without keeping a prepared statement
+   bool execute_script(const std::string& sql);
+
+   bool create_indexes();
+   bool set_schema_version(int version);
+   bool migrate_tables();
+   bool store_artist_album(SongMetadata& song);
+
+   // a song and its search index entry are written together
+   bool begin_song_write();
+   bool end_song_write(bool success);
+   bool index_song_for_search(const std::string& song_uid);
+   bool unindex_song_for_search(const std::string& song_uid);
+   bool record_change(const std::string& song_uid, bool deleted);
+
 public:
+   // version 2 added populated artist and album tables and the
+   // secondary indexes used by the catalog lookups; version 3 added
+   // the full-text search index; version 4 added the changelog and
+   // sync state used to publish the catalog incrementally
+   static const int SCHEMA_VERSION = 4;
+
    JukeboxDB(const std::string& metadata_db_file_path,
              bool debug_print=false);
    ~JukeboxDB();
@@ -33,13 +66,23 @@ public:
    bool create_tables();
 
    bool have_tables();
+   int schema_version();
 
-   bool songs_for_query(chapeau::DBResultSet* rs,
+   // Groups writes into one transaction so that a bulk operation pays for
+   // a single commit rather than one per row. Transactions don't nest.
+   bool begin_transaction();
+   bool commit_transaction();
+   bool rollback_transaction();
+   bool in_transaction() const;
+
+   bool songs_for_query(SQLiteStatement& stmt,
                         std::vector<SongMetadata>& vec_songs);
 
    bool retrieve_song(const std::string& file_name, SongMetadata& song);
    bool insert_song(const SongMetadata& song);
    bool update_song(const SongMetadata& song);
+   // inserts the song, or updates it in place if it's already present
+   bool upsert_song(const SongMetadata& song);
    bool store_song_metadata(const SongMetadata& song);
    std::string sql_where_clause(bool using_encryption = false,
                                 bool using_compression = false);
@@ -48,6 +91,30 @@ public:
                              std::vector<SongMetadata>& songs);
    bool songs_for_artist(const std::string& artist_name,
                          std::vector<SongMetadata>& songs);
+
+   // Finds up to max_results songs, best match first, whose artist, album
+   // or song names contain every word of query (each as a prefix, so
+   // partial words match while typing).
+   bool search_songs(const std::string& query,
+                     std::vector<SongMetadata>& songs,
+                     int max_results);
+
+   // Repopulates the search index from the song table. Index entries are
+   // tied to song rowids, which VACUUM is free to renumber.
+   bool rebuild_search_index();
+
+   // Song writes are recorded in a changelog (unless logging is turned
+   // off, as it is while applying changes that came from elsewhere) until
+   // they're cleared once published.
+   void set_change_logging(bool log_changes);
+   bool get_changes(std::vector<std::string>& stored_song_uids,
+                    std::vector<std::string>& deleted_song_uids);
+   bool clear_changes();
+
+   // named counters kept alongside the catalog; get returns false if the
+   // name has never been set
+   bool get_sync_value(const std::string& name, int64_t& value);
+   bool set_sync_value(const std::string& name, int64_t value);
    void show_listings();
    void show_artists();
    void show_genres();
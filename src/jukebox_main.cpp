@@ -7,16 +7,24 @@
 #include "property_set.h"
 #include "jukebox_options.h"
 #include "jukebox.h"
+#include "s3_storage_system.h"
 #include "s3ext_storage_system.h"
 #include "utils.h"
 #include "OSUtils.h"
 #include "StringTokenizer.h"
 #include "StrUtils.h"
 #include "fs_storage_system.h"
+#include "metered_storage_system.h"
+#include "retrying_storage_system.h"
+#include "content_hash.h"
 
 using namespace std;
 using namespace chaudiere;
 
+// seconds before the storage system's container list is listed again;
+// long enough that only a long play session ever sees a refresh
+static const double CONTAINER_LIST_TTL_SECS = 600.0;
+
 //*****************************************************************************
 
 JukeboxMain::JukeboxMain() :
@@ -161,12 +169,41 @@ StorageSystem* JukeboxMain::connect_s3_system(const PropertySet& credentials,
          secret_key = aws_secret_key;
       }
 
-      return new S3ExtStorageSystem(access_key,
-                                    secret_key,
-                                    protocol,
-                                    host,
-                                    prefix,
-                                    m_debug_mode);
+      if (use_external) {
+         return new S3ExtStorageSystem(access_key,
+                                       secret_key,
+                                       protocol,
+                                       host,
+                                       prefix,
+                                       m_debug_mode);
+      } else {
+         S3StorageSystem* s3 = new S3StorageSystem(access_key,
+                                                   secret_key,
+                                                   protocol,
+                                                   host,
+                                                   prefix,
+                                                   m_debug_mode);
+
+         // optional multipart upload tuning
+         if (credentials.contains("multipart_part_size_mb")) {
+            const string& part_size_mb =
+               credentials.get_string_value("multipart_part_size_mb");
+            int mb = StrUtils::parseInt(part_size_mb);
+            if (mb > 0) {
+               s3->set_multipart_part_size((size_t) mb * 1024 * 1024);
+            }
+         }
+         if (credentials.contains("multipart_concurrency")) {
+            const string& concurrency =
+               credentials.get_string_value("multipart_concurrency");
+            int num_connections = StrUtils::parseInt(concurrency);
+            if (num_connections > 0) {
+               s3->set_multipart_concurrency(num_connections);
+            }
+         }
+
+         return s3;
+      }
    }
    return nullptr;
 }
@@ -314,6 +351,7 @@ void JukeboxMain::show_usage() const {
    printf("\tshow-playlist      - show songs in specified playlist\n");
    printf("\tshuffle-play       - play songs randomly\n");
    printf("\tretrieve-catalog   - retrieve copy of music catalog\n");
+   printf("\tsearch             - show songs matching words given with --query\n");
    printf("\tupload-metadata-db - upload SQLite metadata\n");
    printf("\tusage              - show this help message\n");
    printf("\n");
@@ -338,6 +376,13 @@ int JukeboxMain::run_jukebox_command(Jukebox& jukebox, const string& command) {
          jukebox.play_songs(shuffle, m_artist, m_album);
       } else if (command == "list-songs") {
          jukebox.show_listings();
+      } else if (command == "search") {
+         if (!m_query.empty()) {
+            jukebox.search_songs(m_query);
+         } else {
+            printf("error: search words must be specified using --query option\n");
+            exit_code = 1;
+         }
       } else if (command == "list-artists") {
          jukebox.show_artists();
       } else if (command == "list-containers") {
@@ -425,7 +470,7 @@ int JukeboxMain::run_jukebox_command(Jukebox& jukebox, const string& command) {
             exit_code = 1;
          }
       } else if (command == "upload-metadata-db") {
-         if (jukebox.upload_metadata_db()) {
+         if (jukebox.upload_metadata_db(true)) {
             printf("metadata db uploaded\n");
          } else {
             printf("error: unable to upload metadata db\n");
@@ -455,6 +500,19 @@ int JukeboxMain::run(const vector<string>& console_args) {
    opt_parser.addOptionalBoolFlag("--debug", "run in debug mode");
    opt_parser.addOptionalIntArgument("--file-cache-count", "number of songs to buffer in cache");
    opt_parser.addOptionalBoolFlag("--integrity-checks", "check file integrity after download");
+   opt_parser.addOptionalIntArgument("--progressive-download-kb", "KB of first song to download before starting playback");
+   opt_parser.addOptionalIntArgument("--parallel-download-mb", "download songs of at least this many MB as parallel ranges");
+   opt_parser.addOptionalIntArgument("--parallel-download-ranges", "number of ranges to download in parallel");
+   opt_parser.addOptionalIntArgument("--download-workers", "number of songs to download concurrently");
+   opt_parser.addOptionalIntArgument("--song-cache-mb", "keep played songs in a local cache of up to this many MB");
+   opt_parser.addOptionalStringArgument("--content-hash", "hash recorded for imported songs (md5, xxh64)");
+   opt_parser.addOptionalIntArgument("--import-workers", "number of songs to upload concurrently when importing");
+   opt_parser.addOptionalIntArgument("--storage-retries", "times to retry a failed storage request (0 to disable)");
+   opt_parser.addOptionalBoolFlag("--hedge-reads", "re-issue song downloads slower than recent ones");
+   opt_parser.addOptionalBoolFlag("--storage-stats", "show storage request counts and latencies on exit");
+   opt_parser.addOptionalStringArgument("--stats-prom-file", "Prometheus textfile to write jukebox stats to");
+   opt_parser.addOptionalStringArgument("--stats-json-file", "JSON file to write jukebox stats to");
+   opt_parser.addOptionalIntArgument("--stats-interval", "seconds between writes of the stats files");
    opt_parser.addOptionalBoolFlag("--compress", "use gzip compression");
    opt_parser.addOptionalBoolFlag("--encrypt", "encrypt file contents");
    opt_parser.addOptionalStringArgument("--key", "encryption key");
@@ -464,6 +522,7 @@ int JukeboxMain::run(const vector<string>& console_args) {
    opt_parser.addOptionalStringArgument("--playlist", "limit operations to specified playlist");
    opt_parser.addOptionalStringArgument("--song", "limit operations to specified song");
    opt_parser.addOptionalStringArgument("--album", "limit operations to specified album");
+   opt_parser.addOptionalStringArgument("--query", "words to search for in artist, album and song names");
    opt_parser.addRequiredArgument("command", "command for jukebox");
 
    unique_ptr<PropertySet> args(opt_parser.parse_args(console_args));
@@ -487,6 +546,130 @@ int JukeboxMain::run(const vector<string>& console_args) {
       options.set_file_cache_count(file_cache_count);
    }
 
+   if (args->contains("progressive_download_kb")) {
+      int progressive_download_kb = args->get_int_value("progressive_download_kb");
+      if (m_debug_mode) {
+         printf("setting progressive download KB=%d\n", progressive_download_kb);
+      }
+      if (progressive_download_kb > 0) {
+         options.set_progressive_download_kb(progressive_download_kb);
+      }
+   }
+
+   if (args->contains("parallel_download_mb")) {
+      int parallel_download_mb = args->get_int_value("parallel_download_mb");
+      if (m_debug_mode) {
+         printf("setting parallel download MB=%d\n", parallel_download_mb);
+      }
+      if (parallel_download_mb > 0) {
+         options.set_parallel_download_mb(parallel_download_mb);
+      }
+   }
+
+   if (args->contains("parallel_download_ranges")) {
+      int parallel_download_ranges = args->get_int_value("parallel_download_ranges");
+      if (m_debug_mode) {
+         printf("setting parallel download ranges=%d\n", parallel_download_ranges);
+      }
+      if (parallel_download_ranges > 0) {
+         options.set_parallel_download_ranges(parallel_download_ranges);
+      }
+   }
+
+   if (args->contains("download_workers")) {
+      int download_workers = args->get_int_value("download_workers");
+      if (m_debug_mode) {
+         printf("setting download workers=%d\n", download_workers);
+      }
+      if (download_workers > 0) {
+         options.set_download_workers(download_workers);
+      }
+   }
+
+   if (args->contains("song_cache_mb")) {
+      int song_cache_mb = args->get_int_value("song_cache_mb");
+      if (m_debug_mode) {
+         printf("setting song cache MB=%d\n", song_cache_mb);
+      }
+      if (song_cache_mb > 0) {
+         options.set_song_cache_mb(song_cache_mb);
+      }
+   }
+
+   if (args->contains("content_hash")) {
+      string content_hash = args->get_string_value("content_hash");
+      ContentHash::Algorithm algorithm;
+      if (!ContentHash::algorithm_from_name(content_hash, algorithm)) {
+         printf("error: unsupported content hash %s (md5, xxh64)\n",
+                content_hash.c_str());
+         return 1;
+      }
+      if (m_debug_mode) {
+         printf("setting content hash=%s\n", content_hash.c_str());
+      }
+      options.set_content_hash(content_hash);
+   }
+
+   if (args->contains("import_workers")) {
+      int import_workers = args->get_int_value("import_workers");
+      if (m_debug_mode) {
+         printf("setting import workers=%d\n", import_workers);
+      }
+      if (import_workers > 0) {
+         options.set_import_workers(import_workers);
+      }
+   }
+
+   if (args->contains("storage_retries")) {
+      int storage_retries = args->get_int_value("storage_retries");
+      if (m_debug_mode) {
+         printf("setting storage retries=%d\n", storage_retries);
+      }
+      if (storage_retries >= 0) {
+         options.set_storage_retries(storage_retries);
+      }
+   }
+
+   if (args->contains("hedge_reads")) {
+      if (m_debug_mode) {
+         printf("setting hedged reads on\n");
+      }
+      options.set_hedge_reads(true);
+   }
+
+   if (args->contains("storage_stats")) {
+      if (m_debug_mode) {
+         printf("setting storage stats on\n");
+      }
+      options.set_storage_stats(true);
+   }
+
+   if (args->contains("stats_prom_file")) {
+      string stats_prom_file = args->get_string_value("stats_prom_file");
+      if (m_debug_mode) {
+         printf("setting stats prometheus file=%s\n", stats_prom_file.c_str());
+      }
+      options.set_stats_prometheus_file(stats_prom_file);
+   }
+
+   if (args->contains("stats_json_file")) {
+      string stats_json_file = args->get_string_value("stats_json_file");
+      if (m_debug_mode) {
+         printf("setting stats json file=%s\n", stats_json_file.c_str());
+      }
+      options.set_stats_json_file(stats_json_file);
+   }
+
+   if (args->contains("stats_interval")) {
+      int stats_interval = args->get_int_value("stats_interval");
+      if (m_debug_mode) {
+         printf("setting stats interval=%d\n", stats_interval);
+      }
+      if (stats_interval > 0) {
+         options.set_stats_interval_secs(stats_interval);
+      }
+   }
+
    if (args->contains("integrity_checks")) {
       if (m_debug_mode) {
          printf("setting integrity checks on\n");
@@ -574,6 +757,10 @@ int JukeboxMain::run(const vector<string>& console_args) {
       m_album = args->get_string_value("album");
    }
 
+   if (args->contains("query")) {
+      m_query = args->get_string_value("query");
+   }
+
    if (args->contains("command")) {
       if (m_debug_mode) {
          printf("using storage system type %s\n", storage_type.c_str());
@@ -631,6 +818,7 @@ int JukeboxMain::run(const vector<string>& console_args) {
       non_help_cmds.add("play");
       non_help_cmds.add("shuffle-play");
       non_help_cmds.add("list-songs");
+      non_help_cmds.add("search");
       non_help_cmds.add("list-artists");
       non_help_cmds.add("list-containers");
       non_help_cmds.add("list-genres");
@@ -659,6 +847,18 @@ int JukeboxMain::run(const vector<string>& console_args) {
       update_cmds.add("import-album-art");
       update_cmds.add("init-storage");
 
+      // commands that work with the storage system alone, so startup
+      // doesn't retrieve the catalog for them
+      StringSet storage_only_cmds;
+      storage_only_cmds.add("list-containers");
+      storage_only_cmds.add("list-playlists");
+      storage_only_cmds.add("retrieve-catalog");
+
+      StringSet player_cmds;
+      player_cmds.add("play");
+      player_cmds.add("shuffle-play");
+      player_cmds.add("play-playlist");
+
       StringSet all_cmds;
       all_cmds.append(help_cmds);
       all_cmds.append(non_help_cmds);
@@ -693,7 +893,23 @@ int JukeboxMain::run(const vector<string>& console_args) {
                storage_system.reset(connect_storage_system(storage_type,
                                                            creds,
                                                            container_prefix));
+               // metered inside the retries, so that each attempt counts
+               if (storage_system != nullptr && options.get_storage_stats()) {
+                  storage_system.reset(
+                     new MeteredStorageSystem(storage_system.release(),
+                                              m_debug_mode));
+               }
+               if (storage_system != nullptr &&
+                   (options.get_storage_retries() > 0 ||
+                    options.get_hedge_reads())) {
+                  storage_system.reset(
+                     new RetryingStorageSystem(storage_system.release(),
+                                               options.get_storage_retries() + 1,
+                                               options.get_hedge_reads(),
+                                               m_debug_mode));
+               }
                if (storage_system != nullptr) {
+                  storage_system->set_container_list_ttl(CONTAINER_LIST_TTL_SECS);
                   if (storage_system->enter()) {
                      if (command == "init-storage") {
                         if (init_storage_system(storage_system.get())) {
@@ -702,8 +918,16 @@ int JukeboxMain::run(const vector<string>& console_args) {
                            exit_code = 1;
                         }
                      } else {
+                        unsigned int startup_plan = 0;
+                        if (!storage_only_cmds.contains(command)) {
+                           startup_plan |= Jukebox::STARTUP_CATALOG;
+                        }
+                        if (player_cmds.contains(command)) {
+                           startup_plan |= Jukebox::STARTUP_AUDIO_PLAYER;
+                        }
+
                         Jukebox jukebox(options, *storage_system);
-                        if (jukebox.enter()) {
+                        if (jukebox.enter(startup_plan)) {
                            exit_code = run_jukebox_command(jukebox, command);
                            jukebox.exit();
                         } else {
@@ -15,6 +15,7 @@ private:
    std::string m_album;
    std::string m_song;
    std::string m_playlist;
+   std::string m_query;
    bool m_update_mode;
    bool m_debug_mode;
 
@@ -18,6 +18,19 @@ private:
    std::string m_encryption_key_file;
    std::string m_encryption_iv;
    bool m_suppress_metadata_download;
+   unsigned int m_progressive_download_kb;
+   unsigned int m_parallel_download_mb;
+   unsigned int m_parallel_download_ranges;
+   unsigned int m_download_workers;
+   unsigned int m_song_cache_mb;
+   std::string m_content_hash;
+   unsigned int m_import_workers;
+   unsigned int m_storage_retries;
+   bool m_hedge_reads;
+   bool m_storage_stats;
+   std::string m_stats_prometheus_file;
+   std::string m_stats_json_file;
+   unsigned int m_stats_interval_secs;
 
 
 public:
@@ -28,7 +41,18 @@ public:
       m_check_data_integrity(false),
       m_file_cache_count(3),
       m_number_songs(0),
-      m_suppress_metadata_download(false) {
+      m_suppress_metadata_download(false),
+      m_progressive_download_kb(0),
+      m_parallel_download_mb(0),
+      m_parallel_download_ranges(4),
+      m_download_workers(2),
+      m_song_cache_mb(0),
+      m_content_hash("md5"),
+      m_import_workers(4),
+      m_storage_retries(3),
+      m_hedge_reads(false),
+      m_storage_stats(false),
+      m_stats_interval_secs(15) {
    }
 
    JukeboxOptions(const JukeboxOptions& copy) :
@@ -41,7 +65,20 @@ public:
       m_encryption_key(copy.m_encryption_key),
       m_encryption_key_file(copy.m_encryption_key_file),
       m_encryption_iv(copy.m_encryption_iv),
-      m_suppress_metadata_download(copy.m_suppress_metadata_download) {
+      m_suppress_metadata_download(copy.m_suppress_metadata_download),
+      m_progressive_download_kb(copy.m_progressive_download_kb),
+      m_parallel_download_mb(copy.m_parallel_download_mb),
+      m_parallel_download_ranges(copy.m_parallel_download_ranges),
+      m_download_workers(copy.m_download_workers),
+      m_song_cache_mb(copy.m_song_cache_mb),
+      m_content_hash(copy.m_content_hash),
+      m_import_workers(copy.m_import_workers),
+      m_storage_retries(copy.m_storage_retries),
+      m_hedge_reads(copy.m_hedge_reads),
+      m_storage_stats(copy.m_storage_stats),
+      m_stats_prometheus_file(copy.m_stats_prometheus_file),
+      m_stats_json_file(copy.m_stats_json_file),
+      m_stats_interval_secs(copy.m_stats_interval_secs) {
    }
 
    JukeboxOptions& operator=(const JukeboxOptions& copy) {
@@ -59,6 +96,19 @@ public:
       m_encryption_key_file = copy.m_encryption_key_file;
       m_encryption_iv = copy.m_encryption_iv;
       m_suppress_metadata_download = copy.m_suppress_metadata_download;
+      m_progressive_download_kb = copy.m_progressive_download_kb;
+      m_parallel_download_mb = copy.m_parallel_download_mb;
+      m_parallel_download_ranges = copy.m_parallel_download_ranges;
+      m_download_workers = copy.m_download_workers;
+      m_song_cache_mb = copy.m_song_cache_mb;
+      m_content_hash = copy.m_content_hash;
+      m_import_workers = copy.m_import_workers;
+      m_storage_retries = copy.m_storage_retries;
+      m_hedge_reads = copy.m_hedge_reads;
+      m_storage_stats = copy.m_storage_stats;
+      m_stats_prometheus_file = copy.m_stats_prometheus_file;
+      m_stats_json_file = copy.m_stats_json_file;
+      m_stats_interval_secs = copy.m_stats_interval_secs;
 
       return *this;
    }
@@ -122,6 +172,58 @@ public:
       return m_suppress_metadata_download;
    }
 
+   unsigned int get_progressive_download_kb() const {
+      return m_progressive_download_kb;
+   }
+
+   unsigned int get_parallel_download_mb() const {
+      return m_parallel_download_mb;
+   }
+
+   unsigned int get_parallel_download_ranges() const {
+      return m_parallel_download_ranges;
+   }
+
+   unsigned int get_download_workers() const {
+      return m_download_workers;
+   }
+
+   unsigned int get_song_cache_mb() const {
+      return m_song_cache_mb;
+   }
+
+   const std::string& get_content_hash() const {
+      return m_content_hash;
+   }
+
+   unsigned int get_import_workers() const {
+      return m_import_workers;
+   }
+
+   unsigned int get_storage_retries() const {
+      return m_storage_retries;
+   }
+
+   bool get_hedge_reads() const {
+      return m_hedge_reads;
+   }
+
+   bool get_storage_stats() const {
+      return m_storage_stats;
+   }
+
+   const std::string& get_stats_prometheus_file() const {
+      return m_stats_prometheus_file;
+   }
+
+   const std::string& get_stats_json_file() const {
+      return m_stats_json_file;
+   }
+
+   unsigned int get_stats_interval_secs() const {
+      return m_stats_interval_secs;
+   }
+
    void set_debug_mode(bool b) {
       m_debug_mode = b;
    }
@@ -162,6 +264,58 @@ public:
       m_suppress_metadata_download = b;
    }
 
+   void set_progressive_download_kb(unsigned int i) {
+      m_progressive_download_kb = i;
+   }
+
+   void set_parallel_download_mb(unsigned int i) {
+      m_parallel_download_mb = i;
+   }
+
+   void set_parallel_download_ranges(unsigned int i) {
+      m_parallel_download_ranges = i;
+   }
+
+   void set_download_workers(unsigned int i) {
+      m_download_workers = i;
+   }
+
+   void set_song_cache_mb(unsigned int i) {
+      m_song_cache_mb = i;
+   }
+
+   void set_content_hash(const std::string& s) {
+      m_content_hash = s;
+   }
+
+   void set_import_workers(unsigned int i) {
+      m_import_workers = i;
+   }
+
+   void set_storage_retries(unsigned int i) {
+      m_storage_retries = i;
+   }
+
+   void set_hedge_reads(bool b) {
+      m_hedge_reads = b;
+   }
+
+   void set_storage_stats(bool b) {
+      m_storage_stats = b;
+   }
+
+   void set_stats_prometheus_file(const std::string& s) {
+      m_stats_prometheus_file = s;
+   }
+
+   void set_stats_json_file(const std::string& s) {
+      m_stats_json_file = s;
+   }
+
+   void set_stats_interval_secs(unsigned int i) {
+      m_stats_interval_secs = i;
+   }
+
 };
 
 #endif
@@ -0,0 +1,164 @@
+#include <algorithm>
+
+#include "latency_histogram.h"
+
+using namespace std;
+
+// values below 2^SUB_BUCKET_BITS get a bucket each; above that, each power
+// of two gets SUB_BUCKET_COUNT buckets
+static const unsigned int SUB_BUCKET_BITS = 5;
+static const unsigned int SUB_BUCKET_COUNT = 16;
+static const unsigned int MAX_MAGNITUDE = 36;
+static const size_t NUM_BUCKETS =
+   (1 << SUB_BUCKET_BITS) + (MAX_MAGNITUDE - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+//*****************************************************************************
+
+static unsigned int magnitude(uint64_t value) {
+   unsigned int bits = 0;
+   while (value >>= 1) {
+      ++bits;
+   }
+   return bits;
+}
+
+//*****************************************************************************
+
+size_t LatencyHistogram::bucket_index(uint64_t micros) {
+   if (micros < (1 << SUB_BUCKET_BITS)) {
+      return micros;
+   }
+
+   unsigned int m = magnitude(micros);
+   if (m > MAX_MAGNITUDE) {
+      return NUM_BUCKETS - 1;
+   }
+   // the 4 bits after the leading one pick the sub-bucket
+   size_t sub_bucket = (micros >> (m - 4)) - SUB_BUCKET_COUNT;
+   return (1 << SUB_BUCKET_BITS) + (m - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+//*****************************************************************************
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index) {
+   if (index < (1 << SUB_BUCKET_BITS)) {
+      return index;
+   }
+
+   size_t offset = index - (1 << SUB_BUCKET_BITS);
+   unsigned int m = offset / SUB_BUCKET_COUNT + SUB_BUCKET_BITS;
+   uint64_t sub_bucket = offset % SUB_BUCKET_COUNT;
+   uint64_t lower_bound = (SUB_BUCKET_COUNT + sub_bucket) << (m - 4);
+   return lower_bound + (((uint64_t) 1) << (m - 4)) - 1;
+}
+
+//*****************************************************************************
+
+LatencyHistogram::LatencyHistogram() :
+   m_counts(NUM_BUCKETS, 0),
+   m_total_count(0),
+   m_min_micros(0),
+   m_max_micros(0),
+   m_sum_micros(0.0) {
+}
+
+//*****************************************************************************
+
+void LatencyHistogram::record(double seconds) {
+   record_micros(seconds > 0.0 ? (uint64_t) (seconds * 1000000.0) : 0);
+}
+
+//*****************************************************************************
+
+void LatencyHistogram::record_micros(uint64_t micros) {
+   ++m_counts[bucket_index(micros)];
+   if (m_total_count == 0 || micros < m_min_micros) {
+      m_min_micros = micros;
+   }
+   m_max_micros = std::max(m_max_micros, micros);
+   m_sum_micros += micros;
+   ++m_total_count;
+}
+
+//*****************************************************************************
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+   if (other.m_total_count == 0) {
+      return;
+   }
+   for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+      m_counts[i] += other.m_counts[i];
+   }
+   if (m_total_count == 0 || other.m_min_micros < m_min_micros) {
+      m_min_micros = other.m_min_micros;
+   }
+   m_max_micros = std::max(m_max_micros, other.m_max_micros);
+   m_sum_micros += other.m_sum_micros;
+   m_total_count += other.m_total_count;
+}
+
+//*****************************************************************************
+
+void LatencyHistogram::reset() {
+   std::fill(m_counts.begin(), m_counts.end(), 0);
+   m_total_count = 0;
+   m_min_micros = 0;
+   m_max_micros = 0;
+   m_sum_micros = 0.0;
+}
+
+//*****************************************************************************
+
+uint64_t LatencyHistogram::count() const {
+   return m_total_count;
+}
+
+//*****************************************************************************
+
+uint64_t LatencyHistogram::min_micros() const {
+   return m_min_micros;
+}
+
+//*****************************************************************************
+
+uint64_t LatencyHistogram::max_micros() const {
+   return m_max_micros;
+}
+
+//*****************************************************************************
+
+double LatencyHistogram::mean_micros() const {
+   if (m_total_count == 0) {
+      return 0.0;
+   }
+   return m_sum_micros / m_total_count;
+}
+
+//*****************************************************************************
+
+uint64_t LatencyHistogram::percentile_micros(double fraction) const {
+   if (m_total_count == 0) {
+      return 0;
+   }
+
+   if (fraction <= 0.0) {
+      return m_min_micros;
+   }
+
+   fraction = std::min(fraction, 1.0);
+   uint64_t rank = std::max((uint64_t) 1,
+                            (uint64_t) (fraction * m_total_count + 0.5));
+   uint64_t seen = 0;
+   for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+      seen += m_counts[i];
+      if (seen >= rank) {
+         // a bucket's bound can overstate the values actually in it
+         return std::min(std::max(bucket_upper_bound(i), m_min_micros),
+                         m_max_micros);
+      }
+   }
+   return m_max_micros;
+}
+
+//*****************************************************************************
+
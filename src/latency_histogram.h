@@ -0,0 +1,44 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+// Log-linear histogram of latencies in microseconds, in the manner of an
+// HDR histogram: each power of two is split into 16 buckets, so any
+// recorded value is known to within about 6% using a fixed 4 KB of counts
+// no matter how many values are recorded. Values past about 19 hours land
+// in the last bucket. Not synchronized; callers recording from several
+// threads lock around it.
+class LatencyHistogram {
+private:
+   std::vector<uint64_t> m_counts;
+   uint64_t m_total_count;
+   uint64_t m_min_micros;
+   uint64_t m_max_micros;
+   double m_sum_micros;
+
+   static size_t bucket_index(uint64_t micros);
+   static uint64_t bucket_upper_bound(size_t index);
+
+public:
+   LatencyHistogram();
+
+   void record(double seconds);
+   void record_micros(uint64_t micros);
+   void merge(const LatencyHistogram& other);
+   void reset();
+
+   uint64_t count() const;
+   uint64_t min_micros() const;
+   uint64_t max_micros() const;
+   double mean_micros() const;
+   // value that fraction (0-1) of the recorded values are at or below,
+   // rounded up to its bucket's upper bound; 0 if nothing was recorded
+   uint64_t percentile_micros(double fraction) const;
+};
+
+#endif
+
@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <set>
+
+#include "library_generator.h"
+#include "jb_utils.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+#include "nlohmann/json.hpp"
+
+using namespace std;
+using namespace chaudiere;
+using json = nlohmann::json;
+
+const string LibraryGenerator::SONG_DIR = "song-import";
+const string LibraryGenerator::PLAYLIST_DIR = "playlist-import";
+const string LibraryGenerator::ALBUM_DIR = "album-import";
+
+static const string JSON_FILE_EXT = ".json";
+static const size_t WRITE_BUFFER_SIZE = 256 * 1024;
+static const unsigned int NUM_SIZE_CLASSES = 16;
+
+// only the engine's output is pinned down by the standard (distributions
+// differ between standard libraries), so everything random is derived
+// from it directly to keep libraries identical across platforms
+typedef std::mt19937 LibraryRng;
+
+static const char* SYLLABLES[] = {
+   "ka", "lo", "mi", "ra", "ven", "tor", "sil", "an", "bel", "dro",
+   "mu", "ne", "pa", "quin", "sa", "tel", "vo", "zer", "el", "ri",
+   "cor", "da", "fen", "gal", "hu", "jo", "lin", "mar", "nos", "ol"
+};
+static const size_t NUM_SYLLABLES = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+//*****************************************************************************
+
+static uint32_t random_below(LibraryRng& rng, uint32_t n) {
+   return n > 0 ? rng() % n : 0;
+}
+
+//*****************************************************************************
+
+static double random_unit(LibraryRng& rng) {
+   return rng() / 4294967296.0;
+}
+
+//*****************************************************************************
+
+// running totals of 1/rank^exponent for ranks 1..n
+static vector<double> zipf_cumulative_weights(size_t n, double exponent) {
+   vector<double> cumulative_weights;
+   double total_weight = 0.0;
+   for (size_t rank = 1; rank <= n; ++rank) {
+      total_weight += 1.0 / pow((double) rank, exponent);
+      cumulative_weights.push_back(total_weight);
+   }
+   return cumulative_weights;
+}
+
+//*****************************************************************************
+
+// a zero-based rank drawn with the weights from zipf_cumulative_weights
+static size_t random_zipf_rank(LibraryRng& rng,
+                               const vector<double>& cumulative_weights) {
+   if (cumulative_weights.empty()) {
+      return 0;
+   }
+   double pick = random_unit(rng) * cumulative_weights.back();
+   size_t rank =
+      std::upper_bound(cumulative_weights.begin(),
+                       cumulative_weights.end(),
+                       pick) - cumulative_weights.begin();
+   return std::min(rank, cumulative_weights.size() - 1);
+}
+
+//*****************************************************************************
+
+static string random_word(LibraryRng& rng) {
+   string word;
+   unsigned int num_syllables = 2 + random_below(rng, 2);
+   for (unsigned int i = 0; i < num_syllables; ++i) {
+      word += SYLLABLES[random_below(rng, NUM_SYLLABLES)];
+   }
+   word[0] = toupper(word[0]);
+   return word;
+}
+
+//*****************************************************************************
+
+// a name of a few words that isn't already in used_names
+static string unique_name(LibraryRng& rng,
+                          unsigned int min_words,
+                          unsigned int max_words,
+                          set<string>& used_names) {
+   for (;;) {
+      string name;
+      unsigned int num_words =
+         min_words + random_below(rng, max_words - min_words + 1);
+      for (unsigned int i = 0; i < num_words; ++i) {
+         if (i > 0) {
+            name += " ";
+         }
+         name += random_word(rng);
+      }
+      if (used_names.insert(name).second) {
+         return name;
+      }
+   }
+}
+
+//*****************************************************************************
+
+LibraryGenerator::LibraryGenerator(const LibraryConfig& config) :
+   m_config(config) {
+   if (m_config.min_tracks == 0) {
+      m_config.min_tracks = 1;
+   }
+   if (m_config.max_tracks < m_config.min_tracks) {
+      m_config.max_tracks = m_config.min_tracks;
+   }
+   if (m_config.max_file_bytes < m_config.min_file_bytes) {
+      m_config.max_file_bytes = m_config.min_file_bytes;
+   }
+   if (m_config.extensions.empty()) {
+      m_config.extensions.push_back(".flac");
+   }
+   generate_catalog();
+   generate_playlists();
+}
+
+//*****************************************************************************
+
+void LibraryGenerator::generate_catalog() {
+   LibraryRng rng(m_config.seed);
+   vector<unsigned int> albums_per_artist =
+      zipf_allocation(m_config.num_albums,
+                      m_config.num_artists,
+                      m_config.zipf_exponent);
+
+   // file sizes pick one of NUM_SIZE_CLASSES equal slices of the size range
+   // by Zipf rank (smallest first), then a size within the slice
+   vector<double> size_class_weights =
+      zipf_cumulative_weights(NUM_SIZE_CLASSES, m_config.zipf_exponent);
+   double size_class_bytes =
+      (double) (m_config.max_file_bytes - m_config.min_file_bytes + 1) /
+      NUM_SIZE_CLASSES;
+
+   set<string> artist_names;
+   for (unsigned int num_artist_albums : albums_per_artist) {
+      if (num_artist_albums == 0) {
+         break;
+      }
+      Artist artist;
+      artist.name = unique_name(rng, 1, 3, artist_names);
+      artist.first_album = m_albums.size();
+      artist.num_albums = num_artist_albums;
+
+      set<string> album_names;
+      for (unsigned int i = 0; i < num_artist_albums; ++i) {
+         Album album;
+         album.name = unique_name(rng, 1, 4, album_names);
+         album.first_song = m_songs.size();
+         album.num_songs = m_config.min_tracks +
+            random_below(rng, m_config.max_tracks - m_config.min_tracks + 1);
+
+         set<string> song_names;
+         for (size_t track = 1; track <= album.num_songs; ++track) {
+            GeneratedSong song;
+            song.artist = artist.name;
+            song.album = album.name;
+            song.song = unique_name(rng, 1, 5, song_names);
+            const string& extension =
+               m_config.extensions[random_below(rng, m_config.extensions.size())];
+            song.file_name =
+               JBUtils::encode_artist_album_song(song.artist,
+                                                 song.album,
+                                                 song.song) + extension;
+            song.track_number = track;
+            size_t size_class = random_zipf_rank(rng, size_class_weights);
+            song.file_size = m_config.min_file_bytes +
+               (int64_t) ((size_class + random_unit(rng)) * size_class_bytes);
+            song.file_size = std::min(song.file_size, m_config.max_file_bytes);
+            m_songs.push_back(song);
+         }
+         m_albums.push_back(album);
+      }
+      m_artists.push_back(artist);
+   }
+}
+
+//*****************************************************************************
+
+void LibraryGenerator::generate_playlists() {
+   if (m_songs.empty()) {
+      return;
+   }
+
+   // a separate stream so that changing the playlists leaves the catalog
+   // as it was
+   LibraryRng rng(m_config.seed + 1);
+
+   vector<double> artist_weights =
+      zipf_cumulative_weights(m_artists.size(), m_config.zipf_exponent);
+
+   size_t songs_per_playlist =
+      std::min((size_t) m_config.songs_per_playlist, m_songs.size());
+
+   set<string> playlist_names;
+   for (unsigned int i = 0; i < m_config.num_playlists; ++i) {
+      m_playlist_names.push_back(unique_name(rng, 1, 3, playlist_names));
+
+      vector<size_t> playlist;
+      set<size_t> chosen;
+      while (playlist.size() < songs_per_playlist) {
+         const Artist& artist =
+            m_artists[random_zipf_rank(rng, artist_weights)];
+         const Album& album =
+            m_albums[artist.first_album + random_below(rng, artist.num_albums)];
+         size_t song_index = album.first_song + random_below(rng, album.num_songs);
+         if (chosen.insert(song_index).second) {
+            playlist.push_back(song_index);
+         }
+      }
+      m_playlists.push_back(playlist);
+   }
+}
+
+//*****************************************************************************
+
+const LibraryConfig& LibraryGenerator::get_config() const {
+   return m_config;
+}
+
+//*****************************************************************************
+
+const vector<GeneratedSong>& LibraryGenerator::get_songs() const {
+   return m_songs;
+}
+
+//*****************************************************************************
+
+size_t LibraryGenerator::num_albums() const {
+   return m_albums.size();
+}
+
+//*****************************************************************************
+
+SongMetadata LibraryGenerator::song_metadata(const GeneratedSong& song) const {
+   SongMetadata song_metadata;
+   song_metadata.set_file_uid(song.file_name);
+   song_metadata.set_file_name(song.file_name);
+   song_metadata.set_object_name(song.file_name);
+   song_metadata.set_artist_uid(JBUtils::encode_value(song.artist));
+   song_metadata.set_artist_name(song.artist);
+   song_metadata.set_album_uid(JBUtils::encode_artist_album(song.artist,
+                                                            song.album));
+   song_metadata.set_song_name(song.song);
+   song_metadata.set_origin_file_size((unsigned long) song.file_size);
+   song_metadata.set_stored_file_size((unsigned long) song.file_size);
+   song_metadata.set_pad_char_count(0);
+   song_metadata.set_compressed(0);
+   song_metadata.set_encrypted(0);
+   return song_metadata;
+}
+
+//*****************************************************************************
+
+const vector<string>& LibraryGenerator::get_playlist_names() const {
+   return m_playlist_names;
+}
+
+//*****************************************************************************
+
+string LibraryGenerator::playlist_file_name(size_t playlist) const {
+   return JBUtils::encode_value(m_playlist_names[playlist]) + JSON_FILE_EXT;
+}
+
+//*****************************************************************************
+
+string LibraryGenerator::playlist_json(size_t playlist) const {
+   json songs_json = json::array();
+   for (size_t song_index : m_playlists[playlist]) {
+      const GeneratedSong& song = m_songs[song_index];
+      json song_json;
+      song_json["artist"] = song.artist;
+      song_json["album"] = song.album;
+      song_json["song"] = song.song;
+      songs_json.push_back(song_json);
+   }
+
+   json playlist_json;
+   playlist_json["name"] = m_playlist_names[playlist];
+   playlist_json["songs"] = songs_json;
+   return playlist_json.dump(3);
+}
+
+//*****************************************************************************
+
+string LibraryGenerator::album_file_name(size_t album) const {
+   const GeneratedSong& first_song = m_songs[m_albums[album].first_song];
+   return JBUtils::encode_artist_album(first_song.artist, first_song.album) +
+          JSON_FILE_EXT;
+}
+
+//*****************************************************************************
+
+string LibraryGenerator::album_json(size_t album) const {
+   const Album& the_album = m_albums[album];
+   json tracks_json = json::array();
+   for (size_t i = 0; i < the_album.num_songs; ++i) {
+      const GeneratedSong& song = m_songs[the_album.first_song + i];
+      json track_json;
+      track_json["number"] = song.track_number;
+      track_json["title"] = song.song;
+      track_json["object"] = song.file_name;
+      tracks_json.push_back(track_json);
+   }
+
+   json album_json;
+   album_json["artist"] = m_songs[the_album.first_song].artist;
+   album_json["album"] = the_album.name;
+   album_json["tracks"] = tracks_json;
+   return album_json.dump(3);
+}
+
+//*****************************************************************************
+
+bool LibraryGenerator::write(const string& root_dir) const {
+   return write_songs(OSUtils::pathJoin(root_dir, SONG_DIR)) &&
+          write_playlists(OSUtils::pathJoin(root_dir, PLAYLIST_DIR)) &&
+          write_albums(OSUtils::pathJoin(root_dir, ALBUM_DIR));
+}
+
+//*****************************************************************************
+
+static bool ensure_directory(const string& dir_path) {
+   if (!OSUtils::directoryExists(dir_path) &&
+       !OSUtils::createDirectory(dir_path)) {
+      printf("error: unable to create directory %s\n", dir_path.c_str());
+      return false;
+   }
+   return true;
+}
+
+//*****************************************************************************
+
+bool LibraryGenerator::write_songs(const string& song_dir) const {
+   if (!ensure_directory(song_dir)) {
+      return false;
+   }
+   for (const auto& song : m_songs) {
+      if (!write_song_file(song, OSUtils::pathJoin(song_dir, song.file_name))) {
+         return false;
+      }
+   }
+   return true;
+}
+
+//*****************************************************************************
+
+bool LibraryGenerator::write_playlists(const string& playlist_dir) const {
+   if (!ensure_directory(playlist_dir)) {
+      return false;
+   }
+   for (size_t i = 0; i < m_playlists.size(); ++i) {
+      string file_path = OSUtils::pathJoin(playlist_dir, playlist_file_name(i));
+      if (!Utils::file_write_all_text(file_path, playlist_json(i))) {
+         printf("error: unable to write playlist %s\n", file_path.c_str());
+         return false;
+      }
+   }
+   return true;
+}
+
+//*****************************************************************************
+
+bool LibraryGenerator::write_albums(const string& album_dir) const {
+   if (!ensure_directory(album_dir)) {
+      return false;
+   }
+   for (size_t i = 0; i < m_albums.size(); ++i) {
+      string file_path = OSUtils::pathJoin(album_dir, album_file_name(i));
+      if (!Utils::file_write_all_text(file_path, album_json(i))) {
+         printf("error: unable to write album %s\n", file_path.c_str());
+         return false;
+      }
+   }
+   return true;
+}
+
+//*****************************************************************************
+
+bool LibraryGenerator::write_song_file(const GeneratedSong& song,
+                                       const string& file_path) const {
+   int fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0) {
+      printf("error: unable to create %s\n", file_path.c_str());
+      return false;
+   }
+
+   bool success = true;
+   if (m_config.sparse_files) {
+      success = ftruncate(fd, song.file_size) == 0;
+   } else {
+      // seeded by the song's own name so that its contents don't depend on
+      // which other songs were written or in what order
+      string seed_name = to_string(m_config.seed) + "/" + song.file_name;
+      std::seed_seq seed(seed_name.begin(), seed_name.end());
+      std::mt19937_64 rng(seed);
+      vector<uint64_t> buffer(WRITE_BUFFER_SIZE / sizeof(uint64_t));
+      int64_t bytes_left = song.file_size;
+      while (success && bytes_left > 0) {
+         for (auto& word : buffer) {
+            word = rng();
+         }
+         size_t chunk_size = (size_t) std::min((int64_t) WRITE_BUFFER_SIZE,
+                                               bytes_left);
+         success = ::write(fd, buffer.data(), chunk_size) == (ssize_t) chunk_size;
+         bytes_left -= chunk_size;
+      }
+   }
+
+   if (close(fd) != 0) {
+      success = false;
+   }
+   if (!success) {
+      printf("error: unable to write %s\n", file_path.c_str());
+   }
+   return success;
+}
+
+//*****************************************************************************
+
+vector<unsigned int> LibraryGenerator::zipf_allocation(unsigned int total,
+                                                       unsigned int num_buckets,
+                                                       double exponent) {
+   vector<unsigned int> counts(num_buckets, 0);
+   if (num_buckets == 0) {
+      return counts;
+   }
+   if (total <= num_buckets) {
+      for (unsigned int i = 0; i < total; ++i) {
+         counts[i] = 1;
+      }
+      return counts;
+   }
+
+   vector<double> weights(num_buckets);
+   double total_weight = 0.0;
+   for (unsigned int i = 0; i < num_buckets; ++i) {
+      weights[i] = 1.0 / pow((double) (i + 1), exponent);
+      total_weight += weights[i];
+   }
+
+   // one each, then the rest in proportion to the weights, with whatever
+   // rounding down left over going to the largest remainders
+   unsigned int remaining = total - num_buckets;
+   unsigned int allocated = 0;
+   vector<pair<double, unsigned int>> remainders;
+   for (unsigned int i = 0; i < num_buckets; ++i) {
+      double share = remaining * weights[i] / total_weight;
+      unsigned int whole = (unsigned int) share;
+      counts[i] = 1 + whole;
+      allocated += whole;
+      remainders.push_back(make_pair(share - whole, i));
+   }
+   std::stable_sort(remainders.begin(), remainders.end(),
+                    [](const pair<double, unsigned int>& a,
+                       const pair<double, unsigned int>& b) {
+                       return a.first > b.first;
+                    });
+   for (unsigned int i = 0; allocated < remaining; ++i) {
+      ++counts[remainders[i].second];
+      ++allocated;
+   }
+   return counts;
+}
+
+//*****************************************************************************
+
@@ -0,0 +1,142 @@
+#ifndef LIBRARY_GENERATOR_H
+#define LIBRARY_GENERATOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "song_metadata.h"
+
+
+struct LibraryConfig {
+   unsigned int num_artists;
+   // albums are shared out over the artists by a Zipf distribution (every
+   // artist gets at least one), so a few artists have most of the albums
+   unsigned int num_albums;
+   double zipf_exponent;
+   unsigned int min_tracks;
+   unsigned int max_tracks;
+   // sizes also follow zipf_exponent: the range is cut into equal slices
+   // ranked smallest first, so most files are small with a long tail of
+   // large ones
+   int64_t min_file_bytes;
+   int64_t max_file_bytes;
+   // sparse files take no disk space and read back as zeros; otherwise
+   // each file is filled with its own pseudo-random bytes
+   bool sparse_files;
+   // each song is given one of these at random
+   std::vector<std::string> extensions;
+   // playlist songs are picked with the same Zipf skew towards the
+   // artists with the most albums
+   unsigned int num_playlists;
+   unsigned int songs_per_playlist;
+   uint32_t seed;
+
+   LibraryConfig() :
+      num_artists(50),
+      num_albums(200),
+      zipf_exponent(1.0),
+      min_tracks(8),
+      max_tracks(16),
+      min_file_bytes(3000000),
+      max_file_bytes(12000000),
+      sparse_files(true),
+      extensions({".flac", ".m4a", ".mp3"}),
+      num_playlists(10),
+      songs_per_playlist(25),
+      seed(42) {
+   }
+};
+
+
+struct GeneratedSong {
+   std::string artist;
+   std::string album;
+   std::string song;
+   // artist--album--song.ext, as import_songs expects
+   std::string file_name;
+   unsigned int track_number;
+   int64_t file_size;
+};
+
+
+// Builds a synthetic music library for testing import_songs and the
+// catalog at scale. The same config always produces the same library,
+// names, sizes and file contents included. Names are made up of
+// letters and spaces only, so they survive the file name encoding.
+//
+// write() lays the library out the way the jukebox imports it:
+//  - song-import: one file per song
+//  - playlist-import: one JSON playlist per playlist, as read by
+//    get_playlist_songs
+//  - album-import: one JSON track listing per album, as read from the
+//    album container by show_album and play_album
+class LibraryGenerator {
+private:
+   struct Album {
+      std::string name;
+      size_t first_song;
+      size_t num_songs;
+   };
+
+   struct Artist {
+      std::string name;
+      size_t first_album;
+      size_t num_albums;
+   };
+
+   LibraryConfig m_config;
+   std::vector<Artist> m_artists;
+   std::vector<Album> m_albums;
+   std::vector<GeneratedSong> m_songs;
+   std::vector<std::string> m_playlist_names;
+   std::vector<std::vector<size_t>> m_playlists;
+
+   LibraryGenerator(const LibraryGenerator&);
+   LibraryGenerator& operator=(const LibraryGenerator&);
+
+   void generate_catalog();
+   void generate_playlists();
+
+public:
+   static const std::string SONG_DIR;
+   static const std::string PLAYLIST_DIR;
+   static const std::string ALBUM_DIR;
+
+   explicit LibraryGenerator(const LibraryConfig& config);
+
+   const LibraryConfig& get_config() const;
+   const std::vector<GeneratedSong>& get_songs() const;
+   size_t num_albums() const;
+
+   // the song's catalog entry as import_songs would record it (without
+   // compression or encryption); the container is left to the caller
+   SongMetadata song_metadata(const GeneratedSong& song) const;
+
+   const std::vector<std::string>& get_playlist_names() const;
+   // playlist object name (encoded name plus .json)
+   std::string playlist_file_name(size_t playlist) const;
+   std::string playlist_json(size_t playlist) const;
+
+   // album object name (encoded artist--album plus .json)
+   std::string album_file_name(size_t album) const;
+   std::string album_json(size_t album) const;
+
+   // writes the song files, playlists and album listings under root_dir
+   bool write(const std::string& root_dir) const;
+   bool write_songs(const std::string& song_dir) const;
+   bool write_playlists(const std::string& playlist_dir) const;
+   bool write_albums(const std::string& album_dir) const;
+   bool write_song_file(const GeneratedSong& song,
+                        const std::string& file_path) const;
+
+   // Shares total out over num_buckets with weights 1/rank^exponent,
+   // giving every bucket at least one while there are enough to go
+   // around. Counts are in rank order and always sum to total.
+   static std::vector<unsigned int> zipf_allocation(unsigned int total,
+                                                    unsigned int num_buckets,
+                                                    double exponent);
+};
+
+#endif
+
@@ -0,0 +1,537 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "metadata_sync.h"
+#include "property_set.h"
+#include "utils.h"
+#include "OSUtils.h"
+#include "nlohmann/json.hpp"
+
+using namespace std;
+using namespace chaudiere;
+using json = nlohmann::json;
+
+const string MetadataSync::APPLIED_DELTA = "applied_delta";
+const string MetadataSync::SNAPSHOT_TAG = "snapshot_tag";
+
+static const string DELTA_SUFFIX = ".delta.";
+static const string PROP_ETAG = "etag";
+
+//*****************************************************************************
+
+static json song_to_json(const SongMetadata& song) {
+   json song_json;
+   song_json["song_uid"] = song.get_file_uid();
+   song_json["file_time"] = song.get_file_time();
+   song_json["origin_file_size"] = song.get_origin_file_size();
+   song_json["stored_file_size"] = song.get_stored_file_size();
+   song_json["pad_char_count"] = song.get_pad_char_count();
+   song_json["artist_name"] = song.get_artist_name();
+   song_json["artist_uid"] = song.get_artist_uid();
+   song_json["song_name"] = song.get_song_name();
+   song_json["md5_hash"] = song.get_md5_hash();
+   song_json["compressed"] = song.get_compressed();
+   song_json["encrypted"] = song.get_encrypted();
+   song_json["container_name"] = song.get_container_name();
+   song_json["object_name"] = song.get_object_name();
+   song_json["album_uid"] = song.get_album_uid();
+   return song_json;
+}
+
+//*****************************************************************************
+
+static SongMetadata song_from_json(const json& song_json) {
+   SongMetadata song;
+   song.set_file_uid(song_json["song_uid"].get<string>());
+   song.set_file_time(song_json["file_time"].get<string>());
+   song.set_origin_file_size(song_json["origin_file_size"].get<unsigned long>());
+   song.set_stored_file_size(song_json["stored_file_size"].get<unsigned long>());
+   song.set_pad_char_count(song_json["pad_char_count"].get<unsigned long>());
+   song.set_artist_name(song_json["artist_name"].get<string>());
+   song.set_artist_uid(song_json["artist_uid"].get<string>());
+   song.set_song_name(song_json["song_name"].get<string>());
+   song.set_md5_hash(song_json["md5_hash"].get<string>());
+   song.set_compressed(song_json["compressed"].get<int>());
+   song.set_encrypted(song_json["encrypted"].get<int>());
+   song.set_container_name(song_json["container_name"].get<string>());
+   song.set_object_name(song_json["object_name"].get<string>());
+   song.set_album_uid(song_json["album_uid"].get<string>());
+   return song;
+}
+
+//*****************************************************************************
+
+// tags are only ever compared, so a DB keeps a 64-bit FNV-1a hash of one
+static int64_t tag_value(const string& tag) {
+   if (tag.empty()) {
+      return 0;
+   }
+   uint64_t hash = 14695981039346656037ULL;
+   for (const unsigned char c : tag) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+   }
+   return (int64_t) hash;
+}
+
+//*****************************************************************************
+
+bool MetadataSync::delta_seq_from_name(const string& snapshot_object,
+                                       const string& object_name,
+                                       int64_t& seq) {
+   const string prefix = snapshot_object + DELTA_SUFFIX;
+   if (object_name.length() <= prefix.length() ||
+       object_name.compare(0, prefix.length(), prefix) != 0) {
+      return false;
+   }
+
+   for (size_t i = prefix.length(); i < object_name.length(); ++i) {
+      if (!isdigit((unsigned char) object_name[i])) {
+         return false;
+      }
+   }
+
+   seq = strtoll(object_name.c_str() + prefix.length(), nullptr, 10);
+   return seq > 0;
+}
+
+//*****************************************************************************
+
+MetadataSync::MetadataSync(StorageSystem& storage_system,
+                           const string& container,
+                           const string& snapshot_object,
+                           const string& db_file_path,
+                           unsigned int compaction_interval,
+                           bool debug_print) :
+   m_storage_system(storage_system),
+   m_container(container),
+   m_snapshot_object(snapshot_object),
+   m_db_file_path(db_file_path),
+   m_compaction_interval(compaction_interval > 0 ? compaction_interval : 1),
+   m_debug_print(debug_print) {
+}
+
+//*****************************************************************************
+
+string MetadataSync::delta_object_name(int64_t seq) const {
+   // zero padded so that a listing sorts in sequence order
+   char seq_digits[32];
+   snprintf(seq_digits, sizeof(seq_digits), "%012lld", (long long) seq);
+   return m_snapshot_object + DELTA_SUFFIX + seq_digits;
+}
+
+//*****************************************************************************
+
+void MetadataSync::list_catalog(map<int64_t, string>& deltas,
+                                bool& have_snapshot) {
+   deltas.clear();
+   have_snapshot = false;
+
+   vector<string> container_contents =
+      m_storage_system.list_container_contents(m_container);
+
+   for (const auto& object_name : container_contents) {
+      int64_t seq = 0;
+      if (object_name == m_snapshot_object) {
+         have_snapshot = true;
+      } else if (delta_seq_from_name(m_snapshot_object, object_name, seq)) {
+         deltas[seq] = object_name;
+      }
+   }
+}
+
+//*****************************************************************************
+
+string MetadataSync::snapshot_tag() {
+   PropertySet props;
+   if (!m_storage_system.get_object_metadata(m_container,
+                                             m_snapshot_object,
+                                             props)) {
+      return "";
+   }
+
+   // the md5 is only there if the uploader supplied it; the ETag is
+   // whatever the storage system computed
+   if (props.contains(PropertySet::PROP_CONTENT_MD5)) {
+      return props.get_string_value(PropertySet::PROP_CONTENT_MD5);
+   } else if (props.contains(PROP_ETAG)) {
+      return props.get_string_value(PROP_ETAG);
+   } else {
+      return "";
+   }
+}
+
+//*****************************************************************************
+
+bool MetadataSync::snapshot_replaced(JukeboxDB& jukebox_db) {
+   int64_t recorded_tag = 0;
+   if (!jukebox_db.get_sync_value(SNAPSHOT_TAG, recorded_tag) ||
+       recorded_tag == 0) {
+      return false;
+   }
+
+   // a snapshot that can't be checked is assumed unchanged
+   const string remote_tag = snapshot_tag();
+   return !remote_tag.empty() && tag_value(remote_tag) != recorded_tag;
+}
+
+//*****************************************************************************
+
+// true if every delta after applied is still published
+static bool have_deltas_after(const map<int64_t, string>& deltas,
+                              int64_t applied) {
+   if (deltas.empty() || deltas.rbegin()->first <= applied) {
+      return true;
+   }
+   const int64_t unseen = distance(deltas.upper_bound(applied), deltas.end());
+   return unseen == deltas.rbegin()->first - applied;
+}
+
+//*****************************************************************************
+
+bool MetadataSync::pull(JukeboxDB& jukebox_db) {
+   if (!jukebox_db.is_open() && !jukebox_db.open()) {
+      return false;
+   }
+
+   map<int64_t, string> deltas;
+   bool have_snapshot = false;
+   list_catalog(deltas, have_snapshot);
+
+   int64_t applied = 0;
+   bool synced = jukebox_db.get_sync_value(APPLIED_DELTA, applied);
+
+   if (have_snapshot && (!synced ||
+                         !have_deltas_after(deltas, applied) ||
+                         snapshot_replaced(jukebox_db))) {
+      if (!download_snapshot(jukebox_db)) {
+         return false;
+      }
+      applied = 0;
+      synced = jukebox_db.get_sync_value(APPLIED_DELTA, applied);
+      // a snapshot that records its delta can't be caught up if it's
+      // older than the oldest delta still listed (one uploaded whole by
+      // an older jukebox records none and is taken as is)
+      if (synced && !have_deltas_after(deltas, applied)) {
+         printf("error: metadata deltas after snapshot %lld are missing\n",
+                (long long) applied);
+         return false;
+      }
+   } else if (!have_deltas_after(deltas, applied)) {
+      printf("error: metadata deltas after %lld are missing\n",
+             (long long) applied);
+      return false;
+   }
+
+   if (m_debug_print) {
+      printf("metadata DB includes delta %lld\n", (long long) applied);
+   }
+
+   map<int64_t, string> unseen_deltas(deltas.upper_bound(applied),
+                                      deltas.end());
+   if (unseen_deltas.empty()) {
+      // remember that this DB matches the published catalog; when nothing
+      // has changed there's nothing to write
+      return synced || jukebox_db.set_sync_value(APPLIED_DELTA, applied);
+   }
+
+   return apply_deltas(jukebox_db, unseen_deltas);
+}
+
+//*****************************************************************************
+
+bool MetadataSync::download_snapshot(JukeboxDB& jukebox_db) {
+   vector<string> stored_song_uids;
+   vector<string> deleted_song_uids;
+   jukebox_db.get_changes(stored_song_uids, deleted_song_uids);
+   if (!stored_song_uids.empty() || !deleted_song_uids.empty()) {
+      printf("warning: discarding %zu unpublished metadata changes\n",
+             stored_song_uids.size() + deleted_song_uids.size());
+   }
+
+   if (m_debug_print) {
+      printf("downloading metadata DB snapshot\n");
+   }
+
+   // taken before the download so that a snapshot replaced meanwhile
+   // looks changed next time rather than the other way around
+   const string tag = snapshot_tag();
+
+   jukebox_db.close();
+
+   string download_file = m_db_file_path + ".download";
+   bool downloaded = false;
+   if (m_storage_system.get_object(m_container,
+                                   m_snapshot_object,
+                                   download_file) > 0) {
+      if (Utils::path_exists(m_db_file_path)) {
+         OSUtils::deleteFile(m_db_file_path);
+      }
+      downloaded = Utils::rename_file(download_file, m_db_file_path);
+   } else {
+      printf("error: unable to retrieve metadata DB file\n");
+   }
+
+   if (!jukebox_db.open()) {
+      return false;
+   }
+
+   // replaces the tag recorded by whoever uploaded the snapshot
+   return downloaded &&
+          jukebox_db.set_sync_value(SNAPSHOT_TAG, tag_value(tag));
+}
+
+//*****************************************************************************
+
+bool MetadataSync::apply_deltas(JukeboxDB& jukebox_db,
+                                const map<int64_t, string>& deltas) {
+   for (const auto& delta : deltas) {
+      string delta_contents;
+      ObjectSink sink = [&](const unsigned char* data, size_t num_bytes) {
+         delta_contents.append((const char*) data, num_bytes);
+         return true;
+      };
+
+      if (m_storage_system.get_object_stream(m_container,
+                                             delta.second,
+                                             sink) <= 0) {
+         printf("error: unable to retrieve metadata delta %s\n",
+                delta.second.c_str());
+         return false;
+      }
+
+      if (!apply_delta(jukebox_db, delta.first, delta_contents)) {
+         printf("error: unable to apply metadata delta %s\n",
+                delta.second.c_str());
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//*****************************************************************************
+
+bool MetadataSync::apply_delta(JukeboxDB& jukebox_db,
+                               int64_t seq,
+                               const string& delta_contents) {
+   if (m_debug_print) {
+      printf("applying metadata delta %lld\n", (long long) seq);
+   }
+
+   if (!jukebox_db.begin_transaction()) {
+      return false;
+   }
+
+   // these changes are already published
+   jukebox_db.set_change_logging(false);
+
+   bool success = true;
+   try {
+      json delta_json = json::parse(delta_contents);
+      if (delta_json.contains("songs")) {
+         for (const auto& song_json : delta_json["songs"]) {
+            if (!jukebox_db.store_song_metadata(song_from_json(song_json))) {
+               success = false;
+               break;
+            }
+         }
+      }
+      if (success && delta_json.contains("deleted")) {
+         for (const auto& song_uid : delta_json["deleted"]) {
+            // it's fine if the song was never here
+            jukebox_db.delete_song(song_uid.get<string>());
+         }
+      }
+   } catch (const exception& e) {
+      printf("error: unable to parse metadata delta - %s\n", e.what());
+      success = false;
+   }
+
+   jukebox_db.set_change_logging(true);
+
+   if (success && jukebox_db.set_sync_value(APPLIED_DELTA, seq)) {
+      return jukebox_db.commit_transaction();
+   } else {
+      jukebox_db.rollback_transaction();
+      return false;
+   }
+}
+
+//*****************************************************************************
+
+bool MetadataSync::push(JukeboxDB& jukebox_db, bool force_snapshot) {
+   if (!jukebox_db.is_open()) {
+      return false;
+   }
+
+   vector<string> stored_song_uids;
+   vector<string> deleted_song_uids;
+   if (!jukebox_db.get_changes(stored_song_uids, deleted_song_uids)) {
+      return false;
+   }
+
+   map<int64_t, string> deltas;
+   bool have_snapshot = false;
+   list_catalog(deltas, have_snapshot);
+
+   // catch up on anything published since this DB last synced so that
+   // a snapshot taken from it is complete
+   int64_t applied = 0;
+   jukebox_db.get_sync_value(APPLIED_DELTA, applied);
+   if (!have_deltas_after(deltas, applied)) {
+      printf("error: metadata DB is out of date, unable to publish changes\n");
+      return false;
+   }
+   map<int64_t, string> unseen_deltas(deltas.upper_bound(applied),
+                                      deltas.end());
+   if (!apply_deltas(jukebox_db, unseen_deltas)) {
+      return false;
+   }
+   if (!unseen_deltas.empty()) {
+      applied = unseen_deltas.rbegin()->first;
+   }
+
+   int64_t seq = applied;
+
+   if (!stored_song_uids.empty() || !deleted_song_uids.empty()) {
+      json songs_json = json::array();
+      for (const auto& song_uid : stored_song_uids) {
+         SongMetadata song;
+         if (jukebox_db.retrieve_song(song_uid, song)) {
+            songs_json.push_back(song_to_json(song));
+         }
+      }
+
+      json delta_json;
+      delta_json["songs"] = songs_json;
+      delta_json["deleted"] = deleted_song_uids;
+
+      seq += 1;
+      if (!publish_delta(jukebox_db, seq, delta_json.dump(), deltas)) {
+         return false;
+      }
+   }
+
+   if (force_snapshot) {
+      // A forced snapshot may hold songs that were never published as
+      // deltas (a DB from before deltas existed, say), so readers must not
+      // be able to catch up without it. It's marked with an empty delta
+      // that skips a sequence number, which makes every reader find a
+      // delta missing and fetch the snapshot. The marker goes up only
+      // after the snapshot, so a reader sent to the snapshot by it always
+      // finds one that includes it.
+      return compact(jukebox_db, deltas, seq + 2, true);
+   }
+
+   if (deltas.size() >= m_compaction_interval) {
+      return compact(jukebox_db, deltas, seq, false);
+   }
+
+   return true;
+}
+
+//*****************************************************************************
+
+bool MetadataSync::publish_delta(JukeboxDB& jukebox_db,
+                                 int64_t seq,
+                                 const string& delta_contents,
+                                 map<int64_t, string>& deltas) {
+   const vector<unsigned char> delta_bytes(delta_contents.begin(),
+                                           delta_contents.end());
+   const string delta_object = delta_object_name(seq);
+
+   if (m_debug_print) {
+      printf("uploading metadata delta %s (%zu bytes)\n",
+             delta_object.c_str(),
+             delta_bytes.size());
+   }
+
+   if (!m_storage_system.put_object(m_container,
+                                    delta_object,
+                                    delta_bytes,
+                                    nullptr)) {
+      printf("error: unable to upload metadata delta %s\n",
+             delta_object.c_str());
+      return false;
+   }
+   deltas[seq] = delta_object;
+
+   // the changes are published, so they're now part of the applied delta
+   if (!jukebox_db.begin_transaction()) {
+      return false;
+   }
+   if (!jukebox_db.clear_changes() ||
+       !jukebox_db.set_sync_value(APPLIED_DELTA, seq) ||
+       !jukebox_db.commit_transaction()) {
+      jukebox_db.rollback_transaction();
+      return false;
+   }
+
+   return true;
+}
+
+//*****************************************************************************
+
+bool MetadataSync::compact(JukeboxDB& jukebox_db,
+                           map<int64_t, string>& deltas,
+                           int64_t seq,
+                           bool publish_marker) {
+   // the snapshot records which deltas it includes
+   if (!jukebox_db.set_sync_value(APPLIED_DELTA, seq)) {
+      return false;
+   }
+
+   if (m_debug_print) {
+      printf("uploading metadata DB snapshot through delta %lld\n",
+             (long long) seq);
+   }
+
+   // the file is only guaranteed to be complete once it's closed
+   jukebox_db.close();
+   PropertySet headers;
+   const string md5 = Utils::md5_for_file(m_db_file_path);
+   if (!md5.empty()) {
+      headers.set_content_md5(md5);
+   }
+   bool snapshot_uploaded =
+      m_storage_system.put_object_from_file(m_container,
+                                            m_snapshot_object,
+                                            m_db_file_path,
+                                            &headers);
+   bool reopened = jukebox_db.open();
+
+   if (!snapshot_uploaded) {
+      printf("error: unable to upload metadata DB snapshot\n");
+      return false;
+   }
+
+   // this DB is now the published snapshot, apart from the tag itself
+   if (reopened) {
+      jukebox_db.set_sync_value(SNAPSHOT_TAG, tag_value(md5));
+   }
+
+   if (publish_marker) {
+      json delta_json;
+      delta_json["songs"] = json::array();
+      delta_json["deleted"] = json::array();
+      if (!reopened ||
+          !publish_delta(jukebox_db, seq, delta_json.dump(), deltas)) {
+         return false;
+      }
+   }
+
+   // readers that find a delta missing fall back to the snapshot, which
+   // now exists, so these can go
+   for (const auto& delta : deltas) {
+      if (delta.first < seq) {
+         m_storage_system.delete_object(m_container, delta.second);
+      }
+   }
+
+   return reopened;
+}
+
+//*****************************************************************************
+
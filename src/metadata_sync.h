@@ -0,0 +1,99 @@
+#ifndef METADATA_SYNC_H
+#define METADATA_SYNC_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "jukebox_db.h"
+#include "storage_system.h"
+
+
+// Keeps the local metadata DB and the copy published in the storage system
+// in step without moving the whole DB file for every change.
+//
+// The published catalog is a snapshot (the DB file itself) followed by
+// numbered delta objects ("<snapshot>.delta.<seq>"), each listing the songs
+// stored and deleted by one push. A DB records the last delta it includes,
+// so pulling only fetches deltas it hasn't seen; the snapshot is fetched
+// only when the local DB is missing, has never been synced, or is behind
+// deltas that have since been compacted away. A DB also records the tag
+// (md5 or ETag) of the snapshot it came from, so a snapshot replaced
+// without a delta (by a jukebox that uploads the whole DB) is noticed with
+// one metadata request and fetched again; an unchanged one never is.
+//
+// Once compaction_interval deltas have built up, a push also uploads a new
+// snapshot and then deletes the deltas it includes. The newest delta is
+// always kept so that its sequence number stays visible in the listing.
+// Like uploading the whole DB file, this assumes one writer at a time.
+class MetadataSync {
+public:
+   // sync value recording the last delta applied to a DB
+   static const std::string APPLIED_DELTA;
+   // sync value recording the tag of the snapshot a DB was downloaded as or
+   // uploaded as (0 if the storage system doesn't report one)
+   static const std::string SNAPSHOT_TAG;
+
+private:
+   StorageSystem& m_storage_system;
+   std::string m_container;
+   std::string m_snapshot_object;
+   std::string m_db_file_path;
+   unsigned int m_compaction_interval;
+   bool m_debug_print;
+
+   MetadataSync();
+   MetadataSync(const MetadataSync&);
+   MetadataSync& operator=(const MetadataSync&);
+
+   std::string delta_object_name(int64_t seq) const;
+   // lists the container, returning delta objects by sequence number
+   void list_catalog(std::map<int64_t, std::string>& deltas,
+                     bool& have_snapshot);
+   // the snapshot's md5 or ETag; empty if the storage system has neither
+   std::string snapshot_tag();
+   bool snapshot_replaced(JukeboxDB& jukebox_db);
+   bool download_snapshot(JukeboxDB& jukebox_db);
+   bool apply_deltas(JukeboxDB& jukebox_db,
+                     const std::map<int64_t, std::string>& deltas);
+   bool apply_delta(JukeboxDB& jukebox_db,
+                    int64_t seq,
+                    const std::string& delta_contents);
+   bool publish_delta(JukeboxDB& jukebox_db,
+                      int64_t seq,
+                      const std::string& delta_contents,
+                      std::map<int64_t, std::string>& deltas);
+   // with publish_marker, the empty delta seq is published once the
+   // snapshot is up
+   bool compact(JukeboxDB& jukebox_db,
+                std::map<int64_t, std::string>& deltas,
+                int64_t seq,
+                bool publish_marker);
+
+public:
+   MetadataSync(StorageSystem& storage_system,
+                const std::string& container,
+                const std::string& snapshot_object,
+                const std::string& db_file_path,
+                unsigned int compaction_interval,
+                bool debug_print=false);
+
+   // Opens jukebox_db (constructed for db_file_path) and brings it up to
+   // date with the published catalog. The DB is left open even if the
+   // catalog couldn't be retrieved, as long as it could be opened.
+   bool pull(JukeboxDB& jukebox_db);
+
+   // Publishes the DB's unpublished changes as a delta, applying any
+   // deltas published elsewhere first. With force_snapshot, a snapshot is
+   // uploaded even if compaction isn't due yet.
+   bool push(JukeboxDB& jukebox_db, bool force_snapshot=false);
+
+   // for parsing delta object names; false for any other object
+   static bool delta_seq_from_name(const std::string& snapshot_object,
+                                   const std::string& object_name,
+                                   int64_t& seq);
+};
+
+#endif
+
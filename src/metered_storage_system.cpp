@@ -0,0 +1,345 @@
+#include <stdio.h>
+
+#include "metered_storage_system.h"
+
+using namespace std;
+using namespace chaudiere;
+
+//*****************************************************************************
+
+class MeteredStorageSystem::Request {
+private:
+   MeteredStorageSystem& m_metered;
+   Operation m_op;
+   chrono::steady_clock::time_point m_start;
+   bool m_finished;
+
+   Request(const Request&);
+   Request& operator=(const Request&);
+
+public:
+   Request(MeteredStorageSystem& metered, Operation op) :
+      m_metered(metered),
+      m_op(op),
+      m_start(chrono::steady_clock::now()),
+      m_finished(false) {
+   }
+
+   ~Request() {
+      if (!m_finished) {
+         m_metered.record(m_op, m_start, false, 0);
+      }
+   }
+
+   void finish(bool success, uint64_t bytes=0) {
+      m_finished = true;
+      m_metered.record(m_op, m_start, success, success ? bytes : 0);
+   }
+};
+
+//*****************************************************************************
+
+const char* MeteredStorageSystem::operation_name(Operation op) {
+   switch (op) {
+      case OP_LIST_ACCOUNT_CONTAINERS:
+         return "list_account_containers";
+      case OP_CREATE_CONTAINER:
+         return "create_container";
+      case OP_DELETE_CONTAINER:
+         return "delete_container";
+      case OP_LIST_CONTAINER_CONTENTS:
+         return "list_container_contents";
+      case OP_GET_OBJECT_METADATA:
+         return "get_object_metadata";
+      case OP_PUT_OBJECT:
+         return "put_object";
+      case OP_PUT_OBJECT_FROM_FILE:
+         return "put_object_from_file";
+      case OP_DELETE_OBJECT:
+         return "delete_object";
+      case OP_GET_OBJECT:
+         return "get_object";
+      case OP_PUT_OBJECT_STREAM:
+         return "put_object_stream";
+      case OP_GET_OBJECT_STREAM:
+         return "get_object_stream";
+      case OP_GET_OBJECT_RANGE:
+         return "get_object_range";
+      default:
+         return "unknown";
+   }
+}
+
+//*****************************************************************************
+
+MeteredStorageSystem::MeteredStorageSystem(StorageSystem* storage_system,
+                                           bool debug_mode) :
+   StorageSystem(storage_system->get_storage_system_type(), debug_mode),
+   m_storage_system(storage_system),
+   m_stats(NUM_OPERATIONS) {
+}
+
+//*****************************************************************************
+
+MeteredStorageSystem::~MeteredStorageSystem() {
+}
+
+//*****************************************************************************
+
+void MeteredStorageSystem::record(Operation op,
+                                  const chrono::steady_clock::time_point& start,
+                                  bool success,
+                                  uint64_t bytes) {
+   const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+   std::lock_guard<std::mutex> lock(m_stats_mutex);
+   StorageOpStats& stats = m_stats[op];
+   ++stats.count;
+   if (!success) {
+      ++stats.errors;
+   }
+   stats.bytes += bytes;
+   stats.latency.record(elapsed.count());
+}
+
+//*****************************************************************************
+
+StorageOpStats MeteredStorageSystem::get_stats(Operation op) const {
+   std::lock_guard<std::mutex> lock(m_stats_mutex);
+   return m_stats[op];
+}
+
+//*****************************************************************************
+
+void MeteredStorageSystem::reset_stats() {
+   std::lock_guard<std::mutex> lock(m_stats_mutex);
+   for (auto& stats : m_stats) {
+      stats = StorageOpStats();
+   }
+}
+
+//*****************************************************************************
+
+void MeteredStorageSystem::show_stats() const {
+   vector<StorageOpStats> snapshot;
+   {
+      std::lock_guard<std::mutex> lock(m_stats_mutex);
+      snapshot = m_stats;
+   }
+
+   printf("----- %s storage requests -----\n",
+          get_storage_system_type().c_str());
+   printf("%-24s %8s %7s %12s %9s %9s %9s %9s\n",
+          "operation", "count", "errors", "bytes",
+          "p50 ms", "p90 ms", "p99 ms", "max ms");
+   for (int op = 0; op < NUM_OPERATIONS; ++op) {
+      const StorageOpStats& stats = snapshot[op];
+      if (stats.count == 0) {
+         continue;
+      }
+      printf("%-24s %8llu %7llu %12llu %9.2f %9.2f %9.2f %9.2f\n",
+             operation_name((Operation) op),
+             (unsigned long long) stats.count,
+             (unsigned long long) stats.errors,
+             (unsigned long long) stats.bytes,
+             stats.latency.percentile_micros(0.50) / 1000.0,
+             stats.latency.percentile_micros(0.90) / 1000.0,
+             stats.latency.percentile_micros(0.99) / 1000.0,
+             stats.latency.max_micros() / 1000.0);
+   }
+   printf("-------------------------\n");
+
+   m_storage_system->show_stats();
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::supports_concurrent_reads() const {
+   return m_storage_system->supports_concurrent_reads();
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::supports_concurrent_writes() const {
+   return m_storage_system->supports_concurrent_writes();
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::enter() {
+   return m_storage_system->enter();
+}
+
+//*****************************************************************************
+
+void MeteredStorageSystem::exit() {
+   m_storage_system->exit();
+}
+
+//*****************************************************************************
+
+vector<string> MeteredStorageSystem::list_account_containers() {
+   Request request(*this, OP_LIST_ACCOUNT_CONTAINERS);
+   vector<string> list_containers = m_storage_system->list_account_containers();
+   request.finish(true);
+   return list_containers;
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::create_container(const string& container_name) {
+   Request request(*this, OP_CREATE_CONTAINER);
+   bool container_created = m_storage_system->create_container(container_name);
+   request.finish(container_created);
+   if (container_created) {
+      add_container(container_name);
+   }
+   return container_created;
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::delete_container(const string& container_name) {
+   Request request(*this, OP_DELETE_CONTAINER);
+   bool container_deleted = m_storage_system->delete_container(container_name);
+   request.finish(container_deleted);
+   if (container_deleted) {
+      remove_container(container_name);
+   }
+   return container_deleted;
+}
+
+//*****************************************************************************
+
+vector<string> MeteredStorageSystem::list_container_contents(const string& container_name) {
+   Request request(*this, OP_LIST_CONTAINER_CONTENTS);
+   vector<string> list_contents =
+      m_storage_system->list_container_contents(container_name);
+   request.finish(true);
+   return list_contents;
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::get_object_metadata(const string& container_name,
+                                               const string& object_name,
+                                               PropertySet& dict_props) {
+   Request request(*this, OP_GET_OBJECT_METADATA);
+   bool success = m_storage_system->get_object_metadata(container_name,
+                                                        object_name,
+                                                        dict_props);
+   request.finish(success);
+   return success;
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::put_object(const string& container_name,
+                                      const string& object_name,
+                                      const vector<unsigned char>& file_contents,
+                                      const PropertySet* headers) {
+   Request request(*this, OP_PUT_OBJECT);
+   bool object_added = m_storage_system->put_object(container_name,
+                                                    object_name,
+                                                    file_contents,
+                                                    headers);
+   request.finish(object_added, file_contents.size());
+   return object_added;
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::put_object_from_file(const string& container_name,
+                                                const string& object_name,
+                                                const string& object_file_path,
+                                                const PropertySet* headers) {
+   Request request(*this, OP_PUT_OBJECT_FROM_FILE);
+   bool object_added = m_storage_system->put_object_from_file(container_name,
+                                                              object_name,
+                                                              object_file_path,
+                                                              headers);
+   long file_size = object_added ? Utils::get_file_size(object_file_path) : 0;
+   request.finish(object_added, file_size > 0 ? file_size : 0);
+   return object_added;
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::delete_object(const string& container_name,
+                                         const string& object_name) {
+   Request request(*this, OP_DELETE_OBJECT);
+   bool object_deleted = m_storage_system->delete_object(container_name,
+                                                         object_name);
+   request.finish(object_deleted);
+   return object_deleted;
+}
+
+//*****************************************************************************
+
+int64_t MeteredStorageSystem::get_object(const string& container_name,
+                                         const string& object_name,
+                                         const string& local_file_path) {
+   Request request(*this, OP_GET_OBJECT);
+   int64_t bytes_retrieved = m_storage_system->get_object(container_name,
+                                                          object_name,
+                                                          local_file_path);
+   request.finish(bytes_retrieved > 0, bytes_retrieved);
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
+
+bool MeteredStorageSystem::put_object_stream(const string& container_name,
+                                             const string& object_name,
+                                             const ObjectSource& source,
+                                             const PropertySet* headers) {
+   uint64_t bytes_read = 0;
+   ObjectSource counting_source = [&](unsigned char* buffer, size_t max_bytes) -> int64_t {
+      int64_t num_bytes = source(buffer, max_bytes);
+      if (num_bytes > 0) {
+         bytes_read += num_bytes;
+      }
+      return num_bytes;
+   };
+
+   Request request(*this, OP_PUT_OBJECT_STREAM);
+   bool object_added = m_storage_system->put_object_stream(container_name,
+                                                           object_name,
+                                                           counting_source,
+                                                           headers);
+   request.finish(object_added, bytes_read);
+   return object_added;
+}
+
+//*****************************************************************************
+
+int64_t MeteredStorageSystem::get_object_stream(const string& container_name,
+                                                const string& object_name,
+                                                const ObjectSink& sink) {
+   Request request(*this, OP_GET_OBJECT_STREAM);
+   int64_t bytes_retrieved = m_storage_system->get_object_stream(container_name,
+                                                                 object_name,
+                                                                 sink);
+   request.finish(bytes_retrieved > 0, bytes_retrieved);
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
+
+int64_t MeteredStorageSystem::get_object_range(const string& container_name,
+                                               const string& object_name,
+                                               int64_t offset,
+                                               int64_t length,
+                                               const ObjectSink& sink) {
+   Request request(*this, OP_GET_OBJECT_RANGE);
+   int64_t bytes_retrieved = m_storage_system->get_object_range(container_name,
+                                                                object_name,
+                                                                offset,
+                                                                length,
+                                                                sink);
+   request.finish(bytes_retrieved > 0, bytes_retrieved);
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
+
@@ -0,0 +1,133 @@
+#ifndef METERED_STORAGE_SYSTEM_H
+#define METERED_STORAGE_SYSTEM_H
+
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "storage_system.h"
+#include "latency_histogram.h"
+
+
+// Request statistics for one kind of storage operation.
+struct StorageOpStats {
+   uint64_t count;
+   uint64_t errors;
+   // bytes sent for puts, received for gets
+   uint64_t bytes;
+   LatencyHistogram latency;
+
+   StorageOpStats() :
+      count(0),
+      errors(0),
+      bytes(0) {
+   }
+};
+
+
+// Wraps another storage system, timing every request it makes and counting
+// requests, failures and bytes moved per operation. show_stats prints a
+// table of them with latency percentiles.
+//
+// A failure is whatever the operation reports as one: false, 0 bytes, or
+// an exception (which is counted and then passed on). Listings can't fail
+// visibly, so they never count errors.
+class MeteredStorageSystem : public StorageSystem {
+public:
+   enum Operation {
+      OP_LIST_ACCOUNT_CONTAINERS,
+      OP_CREATE_CONTAINER,
+      OP_DELETE_CONTAINER,
+      OP_LIST_CONTAINER_CONTENTS,
+      OP_GET_OBJECT_METADATA,
+      OP_PUT_OBJECT,
+      OP_PUT_OBJECT_FROM_FILE,
+      OP_DELETE_OBJECT,
+      OP_GET_OBJECT,
+      OP_PUT_OBJECT_STREAM,
+      OP_GET_OBJECT_STREAM,
+      OP_GET_OBJECT_RANGE,
+      NUM_OPERATIONS
+   };
+
+   static const char* operation_name(Operation op);
+
+private:
+   std::unique_ptr<StorageSystem> m_storage_system;
+   // recorded from import and download workers concurrently
+   mutable std::mutex m_stats_mutex;
+   std::vector<StorageOpStats> m_stats;
+
+   MeteredStorageSystem(const MeteredStorageSystem&);
+   MeteredStorageSystem& operator=(const MeteredStorageSystem&);
+
+   // times one request, counting it as failed if it throws
+   class Request;
+
+   void record(Operation op,
+               const std::chrono::steady_clock::time_point& start,
+               bool success,
+               uint64_t bytes);
+
+public:
+   MeteredStorageSystem(StorageSystem* storage_system, bool debug_mode=false);
+   ~MeteredStorageSystem();
+
+   StorageOpStats get_stats(Operation op) const;
+   void reset_stats();
+   void show_stats() const;
+
+   bool supports_concurrent_reads() const;
+   bool supports_concurrent_writes() const;
+
+   bool enter();
+   void exit();
+
+   std::vector<std::string> list_account_containers();
+
+   bool create_container(const std::string& container_name);
+   bool delete_container(const std::string& container_name);
+   std::vector<std::string> list_container_contents(const std::string& container_name);
+
+   bool get_object_metadata(const std::string& container_name,
+                            const std::string& object_name,
+                            PropertySet& dict_props);
+
+   bool put_object(const std::string& container_name,
+                   const std::string& object_name,
+                   const std::vector<unsigned char>& file_contents,
+                   const PropertySet* headers=nullptr);
+
+   bool put_object_from_file(const std::string& container_name,
+                             const std::string& object_name,
+                             const std::string& object_file_path,
+                             const PropertySet* headers=nullptr);
+
+   bool delete_object(const std::string& container_name,
+                      const std::string& object_name);
+
+   int64_t get_object(const std::string& container_name,
+                      const std::string& object_name,
+                      const std::string& local_file_path);
+
+   bool put_object_stream(const std::string& container_name,
+                          const std::string& object_name,
+                          const ObjectSource& source,
+                          const PropertySet* headers=nullptr);
+
+   int64_t get_object_stream(const std::string& container_name,
+                             const std::string& object_name,
+                             const ObjectSink& sink);
+
+   int64_t get_object_range(const std::string& container_name,
+                            const std::string& object_name,
+                            int64_t offset,
+                            int64_t length,
+                            const ObjectSink& sink);
+};
+
+#endif
+
@@ -290,6 +290,18 @@ MirrorStorageSystem::MirrorStorageSystem(const string& ini_file_path,
 
 //*****************************************************************************
 
+MirrorStorageSystem::MirrorStorageSystem(StorageSystem* primary_ss,
+                                         StorageSystem* secondary_ss,
+                                         bool debug_mode) :
+   StorageSystem("Mirror", debug_mode),
+   m_primary_ss(primary_ss),
+   m_secondary_ss(secondary_ss),
+   m_update_in_parallel(false),
+   m_min_updates(1) {
+}
+
+//*****************************************************************************
+
 MirrorStorageSystem::~MirrorStorageSystem() {
    MirrorStorageSystem::exit();
 }
@@ -297,7 +309,9 @@ MirrorStorageSystem::~MirrorStorageSystem() {
 //*****************************************************************************
 
 bool MirrorStorageSystem::enter() {
-   //TODO: implement MirrorStorageSystem::enter
+   if (have_both_ss()) {
+      return m_primary_ss->enter() && m_secondary_ss->enter();
+   }
    return false;
 }
 
@@ -321,6 +335,22 @@ bool MirrorStorageSystem::have_both_ss() const {
 
 //*****************************************************************************
 
+bool MirrorStorageSystem::supports_concurrent_reads() const {
+   return have_both_ss() &&
+          m_primary_ss->supports_concurrent_reads() &&
+          m_secondary_ss->supports_concurrent_reads();
+}
+
+//*****************************************************************************
+
+bool MirrorStorageSystem::supports_concurrent_writes() const {
+   return have_both_ss() &&
+          m_primary_ss->supports_concurrent_writes() &&
+          m_secondary_ss->supports_concurrent_writes();
+}
+
+//*****************************************************************************
+
 bool MirrorStorageSystem::update(UpdateOperation& update_op) {
    if (have_both_ss()) {
       int num_update_successes = 0;
@@ -361,6 +391,7 @@ bool MirrorStorageSystem::update(UpdateOperation& update_op) {
             num_update_successes++;
          }
       }
+      return num_update_successes >= m_min_updates;
    }
    return false;
 }
@@ -601,3 +632,100 @@ int64_t MirrorStorageSystem::get_object(const string& container_name,
 
 //*****************************************************************************
 
+int64_t MirrorStorageSystem::get_object_stream(const string& container_name,
+                                               const string& object_name,
+                                               const ObjectSink& sink) {
+   if (container_name.empty() || object_name.empty() || !have_both_ss()) {
+      return 0;
+   }
+
+   // keep track of what has reached the sink so that we only fall back to
+   // the secondary when nothing has been delivered yet
+   int64_t bytes_delivered = 0;
+   ObjectSink counting_sink = [&](const unsigned char* data, size_t num_bytes) -> bool {
+      if (sink(data, num_bytes)) {
+         bytes_delivered += num_bytes;
+         return true;
+      }
+      return false;
+   };
+
+   try {
+      int64_t bytes_retrieved = m_primary_ss->get_object_stream(container_name,
+                                                                object_name,
+                                                                counting_sink);
+      if (bytes_retrieved > 0) {
+         return bytes_retrieved;
+      }
+   } catch (exception& e) {
+      printf("MSS::get_object_stream exception on primary - %s\n", e.what());
+   }
+
+   if (bytes_delivered > 0) {
+      printf("MSS::get_object_stream primary failed mid-transfer, not retrying\n");
+      return 0;
+   }
+
+   try {
+      return m_secondary_ss->get_object_stream(container_name,
+                                               object_name,
+                                               sink);
+   } catch (exception& e) {
+      printf("MSS::get_object_stream exception on secondary - %s\n", e.what());
+   }
+
+   return 0;
+}
+
+//*****************************************************************************
+
+int64_t MirrorStorageSystem::get_object_range(const string& container_name,
+                                              const string& object_name,
+                                              int64_t offset,
+                                              int64_t length,
+                                              const ObjectSink& sink) {
+   if (container_name.empty() || object_name.empty() || !have_both_ss()) {
+      return 0;
+   }
+
+   int64_t bytes_delivered = 0;
+   ObjectSink counting_sink = [&](const unsigned char* data, size_t num_bytes) -> bool {
+      if (sink(data, num_bytes)) {
+         bytes_delivered += num_bytes;
+         return true;
+      }
+      return false;
+   };
+
+   try {
+      int64_t bytes_retrieved = m_primary_ss->get_object_range(container_name,
+                                                               object_name,
+                                                               offset,
+                                                               length,
+                                                               counting_sink);
+      if (bytes_retrieved > 0) {
+         return bytes_retrieved;
+      }
+   } catch (exception& e) {
+      printf("MSS::get_object_range exception on primary - %s\n", e.what());
+   }
+
+   if (bytes_delivered > 0) {
+      printf("MSS::get_object_range primary failed mid-transfer, not retrying\n");
+      return 0;
+   }
+
+   try {
+      return m_secondary_ss->get_object_range(container_name,
+                                              object_name,
+                                              offset,
+                                              length,
+                                              sink);
+   } catch (exception& e) {
+      printf("MSS::get_object_range exception on secondary - %s\n", e.what());
+   }
+
+   return 0;
+}
+
+//*****************************************************************************
@@ -55,10 +55,18 @@ protected:
 
 public:
    MirrorStorageSystem(const std::string& ini_file_path, bool debug_mode = false);
+   // mirrors two storage systems that have already been constructed,
+   // taking ownership of both
+   MirrorStorageSystem(StorageSystem* primary_ss,
+                       StorageSystem* secondary_ss,
+                       bool debug_mode = false);
    ~MirrorStorageSystem();
 
    bool have_both_ss() const;
 
+   bool supports_concurrent_reads() const;
+   bool supports_concurrent_writes() const;
+
    bool enter();
    void exit();
 
@@ -90,6 +98,18 @@ public:
    int64_t get_object(const std::string& container_name,
                       const std::string& object_name,
                       const std::string& local_file_path);
+
+   // put_object_stream uses the spooling default from StorageSystem since a
+   // source can only be read once but must be written to both systems
+   int64_t get_object_stream(const std::string& container_name,
+                             const std::string& object_name,
+                             const ObjectSink& sink);
+
+   int64_t get_object_range(const std::string& container_name,
+                            const std::string& object_name,
+                            int64_t offset,
+                            int64_t length,
+                            const ObjectSink& sink);
 };
 
 #endif
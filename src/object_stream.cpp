@@ -0,0 +1,121 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "object_stream.h"
+#include "utils.h"
+
+using namespace std;
+
+const size_t ObjectStream::BUFFER_SIZE = 64 * 1024;
+
+//*****************************************************************************
+
+ObjectSource ObjectStream::file_source(FILE* f) {
+   return [f](unsigned char* buffer, size_t max_bytes) -> int64_t {
+      size_t bytes_read = fread(buffer, 1, max_bytes, f);
+      if (bytes_read == 0 && ferror(f)) {
+         return -1;
+      }
+      return bytes_read;
+   };
+}
+
+//*****************************************************************************
+
+ObjectSink ObjectStream::file_sink(FILE* f) {
+   return [f](const unsigned char* data, size_t num_bytes) -> bool {
+      return fwrite(data, 1, num_bytes, f) == num_bytes;
+   };
+}
+
+//*****************************************************************************
+
+int64_t ObjectStream::pump(const ObjectSource& source, const ObjectSink& sink) {
+   vector<unsigned char> buffer(BUFFER_SIZE);
+   int64_t total_bytes = 0;
+
+   for (;;) {
+      int64_t bytes_read = source(buffer.data(), buffer.size());
+      if (bytes_read < 0) {
+         return -1;
+      } else if (bytes_read == 0) {
+         break;
+      }
+      if (!sink(buffer.data(), bytes_read)) {
+         return -1;
+      }
+      total_bytes += bytes_read;
+   }
+
+   return total_bytes;
+}
+
+//*****************************************************************************
+
+int64_t ObjectStream::source_to_file(const ObjectSource& source,
+                                     const string& file_path) {
+   FILE* f = fopen(file_path.c_str(), "wb");
+   if (f == nullptr) {
+      printf("error: unable to open '%s' for writing, errno=%d\n",
+             file_path.c_str(), errno);
+      return -1;
+   }
+
+   int64_t bytes_written = pump(source, file_sink(f));
+   if (fclose(f) != 0) {
+      bytes_written = -1;
+   }
+
+   if (bytes_written < 0) {
+      Utils::file_delete(file_path);
+   }
+
+   return bytes_written;
+}
+
+//*****************************************************************************
+
+int64_t ObjectStream::file_to_sink(const string& file_path,
+                                   const ObjectSink& sink) {
+   FILE* f = fopen(file_path.c_str(), "rb");
+   if (f == nullptr) {
+      return -1;
+   }
+
+   int64_t bytes_read = pump(file_source(f), sink);
+   fclose(f);
+
+   return bytes_read;
+}
+
+//*****************************************************************************
+
+string ObjectStream::temp_file_path(const string& prefix) {
+   // whole objects are spooled here, so honor TMPDIR for systems whose
+   // /tmp is a small tmpfs
+   string temp_dir = "/tmp";
+   const char* tmpdir_env = getenv("TMPDIR");
+   if (tmpdir_env != nullptr && tmpdir_env[0] != '\0') {
+      temp_dir = tmpdir_env;
+   }
+   if (temp_dir.back() != '/') {
+      temp_dir += "/";
+   }
+   string path_template = temp_dir + prefix + "XXXXXX";
+   vector<char> path_chars(path_template.begin(), path_template.end());
+   path_chars.push_back('\0');
+
+   int fd = mkstemp(path_chars.data());
+   if (fd == -1) {
+      return "";
+   }
+   close(fd);
+
+   return string(path_chars.data());
+}
+
+//*****************************************************************************
+
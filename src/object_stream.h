@@ -0,0 +1,42 @@
+#ifndef OBJECT_STREAM_H
+#define OBJECT_STREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+// Streaming object transfers move data through a fixed-size buffer so that
+// memory use stays flat no matter how large the object is.
+
+// An ObjectSource fills at most max_bytes of buffer and returns the number
+// of bytes produced, 0 at end of data, or -1 on error.
+typedef std::function<int64_t(unsigned char* buffer, size_t max_bytes)> ObjectSource;
+
+// An ObjectSink consumes num_bytes of data and returns false to abort the
+// transfer.
+typedef std::function<bool(const unsigned char* data, size_t num_bytes)> ObjectSink;
+
+
+class ObjectStream {
+public:
+   static const size_t BUFFER_SIZE;
+
+   static ObjectSource file_source(FILE* f);
+   static ObjectSink file_sink(FILE* f);
+
+   // returns number of bytes moved, or -1 on error
+   static int64_t pump(const ObjectSource& source, const ObjectSink& sink);
+   static int64_t source_to_file(const ObjectSource& source,
+                                 const std::string& file_path);
+   static int64_t file_to_sink(const std::string& file_path,
+                               const ObjectSink& sink);
+
+   // creates an empty file named prefix plus a unique suffix in $TMPDIR
+   // (/tmp if unset) and returns its path, or "" on failure
+   static std::string temp_file_path(const std::string& prefix);
+};
+
+#endif
+
@@ -0,0 +1,189 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "parallel_download.h"
+#include "utils.h"
+#include "PthreadsThread.h"
+#include "Runnable.h"
+
+using namespace std;
+using namespace chaudiere;
+
+// don't bother splitting objects into ranges smaller than this
+static const int64_t MIN_RANGE_SIZE = 1024 * 1024;
+
+//*****************************************************************************
+//*****************************************************************************
+
+class RangeDownloadWorker : public Runnable {
+private:
+   StorageSystem& m_storage_system;
+   const string& m_container_name;
+   const string& m_object_name;
+   int m_fd;
+   int64_t m_offset;
+   int64_t m_length;
+   int64_t m_bytes_written;
+   std::mutex& m_mutex;
+   std::condition_variable& m_cond_done;
+   unsigned int& m_workers_running;
+
+   RangeDownloadWorker(const RangeDownloadWorker&);
+   RangeDownloadWorker& operator=(const RangeDownloadWorker&);
+
+public:
+   RangeDownloadWorker(StorageSystem& storage_system,
+                       const string& container_name,
+                       const string& object_name,
+                       int fd,
+                       int64_t offset,
+                       int64_t length,
+                       std::mutex& mutex,
+                       std::condition_variable& cond_done,
+                       unsigned int& workers_running) :
+      m_storage_system(storage_system),
+      m_container_name(container_name),
+      m_object_name(object_name),
+      m_fd(fd),
+      m_offset(offset),
+      m_length(length),
+      m_bytes_written(0),
+      m_mutex(mutex),
+      m_cond_done(cond_done),
+      m_workers_running(workers_running) {
+   }
+
+   bool range_complete() const {
+      return m_bytes_written == m_length;
+   }
+
+   virtual void run() {
+      ObjectSink pwrite_sink = [this](const unsigned char* data, size_t num_bytes) -> bool {
+         size_t bytes_remaining = num_bytes;
+         while (bytes_remaining > 0) {
+            ssize_t rc = pwrite(m_fd,
+                                data + (num_bytes - bytes_remaining),
+                                bytes_remaining,
+                                m_offset + m_bytes_written);
+            if (rc <= 0) {
+               return false;
+            }
+            bytes_remaining -= rc;
+            m_bytes_written += rc;
+         }
+         return true;
+      };
+
+      m_storage_system.get_object_range(m_container_name,
+                                        m_object_name,
+                                        m_offset,
+                                        m_length,
+                                        pwrite_sink);
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      --m_workers_running;
+      m_cond_done.notify_all();
+   }
+};
+
+//*****************************************************************************
+//*****************************************************************************
+
+int64_t ParallelDownload::get_object(StorageSystem& storage_system,
+                                     const string& container_name,
+                                     const string& object_name,
+                                     const string& local_file_path,
+                                     int64_t object_size,
+                                     unsigned int num_ranges) {
+   if (object_size / MIN_RANGE_SIZE < num_ranges) {
+      num_ranges = object_size / MIN_RANGE_SIZE;
+   }
+
+   if (num_ranges < 2 || !storage_system.supports_concurrent_reads()) {
+      return storage_system.get_object(container_name,
+                                       object_name,
+                                       local_file_path);
+   }
+
+   int fd = open(local_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd == -1) {
+      printf("error: unable to open %s, errno=%d\n",
+             local_file_path.c_str(), errno);
+      return 0;
+   }
+
+   // preallocate so that every range can be written in place
+   if (ftruncate(fd, object_size) != 0) {
+      printf("error: unable to preallocate %s, errno=%d\n",
+             local_file_path.c_str(), errno);
+      close(fd);
+      Utils::file_delete(local_file_path);
+      return 0;
+   }
+
+   std::mutex mutex;
+   std::condition_variable cond_done;
+   unsigned int workers_running = 0;
+   vector<unique_ptr<RangeDownloadWorker>> workers;
+   vector<unique_ptr<PthreadsThread>> threads;
+
+   int64_t range_size = (object_size + num_ranges - 1) / num_ranges;
+   for (unsigned int i = 0; i < num_ranges; i++) {
+      int64_t offset = i * range_size;
+      int64_t length = std::min(range_size, object_size - offset);
+      workers.emplace_back(new RangeDownloadWorker(storage_system,
+                                                   container_name,
+                                                   object_name,
+                                                   fd,
+                                                   offset,
+                                                   length,
+                                                   mutex,
+                                                   cond_done,
+                                                   workers_running));
+      threads.emplace_back(new PthreadsThread(workers.back().get()));
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         ++workers_running;
+      }
+      if (!threads.back()->start()) {
+         std::lock_guard<std::mutex> lock(mutex);
+         --workers_running;
+      }
+   }
+
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond_done.wait(lock, [&workers_running] { return workers_running == 0; });
+   }
+   threads.clear();
+
+   bool all_ranges_complete = true;
+   for (const auto& worker : workers) {
+      if (!worker->range_complete()) {
+         all_ranges_complete = false;
+         break;
+      }
+   }
+
+   if (close(fd) != 0) {
+      all_ranges_complete = false;
+   }
+
+   if (!all_ranges_complete) {
+      printf("error: parallel download of %s failed\n", object_name.c_str());
+      Utils::file_delete(local_file_path);
+      return 0;
+   }
+
+   return object_size;
+}
+
+//*****************************************************************************
+
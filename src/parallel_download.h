@@ -0,0 +1,25 @@
+#ifndef PARALLEL_DOWNLOAD_H
+#define PARALLEL_DOWNLOAD_H
+
+#include <stdint.h>
+#include <string>
+
+#include "storage_system.h"
+
+
+// Downloads one object as several byte ranges fetched concurrently, each
+// written with pwrite directly into its place in a preallocated local file.
+// Storage systems that can't serve concurrent range reads get a plain
+// get_object instead.
+class ParallelDownload {
+public:
+   static int64_t get_object(StorageSystem& storage_system,
+                             const std::string& container_name,
+                             const std::string& object_name,
+                             const std::string& local_file_path,
+                             int64_t object_size,
+                             unsigned int num_ranges);
+};
+
+#endif
+
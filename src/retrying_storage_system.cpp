@@ -0,0 +1,724 @@
+#include <stdio.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "retrying_storage_system.h"
+#include "utils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+const int64_t RetryingStorageSystem::MAX_HEDGED_RANGE_BYTES = 16 * 1024 * 1024;
+const size_t RetryingStorageSystem::MIN_HEDGE_SAMPLES = 20;
+const int64_t RetryingStorageSystem::MIN_HEDGE_BYTES = 64 * 1024;
+
+static const size_t LATENCY_WINDOW_SIZE = 200;
+static const double HEDGE_PERCENTILE = 0.95;
+// how often a read that might need hedging has its progress checked
+static const double HEDGE_CHECK_SECONDS = 0.05;
+
+// numbers the temporary files of hedged get_objects, so that a losing copy
+// finishing late never deletes the file of a later read of the same object
+static atomic<unsigned long> next_hedged_get(0);
+
+//*****************************************************************************
+
+static double seconds_since(const chrono::steady_clock::time_point& start) {
+   return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+//*****************************************************************************
+
+static string hedge_file_path(const string& local_file_path,
+                              unsigned long hedged_get,
+                              int copy) {
+   return local_file_path + ".hedge" + to_string(hedged_get) + "-" +
+          to_string(copy);
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+LatencyWindow::LatencyWindow(size_t capacity) :
+   m_next_sample(0),
+   m_capacity(capacity > 0 ? capacity : 1) {
+}
+
+//*****************************************************************************
+
+void LatencyWindow::add_sample(double seconds) {
+   std::lock_guard<std::mutex> lock(m_mutex);
+   if (m_samples.size() < m_capacity) {
+      m_samples.push_back(seconds);
+   } else {
+      m_samples[m_next_sample] = seconds;
+   }
+   m_next_sample = (m_next_sample + 1) % m_capacity;
+}
+
+//*****************************************************************************
+
+size_t LatencyWindow::count() const {
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return m_samples.size();
+}
+
+//*****************************************************************************
+
+double LatencyWindow::percentile(double fraction) const {
+   vector<double> samples;
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      samples = m_samples;
+   }
+   if (samples.empty()) {
+      return 0.0;
+   }
+
+   fraction = std::min(std::max(fraction, 0.0), 1.0);
+   size_t index = (size_t) (fraction * (samples.size() - 1) + 0.5);
+   std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+   return samples[index];
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+HedgedReadCopy::HedgedReadCopy(RetryingStorageSystem& storage_system,
+                               const function<void()>& read) :
+   m_storage_system(storage_system),
+   m_read(read) {
+}
+
+//*****************************************************************************
+
+HedgedReadCopy::~HedgedReadCopy() {
+}
+
+//*****************************************************************************
+
+bool HedgedReadCopy::start() {
+   m_thread.reset(new PthreadsThread(this));
+   return m_thread->start();
+}
+
+//*****************************************************************************
+
+void HedgedReadCopy::run() {
+   m_read();
+   m_storage_system.hedge_finished(this);
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+RetryingStorageSystem::RetryingStorageSystem(StorageSystem* storage_system,
+                                             unsigned int max_attempts,
+                                             bool hedge_reads,
+                                             bool debug_mode) :
+   StorageSystem("Retrying", debug_mode),
+   m_storage_system(storage_system),
+   m_max_attempts(max_attempts > 0 ? max_attempts : 1),
+   m_initial_backoff_ms(100),
+   m_max_backoff_ms(5000),
+   m_deadline_ms(30000),
+   m_hedge_reads(hedge_reads),
+   m_object_pace(LATENCY_WINDOW_SIZE),
+   m_range_pace(LATENCY_WINDOW_SIZE),
+   m_rng(std::random_device()()) {
+}
+
+//*****************************************************************************
+
+RetryingStorageSystem::~RetryingStorageSystem() {
+   wait_for_hedges();
+}
+
+//*****************************************************************************
+
+void RetryingStorageSystem::set_backoff(unsigned int initial_ms,
+                                        unsigned int max_ms) {
+   m_initial_backoff_ms = initial_ms;
+   m_max_backoff_ms = std::max(initial_ms, max_ms);
+}
+
+//*****************************************************************************
+
+void RetryingStorageSystem::set_deadline_ms(unsigned int deadline_ms) {
+   m_deadline_ms = deadline_ms;
+}
+
+//*****************************************************************************
+
+unsigned int RetryingStorageSystem::backoff_delay_ms(unsigned int attempt) {
+   // "full jitter": anywhere up to the exponential ceiling, so that
+   // clients that failed together don't retry together
+   uint64_t ceiling = m_initial_backoff_ms;
+   for (unsigned int i = 1; i < attempt && ceiling < m_max_backoff_ms; ++i) {
+      ceiling *= 2;
+   }
+   ceiling = std::min(ceiling, (uint64_t) m_max_backoff_ms);
+
+   std::uniform_int_distribution<unsigned int> delay(0, (unsigned int) ceiling);
+   std::lock_guard<std::mutex> lock(m_rng_mutex);
+   return delay(m_rng);
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::with_retries(const char* op_name,
+                                         const function<bool()>& attempt) {
+   const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   for (unsigned int attempt_number = 1; ; ++attempt_number) {
+      try {
+         if (attempt()) {
+            return true;
+         }
+      } catch (const exception& e) {
+         printf("RetryingStorageSystem::%s exception - %s\n", op_name, e.what());
+      }
+
+      if (attempt_number >= m_max_attempts) {
+         break;
+      }
+
+      unsigned int delay_ms = backoff_delay_ms(attempt_number);
+      if (m_deadline_ms > 0 &&
+          seconds_since(start) * 1000.0 + delay_ms >= m_deadline_ms) {
+         if (debug_mode()) {
+            printf("%s: deadline reached after %u attempts\n",
+                   op_name, attempt_number);
+         }
+         break;
+      }
+
+      if (debug_mode()) {
+         printf("%s: attempt %u failed, retrying in %u ms\n",
+                op_name, attempt_number, delay_ms);
+      }
+      std::this_thread::sleep_for(chrono::milliseconds(delay_ms));
+   }
+
+   return false;
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::hedging() const {
+   return m_hedge_reads && m_storage_system->supports_concurrent_reads();
+}
+
+//*****************************************************************************
+
+int64_t RetryingStorageSystem::hedged_read(LatencyWindow& pace,
+                                           const function<int64_t(int)>& request,
+                                           const function<int64_t(int)>& progress,
+                                           const function<void(int)>& discard,
+                                           int& winner) {
+   winner = -1;
+   reap_hedges();
+
+   // until there's a p95 to go by, reads are just timed
+   if (pace.count() < MIN_HEDGE_SAMPLES) {
+      const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      int64_t result = request(0);
+      if (result > 0) {
+         pace.add_sample(seconds_since(start) / result);
+         winner = 0;
+      } else {
+         discard(0);
+      }
+      return result;
+   }
+
+   const double seconds_per_byte = pace.percentile(HEDGE_PERCENTILE);
+
+   // shared with the request threads, which may outlive this call
+   struct HedgeState {
+      std::mutex mutex;
+      std::condition_variable cond_done;
+      std::array<bool, 2> done = {{false, false}};
+      std::array<int64_t, 2> result = {{0, 0}};
+      int winner = -2;  // undecided
+   };
+   shared_ptr<HedgeState> state(new HedgeState);
+
+   auto run_copy = [state, request, discard, &pace](int copy) {
+      const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      int64_t result = 0;
+      try {
+         result = request(copy);
+      } catch (const exception& e) {
+         printf("RetryingStorageSystem: hedged read exception - %s\n", e.what());
+      }
+      if (result > 0) {
+         pace.add_sample(seconds_since(start) / result);
+      }
+
+      bool lost = false;
+      {
+         std::lock_guard<std::mutex> lock(state->mutex);
+         state->done[copy] = true;
+         state->result[copy] = result;
+         lost = state->winner != -2 && state->winner != copy;
+      }
+      state->cond_done.notify_all();
+      if (lost) {
+         discard(copy);
+      }
+   };
+
+   const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   if (!launch_hedge([run_copy] { run_copy(0); })) {
+      // no thread to spare; read without a hedge
+      int64_t result = request(0);
+      winner = result > 0 ? 0 : -1;
+      if (winner < 0) {
+         discard(0);
+      }
+      return result;
+   }
+
+   // the first copy is hedged once it has taken longer than the p95 pace
+   // allows for what it has received so far
+   int copies = 1;
+   std::unique_lock<std::mutex> lock(state->mutex);
+   while (!state->done[0]) {
+      const int64_t bytes_received = std::max(progress(0), MIN_HEDGE_BYTES);
+      const double hedge_after = seconds_per_byte * bytes_received;
+      const double elapsed = seconds_since(start);
+      if (elapsed >= hedge_after) {
+         lock.unlock();
+         if (debug_mode()) {
+            printf("read slower than p95 pace (%.3f s for %lld bytes), hedging\n",
+                   elapsed, (long long) bytes_received);
+         }
+         if (launch_hedge([run_copy] { run_copy(1); })) {
+            copies = 2;
+         }
+         lock.lock();
+         break;
+      }
+      state->cond_done.wait_for(lock,
+                                chrono::duration<double>(
+                                   std::min(hedge_after - elapsed,
+                                            HEDGE_CHECK_SECONDS)));
+   }
+
+   state->cond_done.wait(lock, [&state, copies] {
+      for (int copy = 0; copy < copies; ++copy) {
+         if (state->done[copy] && state->result[copy] > 0) {
+            return true;
+         }
+      }
+      return state->done[0] && (copies == 1 || state->done[1]);
+   });
+
+   for (int copy = 0; copy < copies; ++copy) {
+      if (state->done[copy] && state->result[copy] > 0) {
+         winner = copy;
+         break;
+      }
+   }
+   state->winner = winner;
+
+   // copies still running discard themselves when they finish
+   vector<int> finished_losers;
+   for (int copy = 0; copy < copies; ++copy) {
+      if (state->done[copy] && copy != winner) {
+         finished_losers.push_back(copy);
+      }
+   }
+   int64_t result = winner >= 0 ? state->result[winner] : 0;
+   lock.unlock();
+
+   for (int copy : finished_losers) {
+      discard(copy);
+   }
+
+   return result;
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::launch_hedge(const function<void()>& read) {
+   unique_ptr<HedgedReadCopy> copy(new HedgedReadCopy(*this, read));
+
+   // held while the thread starts so that it can't finish (and be reaped)
+   // before start returns
+   std::lock_guard<std::mutex> lock(m_hedge_mutex);
+   if (!copy->start()) {
+      return false;
+   }
+   m_running_hedges.push_back(std::move(copy));
+   return true;
+}
+
+//*****************************************************************************
+
+void RetryingStorageSystem::hedge_finished(HedgedReadCopy* copy) {
+   std::lock_guard<std::mutex> lock(m_hedge_mutex);
+   for (auto it = m_running_hedges.begin(); it != m_running_hedges.end(); ++it) {
+      if (it->get() == copy) {
+         m_finished_hedges.push_back(std::move(*it));
+         m_running_hedges.erase(it);
+         break;
+      }
+   }
+   m_hedge_cond.notify_all();
+}
+
+//*****************************************************************************
+
+void RetryingStorageSystem::reap_hedges() {
+   list<unique_ptr<HedgedReadCopy>> finished_hedges;
+   {
+      std::lock_guard<std::mutex> lock(m_hedge_mutex);
+      finished_hedges.swap(m_finished_hedges);
+   }
+   // outside of the lock, which the finished threads may still be
+   // releasing
+   finished_hedges.clear();
+}
+
+//*****************************************************************************
+
+void RetryingStorageSystem::wait_for_hedges() {
+   {
+      std::unique_lock<std::mutex> lock(m_hedge_mutex);
+      m_hedge_cond.wait(lock, [this] { return m_running_hedges.empty(); });
+   }
+   reap_hedges();
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::supports_concurrent_reads() const {
+   return m_storage_system->supports_concurrent_reads();
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::supports_concurrent_writes() const {
+   return m_storage_system->supports_concurrent_writes();
+}
+
+//*****************************************************************************
+
+void RetryingStorageSystem::show_stats() const {
+   m_storage_system->show_stats();
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::enter() {
+   return m_storage_system->enter();
+}
+
+//*****************************************************************************
+
+void RetryingStorageSystem::exit() {
+   wait_for_hedges();
+   m_storage_system->exit();
+}
+
+//*****************************************************************************
+
+vector<string> RetryingStorageSystem::list_account_containers() {
+   return m_storage_system->list_account_containers();
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::create_container(const string& container_name) {
+   // not retried: failing because the container already exists is the
+   // usual reason, and retrying won't change that
+   bool container_created = m_storage_system->create_container(container_name);
+   if (container_created) {
+      add_container(container_name);
+   }
+   return container_created;
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::delete_container(const string& container_name) {
+   bool container_deleted = m_storage_system->delete_container(container_name);
+   if (container_deleted) {
+      remove_container(container_name);
+   }
+   return container_deleted;
+}
+
+//*****************************************************************************
+
+vector<string> RetryingStorageSystem::list_container_contents(const string& container_name) {
+   return m_storage_system->list_container_contents(container_name);
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::get_object_metadata(const string& container_name,
+                                                const string& object_name,
+                                                PropertySet& dict_props) {
+   // not retried: an object without metadata fails the same way
+   return m_storage_system->get_object_metadata(container_name,
+                                                object_name,
+                                                dict_props);
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::put_object(const string& container_name,
+                                       const string& object_name,
+                                       const vector<unsigned char>& file_contents,
+                                       const PropertySet* headers) {
+   return with_retries("put_object", [&]() {
+      return m_storage_system->put_object(container_name,
+                                          object_name,
+                                          file_contents,
+                                          headers);
+   });
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::put_object_from_file(const string& container_name,
+                                                 const string& object_name,
+                                                 const string& object_file_path,
+                                                 const PropertySet* headers) {
+   return with_retries("put_object_from_file", [&]() {
+      return m_storage_system->put_object_from_file(container_name,
+                                                    object_name,
+                                                    object_file_path,
+                                                    headers);
+   });
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::delete_object(const string& container_name,
+                                          const string& object_name) {
+   return with_retries("delete_object", [&]() {
+      return m_storage_system->delete_object(container_name, object_name);
+   });
+}
+
+//*****************************************************************************
+
+int64_t RetryingStorageSystem::get_object(const string& container_name,
+                                          const string& object_name,
+                                          const string& local_file_path) {
+   int64_t bytes_retrieved = 0;
+
+   with_retries("get_object", [&]() {
+      if (!hedging()) {
+         bytes_retrieved = m_storage_system->get_object(container_name,
+                                                        object_name,
+                                                        local_file_path);
+         return bytes_retrieved > 0;
+      }
+
+      // each copy downloads to its own file, and the winner's is kept
+      const unsigned long hedged_get = next_hedged_get++;
+      StorageSystem* storage_system = m_storage_system.get();
+      auto request = [storage_system, container_name, object_name, local_file_path, hedged_get](int copy) {
+         return storage_system->get_object(container_name,
+                                           object_name,
+                                           hedge_file_path(local_file_path,
+                                                           hedged_get,
+                                                           copy));
+      };
+      auto progress = [local_file_path, hedged_get](int copy) -> int64_t {
+         return Utils::get_file_size(hedge_file_path(local_file_path,
+                                                     hedged_get,
+                                                     copy));
+      };
+      auto discard = [local_file_path, hedged_get](int copy) {
+         Utils::file_delete(hedge_file_path(local_file_path, hedged_get, copy));
+      };
+
+      int winner = -1;
+      bytes_retrieved = hedged_read(m_object_pace,
+                                    request,
+                                    progress,
+                                    discard,
+                                    winner);
+      if (winner < 0) {
+         bytes_retrieved = 0;
+         return false;
+      }
+      if (!Utils::rename_file(hedge_file_path(local_file_path, hedged_get, winner),
+                              local_file_path)) {
+         discard(winner);
+         bytes_retrieved = 0;
+         return false;
+      }
+      return true;
+   });
+
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
+
+bool RetryingStorageSystem::put_object_stream(const string& container_name,
+                                              const string& object_name,
+                                              const ObjectSource& source,
+                                              const PropertySet* headers) {
+   int64_t bytes_read = 0;
+   ObjectSource counting_source = [&](unsigned char* buffer, size_t max_bytes) -> int64_t {
+      int64_t num_bytes = source(buffer, max_bytes);
+      if (num_bytes > 0) {
+         bytes_read += num_bytes;
+      }
+      return num_bytes;
+   };
+
+   bool object_stored = false;
+   with_retries("put_object_stream", [&]() {
+      object_stored = m_storage_system->put_object_stream(container_name,
+                                                          object_name,
+                                                          counting_source,
+                                                          headers);
+      // a source that's been read from can't be sent again
+      return object_stored || bytes_read > 0;
+   });
+   return object_stored;
+}
+
+//*****************************************************************************
+
+int64_t RetryingStorageSystem::get_object_stream(const string& container_name,
+                                                 const string& object_name,
+                                                 const ObjectSink& sink) {
+   int64_t bytes_delivered = 0;
+   bool sink_failed = false;
+   ObjectSink counting_sink = [&](const unsigned char* data, size_t num_bytes) -> bool {
+      if (!sink(data, num_bytes)) {
+         sink_failed = true;
+         return false;
+      }
+      bytes_delivered += num_bytes;
+      return true;
+   };
+
+   with_retries("get_object_stream", [&]() {
+      int64_t bytes_retrieved;
+      if (bytes_delivered == 0) {
+         bytes_retrieved = m_storage_system->get_object_stream(container_name,
+                                                               object_name,
+                                                               counting_sink);
+      } else {
+         // pick up after what the sink already has
+         bytes_retrieved = m_storage_system->get_object_range(container_name,
+                                                              object_name,
+                                                              bytes_delivered,
+                                                              0,
+                                                              counting_sink);
+      }
+      return sink_failed || bytes_retrieved > 0;
+   });
+
+   return sink_failed ? 0 : bytes_delivered;
+}
+
+//*****************************************************************************
+
+int64_t RetryingStorageSystem::range_attempt(const string& container_name,
+                                             const string& object_name,
+                                             int64_t offset,
+                                             int64_t length,
+                                             const ObjectSink& sink) {
+   if (!hedging() || length <= 0 || length > MAX_HEDGED_RANGE_BYTES) {
+      return m_storage_system->get_object_range(container_name,
+                                                object_name,
+                                                offset,
+                                                length,
+                                                sink);
+   }
+
+   // each copy reads into its own buffer, and the winner's is delivered
+   struct RangeBuffers {
+      std::array<vector<unsigned char>, 2> buffer;
+      std::array<atomic<int64_t>, 2> bytes_received = {{{0}, {0}}};
+   };
+   shared_ptr<RangeBuffers> buffers(new RangeBuffers);
+   StorageSystem* storage_system = m_storage_system.get();
+   auto request = [storage_system, container_name, object_name, offset, length, buffers](int copy) {
+      vector<unsigned char>& buffer = buffers->buffer[copy];
+      atomic<int64_t>& bytes_received = buffers->bytes_received[copy];
+      buffer.reserve(length);
+      ObjectSink buffer_sink = [&buffer, &bytes_received](const unsigned char* data,
+                                                         size_t num_bytes) {
+         buffer.insert(buffer.end(), data, data + num_bytes);
+         bytes_received += num_bytes;
+         return true;
+      };
+      return storage_system->get_object_range(container_name,
+                                              object_name,
+                                              offset,
+                                              length,
+                                              buffer_sink);
+   };
+   auto progress = [buffers](int copy) -> int64_t {
+      return buffers->bytes_received[copy];
+   };
+   auto discard = [buffers](int copy) {
+      vector<unsigned char>().swap(buffers->buffer[copy]);
+   };
+
+   int winner = -1;
+   hedged_read(m_range_pace, request, progress, discard, winner);
+   if (winner < 0) {
+      return 0;
+   }
+
+   const vector<unsigned char>& buffer = buffers->buffer[winner];
+   if (buffer.empty() || !sink(buffer.data(), buffer.size())) {
+      return 0;
+   }
+   return buffer.size();
+}
+
+//*****************************************************************************
+
+int64_t RetryingStorageSystem::get_object_range(const string& container_name,
+                                                const string& object_name,
+                                                int64_t offset,
+                                                int64_t length,
+                                                const ObjectSink& sink) {
+   int64_t bytes_delivered = 0;
+   bool sink_failed = false;
+   ObjectSink counting_sink = [&](const unsigned char* data, size_t num_bytes) -> bool {
+      if (!sink(data, num_bytes)) {
+         sink_failed = true;
+         return false;
+      }
+      bytes_delivered += num_bytes;
+      return true;
+   };
+
+   with_retries("get_object_range", [&]() {
+      int64_t remaining = length > 0 ? length - bytes_delivered : 0;
+      int64_t bytes_retrieved = range_attempt(container_name,
+                                              object_name,
+                                              offset + bytes_delivered,
+                                              remaining,
+                                              counting_sink);
+      if (sink_failed) {
+         return true;
+      }
+      // a short bounded range resumes from where it stopped
+      return bytes_retrieved > 0 && (length <= 0 || bytes_delivered >= length);
+   });
+
+   return sink_failed ? 0 : bytes_delivered;
+}
+
+//*****************************************************************************
+
@@ -0,0 +1,205 @@
+#ifndef RETRYING_STORAGE_SYSTEM_H
+#define RETRYING_STORAGE_SYSTEM_H
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "storage_system.h"
+#include "PthreadsThread.h"
+#include "Runnable.h"
+
+class RetryingStorageSystem;
+
+
+// Keeps a window of recent request latencies for estimating percentiles.
+class LatencyWindow {
+private:
+   std::vector<double> m_samples;
+   size_t m_next_sample;
+   size_t m_capacity;
+   mutable std::mutex m_mutex;
+
+   LatencyWindow(const LatencyWindow&);
+   LatencyWindow& operator=(const LatencyWindow&);
+
+public:
+   explicit LatencyWindow(size_t capacity);
+
+   void add_sample(double seconds);
+   size_t count() const;
+   // latency that fraction (0-1) of the samples fall within; 0 if empty
+   double percentile(double fraction) const;
+};
+
+
+// One copy of a hedged read, run on a thread of its own. It's kept by its
+// RetryingStorageSystem until the read finishes so that the thread is
+// joined rather than left detached.
+class HedgedReadCopy : public chaudiere::Runnable {
+private:
+   RetryingStorageSystem& m_storage_system;
+   std::function<void()> m_read;
+   // declared last so that the thread is joined first
+   std::unique_ptr<chaudiere::PthreadsThread> m_thread;
+
+   HedgedReadCopy(const HedgedReadCopy&);
+   HedgedReadCopy& operator=(const HedgedReadCopy&);
+
+public:
+   HedgedReadCopy(RetryingStorageSystem& storage_system,
+                  const std::function<void()>& read);
+   virtual ~HedgedReadCopy();
+
+   bool start();
+   virtual void run();
+};
+
+
+// Wraps another storage system, retrying operations that fail with
+// jittered exponential backoff until they succeed, run out of attempts or
+// pass their deadline (which bounds the waiting between attempts, not a
+// request already in flight).
+//
+// The wrapped storage systems only report success or failure, so what's
+// retried is kept to what can safely be repeated:
+//  - listings aren't retried, since an empty list is also a valid answer
+//  - put_object_stream is only retried if the source hasn't been read
+//  - reads that fail partway through resume from where they stopped as a
+//    range read rather than delivering the start of the object twice
+//
+// With hedged reads on (and a storage system that supports concurrent
+// reads), a get_object or bounded get_object_range that falls behind the
+// p95 pace (seconds per byte) of recent reads is issued a second time, and
+// whichever copy finishes first is used. Going by pace rather than by
+// whole-request latency keeps large objects from always being hedged and
+// small ones never. This trims the tail latency of prefetching songs at
+// the cost of occasional duplicate requests.
+class RetryingStorageSystem : public StorageSystem {
+private:
+   std::unique_ptr<StorageSystem> m_storage_system;
+   unsigned int m_max_attempts;
+   unsigned int m_initial_backoff_ms;
+   unsigned int m_max_backoff_ms;
+   unsigned int m_deadline_ms;
+   bool m_hedge_reads;
+   LatencyWindow m_object_pace;
+   LatencyWindow m_range_pace;
+   std::mutex m_rng_mutex;
+   std::default_random_engine m_rng;
+   // copies of hedged reads still running (one that lost is left to finish
+   // in the background) and those that have finished but not been joined
+   std::mutex m_hedge_mutex;
+   std::condition_variable m_hedge_cond;
+   std::list<std::unique_ptr<HedgedReadCopy>> m_running_hedges;
+   std::list<std::unique_ptr<HedgedReadCopy>> m_finished_hedges;
+
+   RetryingStorageSystem(const RetryingStorageSystem&);
+   RetryingStorageSystem& operator=(const RetryingStorageSystem&);
+
+   unsigned int backoff_delay_ms(unsigned int attempt);
+   bool with_retries(const char* op_name,
+                     const std::function<bool()>& attempt);
+   bool hedging() const;
+   int64_t range_attempt(const std::string& container_name,
+                         const std::string& object_name,
+                         int64_t offset,
+                         int64_t length,
+                         const ObjectSink& sink);
+   // Runs request(0), and request(1) as well if request(0) falls behind
+   // the p95 in pace, judged by the bytes progress(0) reports it has
+   // received. winner is the copy whose result is returned (-1 if neither
+   // succeeded); discard is called for any other copy that completes,
+   // whenever it does.
+   int64_t hedged_read(LatencyWindow& pace,
+                       const std::function<int64_t(int)>& request,
+                       const std::function<int64_t(int)>& progress,
+                       const std::function<void(int)>& discard,
+                       int& winner);
+   bool launch_hedge(const std::function<void()>& read);
+   // joins the threads of copies that have finished
+   void reap_hedges();
+   void wait_for_hedges();
+
+public:
+   // hedged range reads are buffered in memory, so larger ranges aren't
+   // hedged
+   static const int64_t MAX_HEDGED_RANGE_BYTES;
+   // reads timed before the p95 is trusted for hedging
+   static const size_t MIN_HEDGE_SAMPLES;
+   // a copy gets the p95 time for this many bytes before it must show
+   // any progress
+   static const int64_t MIN_HEDGE_BYTES;
+
+   RetryingStorageSystem(StorageSystem* storage_system,
+                         unsigned int max_attempts,
+                         bool hedge_reads=false,
+                         bool debug_mode=false);
+   ~RetryingStorageSystem();
+
+   // called by a HedgedReadCopy once its read is done
+   void hedge_finished(HedgedReadCopy* copy);
+
+   // backoff before attempt n+1 is a random delay of up to
+   // initial_ms * 2^(n-1), capped at max_ms
+   void set_backoff(unsigned int initial_ms, unsigned int max_ms);
+   // 0 lets an operation use all of its attempts however long they take
+   void set_deadline_ms(unsigned int deadline_ms);
+
+   bool supports_concurrent_reads() const;
+   bool supports_concurrent_writes() const;
+   void show_stats() const;
+
+   bool enter();
+   void exit();
+
+   std::vector<std::string> list_account_containers();
+
+   bool create_container(const std::string& container_name);
+   bool delete_container(const std::string& container_name);
+   std::vector<std::string> list_container_contents(const std::string& container_name);
+
+   bool get_object_metadata(const std::string& container_name,
+                            const std::string& object_name,
+                            PropertySet& dict_props);
+
+   bool put_object(const std::string& container_name,
+                   const std::string& object_name,
+                   const std::vector<unsigned char>& file_contents,
+                   const PropertySet* headers=nullptr);
+
+   bool put_object_from_file(const std::string& container_name,
+                             const std::string& object_name,
+                             const std::string& object_file_path,
+                             const PropertySet* headers=nullptr);
+
+   bool delete_object(const std::string& container_name,
+                      const std::string& object_name);
+
+   int64_t get_object(const std::string& container_name,
+                      const std::string& object_name,
+                      const std::string& local_file_path);
+
+   bool put_object_stream(const std::string& container_name,
+                          const std::string& object_name,
+                          const ObjectSource& source,
+                          const PropertySet* headers=nullptr);
+
+   int64_t get_object_stream(const std::string& container_name,
+                             const std::string& object_name,
+                             const ObjectSink& sink);
+
+   int64_t get_object_range(const std::string& container_name,
+                            const std::string& object_name,
+                            int64_t offset,
+                            int64_t length,
+                            const ObjectSink& sink);
+};
+
+#endif
+
@@ -0,0 +1,1060 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <istream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+#include "s3_storage_system.h"
+#include "utils.h"
+#include "OSUtils.h"
+#include "StrUtils.h"
+#include "PthreadsThread.h"
+#include "Runnable.h"
+
+#include "client.h"
+#include "providers.h"
+
+using namespace std;
+using namespace chaudiere;
+
+// Helpful links:
+// https://min.io/docs/minio/linux/developers/cpp/minio-cpp.html
+// https://github.com/minio/minio-cpp
+
+static const size_t DEFAULT_MULTIPART_PART_SIZE = 16 * 1024 * 1024;
+static const unsigned int DEFAULT_MULTIPART_CONCURRENCY = 4;
+static const unsigned int MAX_MULTIPART_PARTS = 10000;
+
+
+//*****************************************************************************
+
+static void populate_write_args(const PropertySet* headers,
+                                minio::s3::ObjectWriteArgs& args,
+                                string& content_type) {
+   if (headers == nullptr) {
+      return;
+   }
+
+   vector<string> keys;
+   headers->get_keys(keys);
+
+   for (const auto& key : keys) {
+      if (key == PropertySet::PROP_CONTENT_LENGTH) {
+         // the client computes the content length itself
+         continue;
+      } else if (key == PropertySet::PROP_CONTENT_TYPE) {
+         content_type = headers->get_string_value(key);
+      } else if (key == PropertySet::PROP_CONTENT_ENCODING) {
+         const string& content_encoding = headers->get_string_value(key);
+         if (!content_encoding.empty()) {
+            args.headers.Add(key, content_encoding);
+         }
+      } else if (key == PropertySet::PROP_CONTENT_MD5) {
+         // S3 expects a base64 digest for Content-MD5; ours is hex, so
+         // keep it as user metadata instead
+         const string& content_md5 = headers->get_string_value(key);
+         if (!content_md5.empty()) {
+            args.user_metadata.Add("md5", content_md5);
+         }
+      } else {
+         const PropertyValue* pv = headers->get(key);
+         if (pv != nullptr && pv->is_string()) {
+            args.user_metadata.Add(key, pv->get_string_value());
+         }
+      }
+   }
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Adapts an ObjectSource to the std::istream that minio-cpp reads uploads
+// from, refilling one fixed-size buffer at a time.
+class SourceStreamBuf : public std::streambuf {
+private:
+   const ObjectSource& m_source;
+   vector<unsigned char> m_buffer;
+   bool m_failed;
+
+public:
+   SourceStreamBuf(const ObjectSource& source) :
+      m_source(source),
+      m_buffer(ObjectStream::BUFFER_SIZE),
+      m_failed(false) {
+   }
+
+   bool failed() const {
+      return m_failed;
+   }
+
+protected:
+   int_type underflow() {
+      if (gptr() < egptr()) {
+         return traits_type::to_int_type(*gptr());
+      }
+
+      int64_t bytes_read = m_source(m_buffer.data(), m_buffer.size());
+      if (bytes_read <= 0) {
+         if (bytes_read < 0) {
+            m_failed = true;
+         }
+         return traits_type::eof();
+      }
+
+      char* buffer_start = (char*) m_buffer.data();
+      setg(buffer_start, buffer_start, buffer_start + bytes_read);
+      return traits_type::to_int_type(*gptr());
+   }
+};
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Shared state for one multipart upload. Workers claim part numbers from
+// it and report the etag of every part they upload.
+class MultipartUpload {
+private:
+   std::mutex m_mutex;
+   std::condition_variable m_cond_workers_done;
+   unsigned int m_next_part_number;
+   unsigned int m_workers_running;
+   bool m_failed;
+   list<minio::s3::Part> m_parts;
+
+public:
+   const string m_container_name;
+   const string m_object_name;
+   const string m_file_path;
+   const string m_upload_id;
+   const int64_t m_file_size;
+   const size_t m_part_size;
+   const unsigned int m_num_parts;
+
+   MultipartUpload(const string& container_name,
+                   const string& object_name,
+                   const string& file_path,
+                   const string& upload_id,
+                   int64_t file_size,
+                   size_t part_size,
+                   unsigned int num_workers) :
+      m_next_part_number(1),
+      m_workers_running(num_workers),
+      m_failed(false),
+      m_container_name(container_name),
+      m_object_name(object_name),
+      m_file_path(file_path),
+      m_upload_id(upload_id),
+      m_file_size(file_size),
+      m_part_size(part_size),
+      m_num_parts((file_size + part_size - 1) / part_size) {
+   }
+
+   bool claim_part(unsigned int& part_number) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_failed || m_next_part_number > m_num_parts) {
+         return false;
+      }
+      part_number = m_next_part_number++;
+      return true;
+   }
+
+   void part_uploaded(unsigned int part_number, const string& etag) {
+      minio::s3::Part part;
+      part.number = part_number;
+      part.etag = etag;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_parts.push_back(part);
+   }
+
+   void part_failed(unsigned int part_number, const string& error) {
+      printf("S3StorageSystem - error: upload of part %u of %s failed: %s\n",
+             part_number, m_object_name.c_str(), error.c_str());
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_failed = true;
+   }
+
+   void worker_finished() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      --m_workers_running;
+      m_cond_workers_done.notify_all();
+   }
+
+   void worker_not_started() {
+      worker_finished();
+   }
+
+   // waits for all workers and returns the uploaded parts in order, or
+   // false if any part failed
+   bool wait_for_parts(list<minio::s3::Part>& parts) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond_workers_done.wait(lock, [this] { return m_workers_running == 0; });
+      if (m_failed || m_parts.size() != m_num_parts) {
+         return false;
+      }
+      m_parts.sort([](const minio::s3::Part& a, const minio::s3::Part& b) {
+         return a.number < b.number;
+      });
+      parts = m_parts;
+      return true;
+   }
+};
+
+//*****************************************************************************
+//*****************************************************************************
+
+// Uploads parts until none are left. Clients aren't thread safe, so every
+// worker is handed its own, which it only borrows: the client stays with
+// put_object_multipart and outlives the worker's thread.
+class UploadPartWorker : public chaudiere::Runnable {
+private:
+   MultipartUpload& m_upload;
+   minio::s3::Client& m_client;
+
+   UploadPartWorker(const UploadPartWorker&);
+   UploadPartWorker& operator=(const UploadPartWorker&);
+
+public:
+   UploadPartWorker(MultipartUpload& upload,
+                    minio::s3::Client& client) :
+      m_upload(upload),
+      m_client(client) {
+   }
+
+   virtual void run() {
+      int fd = open(m_upload.m_file_path.c_str(), O_RDONLY);
+      if (fd == -1) {
+         m_upload.part_failed(0, "unable to open " + m_upload.m_file_path);
+         m_upload.worker_finished();
+         return;
+      }
+
+      string part_buffer(m_upload.m_part_size, '\0');
+      unsigned int part_number;
+
+      while (m_upload.claim_part(part_number)) {
+         int64_t offset = (int64_t) (part_number - 1) * m_upload.m_part_size;
+         size_t part_length = std::min((int64_t) m_upload.m_part_size,
+                                       m_upload.m_file_size - offset);
+
+         size_t bytes_read = 0;
+         while (bytes_read < part_length) {
+            ssize_t rc = pread(fd,
+                               &part_buffer[bytes_read],
+                               part_length - bytes_read,
+                               offset + bytes_read);
+            if (rc <= 0) {
+               break;
+            }
+            bytes_read += rc;
+         }
+
+         if (bytes_read != part_length) {
+            m_upload.part_failed(part_number, "short read of " + m_upload.m_file_path);
+            break;
+         }
+
+         minio::s3::UploadPartArgs args;
+         args.bucket = m_upload.m_container_name;
+         args.object = m_upload.m_object_name;
+         args.upload_id = m_upload.m_upload_id;
+         args.part_number = part_number;
+         args.data = string_view(part_buffer.data(), part_length);
+
+         minio::s3::UploadPartResponse resp = m_client.UploadPart(args);
+         if (resp) {
+            m_upload.part_uploaded(part_number, resp.etag);
+         } else {
+            m_upload.part_failed(part_number, resp.Error().String());
+            break;
+         }
+      }
+
+      close(fd);
+      m_upload.worker_finished();
+   }
+};
+
+//*****************************************************************************
+//*****************************************************************************
+
+S3StorageSystem::S3StorageSystem(const string& access_key,
+                                 const string& secret_key,
+                                 const string& protocol,
+                                 const string& host,
+                                 const string& container_prefix,
+                                 bool debug) :
+   StorageSystem("S3", debug),
+   m_debug_mode(debug),
+   m_aws_access_key(access_key),
+   m_aws_secret_key(secret_key),
+   m_s3_host(host),
+   m_use_https(true),
+   m_multipart_part_size(DEFAULT_MULTIPART_PART_SIZE),
+   m_multipart_concurrency(DEFAULT_MULTIPART_CONCURRENCY) {
+
+   string protocol_in_use(protocol);
+
+   if (!protocol.empty()) {
+      StrUtils::toLowerCase(protocol_in_use);
+      if (protocol_in_use == "http") {
+         m_use_https = false;
+      } else if (protocol_in_use != "https") {
+         printf("S3StorageSystem error: unrecognized protocol '%s'\n",
+                protocol.c_str());
+         printf("valid options are: 'http' and 'https'\n");
+         printf("using default value of https\n");
+         protocol_in_use = "https";
+      }
+   } else {
+      protocol_in_use = "https";
+   }
+
+   if (debug_mode()) {
+      printf("S3StorageSystem parameters:\n");
+      printf("access_key=%s\n", m_aws_access_key.c_str());
+      printf("secret_key=%s\n", m_aws_secret_key.c_str());
+      printf("protocol=%s\n", protocol_in_use.c_str());
+      printf("host=%s\n", m_s3_host.c_str());
+      printf("container_prefix=%s\n", container_prefix.c_str());
+   }
+}
+
+//*****************************************************************************
+
+S3StorageSystem::~S3StorageSystem() {
+   S3StorageSystem::exit();
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::is_connected() const {
+   return m_provider != nullptr;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::supports_concurrent_reads() const {
+   return true;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::supports_concurrent_writes() const {
+   return true;
+}
+
+//*****************************************************************************
+
+unique_ptr<minio::s3::Client> S3StorageSystem::acquire_client() {
+   {
+      std::lock_guard<std::mutex> lock(m_idle_clients_mutex);
+      if (!m_idle_clients.empty()) {
+         unique_ptr<minio::s3::Client> client = std::move(m_idle_clients.back());
+         m_idle_clients.pop_back();
+         return client;
+      }
+   }
+
+   return unique_ptr<minio::s3::Client>(new minio::s3::Client(*m_base_url,
+                                                              m_provider.get()));
+}
+
+//*****************************************************************************
+
+void S3StorageSystem::release_client(unique_ptr<minio::s3::Client> client) {
+   std::lock_guard<std::mutex> lock(m_idle_clients_mutex);
+   m_idle_clients.push_back(std::move(client));
+}
+
+//*****************************************************************************
+
+S3StorageSystem::ClientLease::ClientLease(S3StorageSystem& storage_system) :
+   m_storage_system(storage_system),
+   m_client(storage_system.acquire_client()) {
+}
+
+//*****************************************************************************
+
+S3StorageSystem::ClientLease::~ClientLease() {
+   m_storage_system.release_client(std::move(m_client));
+}
+
+//*****************************************************************************
+
+minio::s3::Client& S3StorageSystem::ClientLease::client() {
+   return *m_client;
+}
+
+//*****************************************************************************
+
+void S3StorageSystem::set_multipart_part_size(size_t part_size) {
+   // S3 won't accept parts (other than the last) smaller than 5 MiB
+   m_multipart_part_size = std::max(part_size, (size_t) minio::utils::kMinPartSize);
+}
+
+//*****************************************************************************
+
+void S3StorageSystem::set_multipart_concurrency(unsigned int concurrency) {
+   m_multipart_concurrency = std::max(concurrency, 1U);
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::enter() {
+   if (debug_mode()) {
+      printf("S3StorageSystem.enter\n");
+   }
+
+   if (is_connected()) {
+      return true;
+   }
+
+   m_base_url.reset(new minio::s3::BaseUrl(m_s3_host, m_use_https));
+   if (!*m_base_url) {
+      printf("S3StorageSystem::enter - error: invalid host '%s'\n",
+             m_s3_host.c_str());
+      m_base_url.reset();
+      return false;
+   }
+
+   m_provider.reset(new minio::creds::StaticProvider(m_aws_access_key,
+                                                     m_aws_secret_key));
+
+   // the lease has to be back in the pool before exit() empties it
+   vector<string> list_containers;
+   bool buckets_listed = false;
+   {
+      ClientLease lease(*this);
+      minio::s3::ListBucketsResponse resp = lease.client().ListBuckets();
+      if (resp) {
+         for (const auto& bucket : resp.buckets) {
+            list_containers.push_back(bucket.name);
+         }
+         buckets_listed = true;
+      } else {
+         printf("S3StorageSystem::enter - error: unable to list buckets: %s\n",
+                resp.Error().String().c_str());
+      }
+   }
+   if (!buckets_listed) {
+      exit();
+      return false;
+   }
+
+   set_list_containers(list_containers);
+   set_authenticated(true);
+
+   return true;
+}
+
+//*****************************************************************************
+
+void S3StorageSystem::exit() {
+   if (debug_mode()) {
+      printf("S3StorageSystem.exit\n");
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_idle_clients_mutex);
+      m_idle_clients.clear();
+   }
+   m_provider.reset();
+   m_base_url.reset();
+   set_authenticated(false);
+}
+
+//*****************************************************************************
+
+vector<string> S3StorageSystem::list_account_containers() {
+   if (debug_mode()) {
+      printf("list_account_containers\n");
+   }
+
+   vector<string> list_containers;
+
+   if (is_connected()) {
+      ClientLease lease(*this);
+      minio::s3::ListBucketsResponse resp = lease.client().ListBuckets();
+      if (resp) {
+         for (const auto& bucket : resp.buckets) {
+            list_containers.push_back(bucket.name);
+         }
+      } else {
+         printf("S3StorageSystem::list_account_containers - error: %s\n",
+                resp.Error().String().c_str());
+      }
+   }
+
+   return list_containers;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::create_container(const string& container_name) {
+   if (debug_mode()) {
+      printf("create_container: %s\n", container_name.c_str());
+   }
+
+   bool container_created = false;
+
+   if (is_connected() && !container_name.empty()) {
+      minio::s3::MakeBucketArgs args;
+      args.bucket = container_name;
+
+      ClientLease lease(*this);
+      minio::s3::MakeBucketResponse resp = lease.client().MakeBucket(args);
+      if (resp) {
+         container_created = true;
+         add_container(container_name);
+      } else {
+         printf("S3StorageSystem::create_container - error: create container '%s' failed: %s\n",
+                container_name.c_str(),
+                resp.Error().String().c_str());
+      }
+   }
+
+   return container_created;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::delete_container(const string& container_name) {
+   if (debug_mode()) {
+      printf("delete_container: %s\n", container_name.c_str());
+   }
+
+   bool container_deleted = false;
+
+   if (is_connected() && !container_name.empty()) {
+      minio::s3::RemoveBucketArgs args;
+      args.bucket = container_name;
+
+      ClientLease lease(*this);
+      minio::s3::RemoveBucketResponse resp = lease.client().RemoveBucket(args);
+      if (resp) {
+         container_deleted = true;
+         remove_container(container_name);
+      } else {
+         if (debug_mode()) {
+            printf("S3StorageSystem::delete_container - error: %s\n",
+                   resp.Error().String().c_str());
+         }
+      }
+   }
+
+   return container_deleted;
+}
+
+//*****************************************************************************
+
+vector<string> S3StorageSystem::list_container_contents(const string& container_name) {
+   if (debug_mode()) {
+      printf("list_container_contents: %s\n", container_name.c_str());
+   }
+
+   vector<string> list_objects;
+
+   if (is_connected() && !container_name.empty()) {
+      minio::s3::ListObjectsArgs args;
+      args.bucket = container_name;
+      args.recursive = true;
+
+      ClientLease lease(*this);
+      minio::s3::ListObjectsResult result = lease.client().ListObjects(args);
+      for (; result; result++) {
+         minio::s3::Item item = *result;
+         if (!item) {
+            printf("S3StorageSystem::list_container_contents - error: %s\n",
+                   item.Error().String().c_str());
+            list_objects.clear();
+            break;
+         }
+         if (!item.is_prefix) {
+            list_objects.push_back(item.name);
+         }
+      }
+   }
+
+   return list_objects;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::get_object_metadata(const string& container_name,
+                                          const string& object_name,
+                                          PropertySet& properties) {
+   if (debug_mode()) {
+      printf("get_object_metadata: container=%s, object=%s\n",
+             container_name.c_str(), object_name.c_str());
+   }
+
+   bool success = false;
+
+   if (is_connected() && !container_name.empty() && !object_name.empty()) {
+      minio::s3::StatObjectArgs args;
+      args.bucket = container_name;
+      args.object = object_name;
+
+      ClientLease lease(*this);
+      minio::s3::StatObjectResponse resp = lease.client().StatObject(args);
+      if (resp) {
+         properties.set_content_length(resp.size);
+         if (!resp.etag.empty()) {
+            properties.add("etag", new StrPropertyValue(resp.etag));
+         }
+
+         list<string> meta_keys = resp.user_metadata.Keys();
+         for (const auto& key : meta_keys) {
+            string value = resp.user_metadata.GetFront(key);
+            if (key == "md5") {
+               properties.set_content_md5(value);
+            } else {
+               properties.add(key, new StrPropertyValue(value));
+            }
+         }
+         success = true;
+      } else {
+         if (debug_mode()) {
+            printf("S3StorageSystem::get_object_metadata - error: %s\n",
+                   resp.Error().String().c_str());
+         }
+      }
+   }
+
+   return success;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::put_object(const string& container_name,
+                                 const string& object_name,
+                                 const vector<unsigned char>& file_contents,
+                                 const PropertySet* headers) {
+   if (debug_mode()) {
+      printf("put_object: container=%s, object=%s, length=%ld\n",
+             container_name.c_str(),
+             object_name.c_str(),
+             file_contents.size());
+   }
+
+   bool object_added = false;
+
+   if (is_connected() &&
+       !container_name.empty() &&
+       !object_name.empty() &&
+       !file_contents.empty()) {
+
+      minio::s3::PutObjectApiArgs args;
+      args.bucket = container_name;
+      args.object = object_name;
+      args.data = string_view((const char*) file_contents.data(),
+                              file_contents.size());
+      args.object_size = file_contents.size();
+      populate_write_args(headers, args, args.content_type);
+
+      // Client::PutObject(PutObjectArgs) hides the single-request overload
+      ClientLease lease(*this);
+      minio::s3::BaseClient& base_client = lease.client();
+      minio::s3::PutObjectResponse resp = base_client.PutObject(args);
+      if (resp) {
+         object_added = true;
+      } else {
+         printf("S3StorageSystem::put_object - error: %s\n",
+                resp.Error().String().c_str());
+      }
+   }
+
+   return object_added;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::put_object_from_file(const string& container_name,
+                                           const string& object_name,
+                                           const string& file_path,
+                                           const PropertySet* headers) {
+   if (debug_mode()) {
+      printf("put_object_from_file: container=%s, object=%s, file_path=%s\n",
+             container_name.c_str(),
+             object_name.c_str(),
+             file_path.c_str());
+   }
+
+   bool object_added = false;
+
+   if (is_connected() &&
+       !container_name.empty() &&
+       !object_name.empty() &&
+       !file_path.empty()) {
+
+      int64_t file_size = Utils::get_file_size(file_path);
+      if (file_size > (int64_t) m_multipart_part_size) {
+         return put_object_multipart(container_name,
+                                     object_name,
+                                     file_path,
+                                     file_size,
+                                     headers);
+      }
+
+      minio::s3::UploadObjectArgs args;
+      args.bucket = container_name;
+      args.object = object_name;
+      args.filename = file_path;
+      populate_write_args(headers, args, args.content_type);
+
+      ClientLease lease(*this);
+      minio::s3::UploadObjectResponse resp = lease.client().UploadObject(args);
+      if (resp) {
+         object_added = true;
+      } else {
+         printf("S3StorageSystem::put_object_from_file - error: %s\n",
+                resp.Error().String().c_str());
+      }
+   }
+
+   return object_added;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::delete_object(const string& container_name,
+                                    const string& object_name) {
+   if (debug_mode()) {
+      printf("delete_object: container=%s, object=%s\n",
+             container_name.c_str(), object_name.c_str());
+   }
+
+   bool object_deleted = false;
+
+   if (is_connected() && !container_name.empty() && !object_name.empty()) {
+      minio::s3::RemoveObjectArgs args;
+      args.bucket = container_name;
+      args.object = object_name;
+
+      ClientLease lease(*this);
+      minio::s3::RemoveObjectResponse resp = lease.client().RemoveObject(args);
+      if (resp) {
+         object_deleted = true;
+      } else {
+         if (debug_mode()) {
+            printf("S3StorageSystem::delete_object - error: %s\n",
+                   resp.Error().String().c_str());
+         }
+      }
+   }
+
+   return object_deleted;
+}
+
+//*****************************************************************************
+
+int64_t S3StorageSystem::get_object(const string& container_name,
+                                    const string& object_name,
+                                    const string& local_file_path) {
+   if (debug_mode()) {
+      printf("get_object: container=%s, object=%s, local_file_path=%s\n",
+             container_name.c_str(), object_name.c_str(),
+             local_file_path.c_str());
+   }
+
+   if (local_file_path.empty()) {
+      printf("error: local file path is empty\n");
+      return 0;
+   }
+
+   if (!is_connected() || container_name.empty() || object_name.empty()) {
+      return 0;
+   }
+
+   FILE* f = fopen(local_file_path.c_str(), "wb");
+   if (f == nullptr) {
+      printf("S3StorageSystem::get_object - error: unable to open '%s', errno=%d\n",
+             local_file_path.c_str(), errno);
+      return 0;
+   }
+
+   int64_t bytes_retrieved = 0;
+   bool write_failed = false;
+
+   minio::s3::GetObjectArgs args;
+   args.bucket = container_name;
+   args.object = object_name;
+   args.datafunc = [&](minio::http::DataFunctionArgs data_args) -> bool {
+      const string& chunk = data_args.datachunk;
+      if (fwrite(chunk.data(), 1, chunk.length(), f) != chunk.length()) {
+         write_failed = true;
+         return false;
+      }
+      bytes_retrieved += chunk.length();
+      return true;
+   };
+
+   ClientLease lease(*this);
+   minio::s3::GetObjectResponse resp = lease.client().GetObject(args);
+   fclose(f);
+
+   if (!resp || write_failed) {
+      if (write_failed) {
+         printf("S3StorageSystem::get_object - error: write to '%s' failed\n",
+                local_file_path.c_str());
+      } else {
+         printf("S3StorageSystem::get_object - error: %s\n",
+                resp.Error().String().c_str());
+      }
+      Utils::file_delete(local_file_path);
+      return 0;
+   }
+
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::put_object_stream(const string& container_name,
+                                        const string& object_name,
+                                        const ObjectSource& source,
+                                        const PropertySet* headers) {
+   if (debug_mode()) {
+      printf("put_object_stream: container=%s, object=%s\n",
+             container_name.c_str(), object_name.c_str());
+   }
+
+   bool object_added = false;
+
+   if (is_connected() && !container_name.empty() && !object_name.empty()) {
+      SourceStreamBuf stream_buf(source);
+      istream stream(&stream_buf);
+
+      // size is unknown up front, so upload in minimum-sized parts
+      minio::s3::PutObjectArgs args(stream, -1, minio::utils::kMinPartSize);
+      args.bucket = container_name;
+      args.object = object_name;
+      populate_write_args(headers, args, args.content_type);
+
+      ClientLease lease(*this);
+      minio::s3::PutObjectResponse resp = lease.client().PutObject(args);
+      if (resp && !stream_buf.failed()) {
+         object_added = true;
+      } else {
+         if (stream_buf.failed()) {
+            printf("S3StorageSystem::put_object_stream - error: source failed\n");
+            if (resp) {
+               // don't leave a truncated object behind
+               delete_object(container_name, object_name);
+            }
+         } else {
+            printf("S3StorageSystem::put_object_stream - error: %s\n",
+                   resp.Error().String().c_str());
+         }
+      }
+   }
+
+   return object_added;
+}
+
+//*****************************************************************************
+
+int64_t S3StorageSystem::get_object_stream(const string& container_name,
+                                           const string& object_name,
+                                           const ObjectSink& sink) {
+   if (debug_mode()) {
+      printf("get_object_stream: container=%s, object=%s\n",
+             container_name.c_str(), object_name.c_str());
+   }
+
+   if (!is_connected() || container_name.empty() || object_name.empty()) {
+      return 0;
+   }
+
+   int64_t bytes_retrieved = 0;
+   bool sink_failed = false;
+
+   minio::s3::GetObjectArgs args;
+   args.bucket = container_name;
+   args.object = object_name;
+   args.datafunc = [&](minio::http::DataFunctionArgs data_args) -> bool {
+      const string& chunk = data_args.datachunk;
+      if (!sink((const unsigned char*) chunk.data(), chunk.length())) {
+         sink_failed = true;
+         return false;
+      }
+      bytes_retrieved += chunk.length();
+      return true;
+   };
+
+   ClientLease lease(*this);
+   minio::s3::GetObjectResponse resp = lease.client().GetObject(args);
+   if (!resp || sink_failed) {
+      if (!sink_failed) {
+         printf("S3StorageSystem::get_object_stream - error: %s\n",
+                resp.Error().String().c_str());
+      }
+      return 0;
+   }
+
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
+
+int64_t S3StorageSystem::get_object_range(const string& container_name,
+                                          const string& object_name,
+                                          int64_t offset,
+                                          int64_t length,
+                                          const ObjectSink& sink) {
+   if (debug_mode()) {
+      printf("get_object_range: container=%s, object=%s, offset=%ld, length=%ld\n",
+             container_name.c_str(), object_name.c_str(),
+             (long) offset, (long) length);
+   }
+
+   if (!is_connected() ||
+       container_name.empty() ||
+       object_name.empty() ||
+       offset < 0) {
+      return 0;
+   }
+
+   int64_t bytes_retrieved = 0;
+   bool sink_failed = false;
+   size_t range_offset = offset;
+   size_t range_length = length;
+
+   minio::s3::GetObjectArgs args;
+   args.bucket = container_name;
+   args.object = object_name;
+   args.offset = &range_offset;
+   if (length > 0) {
+      args.length = &range_length;
+   }
+   args.datafunc = [&](minio::http::DataFunctionArgs data_args) -> bool {
+      const string& chunk = data_args.datachunk;
+      if (!sink((const unsigned char*) chunk.data(), chunk.length())) {
+         sink_failed = true;
+         return false;
+      }
+      bytes_retrieved += chunk.length();
+      return true;
+   };
+
+   ClientLease lease(*this);
+   minio::s3::GetObjectResponse resp = lease.client().GetObject(args);
+   if (!resp || sink_failed) {
+      if (!sink_failed) {
+         printf("S3StorageSystem::get_object_range - error: %s\n",
+                resp.Error().String().c_str());
+      }
+      return 0;
+   }
+
+   return bytes_retrieved;
+}
+
+//*****************************************************************************
+
+bool S3StorageSystem::put_object_multipart(const string& container_name,
+                                           const string& object_name,
+                                           const string& file_path,
+                                           int64_t file_size,
+                                           const PropertySet* headers) {
+   size_t part_size = m_multipart_part_size;
+   if ((file_size + part_size - 1) / part_size > MAX_MULTIPART_PARTS) {
+      part_size = (file_size + MAX_MULTIPART_PARTS - 1) / MAX_MULTIPART_PARTS;
+   }
+   unsigned int num_parts = (file_size + part_size - 1) / part_size;
+   unsigned int num_workers = std::min(m_multipart_concurrency, num_parts);
+
+   if (debug_mode()) {
+      printf("put_object_multipart: object=%s, parts=%u, part_size=%zu, workers=%u\n",
+             object_name.c_str(), num_parts, part_size, num_workers);
+   }
+
+   minio::s3::ObjectWriteArgs write_args;
+   string content_type;
+   populate_write_args(headers, write_args, content_type);
+
+   minio::s3::CreateMultipartUploadArgs create_args;
+   create_args.bucket = container_name;
+   create_args.object = object_name;
+   create_args.headers = write_args.Headers();
+   if (!content_type.empty()) {
+      create_args.headers.Add("Content-Type", content_type);
+   }
+
+   ClientLease lease(*this);
+   minio::s3::CreateMultipartUploadResponse create_resp =
+      lease.client().CreateMultipartUpload(create_args);
+   if (!create_resp) {
+      printf("S3StorageSystem::put_object_multipart - error: %s\n",
+             create_resp.Error().String().c_str());
+      return false;
+   }
+
+   MultipartUpload upload(container_name,
+                          object_name,
+                          file_path,
+                          create_resp.upload_id,
+                          file_size,
+                          part_size,
+                          num_workers);
+
+   // declared ahead of the workers and threads so that they are destroyed
+   // last: no client goes back to the pool until every thread using one
+   // has been joined
+   vector<unique_ptr<ClientLease>> worker_leases;
+   vector<unique_ptr<UploadPartWorker>> workers;
+   vector<unique_ptr<PthreadsThread>> threads;
+   for (unsigned int i = 0; i < num_workers; i++) {
+      worker_leases.emplace_back(new ClientLease(*this));
+      workers.emplace_back(new UploadPartWorker(upload,
+                                                worker_leases.back()->client()));
+      threads.emplace_back(new PthreadsThread(workers.back().get()));
+      if (!threads.back()->start()) {
+         printf("S3StorageSystem::put_object_multipart - error: unable to start worker\n");
+         upload.worker_not_started();
+      }
+   }
+
+   list<minio::s3::Part> parts;
+   bool parts_uploaded = upload.wait_for_parts(parts);
+   threads.clear();
+   workers.clear();
+   worker_leases.clear();
+
+   if (parts_uploaded) {
+      minio::s3::CompleteMultipartUploadArgs complete_args;
+      complete_args.bucket = container_name;
+      complete_args.object = object_name;
+      complete_args.upload_id = create_resp.upload_id;
+      complete_args.parts = parts;
+
+      minio::s3::CompleteMultipartUploadResponse complete_resp =
+         lease.client().CompleteMultipartUpload(complete_args);
+      if (complete_resp) {
+         return true;
+      }
+
+      printf("S3StorageSystem::put_object_multipart - error: %s\n",
+             complete_resp.Error().String().c_str());
+   }
+
+   // don't leave orphaned parts behind
+   minio::s3::AbortMultipartUploadArgs abort_args;
+   abort_args.bucket = container_name;
+   abort_args.object = object_name;
+   abort_args.upload_id = create_resp.upload_id;
+   lease.client().AbortMultipartUpload(abort_args);
+
+   return false;
+}
+
+//*****************************************************************************
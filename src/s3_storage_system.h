@@ -0,0 +1,140 @@
+#ifndef S3_STORAGE_SYSTEM_H
+#define S3_STORAGE_SYSTEM_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "storage_system.h"
+#include "property_set.h"
+
+namespace minio {
+   namespace creds {
+      class StaticProvider;
+   }
+   namespace s3 {
+      struct BaseUrl;
+      class Client;
+   }
+}
+
+// S3StorageSystem talks to S3 (or any S3-compatible service such as MinIO
+// or Ceph RGW) in-process using the bundled minio-cpp client. Unlike
+// S3ExtStorageSystem, no scripts are rendered and no external processes
+// are started. Clients are not safe to share across threads, so every
+// request leases one from a pool of idle clients (creating one if none
+// are idle) and returns it when done; the pool is emptied on exit().
+
+
+class S3StorageSystem : public StorageSystem {
+private:
+   bool m_debug_mode;
+   std::string m_aws_access_key;
+   std::string m_aws_secret_key;
+   std::string m_s3_host;
+   bool m_use_https;
+   size_t m_multipart_part_size;
+   unsigned int m_multipart_concurrency;
+   std::unique_ptr<minio::s3::BaseUrl> m_base_url;
+   std::unique_ptr<minio::creds::StaticProvider> m_provider;
+   std::mutex m_idle_clients_mutex;
+   std::vector<std::unique_ptr<minio::s3::Client>> m_idle_clients;
+
+   S3StorageSystem(const S3StorageSystem&);
+   S3StorageSystem& operator=(const S3StorageSystem&);
+
+public:
+   S3StorageSystem(const std::string& aws_access_key,
+                   const std::string& aws_secret_key,
+                   const std::string& protocol,
+                   const std::string& host,
+                   const std::string& container_prefix,
+                   bool debug_mode=false);
+   virtual ~S3StorageSystem();
+
+   bool enter();
+   void exit();
+
+   // files larger than one part are uploaded as a multipart upload with
+   // up to 'concurrency' parts in flight, each on its own connection
+   void set_multipart_part_size(size_t part_size);
+   void set_multipart_concurrency(unsigned int concurrency);
+
+   // requests lease a client from a pool so they can run concurrently
+   bool supports_concurrent_reads() const;
+   bool supports_concurrent_writes() const;
+
+   std::vector<std::string> list_account_containers();
+
+   bool create_container(const std::string& container_name);
+   bool delete_container(const std::string& container_name);
+   std::vector<std::string> list_container_contents(const std::string& container_name);
+
+   bool get_object_metadata(const std::string& container_name,
+                            const std::string& object_name,
+                            PropertySet& properties);
+
+   bool put_object(const std::string& container_name,
+                   const std::string& object_name,
+                   const std::vector<unsigned char>& file_contents,
+                   const PropertySet* headers=nullptr);
+
+   bool put_object_from_file(const std::string& container_name,
+                             const std::string& object_name,
+                             const std::string& file_path,
+                             const PropertySet* headers=nullptr);
+
+   bool delete_object(const std::string& container_name,
+                      const std::string& object_name);
+
+   int64_t get_object(const std::string& container_name,
+                      const std::string& object_name,
+                      const std::string& local_file_path);
+
+   bool put_object_stream(const std::string& container_name,
+                          const std::string& object_name,
+                          const ObjectSource& source,
+                          const PropertySet* headers=nullptr);
+
+   int64_t get_object_stream(const std::string& container_name,
+                             const std::string& object_name,
+                             const ObjectSink& sink);
+
+   int64_t get_object_range(const std::string& container_name,
+                            const std::string& object_name,
+                            int64_t offset,
+                            int64_t length,
+                            const ObjectSink& sink);
+
+protected:
+   // a client taken from the pool for as long as the lease lives
+   class ClientLease {
+   private:
+      S3StorageSystem& m_storage_system;
+      std::unique_ptr<minio::s3::Client> m_client;
+
+      ClientLease(const ClientLease&);
+      ClientLease& operator=(const ClientLease&);
+
+   public:
+      explicit ClientLease(S3StorageSystem& storage_system);
+      ~ClientLease();
+
+      minio::s3::Client& client();
+   };
+
+   bool is_connected() const;
+
+   std::unique_ptr<minio::s3::Client> acquire_client();
+   void release_client(std::unique_ptr<minio::s3::Client> client);
+
+   bool put_object_multipart(const std::string& container_name,
+                             const std::string& object_name,
+                             const std::string& file_path,
+                             int64_t file_size,
+                             const PropertySet* headers);
+};
+
+#endif
+
@@ -28,7 +28,8 @@ S3ExtStorageSystem::S3ExtStorageSystem(const string& access_key,
    m_aws_access_key(access_key),
    m_aws_secret_key(secret_key),
    m_s3_host(host),
-   m_connected(false)
+   m_connected(false),
+   m_run_script_seq(0)
 {
    string protocolInUse(protocol);
 
@@ -73,8 +74,8 @@ bool S3ExtStorageSystem::enter() {
       printf("S3ExtStorageSystem.enter\n");
    }
 
-   set_list_containers(list_account_containers());
-
+   // listing the containers means running a script, so it's left until
+   // something needs the list (see has_container)
    return true;
 }
 
@@ -91,6 +92,12 @@ void S3ExtStorageSystem::exit() {
 
 //*****************************************************************************
 
+bool S3ExtStorageSystem::supports_concurrent_writes() const {
+   return true;
+}
+
+//*****************************************************************************
+
 vector<string> S3ExtStorageSystem::list_account_containers() {
    if (debug_mode()) {
       printf("list_account_containers\n");
@@ -103,7 +110,7 @@ vector<string> S3ExtStorageSystem::list_account_containers() {
    string script_template = "s3-list-containers.sh";
    string run_script = run_script_name_for_template(script_template);
 
-   if (prepare_run_script(script_template, kvp)) {
+   if (prepare_run_script(script_template, run_script, kvp)) {
       if (!run_program(run_script, list_containers)) {
          list_containers.clear();
          printf("S3ExtStorageSystem::list_account_containers - error: unable to run script\n");
@@ -133,7 +140,7 @@ bool S3ExtStorageSystem::create_container(const string& container_name) {
    string script_template = "s3-create-container.sh";
    string run_script = run_script_name_for_template(script_template);
 
-   if (prepare_run_script(script_template, kvp)) {
+   if (prepare_run_script(script_template, run_script, kvp)) {
       if (run_program(run_script)) {
          container_created = true;
       } else {
@@ -164,7 +171,7 @@ bool S3ExtStorageSystem::delete_container(const string& container_name) {
    string script_template = "s3-delete-container.sh";
    string run_script = run_script_name_for_template(script_template);
 
-   if (prepare_run_script(script_template, kvp)) {
+   if (prepare_run_script(script_template, run_script, kvp)) {
       if (run_program(run_script)) {
          container_deleted = true;
       }
@@ -191,7 +198,7 @@ vector<string> S3ExtStorageSystem::list_container_contents(const string& contain
    string script_template = "s3-list-container-contents.sh";
    string run_script = run_script_name_for_template(script_template);
 
-   if (prepare_run_script(script_template, kvp)) {
+   if (prepare_run_script(script_template, run_script, kvp)) {
       if (!run_program(run_script, list_objects)) {
          list_objects.clear();
          printf("S3ExtStorageSystem::list_container_contents - error: unable to run program\n");
@@ -225,7 +232,7 @@ bool S3ExtStorageSystem::get_object_metadata(const string& container_name,
    string script_template = "s3-head-object.sh";
    string run_script = run_script_name_for_template(script_template);
 
-   if (prepare_run_script(script_template, kvp)) {
+   if (prepare_run_script(script_template, run_script, kvp)) {
       string std_out;
       if (run_program(run_script, std_out)) {
          printf("%s\n", std_out.c_str());
@@ -255,6 +262,8 @@ bool S3ExtStorageSystem::put_object(const string& container_name,
    bool object_added = false;
 
    string tmp_file = "tmp_";
+   tmp_file += StrUtils::toString((int) ++m_run_script_seq);
+   tmp_file += "_";
    tmp_file += container_name;
    tmp_file += "_";
    tmp_file += object_name;
@@ -372,7 +381,7 @@ bool S3ExtStorageSystem::put_object_from_file(const string& container_name,
 
    string run_script = run_script_name_for_template(script_template);
 
-   if (prepare_run_script(script_template, kvp)) {
+   if (prepare_run_script(script_template, run_script, kvp)) {
       if (run_program(run_script)) {
          object_added = true;
       }
@@ -402,7 +411,7 @@ bool S3ExtStorageSystem::delete_object(const string& container_name,
    string script_template = "s3-delete-object.sh";
    string run_script = run_script_name_for_template(script_template);
 
-   if (prepare_run_script(script_template, kvp)) {
+   if (prepare_run_script(script_template, run_script, kvp)) {
       if (run_program(run_script)) {
          object_deleted = true;
       }
@@ -440,7 +449,7 @@ int64_t S3ExtStorageSystem::get_object(const string& container_name,
    string script_template = "s3-get-object.sh";
    string run_script = run_script_name_for_template(script_template);
 
-   if (prepare_run_script(script_template, kvp)) {
+   if (prepare_run_script(script_template, run_script, kvp)) {
       if (run_program(run_script)) {
          success = true;
       }
@@ -651,9 +660,8 @@ bool S3ExtStorageSystem::run_program(const string& program_path) {
 //*****************************************************************************
 
 bool S3ExtStorageSystem::prepare_run_script(const string& script_template,
+                                            const string& run_script,
                                             const KeyValuePairs& kvp) {
-   string run_script = run_script_name_for_template(script_template);
-
    if (!Utils::file_copy(script_template, run_script)) {
       return false;
    }
@@ -685,6 +693,8 @@ bool S3ExtStorageSystem::prepare_run_script(const string& script_template,
 
 string S3ExtStorageSystem::run_script_name_for_template(const string& script_template) {
    string run_script = "exec-";
+   run_script += StrUtils::toString((int) ++m_run_script_seq);
+   run_script += "-";
    run_script += script_template;
    return run_script;
 }
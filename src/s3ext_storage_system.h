@@ -1,6 +1,7 @@
 #ifndef S3EXT_STORAGE_SYSTEM_H
 #define S3EXT_STORAGE_SYSTEM_H
 
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -19,6 +20,7 @@ private:
    std::string m_aws_secret_key;
    std::string m_s3_host;
    bool m_connected;
+   std::atomic<unsigned int> m_run_script_seq;
 
    S3ExtStorageSystem(const S3ExtStorageSystem&);
    S3ExtStorageSystem& operator=(const S3ExtStorageSystem&);
@@ -35,6 +37,9 @@ public:
    bool enter();
    void exit();
 
+   // every request renders its own script, so writes can run concurrently
+   bool supports_concurrent_writes() const;
+
    std::vector<std::string> list_account_containers();
 
    bool create_container(const std::string& container_name);
@@ -74,7 +79,10 @@ protected:
                     std::string& std_out);
    bool run_program(const std::string& program_path);
    bool prepare_run_script(const std::string& script_template,
+                           const std::string& run_script,
                            const chaudiere::KeyValuePairs& kvp);
+   // each call returns a distinct name so that concurrent requests
+   // (e.g., parallel song downloads) never share a rendered script
    std::string run_script_name_for_template(const std::string& script_template);
 
 };
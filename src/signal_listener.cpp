@@ -0,0 +1,153 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "signal_listener.h"
+#include "jukebox.h"
+
+using namespace std;
+using namespace chaudiere;
+
+#define READ_PIPE 0
+#define WRITE_PIPE 1
+
+// written to the pipe by stop() to end the listener thread
+static const unsigned char EVENT_SHUTDOWN = 0;
+
+static volatile sig_atomic_t g_signal_write_fd = -1;
+
+//*****************************************************************************
+
+static void signal_handler(int signum) {
+   int fd = g_signal_write_fd;
+   if (fd >= 0) {
+      int saved_errno = errno;
+      unsigned char event = (unsigned char) signum;
+      ssize_t rc = write(fd, &event, 1);
+      (void) rc;
+      errno = saved_errno;
+   }
+}
+
+//*****************************************************************************
+
+static void set_signal_handlers(void (*handler)(int)) {
+   struct sigaction sa;
+   sa.sa_handler = handler;
+   sigemptyset(&sa.sa_mask);
+   // restart interrupted waitpid/read calls in the threads that
+   // happen to receive the signal
+   sa.sa_flags = SA_RESTART;
+
+   sigaction(SIGUSR1, &sa, nullptr);
+   sigaction(SIGUSR2, &sa, nullptr);
+   sigaction(SIGINT, &sa, nullptr);
+   sigaction(SIGWINCH, &sa, nullptr);
+}
+
+//*****************************************************************************
+
+SignalListener::SignalListener(Jukebox& jb) :
+   m_jukebox(jb),
+   m_running(false) {
+   m_pipe_fds[READ_PIPE] = -1;
+   m_pipe_fds[WRITE_PIPE] = -1;
+}
+
+//*****************************************************************************
+
+SignalListener::~SignalListener() {
+   stop();
+}
+
+//*****************************************************************************
+
+bool SignalListener::start() {
+   if (m_thread) {
+      return true;
+   }
+
+   if (pipe(m_pipe_fds) != 0) {
+      printf("error: unable to create signal pipe. errno = %d\n", errno);
+      return false;
+   }
+
+   m_running = true;
+   m_thread.reset(new PthreadsThread(this));
+   if (!m_thread->start()) {
+      printf("error: unable to start signal listener thread\n");
+      m_running = false;
+      m_thread.reset();
+      close(m_pipe_fds[READ_PIPE]);
+      close(m_pipe_fds[WRITE_PIPE]);
+      m_pipe_fds[READ_PIPE] = -1;
+      m_pipe_fds[WRITE_PIPE] = -1;
+      return false;
+   }
+
+   g_signal_write_fd = m_pipe_fds[WRITE_PIPE];
+   set_signal_handlers(signal_handler);
+   return true;
+}
+
+//*****************************************************************************
+
+void SignalListener::stop() {
+   if (!m_thread) {
+      return;
+   }
+
+   set_signal_handlers(SIG_DFL);
+   g_signal_write_fd = -1;
+
+   unsigned char event = EVENT_SHUTDOWN;
+   if (write(m_pipe_fds[WRITE_PIPE], &event, 1) != 1) {
+      printf("error: unable to stop signal listener. errno = %d\n", errno);
+   }
+
+   {
+      unique_lock<mutex> lock(m_mutex);
+      m_cond_stopped.wait(lock, [this] { return !m_running; });
+   }
+   m_thread.reset();
+
+   close(m_pipe_fds[READ_PIPE]);
+   close(m_pipe_fds[WRITE_PIPE]);
+   m_pipe_fds[READ_PIPE] = -1;
+   m_pipe_fds[WRITE_PIPE] = -1;
+}
+
+//*****************************************************************************
+
+void SignalListener::run() {
+   for (;;) {
+      unsigned char event;
+      ssize_t bytes_read = read(m_pipe_fds[READ_PIPE], &event, 1);
+      if (bytes_read < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         printf("error: unable to read signal pipe. errno = %d\n", errno);
+         break;
+      } else if (bytes_read == 0 || event == EVENT_SHUTDOWN) {
+         break;
+      }
+
+      if (event == SIGUSR1) {
+         m_jukebox.toggle_pause_play();
+      } else if (event == SIGUSR2) {
+         m_jukebox.advance_to_next_song();
+      } else if (event == SIGINT) {
+         m_jukebox.prepare_for_termination();
+      } else if (event == SIGWINCH) {
+         m_jukebox.display_info();
+      }
+   }
+
+   lock_guard<mutex> lock(m_mutex);
+   m_running = false;
+   m_cond_stopped.notify_all();
+}
+
+//*****************************************************************************
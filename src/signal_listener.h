@@ -0,0 +1,41 @@
+#ifndef SIGNAL_LISTENER_H
+#define SIGNAL_LISTENER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "Runnable.h"
+#include "PthreadsThread.h"
+
+class Jukebox;
+
+
+// Delivers the jukebox's control signals (SIGUSR1 pause/resume, SIGUSR2
+// next song, SIGINT quit, SIGWINCH info) through a self-pipe. The signal
+// handler only writes the signal number to the pipe; the listener thread
+// reads it and acts on it outside of signal context.
+class SignalListener : public chaudiere::Runnable {
+private:
+   Jukebox& m_jukebox;
+   int m_pipe_fds[2];
+   std::unique_ptr<chaudiere::PthreadsThread> m_thread;
+   std::mutex m_mutex;
+   std::condition_variable m_cond_stopped;
+   bool m_running;
+
+   SignalListener();
+   SignalListener(const SignalListener&);
+   SignalListener& operator=(const SignalListener&);
+
+public:
+   SignalListener(Jukebox& jb);
+   virtual ~SignalListener();
+
+   bool start();
+   void stop();
+
+   virtual void run();
+};
+
+#endif
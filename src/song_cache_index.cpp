@@ -0,0 +1,269 @@
+#include <algorithm>
+
+#include "song_cache_index.h"
+#include "utils.h"
+#include "OSUtils.h"
+#include "nlohmann/json.hpp"
+
+using namespace std;
+using namespace chaudiere;
+using json = nlohmann::json;
+
+const string SongCacheIndex::INDEX_FILE_NAME = ".song_cache_index.json";
+
+//*****************************************************************************
+
+SongCacheIndex::SongCacheIndex() :
+   m_use_counter(0),
+   m_bytes_cached(0) {
+}
+
+//*****************************************************************************
+
+SongCacheIndex::~SongCacheIndex() {
+}
+
+//*****************************************************************************
+
+void SongCacheIndex::reconcile(const string& dir_path) {
+   vector<string> dir_listing = OSUtils::listFilesInDirectory(dir_path);
+
+   lock_guard<mutex> lock(m_mutex);
+   m_songs.clear();
+   m_bytes_cached = 0;
+
+   for (const auto& listing_entry : dir_listing) {
+      string full_path = OSUtils::pathJoin(dir_path, listing_entry);
+      if (listing_entry != INDEX_FILE_NAME && Utils::path_isfile(full_path)) {
+         Entry& entry = m_songs[listing_entry];
+         entry.size = Utils::get_file_size(full_path);
+         entry.last_used = ++m_use_counter;
+         set_state_locked(entry, DOWNLOADED);
+      }
+   }
+}
+
+//*****************************************************************************
+
+bool SongCacheIndex::load(const string& dir_path) {
+   unordered_map<string, Entry> saved_songs;
+   string index_path = OSUtils::pathJoin(dir_path, INDEX_FILE_NAME);
+   string index_contents;
+
+   if (Utils::file_exists(index_path) &&
+       Utils::file_read_all_text(index_path, index_contents) &&
+       !index_contents.empty()) {
+      try {
+         json index_json = json::parse(index_contents);
+         if (index_json.contains("songs")) {
+            for (const auto& song_json : index_json["songs"]) {
+               Entry entry;
+               entry.state = DOWNLOADED;
+               entry.size = song_json["size"];
+               entry.last_used = song_json["last_used"];
+               saved_songs[song_json["uid"]] = entry;
+            }
+         }
+      } catch (const exception& e) {
+         printf("error: unable to parse %s - %s\n",
+                index_path.c_str(), e.what());
+         saved_songs.clear();
+      }
+   }
+
+   vector<string> dir_listing = OSUtils::listFilesInDirectory(dir_path);
+
+   lock_guard<mutex> lock(m_mutex);
+   m_songs.clear();
+   m_bytes_cached = 0;
+   m_use_counter = 0;
+
+   for (const auto& listing_entry : dir_listing) {
+      if (listing_entry == INDEX_FILE_NAME) {
+         continue;
+      }
+      string full_path = OSUtils::pathJoin(dir_path, listing_entry);
+      if (!Utils::path_isfile(full_path)) {
+         continue;
+      }
+
+      auto it = saved_songs.find(listing_entry);
+      if (it != saved_songs.end() &&
+          it->second.size == Utils::get_file_size(full_path)) {
+         Entry& entry = m_songs[listing_entry];
+         entry.size = it->second.size;
+         entry.last_used = it->second.last_used;
+         set_state_locked(entry, DOWNLOADED);
+         m_use_counter = std::max(m_use_counter, entry.last_used);
+      } else {
+         OSUtils::deleteFile(full_path);
+      }
+   }
+
+   return true;
+}
+
+//*****************************************************************************
+
+bool SongCacheIndex::save(const string& dir_path) {
+   json songs_json = json::array();
+   {
+      lock_guard<mutex> lock(m_mutex);
+      for (const auto& kv : m_songs) {
+         if (kv.second.state == DOWNLOADED) {
+            json song_json;
+            song_json["uid"] = kv.first;
+            song_json["size"] = kv.second.size;
+            song_json["last_used"] = kv.second.last_used;
+            songs_json.push_back(song_json);
+         }
+      }
+   }
+
+   json index_json;
+   index_json["songs"] = songs_json;
+
+   // write to a temp file and rename so a crash never leaves a torn index
+   string index_path = OSUtils::pathJoin(dir_path, INDEX_FILE_NAME);
+   string tmp_path = index_path + ".tmp";
+   if (!Utils::file_write_all_text(tmp_path, index_json.dump())) {
+      printf("error: unable to write %s\n", tmp_path.c_str());
+      return false;
+   }
+
+   if (rename(tmp_path.c_str(), index_path.c_str()) != 0) {
+      printf("error: unable to rename %s\n", tmp_path.c_str());
+      OSUtils::deleteFile(tmp_path);
+      return false;
+   }
+
+   return true;
+}
+
+//*****************************************************************************
+
+void SongCacheIndex::set_state_locked(Entry& entry, SongState state) {
+   if (entry.state == DOWNLOADED && state != DOWNLOADED) {
+      m_bytes_cached -= entry.size;
+   } else if (entry.state != DOWNLOADED && state == DOWNLOADED) {
+      m_bytes_cached += entry.size;
+   }
+   entry.state = state;
+}
+
+//*****************************************************************************
+
+SongCacheIndex::SongState SongCacheIndex::get_state(const string& file_uid) {
+   lock_guard<mutex> lock(m_mutex);
+   auto it = m_songs.find(file_uid);
+   if (it != m_songs.end()) {
+      return it->second.state;
+   } else {
+      return NOT_PRESENT;
+   }
+}
+
+//*****************************************************************************
+
+void SongCacheIndex::set_state(const string& file_uid, SongState state) {
+   lock_guard<mutex> lock(m_mutex);
+   set_state_locked(m_songs[file_uid], state);
+}
+
+//*****************************************************************************
+
+void SongCacheIndex::set_downloaded(const string& file_uid, int64_t size) {
+   lock_guard<mutex> lock(m_mutex);
+   Entry& entry = m_songs[file_uid];
+   set_state_locked(entry, NOT_PRESENT);
+   entry.size = size;
+   entry.last_used = ++m_use_counter;
+   set_state_locked(entry, DOWNLOADED);
+}
+
+//*****************************************************************************
+
+void SongCacheIndex::touch(const string& file_uid) {
+   lock_guard<mutex> lock(m_mutex);
+   auto it = m_songs.find(file_uid);
+   if (it != m_songs.end()) {
+      it->second.last_used = ++m_use_counter;
+   }
+}
+
+//*****************************************************************************
+
+bool SongCacheIndex::begin_download(const string& file_uid) {
+   lock_guard<mutex> lock(m_mutex);
+   Entry& entry = m_songs[file_uid];
+   if (entry.state == DOWNLOADING || entry.state == DOWNLOADED) {
+      return false;
+   }
+   set_state_locked(entry, DOWNLOADING);
+   return true;
+}
+
+//*****************************************************************************
+
+bool SongCacheIndex::is_downloaded(const string& file_uid) {
+   return get_state(file_uid) == DOWNLOADED;
+}
+
+//*****************************************************************************
+
+bool SongCacheIndex::is_downloading(const string& file_uid) {
+   return get_state(file_uid) == DOWNLOADING;
+}
+
+//*****************************************************************************
+
+unsigned int SongCacheIndex::count(SongState state) {
+   lock_guard<mutex> lock(m_mutex);
+   unsigned int num_songs = 0;
+   for (const auto& kv : m_songs) {
+      if (kv.second.state == state) {
+         ++num_songs;
+      }
+   }
+   return num_songs;
+}
+
+//*****************************************************************************
+
+int64_t SongCacheIndex::get_bytes_cached() {
+   lock_guard<mutex> lock(m_mutex);
+   return m_bytes_cached;
+}
+
+//*****************************************************************************
+
+vector<string> SongCacheIndex::evict(int64_t byte_budget,
+                                     const unordered_set<string>& pinned) {
+   vector<string> evicted;
+
+   lock_guard<mutex> lock(m_mutex);
+   if (m_bytes_cached <= byte_budget) {
+      return evicted;
+   }
+
+   vector<pair<uint64_t, string>> candidates;
+   for (const auto& kv : m_songs) {
+      if (kv.second.state == DOWNLOADED && pinned.count(kv.first) == 0) {
+         candidates.push_back(make_pair(kv.second.last_used, kv.first));
+      }
+   }
+   std::sort(candidates.begin(), candidates.end());
+
+   for (const auto& candidate : candidates) {
+      if (m_bytes_cached <= byte_budget) {
+         break;
+      }
+      Entry& entry = m_songs[candidate.second];
+      set_state_locked(entry, NOT_PRESENT);
+      evicted.push_back(candidate.second);
+   }
+
+   return evicted;
+}
+
+//*****************************************************************************
@@ -0,0 +1,91 @@
+#ifndef SONG_CACHE_INDEX_H
+#define SONG_CACHE_INDEX_H
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+// In-memory record of the songs in the song-play directory, keyed by file
+// uid. The jukebox consults it when scheduling downloads instead of
+// listing the directory or stat'ing candidate files; it is reconciled
+// with the filesystem only at startup.
+//
+// When used as a persistent cache (load/save), downloaded songs are kept
+// after they play and the index is written to a JSON file in the
+// directory so the cache survives restarts. evict() trims the least
+// recently used songs to keep the cache within a byte budget.
+class SongCacheIndex {
+public:
+   enum SongState {
+      NOT_PRESENT,
+      DOWNLOADING,
+      DOWNLOADED,
+      PLAYED
+   };
+
+   static const std::string INDEX_FILE_NAME;
+
+private:
+   struct Entry {
+      SongState state;
+      int64_t size;
+      uint64_t last_used;
+
+      Entry() :
+         state(NOT_PRESENT),
+         size(0),
+         last_used(0) {
+      }
+   };
+
+   std::mutex m_mutex;
+   std::unordered_map<std::string, Entry> m_songs;
+   uint64_t m_use_counter;
+   int64_t m_bytes_cached;
+
+   SongCacheIndex(const SongCacheIndex&);
+   SongCacheIndex& operator=(const SongCacheIndex&);
+
+   void set_state_locked(Entry& entry, SongState state);
+
+public:
+   SongCacheIndex();
+   ~SongCacheIndex();
+
+   // rebuild the index from the files present in dir_path
+   void reconcile(const std::string& dir_path);
+
+   // rebuild the index from the saved index in dir_path. files that aren't
+   // in the saved index, or whose size doesn't match it, are deleted since
+   // they may be left over from an interrupted download.
+   bool load(const std::string& dir_path);
+   bool save(const std::string& dir_path);
+
+   SongState get_state(const std::string& file_uid);
+   void set_state(const std::string& file_uid, SongState state);
+   void set_downloaded(const std::string& file_uid, int64_t size);
+
+   // marks file_uid as the most recently used song
+   void touch(const std::string& file_uid);
+
+   // moves file_uid to DOWNLOADING unless it's already downloading or
+   // downloaded. returns true if the caller should download it.
+   bool begin_download(const std::string& file_uid);
+
+   bool is_downloaded(const std::string& file_uid);
+   bool is_downloading(const std::string& file_uid);
+   unsigned int count(SongState state);
+   int64_t get_bytes_cached();
+
+   // forgets least recently used downloaded songs (other than those in
+   // pinned) until at most byte_budget bytes remain. returns the uids that
+   // were evicted so the caller can delete their files.
+   std::vector<std::string> evict(int64_t byte_budget,
+                                  const std::unordered_set<std::string>& pinned);
+};
+
+#endif
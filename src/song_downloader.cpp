@@ -1,13 +1,13 @@
 #include "song_downloader.h"
 
 using namespace std;
+using namespace chaudiere;
 
 //*****************************************************************************
 
-SongDownloader::SongDownloader(Jukebox& jb,
-                               const vector<SongMetadata>& the_song_list) :
+SongDownloader::SongDownloader(Jukebox& jb, SongDownloadPool& pool) :
    m_jukebox(jb),
-   m_list_songs(the_song_list) {
+   m_pool(pool) {
 }
 
 //*****************************************************************************
@@ -18,21 +18,174 @@ SongDownloader::~SongDownloader() {
 //*****************************************************************************
 
 void SongDownloader::run() {
-   if (!m_list_songs.empty()) {
+   SongMetadata song;
+   while (m_pool.next_song(song)) {
+      if (!m_jukebox.is_exit_requested()) {
+         m_jukebox.download_song(song);
+      } else {
+         m_jukebox.download_cancelled(song);
+      }
+      m_pool.song_finished(song);
+   }
+   m_pool.worker_exiting();
+}
+
+//*****************************************************************************
+
+SongDownloadPool::SongDownloadPool(Jukebox& jb, unsigned int num_workers) :
+   m_jukebox(jb),
+   m_num_workers(num_workers > 0 ? num_workers : 1),
+   m_workers_running(0),
+   m_stopping(false) {
+}
+
+//*****************************************************************************
+
+SongDownloadPool::~SongDownloadPool() {
+   stop();
+}
+
+//*****************************************************************************
+
+bool SongDownloadPool::start() {
+   for (unsigned int i = 0; i < m_num_workers; ++i) {
+      unique_ptr<SongDownloader> worker(new SongDownloader(m_jukebox, *this));
+      unique_ptr<PthreadsThread> thread(new PthreadsThread(worker.get()));
+      {
+         lock_guard<mutex> lock(m_mutex);
+         ++m_workers_running;
+      }
+      if (!thread->start()) {
+         printf("error: unable to start download worker thread\n");
+         worker_exiting();
+         break;
+      }
+      m_workers.push_back(std::move(worker));
+      m_threads.push_back(std::move(thread));
+   }
+
+   return !m_threads.empty();
+}
+
+//*****************************************************************************
+
+void SongDownloadPool::stop() {
+   unique_lock<mutex> lock(m_mutex);
+   m_stopping = true;
+   // drop anything not yet started; downloads underway are left to finish
+   for (const auto& song : m_queue) {
+      m_in_flight.erase(song.get_file_uid());
+      m_jukebox.download_cancelled(song);
+   }
+   m_queue.clear();
+   m_cond_queue.notify_all();
+   m_cond_done.notify_all();
+   m_cond_done.wait(lock, [this] { return m_workers_running == 0; });
+   lock.unlock();
+
+   m_threads.clear();
+   m_workers.clear();
+}
+
+//*****************************************************************************
+
+bool SongDownloadPool::enqueue(const SongMetadata& song) {
+   lock_guard<mutex> lock(m_mutex);
+   if (m_stopping || m_in_flight.count(song.get_file_uid()) > 0) {
+      return false;
+   }
+
+   if (m_in_flight.empty()) {
       m_jukebox.batch_download_start();
+   }
+   m_in_flight.insert(song.get_file_uid());
+   m_queue.push_back(song);
+   m_jukebox.download_queue_changed(m_queue.size(), m_in_flight.size());
+   m_cond_queue.notify_one();
+   return true;
+}
+
+//*****************************************************************************
 
-      for (const auto& song : m_list_songs) {
-         if (m_jukebox.is_exit_requested()) {
-            break;
-         } else {
-            m_jukebox.download_song(song);
-         }
+bool SongDownloadPool::next_song(SongMetadata& song) {
+   unique_lock<mutex> lock(m_mutex);
+   m_cond_queue.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+   if (m_stopping) {
+      return false;
+   }
+
+   song = m_queue.front();
+   m_queue.pop_front();
+   m_jukebox.download_queue_changed(m_queue.size(), m_in_flight.size());
+   return true;
+}
+
+//*****************************************************************************
+
+void SongDownloadPool::song_finished(const SongMetadata& song) {
+   {
+      lock_guard<mutex> lock(m_mutex);
+      m_in_flight.erase(song.get_file_uid());
+      m_jukebox.download_queue_changed(m_queue.size(), m_in_flight.size());
+      if (m_in_flight.empty()) {
+         m_jukebox.batch_download_complete();
       }
-      m_jukebox.batch_download_complete();
-   } else {
-      printf("SongDownloader.run: list_songs is empty\n");
+      m_cond_done.notify_all();
    }
+
+   // outside of our lock: the play loop checks the song's cache state
+   // while holding its own event lock
+   m_jukebox.notify_playback_event();
+}
+
+//*****************************************************************************
+
+void SongDownloadPool::worker_exiting() {
+   lock_guard<mutex> lock(m_mutex);
+   --m_workers_running;
+   m_cond_done.notify_all();
 }
 
 //*****************************************************************************
 
+SongTailDownloader::SongTailDownloader(Jukebox& jb,
+                                       const SongMetadata& song,
+                                       int64_t offset) :
+   m_jukebox(jb),
+   m_song(song),
+   m_offset(offset) {
+}
+
+//*****************************************************************************
+
+SongTailDownloader::~SongTailDownloader() {
+}
+
+//*****************************************************************************
+
+void SongTailDownloader::run() {
+   m_jukebox.download_song_tail(m_song, m_offset);
+}
+
+//*****************************************************************************
+
+SongStreamFeeder::SongStreamFeeder(Jukebox& jb,
+                                   const SongMetadata& song,
+                                   const string& pipe_path) :
+   m_jukebox(jb),
+   m_song(song),
+   m_pipe_path(pipe_path) {
+}
+
+//*****************************************************************************
+
+SongStreamFeeder::~SongStreamFeeder() {
+}
+
+//*****************************************************************************
+
+void SongStreamFeeder::run() {
+   m_jukebox.stream_song(m_song, m_pipe_path);
+}
+
+//*****************************************************************************
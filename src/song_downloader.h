@@ -1,27 +1,120 @@
 #ifndef SONG_DOWNLOADER_H
 #define SONG_DOWNLOADER_H
 
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "jukebox.h"
 #include "song_metadata.h"
 #include "Runnable.h"
+#include "PthreadsThread.h"
 
 
+class SongDownloadPool;
+
+
+// One worker of a SongDownloadPool. Pulls songs from the pool's queue
+// until the pool is stopped.
 class SongDownloader : public chaudiere::Runnable {
 private:
    Jukebox& m_jukebox;
-   std::vector<SongMetadata> m_list_songs;
+   SongDownloadPool& m_pool;
 
    SongDownloader();
    SongDownloader(const SongDownloader&);
    SongDownloader& operator=(const SongDownloader&);
 
 public:
-   SongDownloader(Jukebox& jb, const std::vector<SongMetadata>& list_songs);
+   SongDownloader(Jukebox& jb, SongDownloadPool& pool);
    virtual ~SongDownloader();
 
    virtual void run();
 };
 
+
+// Persistent set of download workers fed from a prefetch queue. A song is
+// tracked as in flight from the moment it is queued until its download
+// finishes, so the same song is never queued twice.
+class SongDownloadPool {
+private:
+   Jukebox& m_jukebox;
+   unsigned int m_num_workers;
+   std::mutex m_mutex;
+   std::condition_variable m_cond_queue;
+   std::condition_variable m_cond_done;
+   std::deque<SongMetadata> m_queue;
+   std::set<std::string> m_in_flight;
+   std::vector<std::unique_ptr<SongDownloader>> m_workers;
+   std::vector<std::unique_ptr<chaudiere::PthreadsThread>> m_threads;
+   unsigned int m_workers_running;
+   bool m_stopping;
+
+   SongDownloadPool();
+   SongDownloadPool(const SongDownloadPool&);
+   SongDownloadPool& operator=(const SongDownloadPool&);
+
+public:
+   SongDownloadPool(Jukebox& jb, unsigned int num_workers);
+   ~SongDownloadPool();
+
+   bool start();
+   void stop();
+
+   // returns false if the song is already queued or downloading
+   bool enqueue(const SongMetadata& song);
+
+   // called by workers
+   bool next_song(SongMetadata& song);
+   void song_finished(const SongMetadata& song);
+   void worker_exiting();
+};
+
+
+// Fills in the remainder of a song whose leading bytes have already been
+// downloaded so that playback can begin before the download completes.
+class SongTailDownloader : public chaudiere::Runnable {
+private:
+   Jukebox& m_jukebox;
+   SongMetadata m_song;
+   int64_t m_offset;
+
+   SongTailDownloader();
+   SongTailDownloader(const SongTailDownloader&);
+   SongTailDownloader& operator=(const SongTailDownloader&);
+
+public:
+   SongTailDownloader(Jukebox& jb, const SongMetadata& song, int64_t offset);
+   virtual ~SongTailDownloader();
+
+   virtual void run();
+};
+
+
+// Feeds a song to the player through a pipe while its tail is still
+// being downloaded.
+class SongStreamFeeder : public chaudiere::Runnable {
+private:
+   Jukebox& m_jukebox;
+   SongMetadata m_song;
+   std::string m_pipe_path;
+
+   SongStreamFeeder();
+   SongStreamFeeder(const SongStreamFeeder&);
+   SongStreamFeeder& operator=(const SongStreamFeeder&);
+
+public:
+   SongStreamFeeder(Jukebox& jb,
+                    const SongMetadata& song,
+                    const std::string& pipe_path);
+   virtual ~SongStreamFeeder();
+
+   virtual void run();
+};
+
 #endif
@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <chrono>
+
+#include "song_importer.h"
+#include "object_stream.h"
+#include "utils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+//*****************************************************************************
+
+static double seconds_since(const chrono::steady_clock::time_point& start) {
+   return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// storage systems that can't take concurrent writes get a single uploader
+static unsigned int num_upload_workers(const StorageSystem& storage_system,
+                                       const JukeboxOptions& jukebox_options) {
+   if (!storage_system.supports_concurrent_writes()) {
+      return 1;
+   }
+   return jukebox_options.get_import_workers() > 0 ?
+          jukebox_options.get_import_workers() : 1;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+class ImportStageWorker : public Runnable {
+private:
+   SongImporter& m_importer;
+   bool m_is_uploader;
+
+   ImportStageWorker(const ImportStageWorker&);
+   ImportStageWorker& operator=(const ImportStageWorker&);
+
+public:
+   ImportStageWorker(SongImporter& importer, bool is_uploader) :
+      m_importer(importer),
+      m_is_uploader(is_uploader) {
+   }
+
+   virtual void run() {
+      if (m_is_uploader) {
+         m_importer.run_upload_stage();
+      } else {
+         m_importer.run_metadata_stage();
+      }
+   }
+};
+
+//*****************************************************************************
+//*****************************************************************************
+
+SongImporter::SongImporter(StorageSystem& storage_system,
+                           const JukeboxOptions& jukebox_options,
+                           const MetadataStore& metadata_store) :
+   m_storage_system(storage_system),
+   m_jukebox_options(jukebox_options),
+   m_metadata_store(metadata_store),
+   m_metadata_batch_size(0),
+   m_content_hash_algorithm(ContentHash::MD5),
+   m_num_upload_workers(num_upload_workers(storage_system, jukebox_options)),
+   m_upload_queue(2 * m_num_upload_workers),
+   m_metadata_queue(2 * m_num_upload_workers),
+   m_uploaders_running(0),
+   m_stages_running(0),
+   m_import_count(0),
+   m_upload_bytes(0),
+   m_upload_stage_time(0.0),
+   m_metadata_stage_time(0.0),
+   m_start_time(0.0),
+   m_elapsed_time(0.0) {
+
+   ContentHash::algorithm_from_name(m_jukebox_options.get_content_hash(),
+                                    m_content_hash_algorithm);
+}
+
+//*****************************************************************************
+
+SongImporter::~SongImporter() {
+   finish();
+}
+
+//*****************************************************************************
+
+void SongImporter::set_metadata_commit(const MetadataCommit& metadata_commit,
+                                       unsigned int batch_size) {
+   m_metadata_commit = metadata_commit;
+   m_metadata_batch_size = batch_size > 0 ? batch_size : 1;
+}
+
+//*****************************************************************************
+
+void SongImporter::set_progress_callback(const ProgressCallback& progress_callback) {
+   m_progress_callback = progress_callback;
+}
+
+//*****************************************************************************
+
+bool SongImporter::start_stage(Runnable* worker) {
+   m_workers.emplace_back(worker);
+   m_threads.emplace_back(new PthreadsThread(worker));
+   {
+      lock_guard<mutex> lock(m_mutex);
+      ++m_stages_running;
+   }
+   if (!m_threads.back()->start()) {
+      lock_guard<mutex> lock(m_mutex);
+      --m_stages_running;
+      return false;
+   }
+   return true;
+}
+
+//*****************************************************************************
+
+bool SongImporter::start() {
+   m_start_time = Utils::time_time();
+
+   // the metadata stage must be running before anything is uploaded,
+   // otherwise the upload workers would block once its queue fills
+   if (!start_stage(new ImportStageWorker(*this, false))) {
+      printf("error: unable to start import metadata thread\n");
+      return false;
+   }
+
+   for (unsigned int i = 0; i < m_num_upload_workers; ++i) {
+      {
+         lock_guard<mutex> lock(m_mutex);
+         ++m_uploaders_running;
+      }
+      if (!start_stage(new ImportStageWorker(*this, true))) {
+         printf("error: unable to start import upload thread\n");
+         stage_exiting(true);
+         break;
+      }
+   }
+
+   lock_guard<mutex> lock(m_mutex);
+   return m_uploaders_running > 0;
+}
+
+//*****************************************************************************
+
+bool SongImporter::add(const SongMetadata& song, const string& file_path) {
+   SongImportItem item;
+   item.song = song;
+   item.file_path = file_path;
+   return m_upload_queue.push(item);
+}
+
+//*****************************************************************************
+
+void SongImporter::finish() {
+   m_upload_queue.close();
+   {
+      unique_lock<mutex> lock(m_mutex);
+      m_cond_done.wait(lock, [this] { return m_stages_running == 0; });
+   }
+   m_threads.clear();
+   m_workers.clear();
+
+   // deleted only after the upload workers are gone so that storage
+   // systems without concurrent writes never see two requests at once
+   for (const auto& song : m_orphaned_songs) {
+      m_storage_system.delete_object(song.get_container_name(),
+                                     song.get_object_name());
+   }
+   m_orphaned_songs.clear();
+
+   if (m_start_time > 0.0) {
+      m_elapsed_time = Utils::time_time() - m_start_time;
+      m_start_time = 0.0;
+   }
+}
+
+//*****************************************************************************
+
+void SongImporter::stage_exiting(bool is_uploader) {
+   bool close_metadata_queue = false;
+   {
+      lock_guard<mutex> lock(m_mutex);
+      if (is_uploader) {
+         --m_uploaders_running;
+         close_metadata_queue = (m_uploaders_running == 0);
+      }
+   }
+
+   // the last uploader out lets the metadata stage drain and exit
+   if (close_metadata_queue) {
+      m_metadata_queue.close();
+   }
+}
+
+//*****************************************************************************
+
+void SongImporter::run_upload_stage() {
+   SongImportItem item;
+   while (m_upload_queue.pop(item)) {
+      const auto start = chrono::steady_clock::now();
+      item.uploaded = upload_song(item);
+      m_upload_stage_time += seconds_since(start);
+      m_metadata_queue.push(item);
+   }
+
+   stage_exiting(true);
+
+   lock_guard<mutex> lock(m_mutex);
+   --m_stages_running;
+   m_cond_done.notify_all();
+}
+
+//*****************************************************************************
+
+bool SongImporter::upload_song(SongImportItem& item) {
+   SongMetadata& fs_song = item.song;
+
+   // stream file contents to the storage system rather than reading the
+   // whole file into memory
+   FILE* f_song = fopen(item.file_path.c_str(), "rb");
+   if (f_song == nullptr) {
+      printf("error: unable to read file %s\n", item.file_path.c_str());
+      return false;
+   }
+
+   // hash the song as it's read for upload so the file is only read once
+   unique_ptr<ContentHash> song_hash =
+      ContentHash::create(m_content_hash_algorithm);
+   ObjectSource song_source =
+      ContentHash::hashing_source(*song_hash,
+                                  ObjectStream::file_source(f_song));
+
+   // for general purposes, it might be useful or helpful to have
+   // a minimum size for compressing
+   if (m_jukebox_options.get_use_compression()) {
+      if (m_jukebox_options.get_debug_mode()) {
+         printf("compressing file\n");
+      }
+
+      //FUTURE: compression (import_songs)
+      // wrap song_source with a streaming compressor
+   }
+
+   if (m_jukebox_options.get_use_encryption()) {
+      if (m_jukebox_options.get_debug_mode()) {
+         printf("encrypting file\n");
+      }
+
+      //FUTURE: encryption (import_songs)
+      // wrap song_source with a streaming cipher; the length of
+      // the data to encrypt must be a multiple of 16, so the final
+      // block gets padded and fs_song.set_pad_char_count updated
+   }
+
+   // count what's actually being stored so that the stored
+   // file size reflects any transformation of the contents
+   int64_t stored_bytes = 0;
+   ObjectSource counting_source =
+      [&](unsigned char* buffer, size_t max_bytes) -> int64_t {
+         int64_t bytes_read = song_source(buffer, max_bytes);
+         if (bytes_read > 0) {
+            stored_bytes += bytes_read;
+         }
+         return bytes_read;
+      };
+
+   bool song_stored =
+      m_storage_system.put_object_stream(fs_song.get_container_name(),
+                                         fs_song.get_object_name(),
+                                         counting_source,
+                                         nullptr);
+   fclose(f_song);
+
+   if (!song_stored) {
+      printf("error: unable to upload %s to %s\n",
+             fs_song.get_object_name().c_str(),
+             fs_song.get_container_name().c_str());
+      return false;
+   }
+
+   m_upload_bytes += stored_bytes;
+
+   // now that we know how much data was stored, set the file
+   // size for what's being stored
+   fs_song.set_stored_file_size(stored_bytes);
+   fs_song.set_md5_hash(song_hash->tagged_digest());
+
+   return true;
+}
+
+//*****************************************************************************
+
+void SongImporter::run_metadata_stage() {
+   SongImportItem item;
+   while (m_metadata_queue.pop(item)) {
+      const auto start = chrono::steady_clock::now();
+      bool imported = false;
+      if (item.uploaded) {
+         if (m_metadata_store(item.song)) {
+            imported = true;
+            ++m_import_count;
+            if (m_metadata_commit) {
+               m_uncommitted_songs.push_back(item.song);
+               if (m_uncommitted_songs.size() >= m_metadata_batch_size) {
+                  commit_metadata();
+               }
+            }
+         } else {
+            // we stored the song to the storage system, but were unable to store
+            // the metadata in the local database. we need to delete the song
+            // from the storage system since we won't have any way to access it
+            // since we can't store the song metadata locally.
+            printf("unable to store metadata, deleting obj %s\n",
+                   item.song.get_object_name().c_str());
+            lock_guard<mutex> lock(m_mutex);
+            m_orphaned_songs.push_back(item.song);
+         }
+      }
+
+      if (m_progress_callback) {
+         m_progress_callback(item.song, imported);
+      }
+      m_metadata_stage_time += seconds_since(start);
+   }
+
+   const auto start = chrono::steady_clock::now();
+   commit_metadata();
+   m_metadata_stage_time += seconds_since(start);
+
+   lock_guard<mutex> lock(m_mutex);
+   --m_stages_running;
+   m_cond_done.notify_all();
+}
+
+//*****************************************************************************
+
+void SongImporter::commit_metadata() {
+   if (!m_metadata_commit || m_uncommitted_songs.empty()) {
+      return;
+   }
+
+   if (!m_metadata_commit()) {
+      // the whole batch was lost, so none of its objects can be found
+      printf("unable to commit metadata, deleting %zu objects\n",
+             m_uncommitted_songs.size());
+      m_import_count -= (int) m_uncommitted_songs.size();
+      lock_guard<mutex> lock(m_mutex);
+      m_orphaned_songs.insert(m_orphaned_songs.end(),
+                              m_uncommitted_songs.begin(),
+                              m_uncommitted_songs.end());
+   }
+   m_uncommitted_songs.clear();
+}
+
+//*****************************************************************************
+
+unsigned int SongImporter::get_num_upload_workers() const {
+   return m_num_upload_workers;
+}
+
+//*****************************************************************************
+
+int SongImporter::get_import_count() const {
+   return m_import_count;
+}
+
+//*****************************************************************************
+
+int64_t SongImporter::get_upload_bytes() const {
+   return m_upload_bytes;
+}
+
+//*****************************************************************************
+
+double SongImporter::get_elapsed_time() const {
+   return m_elapsed_time;
+}
+
+//*****************************************************************************
+
+double SongImporter::get_upload_stage_time() const {
+   return m_upload_stage_time;
+}
+
+//*****************************************************************************
+
+double SongImporter::get_metadata_stage_time() const {
+   return m_metadata_stage_time;
+}
+
+//*****************************************************************************
+
@@ -0,0 +1,124 @@
+#ifndef SONG_IMPORTER_H
+#define SONG_IMPORTER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "content_hash.h"
+#include "jukebox_options.h"
+#include "song_metadata.h"
+#include "storage_system.h"
+#include "PthreadsThread.h"
+#include "Runnable.h"
+
+
+struct SongImportItem {
+   SongMetadata song;
+   std::string file_path;
+   bool uploaded;
+
+   SongImportItem() :
+      uploaded(false) {
+   }
+};
+
+
+// Imports song files as a pipeline of stages joined by bounded queues:
+//
+//   scan (caller) -> upload workers -> metadata
+//
+// The caller scans the import directory and add()s each song. Upload
+// workers read, hash, transform and upload songs concurrently, hashing
+// as the file streams out so it's only read once. A single metadata
+// stage stores each uploaded song through the MetadataStore since the
+// database connection isn't shared across threads. Storage systems that
+// can't take concurrent writes get one upload worker, which still
+// overlaps with the scan and metadata stages.
+//
+// With a MetadataCommit set, stored songs are committed in batches; if a
+// commit fails, every song in that batch is treated as not imported.
+class SongImporter {
+public:
+   typedef std::function<bool(const SongMetadata&)> MetadataStore;
+   typedef std::function<bool()> MetadataCommit;
+   typedef std::function<void(const SongMetadata&, bool)> ProgressCallback;
+
+private:
+   StorageSystem& m_storage_system;
+   JukeboxOptions m_jukebox_options;
+   MetadataStore m_metadata_store;
+   MetadataCommit m_metadata_commit;
+   unsigned int m_metadata_batch_size;
+   std::vector<SongMetadata> m_uncommitted_songs;
+   ProgressCallback m_progress_callback;
+   ContentHash::Algorithm m_content_hash_algorithm;
+   unsigned int m_num_upload_workers;
+   BoundedQueue<SongImportItem> m_upload_queue;
+   BoundedQueue<SongImportItem> m_metadata_queue;
+   std::vector<std::unique_ptr<chaudiere::Runnable>> m_workers;
+   std::vector<std::unique_ptr<chaudiere::PthreadsThread>> m_threads;
+   std::mutex m_mutex;
+   std::condition_variable m_cond_done;
+   unsigned int m_uploaders_running;
+   unsigned int m_stages_running;
+   std::vector<SongMetadata> m_orphaned_songs;
+   std::atomic<int> m_import_count;
+   std::atomic<int64_t> m_upload_bytes;
+   // time spent working (not waiting on queues), summed over a stage's workers
+   std::atomic<double> m_upload_stage_time;
+   std::atomic<double> m_metadata_stage_time;
+   double m_start_time;
+   double m_elapsed_time;
+
+   SongImporter();
+   SongImporter(const SongImporter&);
+   SongImporter& operator=(const SongImporter&);
+
+   bool start_stage(chaudiere::Runnable* worker);
+   void stage_exiting(bool is_uploader);
+   bool upload_song(SongImportItem& item);
+   void commit_metadata();
+
+public:
+   SongImporter(StorageSystem& storage_system,
+                const JukeboxOptions& jukebox_options,
+                const MetadataStore& metadata_store);
+   ~SongImporter();
+
+   // invoked from the metadata stage after every batch_size songs stored
+   // and once more when the last song has been stored
+   void set_metadata_commit(const MetadataCommit& metadata_commit,
+                            unsigned int batch_size);
+
+   // invoked from the metadata stage once per song added
+   void set_progress_callback(const ProgressCallback& progress_callback);
+
+   bool start();
+
+   // blocks while the upload queue is full
+   bool add(const SongMetadata& song, const std::string& file_path);
+
+   // waits for every song added to pass through all stages
+   void finish();
+
+   unsigned int get_num_upload_workers() const;
+   int get_import_count() const;
+   int64_t get_upload_bytes() const;
+   double get_elapsed_time() const;
+   double get_upload_stage_time() const;
+   double get_metadata_stage_time() const;
+
+   // called by stage workers
+   void run_upload_stage();
+   void run_metadata_stage();
+};
+
+#endif
+
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <sqlite3.h>
+
+#include "sqlite_statement.h"
+
+using namespace std;
+
+//*****************************************************************************
+
+unique_ptr<SQLiteStatement> SQLiteStatement::prepare(sqlite3* db,
+                                                     const string& sql) {
+   sqlite3_stmt* stmt = nullptr;
+   int rc = sqlite3_prepare_v3(db,
+                               sql.c_str(),
+                               (int) sql.length() + 1,
+                               SQLITE_PREPARE_PERSISTENT,
+                               &stmt,
+                               nullptr);
+   if (rc != SQLITE_OK) {
+      printf("SQL error: %s\n", sqlite3_errmsg(db));
+      sqlite3_finalize(stmt);
+      return unique_ptr<SQLiteStatement>();
+   }
+
+   return unique_ptr<SQLiteStatement>(new SQLiteStatement(db, stmt));
+}
+
+//*****************************************************************************
+
+SQLiteStatement::SQLiteStatement(sqlite3* db, sqlite3_stmt* stmt) :
+   m_db(db),
+   m_stmt(stmt) {
+}
+
+//*****************************************************************************
+
+SQLiteStatement::~SQLiteStatement() {
+   sqlite3_finalize(m_stmt);
+}
+
+//*****************************************************************************
+
+void SQLiteStatement::reset() {
+   sqlite3_reset(m_stmt);
+   sqlite3_clear_bindings(m_stmt);
+}
+
+//*****************************************************************************
+
+bool SQLiteStatement::bind_text(int index, const string& value) {
+   return sqlite3_bind_text(m_stmt,
+                            index,
+                            value.c_str(),
+                            (int) value.length(),
+                            SQLITE_TRANSIENT) == SQLITE_OK;
+}
+
+//*****************************************************************************
+
+bool SQLiteStatement::bind_int(int index, int value) {
+   return sqlite3_bind_int(m_stmt, index, value) == SQLITE_OK;
+}
+
+//*****************************************************************************
+
+bool SQLiteStatement::bind_int64(int index, int64_t value) {
+   return sqlite3_bind_int64(m_stmt, index, value) == SQLITE_OK;
+}
+
+//*****************************************************************************
+
+bool SQLiteStatement::bind_null(int index) {
+   return sqlite3_bind_null(m_stmt, index) == SQLITE_OK;
+}
+
+//*****************************************************************************
+
+bool SQLiteStatement::next() {
+   int rc = sqlite3_step(m_stmt);
+   if (rc == SQLITE_ROW) {
+      return true;
+   }
+
+   if (rc != SQLITE_DONE) {
+      printf("SQL error: %s\n", sqlite3_errmsg(m_db));
+   }
+
+   // release any locks held by the statement
+   sqlite3_reset(m_stmt);
+   return false;
+}
+
+//*****************************************************************************
+
+bool SQLiteStatement::execute() {
+   int rc = sqlite3_step(m_stmt);
+   if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+      printf("SQL error: %s\n", sqlite3_errmsg(m_db));
+   }
+   sqlite3_reset(m_stmt);
+   return rc == SQLITE_DONE || rc == SQLITE_ROW;
+}
+
+//*****************************************************************************
+
+bool SQLiteStatement::column_text(int index, string& value) {
+   const unsigned char* text = sqlite3_column_text(m_stmt, index);
+   if (text == nullptr) {
+      return false;
+   }
+   value.assign((const char*) text, sqlite3_column_bytes(m_stmt, index));
+   return true;
+}
+
+//*****************************************************************************
+
+int SQLiteStatement::column_int(int index) {
+   return sqlite3_column_int(m_stmt, index);
+}
+
+//*****************************************************************************
+
+int64_t SQLiteStatement::column_int64(int index) {
+   return sqlite3_column_int64(m_stmt, index);
+}
+
+//*****************************************************************************
+
@@ -0,0 +1,52 @@
+#ifndef SQLITE_STATEMENT_H
+#define SQLITE_STATEMENT_H
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+
+// Owns one prepared SQLite statement so that it can be kept and reused
+// across calls. Parameters are bound in place (1-based, as in SQLite) and
+// columns are read directly from the current row (0-based).
+class SQLiteStatement {
+private:
+   sqlite3* m_db;
+   sqlite3_stmt* m_stmt;
+
+   SQLiteStatement();
+   SQLiteStatement(const SQLiteStatement&);
+   SQLiteStatement& operator=(const SQLiteStatement&);
+
+   SQLiteStatement(sqlite3* db, sqlite3_stmt* stmt);
+
+public:
+   // returns nullptr (and reports the error) if sql doesn't compile
+   static std::unique_ptr<SQLiteStatement> prepare(sqlite3* db,
+                                                   const std::string& sql);
+   ~SQLiteStatement();
+
+   // readies the statement for another use and clears its bindings
+   void reset();
+
+   bool bind_text(int index, const std::string& value);
+   bool bind_int(int index, int value);
+   bool bind_int64(int index, int64_t value);
+   bool bind_null(int index);
+
+   // advances to the next row; false once there are no more rows
+   bool next();
+
+   // runs a statement that doesn't return rows
+   bool execute();
+
+   bool column_text(int index, std::string& value);
+   int column_int(int index);
+   int64_t column_int64(int index);
+};
+
+#endif
+
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "stats_registry.h"
+#include "utils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+//*****************************************************************************
+
+static string format_value(double value) {
+   char buffer[64];
+   snprintf(buffer, sizeof(buffer), "%.15g", value);
+   return buffer;
+}
+
+//*****************************************************************************
+
+static string escape_help(const string& help) {
+   string escaped;
+   for (char ch : help) {
+      if (ch == '\\') {
+         escaped += "\\\\";
+      } else if (ch == '\n') {
+         escaped += "\\n";
+      } else {
+         escaped += ch;
+      }
+   }
+   return escaped;
+}
+
+//*****************************************************************************
+
+StatsRegistry::StatsRegistry() {
+}
+
+//*****************************************************************************
+
+StatsRegistry::Metric* StatsRegistry::find_metric(const string& name) {
+   auto it = m_metric_index.find(name);
+   if (it == m_metric_index.end()) {
+      return nullptr;
+   }
+   return &m_metrics[it->second];
+}
+
+//*****************************************************************************
+
+void StatsRegistry::define(const string& name,
+                           MetricType type,
+                           const string& help) {
+   std::lock_guard<std::mutex> lock(m_mutex);
+   Metric* metric = find_metric(name);
+   if (metric != nullptr) {
+      metric->type = type;
+      metric->help = help;
+      return;
+   }
+
+   Metric new_metric;
+   new_metric.name = name;
+   new_metric.help = help;
+   new_metric.type = type;
+   new_metric.value = 0.0;
+   m_metric_index[name] = m_metrics.size();
+   m_metrics.push_back(new_metric);
+}
+
+//*****************************************************************************
+
+void StatsRegistry::add(const string& name, double amount) {
+   std::lock_guard<std::mutex> lock(m_mutex);
+   Metric* metric = find_metric(name);
+   if (metric != nullptr) {
+      metric->value += amount;
+   }
+}
+
+//*****************************************************************************
+
+void StatsRegistry::set(const string& name, double value) {
+   std::lock_guard<std::mutex> lock(m_mutex);
+   Metric* metric = find_metric(name);
+   if (metric != nullptr) {
+      metric->value = value;
+   }
+}
+
+//*****************************************************************************
+
+double StatsRegistry::get(const string& name) const {
+   std::lock_guard<std::mutex> lock(m_mutex);
+   auto it = m_metric_index.find(name);
+   if (it == m_metric_index.end()) {
+      return 0.0;
+   }
+   return m_metrics[it->second].value;
+}
+
+//*****************************************************************************
+
+string StatsRegistry::to_prometheus() const {
+   std::lock_guard<std::mutex> lock(m_mutex);
+   string text;
+   for (const auto& metric : m_metrics) {
+      text += "# HELP " + metric.name + " " + escape_help(metric.help) + "\n";
+      text += "# TYPE " + metric.name + " ";
+      text += (metric.type == COUNTER) ? "counter\n" : "gauge\n";
+      text += metric.name + " " + format_value(metric.value) + "\n";
+   }
+   return text;
+}
+
+//*****************************************************************************
+
+string StatsRegistry::to_json() const {
+   std::lock_guard<std::mutex> lock(m_mutex);
+   // metric names are [a-zA-Z0-9_:], so they need no escaping
+   string json = "{\n  \"timestamp\": " + format_value((double) ::time(nullptr));
+   for (const auto& metric : m_metrics) {
+      json += ",\n  \"" + metric.name + "\": " + format_value(metric.value);
+   }
+   json += "\n}\n";
+   return json;
+}
+
+//*****************************************************************************
+
+bool StatsRegistry::write_atomically(const string& file_path,
+                                     const string& contents) {
+   // same directory, so the rename can't cross filesystems, and a suffix
+   // that the textfile collector's *.prom pattern won't pick up
+   string tmp_file_path = file_path + ".tmp." + to_string(getpid());
+   if (!Utils::file_write_all_text(tmp_file_path, contents)) {
+      printf("error: unable to write stats file %s\n", tmp_file_path.c_str());
+      Utils::file_delete(tmp_file_path);
+      return false;
+   }
+   if (!Utils::rename_file(tmp_file_path, file_path)) {
+      printf("error: unable to rename stats file to %s\n", file_path.c_str());
+      Utils::file_delete(tmp_file_path);
+      return false;
+   }
+   return true;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+
+StatsExporter::StatsExporter(const StatsRegistry& registry,
+                             const string& prometheus_file,
+                             const string& json_file,
+                             double interval_secs) :
+   m_registry(registry),
+   m_prometheus_file(prometheus_file),
+   m_json_file(json_file),
+   m_interval_secs(interval_secs > 0.0 ? interval_secs : 15.0),
+   m_running(false),
+   m_stop_requested(false) {
+}
+
+//*****************************************************************************
+
+StatsExporter::~StatsExporter() {
+   stop();
+}
+
+//*****************************************************************************
+
+bool StatsExporter::start() {
+   if (m_thread) {
+      return true;
+   }
+
+   m_running = true;
+   m_stop_requested = false;
+   m_thread.reset(new PthreadsThread(this));
+   if (!m_thread->start()) {
+      printf("error: unable to start stats exporter thread\n");
+      m_running = false;
+      m_thread.reset();
+      return false;
+   }
+   return true;
+}
+
+//*****************************************************************************
+
+void StatsExporter::stop() {
+   if (!m_thread) {
+      return;
+   }
+
+   {
+      unique_lock<mutex> lock(m_mutex);
+      m_stop_requested = true;
+      m_cond_wake.notify_all();
+      m_cond_stopped.wait(lock, [this] { return !m_running; });
+   }
+   m_thread.reset();
+
+   // the final values
+   write_files();
+}
+
+//*****************************************************************************
+
+bool StatsExporter::write_files() {
+   bool success = true;
+   if (!m_prometheus_file.empty()) {
+      success = StatsRegistry::write_atomically(m_prometheus_file,
+                                                m_registry.to_prometheus());
+   }
+   if (!m_json_file.empty()) {
+      success = StatsRegistry::write_atomically(m_json_file,
+                                                m_registry.to_json()) && success;
+   }
+   return success;
+}
+
+//*****************************************************************************
+
+void StatsExporter::run() {
+   unique_lock<mutex> lock(m_mutex);
+   while (!m_stop_requested) {
+      lock.unlock();
+      write_files();
+      lock.lock();
+      m_cond_wake.wait_for(lock,
+                           chrono::duration<double>(m_interval_secs),
+                           [this] { return m_stop_requested; });
+   }
+   m_running = false;
+   m_cond_stopped.notify_all();
+}
+
+//*****************************************************************************
+
@@ -0,0 +1,103 @@
+#ifndef STATS_REGISTRY_H
+#define STATS_REGISTRY_H
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Runnable.h"
+#include "PthreadsThread.h"
+
+
+// Named counters and gauges describing a running jukebox. Values are
+// pushed by whatever owns them (download workers, the play loop, the
+// importer), so taking a snapshot never has to reach into other threads'
+// state. Metrics are reported in the order they were defined.
+class StatsRegistry {
+public:
+   enum MetricType {
+      COUNTER,
+      GAUGE
+   };
+
+private:
+   struct Metric {
+      std::string name;
+      std::string help;
+      MetricType type;
+      double value;
+   };
+
+   mutable std::mutex m_mutex;
+   std::vector<Metric> m_metrics;
+   std::map<std::string, size_t> m_metric_index;
+
+   StatsRegistry(const StatsRegistry&);
+   StatsRegistry& operator=(const StatsRegistry&);
+
+   // m_mutex must be held; nullptr if name hasn't been defined
+   Metric* find_metric(const std::string& name);
+
+public:
+   StatsRegistry();
+
+   // redefining a metric keeps its value
+   void define(const std::string& name, MetricType type, const std::string& help);
+
+   // adding to or setting an undefined metric does nothing
+   void add(const std::string& name, double amount=1.0);
+   void set(const std::string& name, double value);
+   double get(const std::string& name) const;
+
+   // Prometheus text exposition format (as read by node_exporter's
+   // textfile collector)
+   std::string to_prometheus() const;
+   // one JSON object of name: value, with the time it was taken
+   std::string to_json() const;
+
+   // Writes the snapshot to a temporary file beside file_path and renames
+   // it into place, so readers never see a partly written file.
+   static bool write_atomically(const std::string& file_path,
+                                const std::string& contents);
+};
+
+
+// Writes a StatsRegistry to a Prometheus textfile and/or a JSON file every
+// interval seconds on its own thread, and once more when stopped.
+class StatsExporter : public chaudiere::Runnable {
+private:
+   const StatsRegistry& m_registry;
+   std::string m_prometheus_file;
+   std::string m_json_file;
+   double m_interval_secs;
+   std::unique_ptr<chaudiere::PthreadsThread> m_thread;
+   std::mutex m_mutex;
+   std::condition_variable m_cond_wake;
+   std::condition_variable m_cond_stopped;
+   bool m_running;
+   bool m_stop_requested;
+
+   StatsExporter();
+   StatsExporter(const StatsExporter&);
+   StatsExporter& operator=(const StatsExporter&);
+
+public:
+   // either file path may be empty to skip that format
+   StatsExporter(const StatsRegistry& registry,
+                 const std::string& prometheus_file,
+                 const std::string& json_file,
+                 double interval_secs);
+   virtual ~StatsExporter();
+
+   bool start();
+   void stop();
+   bool write_files();
+
+   virtual void run();
+};
+
+#endif
+
@@ -1,7 +1,13 @@
 #ifndef STORAGE_SYSTEM_H
 #define STORAGE_SYSTEM_H
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "file_metadata.h"
@@ -9,6 +15,7 @@
 #include "OSUtils.h"
 #include "data_types.h"
 #include "property_set.h"
+#include "object_stream.h"
 
 
 class StorageSystem {
@@ -17,17 +24,52 @@ private:
    bool m_authenticated;
    bool m_compress_files;
    bool m_encrypt_files;
-   std::vector<std::string> m_list_containers;
+   // Container registry, loaded from list_account_containers on first use
+   // and again once it's older than m_container_list_ttl seconds (if set).
+   // Import and download workers consult it concurrently.
+   std::unordered_set<std::string> m_containers;
+   bool m_containers_listed;
+   std::chrono::steady_clock::time_point m_containers_listed_time;
+   double m_container_list_ttl;
+   std::mutex m_containers_mutex;
+   std::condition_variable m_containers_cond;
+   // set while one thread lists the containers (without the mutex held);
+   // adds (true) and removes (false) made meanwhile are replayed onto the
+   // new list, and an invalidate marks it stale
+   bool m_containers_listing;
+   bool m_containers_invalidated;
+   std::vector<std::pair<std::string, bool>> m_container_changes;
    std::string m_container_prefix;
    std::string m_metadata_prefix;
    std::string m_storage_system_type;
 
+   // m_containers_mutex must be held for these
+   bool container_list_expired() const {
+      if (m_container_list_ttl <= 0.0) {
+         return false;
+      }
+      const std::chrono::duration<double> age =
+         std::chrono::steady_clock::now() - m_containers_listed_time;
+      return age.count() >= m_container_list_ttl;
+   }
+
+   void store_containers(const std::vector<std::string>& list_containers) {
+      m_containers.clear();
+      m_containers.insert(list_containers.begin(), list_containers.end());
+      m_containers_listed = true;
+      m_containers_listed_time = std::chrono::steady_clock::now();
+   }
+
 public:
    StorageSystem(const std::string& system_type, bool debug=false) :
       m_debug_mode(debug),
       m_authenticated(false),
       m_compress_files(false),
       m_encrypt_files(false),
+      m_containers_listed(false),
+      m_container_list_ttl(0.0),
+      m_containers_listing(false),
+      m_containers_invalidated(false),
       m_storage_system_type(system_type) {
    }
 
@@ -38,13 +80,24 @@ public:
    }
 
    void set_list_containers(const std::vector<std::string>& list_containers) {
-      m_list_containers = list_containers;
+      std::lock_guard<std::mutex> lock(m_containers_mutex);
+      store_containers(list_containers);
+   }
+
+   // 0 (the default) keeps the container list until the process exits
+   void set_container_list_ttl(double seconds) {
+      std::lock_guard<std::mutex> lock(m_containers_mutex);
+      m_container_list_ttl = seconds;
    }
 
    bool debug_mode() const {
       return m_debug_mode;
    }
 
+   const std::string& get_storage_system_type() const {
+      return m_storage_system_type;
+   }
+
    std::string un_prefixed_container(const std::string& container_name) {
       if (!m_container_prefix.empty() && !container_name.empty()) {
          // does the container name begin with the prefix?
@@ -61,29 +114,83 @@ public:
       return m_container_prefix + container_name;
    }
 
-   bool has_container(const std::string& container_name) const {
-      bool container_found = false;
-      for (const auto& cName : m_list_containers) {
-         if (cName == container_name) {
-            container_found = true;
-            break;
+   // The account's containers are listed the first time they're asked
+   // about rather than on enter, since most commands never ask. The
+   // listing is a request to the storage system, so it runs without the
+   // registry locked. Only one thread lists at a time: the others answer
+   // from the list they have, even an expired one, or wait for the
+   // listing if there's none yet. An empty listing is what a failed one
+   // looks like, so it isn't kept: the next call lists again, and a list
+   // that had expired stays in use until a listing succeeds.
+   bool has_container(const std::string& container_name) {
+      std::unique_lock<std::mutex> lock(m_containers_mutex);
+      m_containers_cond.wait(lock, [this] {
+         return !m_containers_listing || m_containers_listed;
+      });
+
+      if (!m_containers_listing &&
+          (!m_containers_listed || container_list_expired())) {
+         m_containers_listing = true;
+         m_containers_invalidated = false;
+         m_container_changes.clear();
+         lock.unlock();
+
+         std::vector<std::string> list_containers;
+         try {
+            list_containers = list_account_containers();
+         } catch (...) {
+            lock.lock();
+            m_containers_listing = false;
+            m_containers_cond.notify_all();
+            throw;
          }
+
+         lock.lock();
+         m_containers_listing = false;
+         if (!list_containers.empty()) {
+            store_containers(list_containers);
+            for (const auto& change : m_container_changes) {
+               if (change.second) {
+                  m_containers.insert(change.first);
+               } else {
+                  m_containers.erase(change.first);
+               }
+            }
+            if (m_containers_invalidated) {
+               m_containers_listed = false;
+            }
+         }
+         m_container_changes.clear();
+         m_containers_cond.notify_all();
       }
-      return container_found;
+
+      return m_containers.count(container_name) > 0;
    }
 
+   // reloads the container list on the next has_container
+   void invalidate_containers() {
+      std::lock_guard<std::mutex> lock(m_containers_mutex);
+      m_containers_listed = false;
+      m_containers_invalidated = true;
+   }
+
+   // add/remove keep an already loaded list current; one that hasn't been
+   // loaded yet will pick up the change when it is
    void add_container(const std::string& container_name) {
-      m_list_containers.push_back(container_name);
+      std::lock_guard<std::mutex> lock(m_containers_mutex);
+      if (m_containers_listed) {
+         m_containers.insert(container_name);
+      }
+      if (m_containers_listing) {
+         m_container_changes.push_back(std::make_pair(container_name, true));
+      }
    }
 
    void remove_container(const std::string& container_name) {
-      auto it = m_list_containers.begin();
-      const auto it_end = m_list_containers.end();
-      for (; it != it_end; it++) {
-         if (*it == container_name) {
-            m_list_containers.erase(it);
-            break;
-         }
+      std::lock_guard<std::mutex> lock(m_containers_mutex);
+      m_containers.erase(container_name);
+      if (m_containers_listing) {
+         m_container_changes.push_back(std::make_pair(container_name, false));
       }
    }
 
@@ -117,10 +224,11 @@ public:
           !object_name.empty() &&
           !file_path.empty()) {
 
-         std::vector<unsigned char> file_contents;
-         bool success = Utils::file_read_all_bytes(file_path, file_contents);
-         if (success && !file_contents.empty()) {
-            return put_object(container_name, object_name, file_contents, nullptr);
+         if (Utils::file_exists(file_path)) {
+            return put_object_from_file(container_name,
+                                        object_name,
+                                        file_path,
+                                        nullptr);
          } else {
             printf("error: unable to read file %s\n", file_path.c_str());
             return false;
@@ -134,25 +242,116 @@ public:
                            const std::string& object_name,
                            const std::string& file_path,
                            const PropertySet* headers=nullptr) {
-      bool file_read = false;
-      bool put_success = false;
-      std::vector<unsigned char> file_contents;
-
-      if (Utils::file_read_all_bytes(file_path, file_contents)) {
-         file_read = true;
-      } else {
+      if (!Utils::file_exists(file_path)) {
          printf("error: unable to read file %s\n", file_path.c_str());
+         return false;
       }
-
-      if (file_read) {
-         put_success = put_object(container_name,
+      return put_object_from_file(container_name,
                                   object_name,
-                                  file_contents,
+                                  file_path,
                                   headers);
+   }
+
+   // Streaming variants of put_object/get_object. The defaults spool the
+   // data through a temporary file so that any storage system that can
+   // move files can stream; implementations that can do better override.
+   virtual bool put_object_stream(const std::string& container_name,
+                                  const std::string& object_name,
+                                  const ObjectSource& source,
+                                  const PropertySet* headers=nullptr) {
+      std::string tmp_file = ObjectStream::temp_file_path("jb_put_");
+      if (tmp_file.empty()) {
+         return false;
       }
+
+      bool put_success = false;
+      if (ObjectStream::source_to_file(source, tmp_file) >= 0) {
+         put_success = put_object_from_file(container_name,
+                                            object_name,
+                                            tmp_file,
+                                            headers);
+      }
+      Utils::file_delete(tmp_file);
       return put_success;
    }
 
+   // returns number of bytes delivered to sink (0 on failure)
+   virtual int64_t get_object_stream(const std::string& container_name,
+                                     const std::string& object_name,
+                                     const ObjectSink& sink) {
+      std::string tmp_file = ObjectStream::temp_file_path("jb_get_");
+      if (tmp_file.empty()) {
+         return 0;
+      }
+
+      int64_t bytes_retrieved = 0;
+      if (get_object(container_name, object_name, tmp_file) > 0) {
+         bytes_retrieved = ObjectStream::file_to_sink(tmp_file, sink);
+         if (bytes_retrieved < 0) {
+            bytes_retrieved = 0;
+         }
+      }
+      Utils::file_delete(tmp_file);
+      return bytes_retrieved;
+   }
+
+   // Delivers bytes [offset, offset+length) of an object to sink; a length
+   // of zero or less reads through the end of the object. Returns the number
+   // of bytes delivered. The default reads the whole object and discards
+   // what falls outside of the range.
+   virtual int64_t get_object_range(const std::string& container_name,
+                                    const std::string& object_name,
+                                    int64_t offset,
+                                    int64_t length,
+                                    const ObjectSink& sink) {
+      int64_t position = 0;
+      int64_t bytes_delivered = 0;
+      bool sink_failed = false;
+
+      ObjectSink range_sink = [&](const unsigned char* data, size_t num_bytes) -> bool {
+         size_t start = 0;
+         if (position < offset) {
+            start = (size_t) std::min((int64_t) num_bytes, offset - position);
+         }
+         position += num_bytes;
+
+         int64_t available = num_bytes - start;
+         if (length > 0) {
+            available = std::min(available, length - bytes_delivered);
+         }
+         if (available > 0) {
+            if (!sink(data + start, available)) {
+               sink_failed = true;
+               return false;
+            }
+            bytes_delivered += available;
+         }
+
+         // stop the transfer once the range has been satisfied
+         return length <= 0 || bytes_delivered < length;
+      };
+
+      get_object_stream(container_name, object_name, range_sink);
+      return sink_failed ? 0 : bytes_delivered;
+   }
+
+   // true if get_object, get_object_stream and get_object_range may be
+   // called from several threads at once
+   virtual bool supports_concurrent_reads() const {
+      return false;
+   }
+
+   // true if put_object, put_object_from_file, put_object_stream and
+   // delete_object may be called from several threads at once
+   virtual bool supports_concurrent_writes() const {
+      return false;
+   }
+
+   // prints whatever request statistics the storage system keeps (see
+   // MeteredStorageSystem); wrappers pass it on to what they wrap
+   virtual void show_stats() const {
+   }
+
    virtual std::vector<std::string> list_account_containers() = 0;
 
    virtual bool create_container(const std::string& container_name) = 0;
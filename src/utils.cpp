@@ -3,7 +3,9 @@
 #include <string.h>
 #include <signal.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <algorithm>
 #include <memory>
 #include <time.h>
 #include <sys/select.h>
@@ -11,8 +13,14 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
 
 #include "utils.h"
+#include "content_hash.h"
 #include "DateTime.h"
 #include "StrUtils.h"
 #include "IniReader.h"
@@ -28,20 +36,10 @@ using namespace chaudiere;
 
 #define NS_PER_SEC 1000000000.0
 
-static bool finished_reading_child_fds = false;
 static const string EMPTY = "";
 
 //*****************************************************************************
 
-void sig_child_handler(int signo) {
-   if (signo == SIGCHLD) {
-      finished_reading_child_fds = true;
-      wait(nullptr);
-   }
-}
-
-//*****************************************************************************
-
 string Utils::datetime_datetime_fromtimestamp(double ts) {
    // python datetime.datetime.fromtimestamp
 
@@ -451,89 +449,13 @@ bool Utils::file_write_all_bytes(const string& file_path,
 
 //*****************************************************************************
 
-string Utils::md5_for_file(const string& ini_file_name,
-                           const string& path_to_file) {
-   if (!file_exists(ini_file_name)) {
-      printf("error (md5_for_file): ini file does not exist '%s'\n", ini_file_name.c_str());
-      return EMPTY;
-   }
-
+string Utils::md5_for_file(const string& path_to_file) {
    if (!file_exists(path_to_file)) {
       printf("error (md5_for_file): file does not exist '%s'\n", path_to_file.c_str());
       return EMPTY;
    }
 
-   KeyValuePairs kvp;
-   if (get_platform_config_values(ini_file_name, kvp)) {
-      string key_exe = "md5_exe_file_name";
-      string key_field_number = "md5_hash_output_field";
-      if (kvp.hasKey(key_exe)) {
-         string md5_exe = kvp.getValue(key_exe);
-         if (!file_exists(md5_exe)) {
-            printf("error: md5 executable not found: '%s'\n", md5_exe.c_str());
-            return EMPTY;
-         }
-
-         vector<string> program_args;
-         program_args.push_back(path_to_file);
-         int exit_code = 0;
-         string std_out;
-         string std_err;
-
-         if (execute_program(md5_exe,
-                             program_args,
-                             exit_code,
-                             std_out,
-                             std_err)) {
-            if (exit_code == 0) {
-               if (!std_out.empty()) {
-                  int field_number = 1;
-                  if (kvp.hasKey(key_field_number)) {
-                     string field_number_text = kvp.getValue(key_field_number);
-                     if (!field_number_text.empty()) {
-                        try {
-                           field_number = StrUtils::parseInt(field_number_text);
-                        } catch (const exception& e) {
-                           printf("error: unable to convert value '%s' for '%s' to integer\n",
-                                  field_number_text.c_str(),
-                                  key_field_number.c_str());
-                           printf("will attempt to use first field\n");
-                        }
-                     }
-                  }
-                  vector<string> file_lines = StrUtils::split(std_out, "\n");
-                  if (!file_lines.empty()) {
-                     string first_line = file_lines[0];
-                     vector<string> line_fields = StrUtils::split(first_line, " ");
-                     if (!line_fields.empty()) {
-                        return line_fields[field_number-1];
-                     } else {
-                        if (!first_line.empty()) {
-                           return first_line;
-                        } else {
-                           printf("error: md5_for_file - first stdout line is empty\n");
-                        }
-                     }
-                  } else {
-                     printf("error: md5_for_file - stdout split by lines is empty\n");
-                  }
-               } else {
-                  printf("error: md5_for_file - no content for stdout captured\n");
-               }
-            } else {
-               printf("error: md5_for_file - non-zero exit code for md5 utility. value=%d\n", exit_code);
-            }
-         } else {
-            printf("error: md5_for_file - unable to execute md5 sum utility '%s'\n", md5_exe.c_str());
-         }
-      } else {
-         printf("error: md5_for_file - no value present for '%s'\n", key_exe.c_str());
-      }
-   } else {
-      printf("error: md5_for_file - unable to retrieve platform config values\n");
-   }
-
-   return EMPTY;
+   return ContentHash::hash_file(path_to_file, ContentHash::MD5);
 }
 
 //*****************************************************************************
@@ -558,66 +480,119 @@ bool Utils::file_delete(const string& file_path) {
 
 //*****************************************************************************
 
-bool Utils::file_copy(const string& from_file, const string& to_file) {
-   if (!file_exists(from_file)) {
-      return false;
-   }
+// Copies length bytes from src_fd to dst_fd (at their current offsets),
+// keeping the data out of userspace where the kernel allows: a reflink
+// shares the source's blocks without copying them at all, and
+// copy_file_range (which NFS can turn into a server-side copy) or
+// sendfile copy within the kernel. Each falls through to the next when
+// the file system doesn't support it, ending with a buffered copy.
+static bool copy_file_contents(int src_fd, int dst_fd, int64_t length) {
+   int64_t bytes_copied = 0;
 
-   long file_size = get_file_size(from_file);
-
-   FILE* f_source = fopen(from_file.c_str(), "r");
-   if (f_source == nullptr) {
-      return false;
+#ifdef __linux__
+#ifdef FICLONE
+   if (length > 0 && ioctl(dst_fd, FICLONE, src_fd) == 0) {
+      return true;
    }
+#endif
 
-   FILE* f_dest = fopen(to_file.c_str(), "w");
-   if (f_dest == nullptr) {
-      fclose(f_source);
-      return false;
+   while (bytes_copied < length) {
+      ssize_t rc = copy_file_range(src_fd,
+                                   nullptr,
+                                   dst_fd,
+                                   nullptr,
+                                   (size_t) (length - bytes_copied),
+                                   0);
+      if (rc < 0 && errno == EINTR) {
+         continue;
+      }
+      if (rc <= 0) {
+         break;
+      }
+      bytes_copied += rc;
    }
 
-   long bytes_remaining = file_size;
-   size_t bytes_to_copy = 4096;
-   size_t bytes_transferred;
-   unsigned char byte_buffer[4096];
+   while (bytes_copied < length) {
+      ssize_t rc = sendfile(dst_fd,
+                            src_fd,
+                            nullptr,
+                            (size_t) (length - bytes_copied));
+      if (rc < 0 && errno == EINTR) {
+         continue;
+      }
+      if (rc <= 0) {
+         break;
+      }
+      bytes_copied += rc;
+   }
+#endif
 
-   while (bytes_remaining > 0) {
-      if (bytes_remaining < 4096) {
-         bytes_to_copy = bytes_remaining;
+   unsigned char buffer[64 * 1024];
+   while (bytes_copied < length) {
+      size_t bytes_to_read = (size_t) std::min((int64_t) sizeof(buffer),
+                                               length - bytes_copied);
+      ssize_t bytes_read = read(src_fd, buffer, bytes_to_read);
+      if (bytes_read < 0 && errno == EINTR) {
+         continue;
       }
-      bytes_transferred = fread(byte_buffer,
-                                1,
-                                bytes_to_copy,
-                                f_source);
-      if (bytes_transferred < bytes_to_copy) {
-         fclose(f_source);
-         fclose(f_dest);
-         file_delete(to_file);
+      if (bytes_read <= 0) {
          return false;
-      } else {
-         bytes_transferred = fwrite(byte_buffer,
-                                    1,
-                                    bytes_to_copy,
-                                    f_dest);
-         if (bytes_transferred < bytes_to_copy) {
-            fclose(f_source);
-            fclose(f_dest);
-            file_delete(to_file);
+      }
+
+      ssize_t bytes_written = 0;
+      while (bytes_written < bytes_read) {
+         ssize_t rc = write(dst_fd,
+                            buffer + bytes_written,
+                            bytes_read - bytes_written);
+         if (rc < 0 && errno == EINTR) {
+            continue;
+         }
+         if (rc <= 0) {
             return false;
-         } else {
-            bytes_remaining -= bytes_to_copy;
          }
+         bytes_written += rc;
       }
+      bytes_copied += bytes_read;
    }
 
-   fclose(f_source);
-   fclose(f_dest);
-
    return true;
 }
 
 //*****************************************************************************
 
+bool Utils::file_copy(const string& from_file, const string& to_file) {
+   int src_fd = open(from_file.c_str(), O_RDONLY);
+   if (src_fd < 0) {
+      return false;
+   }
+
+   struct stat s;
+   if (fstat(src_fd, &s) != 0 || !S_ISREG(s.st_mode)) {
+      close(src_fd);
+      return false;
+   }
+
+   int dst_fd = open(to_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if (dst_fd < 0) {
+      close(src_fd);
+      return false;
+   }
+
+   bool copied = copy_file_contents(src_fd, dst_fd, s.st_size);
+   close(src_fd);
+   if (close(dst_fd) != 0) {
+      copied = false;
+   }
+
+   if (!copied) {
+      file_delete(to_file);
+   }
+
+   return copied;
+}
+
+//*****************************************************************************
+
 bool Utils::file_set_permissions(const string& file_path,
                                  int user_perms,
                                  int group_perms,
@@ -763,51 +738,65 @@ bool Utils::execute_program(const string& program_path,
 
       fd_set read_fds;
 
-      signal(SIGCHLD, sig_child_handler);
+      // read until the child closes both pipes (EOF) rather than waiting
+      // for SIGCHLD. a process-wide signal flag can't tell one child from
+      // another, so it breaks as soon as two threads run programs at once.
+      bool stdout_open = true;
+      bool stderr_open = true;
 
-      do {
+      while (stdout_open || stderr_open) {
          FD_ZERO(&read_fds);
-         FD_SET(fd_stdout[READ_PIPE], &read_fds);
-         FD_SET(fd_stderr[READ_PIPE], &read_fds);
-         int cnt = select(std::max(fd_stdout[READ_PIPE],
-                                   fd_stderr[READ_PIPE]) + 1,  // nfds
-                          &read_fds,                           // readfds
-                          nullptr,                             // writefds
-                          nullptr,                             // exceptfds
-                          nullptr);                            // timeout
+         int max_fd = -1;
+         if (stdout_open) {
+            FD_SET(fd_stdout[READ_PIPE], &read_fds);
+            max_fd = std::max(max_fd, fd_stdout[READ_PIPE]);
+         }
+         if (stderr_open) {
+            FD_SET(fd_stderr[READ_PIPE], &read_fds);
+            max_fd = std::max(max_fd, fd_stderr[READ_PIPE]);
+         }
+         int cnt = select(max_fd + 1,  // nfds
+                          &read_fds,   // readfds
+                          nullptr,     // writefds
+                          nullptr,     // exceptfds
+                          nullptr);    // timeout
          if (cnt > 0) {
-            if (FD_ISSET(fd_stdout[READ_PIPE], &read_fds)) {
+            if (stdout_open && FD_ISSET(fd_stdout[READ_PIPE], &read_fds)) {
                ssize_t bytes_read = read(fd_stdout[READ_PIPE],
                                          pipe_read_buffer,
                                          sizeof(pipe_read_buffer)-1);
                if (bytes_read < 0) {
-                  printf("error: unable to read pipe. errno = %d\n", errno);
-               } else if (bytes_read > 0) {
-                  if (pipe_read_buffer[0] != 0) {
-                     std_out += string(pipe_read_buffer);
+                  if (errno != EINTR) {
+                     printf("error: unable to read pipe. errno = %d\n", errno);
+                     stdout_open = false;
                   }
-                  memset(pipe_read_buffer, 0, sizeof(pipe_read_buffer));
+               } else if (bytes_read == 0) {
+                  stdout_open = false;
+               } else {
+                  std_out.append(pipe_read_buffer, bytes_read);
                }
             }
 
-            if (FD_ISSET(fd_stderr[READ_PIPE], &read_fds)) {
+            if (stderr_open && FD_ISSET(fd_stderr[READ_PIPE], &read_fds)) {
                ssize_t bytes_read = read(fd_stderr[READ_PIPE],
                                          pipe_read_buffer,
                                          sizeof(pipe_read_buffer)-1);
                if (bytes_read < 0) {
-                  printf("error: unable to read pipe. errno = %d\n", errno);
-               } else if (bytes_read > 0) {
-                  if (pipe_read_buffer[0] != 0) {
-                     std_err += string(pipe_read_buffer);
+                  if (errno != EINTR) {
+                     printf("error: unable to read pipe. errno = %d\n", errno);
+                     stderr_open = false;
                   }
-                  memset(pipe_read_buffer, 0, sizeof(pipe_read_buffer));
+               } else if (bytes_read == 0) {
+                  stderr_open = false;
+               } else {
+                  std_err.append(pipe_read_buffer, bytes_read);
                }
             }
-         } else if (cnt < 0) {
+         } else if (cnt < 0 && errno != EINTR) {
             printf("error on select: errno = %d\n", errno);
-            finished_reading_child_fds = true;
+            break;
          }
-      } while (!finished_reading_child_fds);
+      }
       close(fd_stdout[READ_PIPE]);
       close(fd_stderr[READ_PIPE]);
 
@@ -49,8 +49,7 @@ public:
                                     int world_perms);
    static std::vector<std::string> file_read_lines(const std::string& file_path);
    static bool directory_delete_directory(const std::string& dir_path);
-   static std::string md5_for_file(const std::string& ini_file_name,
-                                   const std::string& path_to_file);
+   static std::string md5_for_file(const std::string& path_to_file);
    static bool file_get_mtime(const std::string& file_path, double& mtime);
    static bool execute_program(const std::string& program_path,
                                const std::vector<std::string>& program_args,
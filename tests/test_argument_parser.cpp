@@ -115,9 +115,12 @@ void TestArgumentParser::test_parse_args() {
    ap.addOptionalBoolFlag("--debug", "provide debugging support");
    ap.addOptionalIntArgument("--logLevel", "adjust logging level up or down");
    ap.addOptionalStringArgument("--user", "user issuing command");
+   ap.addOptionalIntArgument("--file-cache-count", "number of songs to buffer");
    ap.addRequiredArgument("command", "command to execute");
 
    vector<string> args;
+   args.push_back("--file-cache-count");
+   args.push_back("4");
    args.push_back("--logLevel");
    args.push_back("6");
    args.push_back("--user");
@@ -132,6 +135,8 @@ void TestArgumentParser::test_parse_args() {
       require(ps->contains("user"), "user should exist");
       require(ps->contains("debug"), "debug should exist");
       require(ps->contains("command"), "command should exist");
+      require(ps->contains("file_cache_count"), "dashes in names should become underscores");
+      require(ps->get_int_value("file_cache_count") == 4);
       int logLevel = ps->get_int_value("logLevel");
       string user = ps->get_string_value("user");
       bool debug = ps->get_bool_value("debug");
@@ -0,0 +1,166 @@
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "test_content_hash.h"
+#include "content_hash.h"
+#include "fs_test_case.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+static string hash_string(ContentHash::Algorithm algorithm,
+                          const string& s,
+                          size_t chunk_size) {
+   unique_ptr<ContentHash> hash = ContentHash::create(algorithm);
+   for (size_t i = 0; i < s.length(); i += chunk_size) {
+      size_t length = std::min(chunk_size, s.length() - i);
+      hash->update((const unsigned char*) s.data() + i, length);
+   }
+   return hash->hex_digest();
+}
+
+TestContentHash::TestContentHash() :
+   TestSuite("TestContentHash") {
+}
+
+void TestContentHash::runTests() {
+   test_md5();
+   test_xxh64();
+   test_incremental_update();
+   test_tagged_digest();
+   test_algorithm_from_name();
+   test_hash_file();
+   test_hashing_source_and_sink();
+}
+
+void TestContentHash::test_md5() {
+   TEST_CASE("test_md5");
+   requireStringEquals("d41d8cd98f00b204e9800998ecf8427e",
+                       hash_string(ContentHash::MD5, "", 64),
+                       "md5 of empty string");
+   requireStringEquals("900150983cd24fb0d6963f7d28e17f72",
+                       hash_string(ContentHash::MD5, "abc", 64),
+                       "md5 of abc");
+   requireStringEquals("9e107d9d372bb6826bd81d3542a419d6",
+                       hash_string(ContentHash::MD5,
+                                   "The quick brown fox jumps over the lazy dog",
+                                   64),
+                       "md5 of quick brown fox");
+}
+
+void TestContentHash::test_xxh64() {
+   TEST_CASE("test_xxh64");
+   requireStringEquals("ef46db3751d8e999",
+                       hash_string(ContentHash::XXH64, "", 64),
+                       "xxh64 of empty string");
+   requireStringEquals("44bc2cf5ad770999",
+                       hash_string(ContentHash::XXH64, "abc", 64),
+                       "xxh64 of abc");
+   requireStringEquals("fbcea83c8a378bf1",
+                       hash_string(ContentHash::XXH64,
+                                   "Nobody inspects the spammish repetition",
+                                   64),
+                       "xxh64 of 39 byte string");
+}
+
+void TestContentHash::test_incremental_update() {
+   TEST_CASE("test_incremental_update");
+   string data;
+   for (int i = 0; i < 10000; ++i) {
+      data += (char) (i * 7 + 3);
+   }
+
+   string md5_whole = hash_string(ContentHash::MD5, data, data.length());
+   string xxh64_whole = hash_string(ContentHash::XXH64, data, data.length());
+   vector<size_t> chunk_sizes = {1, 7, 31, 32, 63, 64, 65, 4096};
+   for (size_t chunk_size : chunk_sizes) {
+      requireStringEquals(md5_whole,
+                          hash_string(ContentHash::MD5, data, chunk_size),
+                          "md5 independent of chunking");
+      requireStringEquals(xxh64_whole,
+                          hash_string(ContentHash::XXH64, data, chunk_size),
+                          "xxh64 independent of chunking");
+   }
+}
+
+void TestContentHash::test_tagged_digest() {
+   TEST_CASE("test_tagged_digest");
+   unique_ptr<ContentHash> md5 = ContentHash::create(ContentHash::MD5);
+   requireStringEquals("d41d8cd98f00b204e9800998ecf8427e",
+                       md5->tagged_digest(),
+                       "md5 digests are untagged");
+
+   unique_ptr<ContentHash> xxh64 = ContentHash::create(ContentHash::XXH64);
+   requireStringEquals("xxh64:ef46db3751d8e999",
+                       xxh64->tagged_digest(),
+                       "xxh64 digests are tagged");
+
+   require(ContentHash::create_for_tagged_digest("xxh64:ef46db3751d8e999")->get_algorithm() == ContentHash::XXH64,
+           "xxh64 tag recognized");
+   require(ContentHash::create_for_tagged_digest("d41d8cd98f00b204e9800998ecf8427e")->get_algorithm() == ContentHash::MD5,
+           "untagged is md5");
+   require(ContentHash::create_for_tagged_digest("")->get_algorithm() == ContentHash::MD5,
+           "empty is md5");
+}
+
+void TestContentHash::test_algorithm_from_name() {
+   TEST_CASE("test_algorithm_from_name");
+   ContentHash::Algorithm algorithm;
+   require(ContentHash::algorithm_from_name("md5", algorithm), "md5 known");
+   require(algorithm == ContentHash::MD5, "md5 algorithm");
+   require(ContentHash::algorithm_from_name("xxh64", algorithm), "xxh64 known");
+   require(algorithm == ContentHash::XXH64, "xxh64 algorithm");
+   requireFalse(ContentHash::algorithm_from_name("sha1", algorithm), "sha1 unknown");
+   requireStringEquals("xxh64", ContentHash::algorithm_name(ContentHash::XXH64),
+                       "xxh64 name");
+}
+
+void TestContentHash::test_hash_file() {
+   TEST_CASE("test_hash_file");
+   string test_dir = "/tmp/test_cpp_contenthash_hash_file";
+   FSTestCase test_case(*this, test_dir);
+
+   string file_path = OSUtils::pathJoin(test_dir, "stooges.txt");
+   require(Utils::file_write_all_text(file_path, "moe\nlarry\ncurly\nshemp\njoe\n"),
+           "write succeeds");
+   requireStringEquals("172f966fe02ff84c0f36178fa7aaa686",
+                       ContentHash::hash_file(file_path, ContentHash::MD5),
+                       "md5 of file");
+   requireStringEquals("",
+                       ContentHash::hash_file(OSUtils::pathJoin(test_dir, "missing"),
+                                              ContentHash::MD5),
+                       "missing file has no hash");
+}
+
+void TestContentHash::test_hashing_source_and_sink() {
+   TEST_CASE("test_hashing_source_and_sink");
+   string data = "The quick brown fox jumps over the lazy dog";
+   size_t offset = 0;
+   ObjectSource source = [&](unsigned char* buffer, size_t max_bytes) -> int64_t {
+      size_t length = std::min(max_bytes, data.length() - offset);
+      memcpy(buffer, data.data() + offset, length);
+      offset += length;
+      return length;
+   };
+
+   string received;
+   ObjectSink sink = [&](const unsigned char* buffer, size_t length) {
+      received.append((const char*) buffer, length);
+      return true;
+   };
+
+   unique_ptr<ContentHash> source_hash = ContentHash::create(ContentHash::MD5);
+   unique_ptr<ContentHash> sink_hash = ContentHash::create(ContentHash::MD5);
+   int64_t bytes = ObjectStream::pump(ContentHash::hashing_source(*source_hash, source),
+                                      ContentHash::hashing_sink(*sink_hash, sink));
+   require(bytes == (int64_t) data.length(), "all bytes pumped");
+   requireStringEquals(data, received, "data passes through unchanged");
+   requireStringEquals("9e107d9d372bb6826bd81d3542a419d6",
+                       source_hash->hex_digest(), "source hash");
+   requireStringEquals("9e107d9d372bb6826bd81d3542a419d6",
+                       sink_hash->hex_digest(), "sink hash");
+}
@@ -0,0 +1,24 @@
+#ifndef TEST_CONTENT_HASH_H
+#define TEST_CONTENT_HASH_H
+
+#include "TestSuite.h"
+
+
+class TestContentHash : public chaudiere::TestSuite {
+protected:
+   void runTests();
+
+   void test_md5();
+   void test_xxh64();
+   void test_incremental_update();
+   void test_tagged_digest();
+   void test_algorithm_from_name();
+   void test_hash_file();
+   void test_hashing_source_and_sink();
+
+public:
+   TestContentHash();
+
+};
+
+#endif
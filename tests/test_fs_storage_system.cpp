@@ -1,13 +1,29 @@
+#include <algorithm>
 #include <filesystem>
 
 #include "test_fs_storage_system.h"
 #include "fs_storage_system.h"
+#include "parallel_download.h"
 #include "fs_test_case.h"
 
 using namespace std;
 using namespace chaudiere;
 namespace fs = std::filesystem;
 
+// FS storage that adds a container to the registry while it's listing
+class AddWhileListingStorageSystem : public FSStorageSystem {
+public:
+   AddWhileListingStorageSystem(const string& root_dir) :
+      FSStorageSystem(root_dir) {
+   }
+
+   vector<string> list_account_containers() {
+      vector<string> list_containers = FSStorageSystem::list_account_containers();
+      add_container("added-while-listing");
+      return list_containers;
+   }
+};
+
 TestFSStorageSystem::TestFSStorageSystem() :
    TestSuite("TestFSStorageSystem") {
 }
@@ -17,12 +33,19 @@ void TestFSStorageSystem::runTests() {
    test_exit();
    test_list_account_containers();
    test_create_container();
+   test_has_container();
+   test_container_list_ttl();
+   test_container_listing_unlocked();
    test_delete_container();
    test_list_container_contents();
    test_get_object_metadata();
    test_put_object();
    test_delete_object();
    test_get_object();
+   test_put_object_stream();
+   test_get_object_stream();
+   test_get_object_range();
+   test_get_object_parallel();
 }
 
 void TestFSStorageSystem::test_enter() {
@@ -93,6 +116,70 @@ void TestFSStorageSystem::test_create_container() {
    requireFalse(fs.create_container("foo"), "call to create container with existing name must return false");
 }
 
+void TestFSStorageSystem::test_has_container() {
+   TEST_CASE("test_has_container");
+   string test_dir = "/tmp/test_cpp_fsstoragesystem_has_container";
+   FSTestCase fs_test_case(*this, test_dir);
+   FSStorageSystem fs(test_dir, false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("foo"), "create container must work");
+   require(fs.has_container("foo"), "created container must be found");
+   requireFalse(fs.has_container("bar"), "missing container must not be found");
+
+   // containers made elsewhere are found once the list is loaded
+   FSStorageSystem fs2(test_dir, false);
+   require(fs2.enter(), "enter must return true");
+   require(fs.create_container("bar"), "create container must work");
+   require(fs2.has_container("foo"), "existing container must be found");
+   require(fs2.has_container("bar"), "existing container must be found");
+   require(fs2.create_container("baz"), "create container must work");
+   require(fs2.has_container("baz"), "created container must be found");
+   require(fs2.delete_container("baz"), "delete container must return true");
+   requireFalse(fs2.has_container("baz"), "deleted container must not be found");
+}
+
+void TestFSStorageSystem::test_container_list_ttl() {
+   TEST_CASE("test_container_list_ttl");
+   string test_dir = "/tmp/test_cpp_fsstoragesystem_container_list_ttl";
+   FSTestCase fs_test_case(*this, test_dir);
+   FSStorageSystem fs(test_dir, false);
+   require(fs.enter(), "enter must return true");
+   fs.set_container_list_ttl(0.2);
+   requireFalse(fs.has_container("foo"), "missing container must not be found");
+
+   // an empty list isn't kept, since a failed listing looks the same
+   FSStorageSystem fs2(test_dir, false);
+   require(fs2.enter(), "enter must return true");
+   require(fs2.create_container("bar"), "create container must work");
+   require(fs.has_container("bar"), "empty container list must be listed again");
+
+   require(fs2.create_container("foo"), "create container must work");
+   requireFalse(fs.has_container("foo"), "container list must be kept until it expires");
+
+   Utils::time_sleep_millis(300);
+   require(fs.has_container("foo"), "expired container list must be listed again");
+
+   require(fs2.delete_container("foo"), "delete container must return true");
+   require(fs.has_container("foo"), "container list must be kept until it expires");
+   fs.invalidate_containers();
+   requireFalse(fs.has_container("foo"), "invalidated container list must be listed again");
+}
+
+void TestFSStorageSystem::test_container_listing_unlocked() {
+   TEST_CASE("test_container_listing_unlocked");
+   string test_dir = "/tmp/test_cpp_fsstoragesystem_container_listing_unlocked";
+   FSTestCase fs_test_case(*this, test_dir);
+   AddWhileListingStorageSystem fs(test_dir);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("foo"), "create container must work");
+
+   // the registry isn't locked during the listing, and changes made
+   // meanwhile aren't lost when the listing is stored
+   require(fs.has_container("foo"), "listed container must be found");
+   require(fs.has_container("added-while-listing"),
+           "container added during listing must be kept");
+}
+
 void TestFSStorageSystem::test_delete_container() {
    TEST_CASE("test_delete_container");
    string test_dir = "/tmp/test_cpp_fsstoragesystem_delete_container";
@@ -282,3 +369,154 @@ void TestFSStorageSystem::test_get_object() {
    require(ret_val == 0, "deleted object should return 0");
 }
 
+void TestFSStorageSystem::test_put_object_stream() {
+   TEST_CASE("test_put_object_stream");
+   string test_dir = "/tmp/test_cpp_fsstoragesystem_put_object_stream";
+   FSTestCase fs_test_case(*this, test_dir);
+   FSStorageSystem fs(test_dir, false);
+   require(fs.enter(), "enter must return true");
+
+   // object larger than the stream buffer so that several chunks are moved
+   const size_t object_size = ObjectStream::BUFFER_SIZE * 3 + 17;
+   size_t bytes_produced = 0;
+   ObjectSource source = [&](unsigned char* buffer, size_t max_bytes) -> int64_t {
+      require(max_bytes <= ObjectStream::BUFFER_SIZE, "source must be asked for bounded chunks");
+      size_t num_bytes = std::min(max_bytes, object_size - bytes_produced);
+      for (size_t i = 0; i < num_bytes; i++) {
+         buffer[i] = (unsigned char) ((bytes_produced + i) % 251);
+      }
+      bytes_produced += num_bytes;
+      return num_bytes;
+   };
+
+   // non-existing container
+   requireFalse(fs.put_object_stream("songs", "song.flac", source, nullptr), "put object stream for non-existing container must return false");
+
+   // existing container
+   require(fs.create_container("songs"), "create container must return true");
+   bytes_produced = 0;
+   require(fs.put_object_stream("songs", "song.flac", source, nullptr), "put object stream for existing container must return true");
+
+   string local_file_path = OSUtils::pathJoin(test_dir, "song.flac");
+   require(fs.get_object("songs", "song.flac", local_file_path) == (int64_t) object_size, "streamed object must be complete");
+
+   // failing source
+   ObjectSource failing_source = [](unsigned char*, size_t) -> int64_t {
+      return -1;
+   };
+   requireFalse(fs.put_object_stream("songs", "bad.flac", failing_source, nullptr), "put object stream with failing source must return false");
+   require(fs.list_container_contents("songs").size() == 1, "failed put must not leave an object behind");
+}
+
+void TestFSStorageSystem::test_get_object_stream() {
+   TEST_CASE("test_get_object_stream");
+   string test_dir = "/tmp/test_cpp_fsstoragesystem_get_object_stream";
+   FSTestCase fs_test_case(*this, test_dir);
+   FSStorageSystem fs(test_dir, false);
+   require(fs.enter(), "enter must return true");
+
+   string streamed;
+   ObjectSink sink = [&](const unsigned char* data, size_t num_bytes) -> bool {
+      streamed.append((const char*) data, num_bytes);
+      return true;
+   };
+
+   // existing container, non-existing object
+   require(fs.create_container("books"), "create container must return true");
+   require(fs.get_object_stream("books", "book.txt", sink) == 0, "non-existing object should return 0");
+
+   // existing container, existing object
+   string object_contents = "It was the best of times. It was the worst of times.";
+   std::vector<unsigned char> v_obj_contents;
+   std::copy(object_contents.begin(), object_contents.end(), std::back_inserter(v_obj_contents));
+   require(fs.put_object("books", "book.txt", v_obj_contents, nullptr), "put object must work");
+   require(fs.get_object_stream("books", "book.txt", sink) == (int64_t) object_contents.size(), "existing object should return its size");
+   requireStringEquals(object_contents, streamed, "streamed contents must match");
+
+   // sink that aborts the transfer
+   ObjectSink aborting_sink = [](const unsigned char*, size_t) -> bool {
+      return false;
+   };
+   require(fs.get_object_stream("books", "book.txt", aborting_sink) == 0, "aborted transfer should return 0");
+}
+
+void TestFSStorageSystem::test_get_object_range() {
+   TEST_CASE("test_get_object_range");
+   string test_dir = "/tmp/test_cpp_fsstoragesystem_get_object_range";
+   FSTestCase fs_test_case(*this, test_dir);
+   FSStorageSystem fs(test_dir, false);
+   require(fs.enter(), "enter must return true");
+
+   string streamed;
+   ObjectSink sink = [&](const unsigned char* data, size_t num_bytes) -> bool {
+      streamed.append((const char*) data, num_bytes);
+      return true;
+   };
+
+   // existing container, non-existing object
+   require(fs.create_container("books"), "create container must return true");
+   require(fs.get_object_range("books", "book.txt", 0, 10, sink) == 0, "non-existing object should return 0");
+
+   string object_contents = "It was the best of times. It was the worst of times.";
+   std::vector<unsigned char> v_obj_contents;
+   std::copy(object_contents.begin(), object_contents.end(), std::back_inserter(v_obj_contents));
+   require(fs.put_object("books", "book.txt", v_obj_contents, nullptr), "put object must work");
+
+   // leading range
+   require(fs.get_object_range("books", "book.txt", 0, 6, sink) == 6, "leading range should return its length");
+   requireStringEquals("It was", streamed, "leading range contents must match");
+
+   // interior range
+   streamed.clear();
+   require(fs.get_object_range("books", "book.txt", 11, 4, sink) == 4, "interior range should return its length");
+   requireStringEquals("best", streamed, "interior range contents must match");
+
+   // open-ended range through end of object
+   streamed.clear();
+   int64_t offset = object_contents.find("worst");
+   require(fs.get_object_range("books", "book.txt", offset, 0, sink) == (int64_t) object_contents.size() - offset, "open-ended range should return remaining length");
+   requireStringEquals("worst of times.", streamed, "open-ended range contents must match");
+
+   // range past end of object
+   streamed.clear();
+   require(fs.get_object_range("books", "book.txt", object_contents.size() + 10, 5, sink) == 0, "range past end should return 0");
+}
+
+void TestFSStorageSystem::test_get_object_parallel() {
+   TEST_CASE("test_get_object_parallel");
+   string test_dir = "/tmp/test_cpp_fsstoragesystem_get_object_parallel";
+   FSTestCase fs_test_case(*this, test_dir);
+   FSStorageSystem fs(test_dir, false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("songs"), "create container must return true");
+
+   // large enough to be split into several ranges, not evenly divisible
+   std::vector<unsigned char> v_obj_contents(5 * 1024 * 1024 + 321);
+   for (size_t i = 0; i < v_obj_contents.size(); i++) {
+      v_obj_contents[i] = (unsigned char) (i % 253);
+   }
+   require(fs.put_object("songs", "song.flac", v_obj_contents, nullptr), "put object must work");
+
+   string local_file_path = OSUtils::pathJoin(test_dir, "song.flac");
+   int64_t bytes_retrieved = ParallelDownload::get_object(fs,
+                                                          "songs",
+                                                          "song.flac",
+                                                          local_file_path,
+                                                          v_obj_contents.size(),
+                                                          4);
+   require(bytes_retrieved == (int64_t) v_obj_contents.size(), "parallel download must return object size");
+
+   std::vector<unsigned char> v_retrieved;
+   require(Utils::file_read_all_bytes(local_file_path, v_retrieved), "downloaded file must be readable");
+   require(v_retrieved == v_obj_contents, "ranges must be written in place");
+
+   // size larger than the object means some ranges come back short
+   bytes_retrieved = ParallelDownload::get_object(fs,
+                                                  "songs",
+                                                  "song.flac",
+                                                  local_file_path,
+                                                  v_obj_contents.size() * 2,
+                                                  4);
+   require(bytes_retrieved == 0, "incomplete parallel download must return 0");
+   requireFalse(Utils::file_exists(local_file_path), "incomplete download must not leave a file behind");
+}
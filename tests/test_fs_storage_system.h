@@ -13,12 +13,19 @@ protected:
    void test_exit();
    void test_list_account_containers();
    void test_create_container();
+   void test_has_container();
+   void test_container_list_ttl();
+   void test_container_listing_unlocked();
    void test_delete_container();
    void test_list_container_contents();
    void test_get_object_metadata();
    void test_put_object();
    void test_delete_object();
    void test_get_object();
+   void test_put_object_stream();
+   void test_get_object_stream();
+   void test_get_object_range();
+   void test_get_object_parallel();
 
 public:
    TestFSStorageSystem();
@@ -1,4 +1,5 @@
 #include <string>
+#include <sqlite3.h>
 
 #include "test_jukebox_db.h"
 #include "jukebox_db.h"
@@ -228,9 +229,15 @@ void TestJukeboxDB::runTests() {
    test_insert_song();
    test_update_song();
    test_store_song_metadata();
+   test_transaction();
+   test_statement_reuse();
    test_sql_where_clause();
    test_retrieve_album_songs();
    test_songs_for_artist();
+   test_artist_album_tables();
+   test_index_lookups();
+   test_schema_migration();
+   test_search_songs();
    test_show_listings();
    test_show_artists();
    test_show_genres();
@@ -465,7 +472,128 @@ void TestJukeboxDB::test_update_song() {
 
 void TestJukeboxDB::test_store_song_metadata() {
    TEST_CASE("test_store_song_metadata");
-   //TODO: implement test_store_song_metadata
+   string test_dir = "/tmp/test_cpp_jukeboxdb_store_song_metadata";
+   FSTestCase test_case(*this, test_dir);
+   string db_file = "jukebox_db.sqlite3";
+   JukeboxDB jbdb(db_file);
+   require(jbdb.open(), "open must return true");
+
+   SongMetadata song;
+   song.set_file_uid("The-Who--Whos-Next--My-Wife.flac");
+   song.set_file_name("The-Who--Whos-Next--My-Wife.flac");
+   song.set_origin_file_size(23827669L);
+   song.set_stored_file_size(23827669L);
+   song.set_pad_char_count(0L);
+   song.set_file_time("2022-09-17 08:56:0.000");
+   song.set_md5_hash("asdf");
+   song.set_compressed(0);
+   song.set_encrypted(0);
+   song.set_container_name("w-artist-songs");
+   song.set_object_name("The-Who--Whos-Next--My-Wife.flac");
+   song.set_artist_uid("The-Who");
+   song.set_artist_name("The Who");
+   song.set_album_uid("Whos-Next");
+   song.set_song_name("My Wife");
+
+   require(jbdb.store_song_metadata(song), "store must insert a new song");
+   require(jbdb.store_song_metadata(song), "storing an unchanged song must return true");
+
+   song.set_md5_hash("qwerty");
+   song.set_stored_file_size(1000L);
+   require(jbdb.store_song_metadata(song), "store must update an existing song");
+
+   SongMetadata db_song;
+   require(jbdb.retrieve_song(song.get_file_uid(), db_song), "retrieve_song must return true");
+   requireStringEquals("qwerty", db_song.get_md5_hash(), "hash must be updated");
+   require(db_song.get_stored_file_size() == 1000L, "stored size must be updated");
+
+   requireFalse(jbdb.store_song_metadata(SongMetadata()), "song without uid must return false");
+   jbdb.close();
+}
+
+void TestJukeboxDB::test_transaction() {
+   TEST_CASE("test_transaction");
+   string test_dir = "/tmp/test_cpp_jukeboxdb_transaction";
+   FSTestCase test_case(*this, test_dir);
+   string db_file = "jukebox_db.sqlite3";
+   JukeboxDB jbdb(db_file);
+
+   requireFalse(jbdb.begin_transaction(), "begin must return false for DB not open");
+   require(jbdb.open(), "open must return true");
+   requireFalse(jbdb.commit_transaction(), "commit without begin must return false");
+
+   SongMetadata song;
+   song.set_file_uid("The-Who--Whos-Next--My-Wife.flac");
+   song.set_song_name("My Wife");
+   song.set_md5_hash("asdf");
+   song.set_container_name("w-artist-songs");
+   song.set_object_name("The-Who--Whos-Next--My-Wife.flac");
+
+   // rolled back writes are discarded
+   require(jbdb.begin_transaction(), "begin must return true");
+   require(jbdb.in_transaction(), "in_transaction must return true after begin");
+   requireFalse(jbdb.begin_transaction(), "transactions must not nest");
+   require(jbdb.store_song_metadata(song), "store must return true");
+   require(jbdb.rollback_transaction(), "rollback must return true");
+   requireFalse(jbdb.in_transaction(), "in_transaction must return false after rollback");
+   SongMetadata db_song;
+   requireFalse(jbdb.retrieve_song(song.get_file_uid(), db_song), "rolled back song must not exist");
+
+   // committed writes survive closing the DB
+   require(jbdb.begin_transaction(), "begin must return true");
+   require(jbdb.store_song_metadata(song), "store must return true");
+   require(jbdb.commit_transaction(), "commit must return true");
+   requireFalse(jbdb.in_transaction(), "in_transaction must return false after commit");
+   jbdb.close();
+
+   require(jbdb.open(), "open must return true");
+   require(jbdb.retrieve_song(song.get_file_uid(), db_song), "committed song must exist");
+
+   // uncommitted writes are discarded on close
+   song.set_file_uid("The-Who--Whos-Next--Baba-ORiley.flac");
+   require(jbdb.begin_transaction(), "begin must return true");
+   require(jbdb.store_song_metadata(song), "store must return true");
+   jbdb.close();
+   require(jbdb.open(), "open must return true");
+   requireFalse(jbdb.retrieve_song(song.get_file_uid(), db_song), "uncommitted song must not exist");
+   jbdb.close();
+}
+
+void TestJukeboxDB::test_statement_reuse() {
+   TEST_CASE("test_statement_reuse");
+   string test_dir = "/tmp/test_cpp_jukeboxdb_statement_reuse";
+   FSTestCase test_case(*this, test_dir);
+   string db_file = "jukebox_db.sqlite3";
+   JukeboxDB jbdb(db_file);
+   require(jbdb.open(), "open must return true");
+   require(insert_album(jbdb), "insert_album must return true");
+
+   // the same prepared statements serve repeated and interleaved calls
+   for (int i = 0; i < 3; i++) {
+      vector<SongMetadata> songs;
+      require(jbdb.retrieve_album_songs("Steely Dan", "Aja", songs),
+              "retrieve_album_songs must return true");
+      require(songs.size() == 7, "retrieve_album_songs must return 7 songs");
+      for (const auto& song : songs) {
+         SongMetadata db_song;
+         require(jbdb.retrieve_song(song.get_file_uid(), db_song),
+                 "retrieve_song must return true");
+         requireStringEquals(song.get_song_name(), db_song.get_song_name(),
+                             "song names must match");
+      }
+   }
+
+   SongMetadata db_song;
+   requireFalse(jbdb.retrieve_song("No-Such--Song", db_song),
+                "retrieve_song must return false for missing song");
+
+   // statements are prepared again after the DB is reopened
+   jbdb.close();
+   require(jbdb.open(), "open must return true");
+   vector<SongMetadata> songs;
+   jbdb.retrieve_album_songs("Steely Dan", "Aja", songs);
+   require(songs.size() == 7, "retrieve_album_songs must return 7 songs after reopen");
+   jbdb.close();
 }
 
 void TestJukeboxDB::test_sql_where_clause() {
@@ -571,11 +699,256 @@ void TestJukeboxDB::test_songs_for_artist() {
    require(jbdb.insert_song(song2), "insert_song must return true");
 
    jbdb.songs_for_artist("Van Halen", songs);
-   require(songs.empty(), "songs_for_artist must return 1 song");
+   require(songs.size() == 1, "songs_for_artist must return 1 song");
 
    //TODO: multiple matching and non-matching artist songs
 }
 
+void TestJukeboxDB::test_artist_album_tables() {
+   TEST_CASE("test_artist_album_tables");
+   string test_dir = "/tmp/test_cpp_jukeboxdb_artist_album_tables";
+   FSTestCase test_case(*this, test_dir);
+   string db_file = "jukebox_db.sqlite3";
+   JukeboxDB jbdb(db_file);
+   require(jbdb.open(), "open must return true");
+   require(jbdb.schema_version() == JukeboxDB::SCHEMA_VERSION,
+           "new DB must have current schema version");
+
+   // uids are derived from the song uid when they're missing
+   SongMetadata song;
+   song.set_file_uid("The-Who--Whos-Next--My-Wife.flac");
+   song.set_song_name("My Wife");
+   song.set_md5_hash("asdf");
+   song.set_container_name("w-artist-songs");
+   song.set_object_name("The-Who--Whos-Next--My-Wife.flac");
+   require(jbdb.store_song_metadata(song), "store must return true");
+
+   SongMetadata db_song;
+   require(jbdb.retrieve_song(song.get_file_uid(), db_song), "retrieve_song must return true");
+   requireStringEquals("The-Who", db_song.get_artist_uid(), "artist uid must be derived");
+   requireStringEquals("The-Who--Whos-Next", db_song.get_album_uid(), "album uid must be derived");
+
+   // two artists can each have an album with the same name
+   SongMetadata song2;
+   song2.set_file_uid("Ramones--Greatest-Hits--Blitzkrieg-Bop.flac");
+   song2.set_song_name("Blitzkrieg Bop");
+   song2.set_md5_hash("asdf");
+   song2.set_container_name("r-artist-songs");
+   song2.set_object_name("Ramones--Greatest-Hits--Blitzkrieg-Bop.flac");
+   require(jbdb.store_song_metadata(song2), "store must return true");
+
+   SongMetadata song3(song2);
+   song3.set_file_uid("Queen--Greatest-Hits--Killer-Queen.flac");
+   song3.set_song_name("Killer Queen");
+   song3.set_container_name("q-artist-songs");
+   song3.set_object_name("Queen--Greatest-Hits--Killer-Queen.flac");
+   song3.set_artist_uid("Queen");
+   song3.set_album_uid("Greatest-Hits");
+   require(jbdb.store_song_metadata(song3), "store must return true");
+
+   vector<SongMetadata> songs;
+   jbdb.retrieve_album_songs("Queen", "Greatest Hits", songs);
+   require(songs.size() == 1, "retrieve_album_songs must return 1 song");
+   requireStringEquals("Queen--Greatest-Hits", songs[0].get_album_uid(),
+                       "album uid must be qualified by artist");
+
+   songs.clear();
+   jbdb.retrieve_album_songs("", "Greatest Hits", songs);
+   require(songs.size() == 2, "album lookup must match both artists");
+
+   songs.clear();
+   jbdb.retrieve_album_songs("Ramones", "", songs);
+   require(songs.size() == 1, "artist lookup must return 1 song");
+
+   songs.clear();
+   jbdb.retrieve_album_songs("The-Who", "Whos-Next", songs);
+   require(songs.size() == 1, "encoded names must match");
+   jbdb.close();
+}
+
+void TestJukeboxDB::test_index_lookups() {
+   TEST_CASE("test_index_lookups");
+   string test_dir = "/tmp/test_cpp_jukeboxdb_index_lookups";
+   FSTestCase test_case(*this, test_dir);
+   string db_file = "jukebox_db.sqlite3";
+   {
+      JukeboxDB jbdb(db_file);
+      require(jbdb.open(), "open must return true");
+   }
+
+   sqlite3* db = nullptr;
+   require(sqlite3_open(db_file.c_str(), &db) == SQLITE_OK, "sqlite3_open must succeed");
+
+   // each lookup and the index it must seek on
+   const char* queries[][2] = {
+      {"SELECT * FROM song WHERE encrypted = 0 AND compressed = 0 "
+          "AND artist_name = 'Steely Dan'",
+       "song_artist_name"},
+      {"SELECT * FROM song WHERE encrypted = 0 AND compressed = 0 "
+          "AND artist_uid = 'Steely-Dan'",
+       "song_artist_uid"},
+      {"SELECT * FROM song WHERE encrypted = 0 AND compressed = 0 "
+          "AND album_uid IN (SELECT album_uid FROM album "
+          "WHERE artist_uid = 'Steely-Dan' AND album_name = 'Aja')",
+       "song_album_uid"},
+      {"SELECT * FROM song WHERE encrypted = 0 AND compressed = 0 "
+          "AND album_uid IN (SELECT album_uid FROM album WHERE album_name = 'Aja')",
+       "album_album_name"},
+      {"SELECT * FROM song WHERE container_name = 's-artist-songs'",
+       "song_container_name"},
+      {"SELECT * FROM song WHERE encrypted = 0 AND compressed = 0",
+       "song_encrypted_compressed"},
+      {"SELECT * FROM genre WHERE genre_name = 'Jazz'",
+       "sqlite_autoindex_genre"}
+   };
+
+   for (const auto& query : queries) {
+      string sql = string("EXPLAIN QUERY PLAN ") + query[0];
+      sqlite3_stmt* stmt = nullptr;
+      require(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK,
+              "query plan must be prepared");
+      bool table_scan = false;
+      bool uses_index = false;
+      while (sqlite3_step(stmt) == SQLITE_ROW) {
+         string detail = (const char*) sqlite3_column_text(stmt, 3);
+         if (detail.find("SCAN") == 0) {
+            table_scan = true;
+         }
+         if (detail.find(query[1]) != string::npos) {
+            uses_index = true;
+         }
+      }
+      sqlite3_finalize(stmt);
+      requireFalse(table_scan, string("lookup must not scan a table: ") + query[0]);
+      require(uses_index, string("lookup must use ") + query[1] + ": " + query[0]);
+   }
+
+   sqlite3_close(db);
+}
+
+void TestJukeboxDB::test_schema_migration() {
+   TEST_CASE("test_schema_migration");
+   string test_dir = "/tmp/test_cpp_jukeboxdb_schema_migration";
+   FSTestCase test_case(*this, test_dir);
+   string db_file = "jukebox_db.sqlite3";
+
+   // a version 1 DB: unique album names, no indexes, unpopulated artist
+   // and album tables, and songs without artist or album uids
+   sqlite3* db = nullptr;
+   require(sqlite3_open(db_file.c_str(), &db) == SQLITE_OK, "sqlite3_open must succeed");
+   string v1_schema =
+      "CREATE TABLE genre (genre_uid TEXT UNIQUE NOT NULL,"
+         "genre_name TEXT UNIQUE NOT NULL, genre_description TEXT);"
+      "CREATE TABLE artist (artist_uid TEXT UNIQUE NOT NULL,"
+         "artist_name TEXT UNIQUE NOT NULL, artist_description TEXT);"
+      "CREATE TABLE album (album_uid TEXT UNIQUE NOT NULL,"
+         "album_name TEXT UNIQUE NOT NULL, album_description TEXT,"
+         "artist_uid TEXT NOT NULL REFERENCES artist(artist_uid),"
+         "genre_uid TEXT REFERENCES genre(genre_uid));"
+      "CREATE TABLE song (song_uid TEXT UNIQUE NOT NULL, file_time TEXT,"
+         "origin_file_size INTEGER, stored_file_size INTEGER,"
+         "pad_char_count INTEGER, artist_name TEXT,"
+         "artist_uid TEXT REFERENCES artist(artist_uid),"
+         "song_name TEXT NOT NULL, md5_hash TEXT NOT NULL,"
+         "compressed INTEGER, encrypted INTEGER,"
+         "container_name TEXT NOT NULL, object_name TEXT NOT NULL,"
+         "album_uid TEXT REFERENCES album(album_uid));"
+      "INSERT INTO song VALUES ('Steely-Dan--Aja--Peg.flac', '', 0, 0, 0,"
+         "'Steely Dan', '', 'Peg', 'asdf', 0, 0, 's-artist-songs',"
+         "'Steely-Dan--Aja--Peg.flac', '');"
+      "INSERT INTO song VALUES ('Steely-Dan--Aja--Josie.flac', '', 0, 0, 0,"
+         "'Steely Dan', '', 'Josie', 'asdf', 0, 0, 's-artist-songs',"
+         "'Steely-Dan--Aja--Josie.flac', NULL);";
+   require(sqlite3_exec(db, v1_schema.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK,
+           "v1 schema must be created");
+   sqlite3_close(db);
+
+   JukeboxDB jbdb(db_file);
+   require(jbdb.open(), "open must migrate the DB");
+   require(jbdb.schema_version() == JukeboxDB::SCHEMA_VERSION,
+           "migrated DB must have current schema version");
+
+   SongMetadata db_song;
+   require(jbdb.retrieve_song("Steely-Dan--Aja--Peg.flac", db_song), "retrieve_song must return true");
+   requireStringEquals("Steely-Dan", db_song.get_artist_uid(), "artist uid must be backfilled");
+   requireStringEquals("Steely-Dan--Aja", db_song.get_album_uid(), "album uid must be backfilled");
+
+   vector<SongMetadata> songs;
+   jbdb.retrieve_album_songs("Steely Dan", "Aja", songs);
+   require(songs.size() == 2, "retrieve_album_songs must return migrated songs");
+   jbdb.close();
+
+   // reopening a current DB doesn't migrate again
+   require(jbdb.open(), "open must return true");
+   songs.clear();
+   jbdb.retrieve_album_songs("", "Aja", songs);
+   require(songs.size() == 2, "album lookup must return migrated songs");
+
+   songs.clear();
+   jbdb.search_songs("josie", songs, 10);
+   require(songs.size() == 1, "migrated songs must be searchable");
+   jbdb.close();
+}
+
+void TestJukeboxDB::test_search_songs() {
+   TEST_CASE("test_search_songs");
+   string test_dir = "/tmp/test_cpp_jukeboxdb_search_songs";
+   FSTestCase test_case(*this, test_dir);
+   string db_file = "jukebox_db.sqlite3";
+   JukeboxDB jbdb(db_file);
+   vector<SongMetadata> songs;
+
+   requireFalse(jbdb.search_songs("aja", songs, 10), "search must return false for DB not open");
+   require(jbdb.open(), "open must return true");
+   require(insert_album(jbdb), "insert_album must return true");
+
+   requireFalse(jbdb.search_songs("   ", songs, 10), "search without words must return false");
+
+   require(jbdb.search_songs("steely", songs, 10), "search must return true");
+   require(songs.size() == 7, "artist search must return 7 songs");
+
+   // the song named after its album matches in two columns
+   jbdb.search_songs("aja", songs, 10);
+   require(songs.size() == 7, "album search must return 7 songs");
+   requireStringEquals("Aja", songs[0].get_song_name(), "best match must be first");
+
+   jbdb.search_songs("aja", songs, 3);
+   require(songs.size() == 3, "search must return at most max_results songs");
+
+   // every word must match, as a prefix
+   jbdb.search_songs("dea blu", songs, 10);
+   require(songs.size() == 1, "prefix search must return 1 song");
+   requireStringEquals("Deacon Blues", songs[0].get_song_name(), "prefix search must match song");
+
+   jbdb.search_songs("deacon josie", songs, 10);
+   require(songs.empty(), "search must require every word");
+
+   // FTS5 syntax in the query is taken literally
+   require(jbdb.search_songs("peg\" OR NOT *", songs, 10), "search with FTS5 syntax must return true");
+   require(songs.empty(), "FTS5 syntax must not be interpreted");
+
+   // the index follows updates and deletes
+   SongMetadata song;
+   require(jbdb.retrieve_song(string("Steely-Dan--Aja") + "Peg", song), "retrieve_song must return true");
+   song.set_song_name("Peggy Sue");
+   require(jbdb.update_song(song), "update_song must return true");
+   jbdb.search_songs("sue", songs, 10);
+   require(songs.size() == 1, "updated song name must be searchable");
+   require(jbdb.delete_song(song.get_file_uid()), "delete_song must return true");
+   jbdb.search_songs("peg", songs, 10);
+   require(songs.empty(), "deleted song must not be found");
+
+   // a failed insert leaves no index entry behind
+   printf("=== expecting SQL error below\n");
+   SongMetadata dup_song;
+   require(jbdb.retrieve_song(string("Steely-Dan--Aja") + "Josie", dup_song), "retrieve_song must return true");
+   requireFalse(jbdb.insert_song(dup_song), "duplicate insert must return false");
+   jbdb.search_songs("josie", songs, 10);
+   require(songs.size() == 1, "failed insert must not add a search entry");
+
+   jbdb.close();
+}
+
 void TestJukeboxDB::test_show_listings() {
    TEST_CASE("test_show_listings");
    //TODO: implement test_show_listings
@@ -35,9 +35,15 @@ protected:
    void test_insert_song();
    void test_update_song();
    void test_store_song_metadata();
+   void test_transaction();
+   void test_statement_reuse();
    void test_sql_where_clause();
    void test_retrieve_album_songs();
    void test_songs_for_artist();
+   void test_artist_album_tables();
+   void test_index_lookups();
+   void test_schema_migration();
+   void test_search_songs();
    void test_show_listings();
    void test_show_artists();
    void test_show_genres();
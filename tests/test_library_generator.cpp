@@ -0,0 +1,216 @@
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test_library_generator.h"
+#include "library_generator.h"
+#include "fs_test_case.h"
+#include "jb_utils.h"
+#include "jukebox_db.h"
+#include "utils.h"
+#include "OSUtils.h"
+#include "StrUtils.h"
+
+#include "nlohmann/json.hpp"
+
+using namespace std;
+using namespace chaudiere;
+using json = nlohmann::json;
+
+static LibraryConfig small_config() {
+   LibraryConfig config;
+   config.num_artists = 5;
+   config.num_albums = 12;
+   config.min_tracks = 2;
+   config.max_tracks = 4;
+   config.min_file_bytes = 1000;
+   config.max_file_bytes = 300000;
+   config.num_playlists = 3;
+   config.songs_per_playlist = 6;
+   return config;
+}
+
+TestLibraryGenerator::TestLibraryGenerator() :
+   TestSuite("TestLibraryGenerator") {
+}
+
+void TestLibraryGenerator::runTests() {
+   test_zipf_allocation();
+   test_deterministic();
+   test_file_names();
+   test_write_library();
+   test_playlists_match_catalog();
+}
+
+void TestLibraryGenerator::test_zipf_allocation() {
+   TEST_CASE("test_zipf_allocation");
+   vector<unsigned int> counts = LibraryGenerator::zipf_allocation(1000, 10, 1.0);
+   require(counts.size() == 10, "one count per bucket");
+   unsigned int sum = 0;
+   for (size_t i = 0; i < counts.size(); ++i) {
+      sum += counts[i];
+      require(counts[i] >= 1, "every bucket gets at least one");
+      if (i > 0) {
+         require(counts[i] <= counts[i-1], "counts must not increase with rank");
+      }
+   }
+   require(sum == 1000, "counts must sum to total");
+   // harmonic number H(10) is about 2.93, so rank 1 gets about a third
+   require(counts[0] > 300 && counts[0] < 380, "rank 1 share");
+
+   counts = LibraryGenerator::zipf_allocation(3, 5, 1.0);
+   require(counts[0] == 1 && counts[2] == 1 && counts[3] == 0 && counts[4] == 0,
+           "too few to go around fills the top ranks");
+}
+
+void TestLibraryGenerator::test_deterministic() {
+   TEST_CASE("test_deterministic");
+   LibraryConfig config = small_config();
+   LibraryGenerator generator_a(config);
+   LibraryGenerator generator_b(config);
+
+   const vector<GeneratedSong>& songs_a = generator_a.get_songs();
+   const vector<GeneratedSong>& songs_b = generator_b.get_songs();
+   require(songs_a.size() == songs_b.size(), "same config gives same song count");
+   bool all_equal = songs_a.size() == songs_b.size();
+   for (size_t i = 0; all_equal && i < songs_a.size(); ++i) {
+      all_equal = songs_a[i].file_name == songs_b[i].file_name &&
+                  songs_a[i].file_size == songs_b[i].file_size;
+   }
+   require(all_equal, "same config gives same songs");
+   requireStringEquals(generator_a.playlist_json(0),
+                       generator_b.playlist_json(0),
+                       "same config gives same playlists");
+
+   config.seed = 7;
+   LibraryGenerator generator_c(config);
+   requireFalse(generator_c.get_songs()[0].file_name == songs_a[0].file_name,
+                "different seed gives different library");
+
+   require(generator_a.num_albums() == 12, "album count");
+   require(songs_a.size() >= 12 * 2 && songs_a.size() <= 12 * 4,
+           "track counts within bounds");
+}
+
+void TestLibraryGenerator::test_file_names() {
+   TEST_CASE("test_file_names");
+   LibraryGenerator generator(small_config());
+   set<string> file_names;
+   size_t num_small = 0;
+   for (const auto& song : generator.get_songs()) {
+      file_names.insert(song.file_name);
+
+      // the reverse of what import_songs does with the file name
+      string base_name = song.file_name.substr(0, song.file_name.find('.'));
+      vector<string> tokens = StrUtils::split(base_name, "--");
+      require(tokens.size() == 3, "file name must have artist--album--song");
+      if (tokens.size() == 3) {
+         requireStringEquals(song.artist, JBUtils::unencode_value(tokens[0]), "artist");
+         requireStringEquals(song.album, JBUtils::unencode_value(tokens[1]), "album");
+         requireStringEquals(song.song, JBUtils::unencode_value(tokens[2]), "song");
+      }
+      require(song.file_size >= 1000 && song.file_size <= 300000,
+              "file size within bounds");
+      if (song.file_size < 150500) {
+         ++num_small;
+      }
+   }
+   require(num_small * 2 > generator.get_songs().size(),
+           "sizes skewed towards the small end");
+   require(file_names.size() == generator.get_songs().size(),
+           "file names must be unique");
+}
+
+void TestLibraryGenerator::test_write_library() {
+   TEST_CASE("test_write_library");
+   string test_dir = "/tmp/test_cpp_library_generator";
+   FSTestCase test_case(*this, test_dir);
+   OSUtils::createDirectory(test_dir);
+
+   LibraryConfig config = small_config();
+   LibraryGenerator sparse_generator(config);
+   string sparse_dir = OSUtils::pathJoin(test_dir, "sparse");
+   OSUtils::createDirectory(sparse_dir);
+   require(sparse_generator.write(sparse_dir), "write sparse library");
+
+   string song_dir = OSUtils::pathJoin(sparse_dir, LibraryGenerator::SONG_DIR);
+   const vector<GeneratedSong>& songs = sparse_generator.get_songs();
+   require(OSUtils::listFilesInDirectory(song_dir).size() == songs.size(),
+           "one file per song");
+   require(Utils::get_file_size(OSUtils::pathJoin(song_dir, songs[0].file_name)) ==
+           songs[0].file_size, "sparse file size");
+
+   string playlist_dir = OSUtils::pathJoin(sparse_dir, LibraryGenerator::PLAYLIST_DIR);
+   require(OSUtils::listFilesInDirectory(playlist_dir).size() == 3, "playlist files");
+   string album_dir = OSUtils::pathJoin(sparse_dir, LibraryGenerator::ALBUM_DIR);
+   require(OSUtils::listFilesInDirectory(album_dir).size() == 12, "album files");
+
+   string album_contents;
+   require(Utils::file_read_all_text(
+              OSUtils::pathJoin(album_dir, sparse_generator.album_file_name(0)),
+              album_contents), "read album json");
+   json album_json = json::parse(album_contents);
+   require(album_json.contains("tracks") && !album_json["tracks"].empty(),
+           "album json must list tracks");
+   requireStringEquals(songs[0].file_name,
+                       album_json["tracks"][0]["object"].get<string>(),
+                       "first track object");
+   requireStringEquals(songs[0].song,
+                       album_json["tracks"][0]["title"].get<string>(),
+                       "first track title");
+
+   // real bytes are the same every time they're written
+   config.sparse_files = false;
+   LibraryGenerator real_generator(config);
+   string path_a = OSUtils::pathJoin(test_dir, "a.bin");
+   string path_b = OSUtils::pathJoin(test_dir, "b.bin");
+   string path_c = OSUtils::pathJoin(test_dir, "c.bin");
+   require(real_generator.write_song_file(songs[0], path_a), "write song a");
+   require(real_generator.write_song_file(songs[0], path_b), "write song b");
+   require(real_generator.write_song_file(songs[1], path_c), "write song c");
+   require(Utils::get_file_size(path_a) == songs[0].file_size, "real file size");
+   requireStringEquals(Utils::md5_for_file(path_a), Utils::md5_for_file(path_b),
+                       "same song gives same bytes");
+   requireFalse(Utils::md5_for_file(path_a) == Utils::md5_for_file(path_c),
+                "different songs give different bytes");
+}
+
+void TestLibraryGenerator::test_playlists_match_catalog() {
+   TEST_CASE("test_playlists_match_catalog");
+   string test_dir = "/tmp/test_cpp_library_generator_db";
+   FSTestCase test_case(*this, test_dir);
+   OSUtils::createDirectory(test_dir);
+
+   LibraryGenerator generator(small_config());
+   JukeboxDB jukebox_db(OSUtils::pathJoin(test_dir, "jukebox_db.sqlite3"));
+   require(jukebox_db.open(), "open db");
+   jukebox_db.begin_transaction();
+   for (const auto& song : generator.get_songs()) {
+      require(jukebox_db.insert_song(generator.song_metadata(song)), "insert song");
+   }
+   jukebox_db.commit_transaction();
+
+   // looked up the way get_playlist_songs does
+   for (size_t i = 0; i < generator.get_playlist_names().size(); ++i) {
+      json playlist_json = json::parse(generator.playlist_json(i));
+      require(playlist_json["songs"].size() == 6, "playlist length");
+      for (const auto& song_json : playlist_json["songs"]) {
+         string encoded_song =
+            JBUtils::encode_artist_album_song(song_json["artist"].get<string>(),
+                                              song_json["album"].get<string>(),
+                                              song_json["song"].get<string>());
+         encoded_song = JBUtils::remove_punctuation(encoded_song);
+         bool found = false;
+         for (const string extension : {".flac", ".m4a", ".mp3"}) {
+            SongMetadata song;
+            if (jukebox_db.retrieve_song(encoded_song + extension, song)) {
+               found = true;
+               break;
+            }
+         }
+         require(found, "playlist song must be in the catalog");
+      }
+   }
+   jukebox_db.close();
+}
+
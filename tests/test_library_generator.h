@@ -0,0 +1,23 @@
+#ifndef TEST_LIBRARY_GENERATOR_H
+#define TEST_LIBRARY_GENERATOR_H
+
+#include "TestSuite.h"
+
+
+class TestLibraryGenerator : public chaudiere::TestSuite {
+protected:
+   void runTests();
+
+   void test_zipf_allocation();
+   void test_deterministic();
+   void test_file_names();
+   void test_write_library();
+   void test_playlists_match_catalog();
+
+public:
+   TestLibraryGenerator();
+
+};
+
+#endif
+
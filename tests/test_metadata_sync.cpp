@@ -0,0 +1,324 @@
+#include <string>
+#include <vector>
+
+#include "test_metadata_sync.h"
+#include "metadata_sync.h"
+#include "jukebox_db.h"
+#include "fs_storage_system.h"
+#include "fs_test_case.h"
+#include "property_set.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+static const string METADATA_CONTAINER = "music-metadata";
+static const string SNAPSHOT_OBJECT = "jukebox_db.sqlite3";
+
+static SongMetadata make_song(const string& song_uid) {
+   SongMetadata song;
+   song.set_file_uid(song_uid);
+   song.set_object_name(song_uid);
+   song.set_container_name("songs");
+   song.set_song_name(song_uid);
+   song.set_md5_hash("asdf");
+   return song;
+}
+
+static int count_songs(JukeboxDB& jbdb) {
+   vector<SongMetadata> songs;
+   jbdb.retrieve_album_songs("", "", songs);
+   return (int) songs.size();
+}
+
+static bool have_object(FSStorageSystem& fs, const string& object_name) {
+   vector<string> contents = fs.list_container_contents(METADATA_CONTAINER);
+   for (const auto& name : contents) {
+      if (name == object_name) {
+         return true;
+      }
+   }
+   return false;
+}
+
+TestMetadataSync::TestMetadataSync() :
+   TestSuite("TestMetadataSync") {
+}
+
+void TestMetadataSync::runTests() {
+   test_delta_seq_from_name();
+   test_push_pull();
+   test_compaction();
+   test_force_snapshot();
+   test_snapshot_replaced();
+}
+
+void TestMetadataSync::test_delta_seq_from_name() {
+   TEST_CASE("test_delta_seq_from_name");
+   int64_t seq = 0;
+   require(MetadataSync::delta_seq_from_name(SNAPSHOT_OBJECT,
+                                             "jukebox_db.sqlite3.delta.000000000042",
+                                             seq),
+           "delta name must be recognized");
+   require(seq == 42, "delta seq must be parsed");
+   requireFalse(MetadataSync::delta_seq_from_name(SNAPSHOT_OBJECT, SNAPSHOT_OBJECT, seq),
+                "snapshot is not a delta");
+   requireFalse(MetadataSync::delta_seq_from_name(SNAPSHOT_OBJECT,
+                                                  "jukebox_db.sqlite3.delta.",
+                                                  seq),
+                "delta name without seq is not a delta");
+   requireFalse(MetadataSync::delta_seq_from_name(SNAPSHOT_OBJECT,
+                                                  "jukebox_db.sqlite3.delta.12x",
+                                                  seq),
+                "delta name with non-digits is not a delta");
+   requireFalse(MetadataSync::delta_seq_from_name(SNAPSHOT_OBJECT,
+                                                  "other.delta.000000000001",
+                                                  seq),
+                "other object is not a delta");
+}
+
+void TestMetadataSync::test_push_pull() {
+   TEST_CASE("test_push_pull");
+   string test_dir = "/tmp/test_cpp_metadata_sync_push_pull";
+   FSTestCase test_case(*this, test_dir);
+   FSStorageSystem fs(OSUtils::pathJoin(test_dir, "storage"), false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container(METADATA_CONTAINER), "create container must work");
+
+   string db_path_a = OSUtils::pathJoin(test_dir, "a.sqlite3");
+   string db_path_b = OSUtils::pathJoin(test_dir, "b.sqlite3");
+   JukeboxDB jbdb_a(db_path_a);
+   JukeboxDB jbdb_b(db_path_b);
+   MetadataSync sync_a(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_a, 10);
+   MetadataSync sync_b(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_b, 10);
+
+   require(sync_a.pull(jbdb_a), "pull of empty catalog must return true");
+   require(jbdb_a.store_song_metadata(make_song("A--B--One.flac")), "store must return true");
+   require(jbdb_a.store_song_metadata(make_song("A--B--Two.flac")), "store must return true");
+   require(sync_a.push(jbdb_a), "push must return true");
+
+   string delta_1 = SNAPSHOT_OBJECT + ".delta.000000000001";
+   require(have_object(fs, delta_1), "push must upload a delta");
+   requireFalse(have_object(fs, SNAPSHOT_OBJECT), "push must not upload a snapshot");
+
+   vector<string> stored_uids;
+   vector<string> deleted_uids;
+   jbdb_a.get_changes(stored_uids, deleted_uids);
+   require(stored_uids.empty() && deleted_uids.empty(), "push must clear changes");
+   require(sync_a.push(jbdb_a), "push without changes must return true");
+   requireFalse(have_object(fs, SNAPSHOT_OBJECT + ".delta.000000000002"),
+                "push without changes must not upload a delta");
+
+   require(sync_b.pull(jbdb_b), "pull must return true");
+   require(count_songs(jbdb_b) == 2, "pull must apply delta");
+   jbdb_b.get_changes(stored_uids, deleted_uids);
+   require(stored_uids.empty() && deleted_uids.empty(),
+           "applied changes must not be logged");
+
+   require(jbdb_a.delete_song("A--B--One.flac"), "delete must return true");
+   require(jbdb_a.store_song_metadata(make_song("A--B--Three.flac")), "store must return true");
+   require(sync_a.push(jbdb_a), "push must return true");
+
+   // the delta b has already applied isn't needed again
+   require(fs.delete_object(METADATA_CONTAINER, delta_1), "delete delta must work");
+   jbdb_b.close();
+   require(sync_b.pull(jbdb_b), "pull must return true");
+   require(count_songs(jbdb_b) == 2, "pull must apply only the new delta");
+   SongMetadata song;
+   requireFalse(jbdb_b.retrieve_song("A--B--One.flac", song), "deleted song must be gone");
+   require(jbdb_b.retrieve_song("A--B--Three.flac", song), "stored song must exist");
+
+   // b publishes on top of a's deltas, and a catches up before publishing
+   require(jbdb_b.store_song_metadata(make_song("A--B--Four.flac")), "store must return true");
+   require(sync_b.push(jbdb_b), "push must return true");
+   require(jbdb_a.store_song_metadata(make_song("A--B--Five.flac")), "store must return true");
+   require(sync_a.push(jbdb_a), "push must return true");
+   require(count_songs(jbdb_a) == 4, "push must apply unseen deltas first");
+   require(sync_b.pull(jbdb_b), "pull must return true");
+   require(count_songs(jbdb_b) == 4, "pull must apply the newest delta");
+
+   jbdb_a.close();
+   jbdb_b.close();
+   fs.exit();
+}
+
+void TestMetadataSync::test_compaction() {
+   TEST_CASE("test_compaction");
+   string test_dir = "/tmp/test_cpp_metadata_sync_compaction";
+   FSTestCase test_case(*this, test_dir);
+   FSStorageSystem fs(OSUtils::pathJoin(test_dir, "storage"), false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container(METADATA_CONTAINER), "create container must work");
+
+   string db_path_a = OSUtils::pathJoin(test_dir, "a.sqlite3");
+   string db_path_b = OSUtils::pathJoin(test_dir, "b.sqlite3");
+   string db_path_c = OSUtils::pathJoin(test_dir, "c.sqlite3");
+   JukeboxDB jbdb_a(db_path_a);
+   JukeboxDB jbdb_b(db_path_b);
+   JukeboxDB jbdb_c(db_path_c);
+   MetadataSync sync_a(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_a, 3);
+   MetadataSync sync_b(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_b, 3);
+   MetadataSync sync_c(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_c, 3);
+
+   require(sync_a.pull(jbdb_a), "pull must return true");
+   require(jbdb_a.store_song_metadata(make_song("A--B--One.flac")), "store must return true");
+   require(sync_a.push(jbdb_a), "push must return true");
+
+   // c falls behind after the first delta
+   require(sync_c.pull(jbdb_c), "pull must return true");
+   require(count_songs(jbdb_c) == 1, "pull must apply delta");
+
+   require(jbdb_a.store_song_metadata(make_song("A--B--Two.flac")), "store must return true");
+   require(sync_a.push(jbdb_a), "push must return true");
+   requireFalse(have_object(fs, SNAPSHOT_OBJECT), "compaction must wait for interval");
+   require(jbdb_a.store_song_metadata(make_song("A--B--Three.flac")), "store must return true");
+   require(sync_a.push(jbdb_a), "push must return true");
+
+   require(have_object(fs, SNAPSHOT_OBJECT), "compaction must upload snapshot");
+   requireFalse(have_object(fs, SNAPSHOT_OBJECT + ".delta.000000000001"),
+                "compaction must delete older deltas");
+   requireFalse(have_object(fs, SNAPSHOT_OBJECT + ".delta.000000000002"),
+                "compaction must delete older deltas");
+   require(have_object(fs, SNAPSHOT_OBJECT + ".delta.000000000003"),
+           "compaction must keep newest delta");
+   require(jbdb_a.is_open(), "DB must be reopened after compaction");
+   require(count_songs(jbdb_a) == 3, "DB must be intact after compaction");
+
+   // a new DB starts from the snapshot
+   require(sync_b.pull(jbdb_b), "pull must return true");
+   require(count_songs(jbdb_b) == 3, "pull must download snapshot");
+   int64_t applied = 0;
+   require(jbdb_b.get_sync_value(MetadataSync::APPLIED_DELTA, applied), "applied delta must be set");
+   require(applied == 3, "snapshot must include delta 3");
+
+   // c can't catch up from deltas alone
+   require(jbdb_c.store_song_metadata(make_song("C--D--Lost.flac")), "store must return true");
+   jbdb_c.close();
+   require(sync_c.pull(jbdb_c), "pull must return true");
+   require(count_songs(jbdb_c) == 3, "pull must fall back to snapshot");
+   SongMetadata lost_song;
+   requireFalse(jbdb_c.retrieve_song("C--D--Lost.flac", lost_song),
+                "unpublished song must be discarded");
+   vector<string> stored_song_uids;
+   vector<string> deleted_song_uids;
+   require(jbdb_c.get_changes(stored_song_uids, deleted_song_uids) &&
+           stored_song_uids.empty() && deleted_song_uids.empty(),
+           "unpublished changes must be discarded");
+
+   // and the next delta after the snapshot applies normally
+   require(jbdb_a.store_song_metadata(make_song("A--B--Four.flac")), "store must return true");
+   require(sync_a.push(jbdb_a), "push must return true");
+   require(sync_c.pull(jbdb_c), "pull must return true");
+   require(count_songs(jbdb_c) == 4, "pull must apply delta after snapshot");
+
+   jbdb_a.close();
+   jbdb_b.close();
+   jbdb_c.close();
+   fs.exit();
+}
+
+void TestMetadataSync::test_force_snapshot() {
+   TEST_CASE("test_force_snapshot");
+   string test_dir = "/tmp/test_cpp_metadata_sync_force_snapshot";
+   FSTestCase test_case(*this, test_dir);
+   FSStorageSystem fs(OSUtils::pathJoin(test_dir, "storage"), false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container(METADATA_CONTAINER), "create container must work");
+
+   string db_path_a = OSUtils::pathJoin(test_dir, "a.sqlite3");
+   string db_path_b = OSUtils::pathJoin(test_dir, "b.sqlite3");
+   JukeboxDB jbdb_a(db_path_a);
+   JukeboxDB jbdb_b(db_path_b);
+   MetadataSync sync_a(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_a, 10);
+   MetadataSync sync_b(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_b, 10);
+
+   // b is in sync with an empty catalog
+   require(sync_b.pull(jbdb_b), "pull must return true");
+
+   // a DB with songs that were never published as deltas
+   require(jbdb_a.open(), "open must return true");
+   jbdb_a.set_change_logging(false);
+   require(jbdb_a.store_song_metadata(make_song("A--B--One.flac")), "store must return true");
+   jbdb_a.set_change_logging(true);
+
+   require(sync_a.push(jbdb_a, true), "forced push must return true");
+   require(have_object(fs, SNAPSHOT_OBJECT), "forced push must upload snapshot");
+   requireFalse(have_object(fs, SNAPSHOT_OBJECT + ".delta.000000000001"),
+                "snapshot must skip a delta");
+   require(have_object(fs, SNAPSHOT_OBJECT + ".delta.000000000002"),
+           "snapshot must be marked with a delta");
+
+   jbdb_b.close();
+   require(sync_b.pull(jbdb_b), "pull must return true");
+   require(count_songs(jbdb_b) == 1, "synced DB must pick up the snapshot");
+
+   jbdb_a.close();
+   jbdb_b.close();
+   fs.exit();
+}
+
+
+void TestMetadataSync::test_snapshot_replaced() {
+   TEST_CASE("test_snapshot_replaced");
+   string test_dir = "/tmp/test_cpp_metadata_sync_snapshot_replaced";
+   FSTestCase test_case(*this, test_dir);
+   FSStorageSystem fs(OSUtils::pathJoin(test_dir, "storage"), false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container(METADATA_CONTAINER), "create container must work");
+
+   string db_path_a = OSUtils::pathJoin(test_dir, "a.sqlite3");
+   string db_path_b = OSUtils::pathJoin(test_dir, "b.sqlite3");
+   string db_path_c = OSUtils::pathJoin(test_dir, "c.sqlite3");
+   JukeboxDB jbdb_a(db_path_a);
+   JukeboxDB jbdb_b(db_path_b);
+   MetadataSync sync_a(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_a, 10);
+   MetadataSync sync_b(fs, METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_b, 10);
+
+   require(sync_a.pull(jbdb_a), "pull must return true");
+   require(jbdb_a.store_song_metadata(make_song("A--B--One.flac")), "store must return true");
+   require(sync_a.push(jbdb_a, true), "forced push must return true");
+
+   PropertySet props;
+   require(fs.get_object_metadata(METADATA_CONTAINER, SNAPSHOT_OBJECT, props),
+           "snapshot must have metadata");
+   require(props.get_string_value(PropertySet::PROP_CONTENT_MD5).length() == 32,
+           "snapshot must carry its md5");
+   int64_t tag = 0;
+   require(jbdb_a.get_sync_value(MetadataSync::SNAPSHOT_TAG, tag) && tag != 0,
+           "snapshot tag must be recorded on upload");
+
+   require(sync_b.pull(jbdb_b), "pull must return true");
+   require(count_songs(jbdb_b) == 1, "pull must download snapshot");
+   int64_t tag_b = 0;
+   require(jbdb_b.get_sync_value(MetadataSync::SNAPSHOT_TAG, tag_b) && tag_b == tag,
+           "snapshot tag must be recorded on download");
+
+   // an unchanged snapshot isn't downloaded again, which would lose this
+   jbdb_b.set_change_logging(false);
+   require(jbdb_b.store_song_metadata(make_song("B--C--Local.flac")), "store must return true");
+   jbdb_b.set_change_logging(true);
+   require(sync_b.pull(jbdb_b), "pull must return true");
+   require(count_songs(jbdb_b) == 2, "unchanged snapshot must not be downloaded");
+
+   // the whole DB is uploaded over the snapshot without a delta
+   {
+      JukeboxDB jbdb_c(db_path_c);
+      require(jbdb_c.open(), "open must return true");
+      require(jbdb_c.store_song_metadata(make_song("C--D--One.flac")), "store must return true");
+      require(jbdb_c.store_song_metadata(make_song("C--D--Two.flac")), "store must return true");
+      require(jbdb_c.store_song_metadata(make_song("C--D--Three.flac")), "store must return true");
+      jbdb_c.close();
+   }
+   PropertySet headers;
+   headers.set_content_md5(Utils::md5_for_file(db_path_c));
+   require(fs.put_object_from_file(METADATA_CONTAINER, SNAPSHOT_OBJECT, db_path_c, &headers),
+           "put snapshot must work");
+
+   require(sync_b.pull(jbdb_b), "pull must return true");
+   require(count_songs(jbdb_b) == 3, "replaced snapshot must be downloaded");
+
+   jbdb_a.close();
+   jbdb_b.close();
+   fs.exit();
+}
@@ -0,0 +1,23 @@
+#ifndef TEST_METADATA_SYNC_H
+#define TEST_METADATA_SYNC_H
+
+#include "TestSuite.h"
+
+
+class TestMetadataSync : public chaudiere::TestSuite {
+protected:
+   void runTests();
+
+   void test_delta_seq_from_name();
+   void test_push_pull();
+   void test_compaction();
+   void test_force_snapshot();
+   void test_snapshot_replaced();
+
+public:
+   TestMetadataSync();
+
+};
+
+#endif
+
@@ -0,0 +1,130 @@
+#include <string>
+#include <vector>
+
+#include "test_metered_storage_system.h"
+#include "metered_storage_system.h"
+#include "latency_histogram.h"
+#include "fs_storage_system.h"
+#include "fs_test_case.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+static const string CONTAINER = "songs";
+
+TestMeteredStorageSystem::TestMeteredStorageSystem() :
+   TestSuite("TestMeteredStorageSystem") {
+}
+
+void TestMeteredStorageSystem::runTests() {
+   test_latency_histogram();
+   test_histogram_merge();
+   test_operation_stats();
+}
+
+void TestMeteredStorageSystem::test_latency_histogram() {
+   TEST_CASE("test_latency_histogram");
+   LatencyHistogram histogram;
+   require(histogram.count() == 0, "new histogram must be empty");
+   require(histogram.percentile_micros(0.5) == 0, "empty percentile must be 0");
+
+   // 1..1000 ms
+   for (uint64_t i = 1; i <= 1000; ++i) {
+      histogram.record_micros(i * 1000);
+   }
+   require(histogram.count() == 1000, "count must include every value");
+   require(histogram.min_micros() == 1000, "min must be smallest value");
+   require(histogram.max_micros() == 1000000, "max must be largest value");
+   require(histogram.mean_micros() == 500500.0, "mean must be exact");
+
+   uint64_t p50 = histogram.percentile_micros(0.50);
+   uint64_t p99 = histogram.percentile_micros(0.99);
+   require(p50 >= 500000 && p50 <= 500000 * 107 / 100,
+           "p50 must be within bucket precision");
+   require(p99 >= 990000 && p99 <= 1000000, "p99 must be within bucket precision");
+   require(histogram.percentile_micros(1.0) == 1000000, "p100 must be max");
+   require(histogram.percentile_micros(0.0) == 1000, "p0 must be min");
+
+   // small values are exact
+   LatencyHistogram small;
+   small.record_micros(3);
+   small.record_micros(7);
+   require(small.percentile_micros(0.5) == 3, "small values must be exact");
+
+   // huge values land in the last bucket without overflowing
+   small.record(1.0e9);
+   require(small.max_micros() == 1000000000000000ULL, "max must keep huge value");
+   require(small.percentile_micros(1.0) > 0, "huge value must be counted");
+
+   histogram.reset();
+   require(histogram.count() == 0, "reset must clear counts");
+}
+
+void TestMeteredStorageSystem::test_histogram_merge() {
+   TEST_CASE("test_histogram_merge");
+   LatencyHistogram fast;
+   LatencyHistogram slow;
+   for (int i = 0; i < 90; ++i) {
+      fast.record_micros(100);
+   }
+   for (int i = 0; i < 10; ++i) {
+      slow.record_micros(100000);
+   }
+   fast.merge(slow);
+   require(fast.count() == 100, "merge must add counts");
+   require(fast.min_micros() == 100, "merge must keep min");
+   require(fast.max_micros() == 100000, "merge must take max");
+   require(fast.percentile_micros(0.5) <= 104, "p50 must be the fast values");
+   require(fast.percentile_micros(0.95) >= 100000, "p95 must be the slow values");
+}
+
+void TestMeteredStorageSystem::test_operation_stats() {
+   TEST_CASE("test_operation_stats");
+   string test_dir = "/tmp/test_cpp_metered_operation_stats";
+   FSTestCase test_case(*this, test_dir);
+   MeteredStorageSystem mss(new FSStorageSystem(test_dir));
+   require(mss.get_storage_system_type() == "FS", "type must be the wrapped type");
+   require(mss.enter(), "enter must return true");
+   require(mss.create_container(CONTAINER), "create container must work");
+   require(mss.has_container(CONTAINER), "created container must be known");
+
+   vector<unsigned char> contents(1000, 'x');
+   require(mss.put_object(CONTAINER, "one", contents), "put must work");
+   require(mss.put_object(CONTAINER, "two", contents), "put must work");
+   string local_file = OSUtils::pathJoin(test_dir, "one.copy");
+   require(mss.get_object(CONTAINER, "one", local_file) == 1000, "get must work");
+   requireFalse(mss.get_object(CONTAINER, "missing", local_file) > 0,
+                "get of missing object must fail");
+
+   int64_t bytes_read = mss.get_object_range(CONTAINER, "two", 100, 200,
+      [](const unsigned char*, size_t) { return true; });
+   require(bytes_read == 200, "range must work");
+   require(mss.list_container_contents(CONTAINER).size() == 2, "list must work");
+
+   StorageOpStats put_stats = mss.get_stats(MeteredStorageSystem::OP_PUT_OBJECT);
+   require(put_stats.count == 2, "puts must be counted");
+   require(put_stats.errors == 0, "successful puts must not be errors");
+   require(put_stats.bytes == 2000, "put bytes must be counted");
+   require(put_stats.latency.count() == 2, "put latencies must be recorded");
+
+   StorageOpStats get_stats = mss.get_stats(MeteredStorageSystem::OP_GET_OBJECT);
+   require(get_stats.count == 2, "gets must be counted");
+   require(get_stats.errors == 1, "failed get must be an error");
+   require(get_stats.bytes == 1000, "only retrieved bytes must be counted");
+
+   StorageOpStats range_stats = mss.get_stats(MeteredStorageSystem::OP_GET_OBJECT_RANGE);
+   require(range_stats.count == 1 && range_stats.bytes == 200,
+           "range must be counted");
+   require(mss.get_stats(MeteredStorageSystem::OP_LIST_CONTAINER_CONTENTS).count == 1,
+           "list must be counted");
+   require(mss.get_stats(MeteredStorageSystem::OP_DELETE_OBJECT).count == 0,
+           "unused operations must be empty");
+
+   mss.show_stats();
+   mss.reset_stats();
+   require(mss.get_stats(MeteredStorageSystem::OP_PUT_OBJECT).count == 0,
+           "reset must clear stats");
+}
+
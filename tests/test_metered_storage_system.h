@@ -0,0 +1,21 @@
+#ifndef TEST_METERED_STORAGE_SYSTEM_H
+#define TEST_METERED_STORAGE_SYSTEM_H
+
+#include "TestSuite.h"
+
+
+class TestMeteredStorageSystem : public chaudiere::TestSuite {
+protected:
+   void runTests();
+
+   void test_latency_histogram();
+   void test_histogram_merge();
+   void test_operation_stats();
+
+public:
+   TestMeteredStorageSystem();
+
+};
+
+#endif
+
@@ -0,0 +1,329 @@
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_retrying_storage_system.h"
+#include "retrying_storage_system.h"
+#include "fs_storage_system.h"
+#include "fs_test_case.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+static const string CONTAINER = "songs";
+static const string OBJECT = "A--B--Song.flac";
+
+// FS storage that fails (or stalls) its next few requests
+class FlakyStorageSystem : public FSStorageSystem {
+public:
+   atomic<int> m_failures;
+   atomic<int> m_slow_reads;
+   atomic<int> m_calls;
+   // bytes a failing range read delivers before failing
+   int64_t m_partial_bytes;
+
+   FlakyStorageSystem(const string& root_dir) :
+      FSStorageSystem(root_dir),
+      m_failures(0),
+      m_slow_reads(0),
+      m_calls(0),
+      m_partial_bytes(0) {
+   }
+
+   bool fail() {
+      ++m_calls;
+      return m_failures.fetch_sub(1) > 0;
+   }
+
+   void stall() {
+      if (m_slow_reads.fetch_sub(1) > 0) {
+         this_thread::sleep_for(chrono::milliseconds(1500));
+      }
+   }
+
+   bool put_object(const string& container_name,
+                   const string& object_name,
+                   const vector<unsigned char>& file_contents,
+                   const PropertySet* headers=nullptr) {
+      if (fail()) {
+         return false;
+      }
+      return FSStorageSystem::put_object(container_name,
+                                         object_name,
+                                         file_contents,
+                                         headers);
+   }
+
+   bool put_object_stream(const string& container_name,
+                          const string& object_name,
+                          const ObjectSource& source,
+                          const PropertySet* headers=nullptr) {
+      if (fail()) {
+         // the source is consumed before the request fails
+         unsigned char buffer[16];
+         source(buffer, sizeof(buffer));
+         return false;
+      }
+      return FSStorageSystem::put_object_stream(container_name,
+                                                object_name,
+                                                source,
+                                                headers);
+   }
+
+   int64_t get_object(const string& container_name,
+                      const string& object_name,
+                      const string& local_file_path) {
+      bool failing = fail();
+      stall();
+      if (failing) {
+         return 0;
+      }
+      return FSStorageSystem::get_object(container_name,
+                                         object_name,
+                                         local_file_path);
+   }
+
+   int64_t get_object_range(const string& container_name,
+                            const string& object_name,
+                            int64_t offset,
+                            int64_t length,
+                            const ObjectSink& sink) {
+      bool failing = fail();
+      stall();
+      if (failing) {
+         if (m_partial_bytes > 0) {
+            FSStorageSystem::get_object_range(container_name,
+                                              object_name,
+                                              offset,
+                                              m_partial_bytes,
+                                              sink);
+         }
+         return 0;
+      }
+      return FSStorageSystem::get_object_range(container_name,
+                                               object_name,
+                                               offset,
+                                               length,
+                                               sink);
+   }
+};
+
+static vector<unsigned char> make_contents(size_t length) {
+   vector<unsigned char> contents(length);
+   for (size_t i = 0; i < length; ++i) {
+      contents[i] = (unsigned char) (i * 7);
+   }
+   return contents;
+}
+
+static RetryingStorageSystem* make_retrying(FlakyStorageSystem* flaky,
+                                            unsigned int max_attempts,
+                                            bool hedge_reads=false) {
+   RetryingStorageSystem* rss = new RetryingStorageSystem(flaky,
+                                                          max_attempts,
+                                                          hedge_reads);
+   rss->set_backoff(1, 5);
+   return rss;
+}
+
+TestRetryingStorageSystem::TestRetryingStorageSystem() :
+   TestSuite("TestRetryingStorageSystem") {
+}
+
+void TestRetryingStorageSystem::runTests() {
+   test_latency_window();
+   test_retry_put();
+   test_max_attempts();
+   test_range_resume();
+   test_put_stream_not_resent();
+   test_hedged_range();
+   test_hedged_get_object();
+}
+
+void TestRetryingStorageSystem::test_latency_window() {
+   TEST_CASE("test_latency_window");
+   LatencyWindow window(10);
+   require(window.count() == 0, "new window must be empty");
+   require(window.percentile(0.95) == 0.0, "empty window percentile must be 0");
+   for (int i = 1; i <= 20; ++i) {
+      window.add_sample(i);
+   }
+   require(window.count() == 10, "window must keep only its capacity");
+   require(window.percentile(0.0) == 11.0, "oldest samples must be replaced");
+   require(window.percentile(1.0) == 20.0, "p100 must be the largest sample");
+   require(window.percentile(0.5) > 14.0 && window.percentile(0.5) < 17.0,
+           "p50 must be the middle sample");
+}
+
+void TestRetryingStorageSystem::test_retry_put() {
+   TEST_CASE("test_retry_put");
+   string test_dir = "/tmp/test_cpp_retrying_retry_put";
+   FSTestCase test_case(*this, test_dir);
+   FlakyStorageSystem* flaky = new FlakyStorageSystem(test_dir);
+   unique_ptr<RetryingStorageSystem> rss(make_retrying(flaky, 3));
+   require(rss->enter(), "enter must return true");
+   require(rss->create_container(CONTAINER), "create container must work");
+   require(rss->has_container(CONTAINER), "created container must be known");
+
+   flaky->m_failures = 2;
+   require(rss->put_object(CONTAINER, OBJECT, make_contents(100)),
+           "put must succeed within its attempts");
+   require(flaky->m_calls == 3, "put must be attempted 3 times");
+   require(Utils::get_file_size(OSUtils::pathJoin(OSUtils::pathJoin(test_dir, CONTAINER), OBJECT)) == 100,
+           "object must be stored");
+}
+
+void TestRetryingStorageSystem::test_max_attempts() {
+   TEST_CASE("test_max_attempts");
+   string test_dir = "/tmp/test_cpp_retrying_max_attempts";
+   FSTestCase test_case(*this, test_dir);
+   FlakyStorageSystem* flaky = new FlakyStorageSystem(test_dir);
+   unique_ptr<RetryingStorageSystem> rss(make_retrying(flaky, 3));
+   require(rss->enter(), "enter must return true");
+   require(rss->create_container(CONTAINER), "create container must work");
+
+   flaky->m_failures = 5;
+   requireFalse(rss->put_object(CONTAINER, OBJECT, make_contents(100)),
+                "put must fail when attempts run out");
+   require(flaky->m_calls == 3, "put must stop after max attempts");
+
+   // a deadline shorter than the backoff stops retrying early
+   flaky->m_calls = 0;
+   flaky->m_failures = 5;
+   rss->set_backoff(50, 50);
+   rss->set_deadline_ms(1);
+   requireFalse(rss->put_object(CONTAINER, OBJECT, make_contents(100)),
+                "put must fail past its deadline");
+   require(flaky->m_calls < 3, "deadline must stop retries");
+}
+
+void TestRetryingStorageSystem::test_range_resume() {
+   TEST_CASE("test_range_resume");
+   string test_dir = "/tmp/test_cpp_retrying_range_resume";
+   FSTestCase test_case(*this, test_dir);
+   FlakyStorageSystem* flaky = new FlakyStorageSystem(test_dir);
+   unique_ptr<RetryingStorageSystem> rss(make_retrying(flaky, 3));
+   require(rss->enter(), "enter must return true");
+   require(rss->create_container(CONTAINER), "create container must work");
+   vector<unsigned char> contents = make_contents(1000);
+   require(rss->put_object(CONTAINER, OBJECT, contents), "put must work");
+
+   // the first attempt delivers 100 bytes and then fails
+   flaky->m_failures = 1;
+   flaky->m_partial_bytes = 100;
+   vector<unsigned char> received;
+   ObjectSink sink = [&](const unsigned char* data, size_t num_bytes) {
+      received.insert(received.end(), data, data + num_bytes);
+      return true;
+   };
+   int64_t bytes_read = rss->get_object_range(CONTAINER, OBJECT, 200, 500, sink);
+   require(bytes_read == 500, "range must be read in full");
+   require(received == vector<unsigned char>(contents.begin() + 200,
+                                             contents.begin() + 700),
+           "resumed range must not repeat bytes");
+}
+
+void TestRetryingStorageSystem::test_put_stream_not_resent() {
+   TEST_CASE("test_put_stream_not_resent");
+   string test_dir = "/tmp/test_cpp_retrying_put_stream";
+   FSTestCase test_case(*this, test_dir);
+   FlakyStorageSystem* flaky = new FlakyStorageSystem(test_dir);
+   unique_ptr<RetryingStorageSystem> rss(make_retrying(flaky, 3));
+   require(rss->enter(), "enter must return true");
+   require(rss->create_container(CONTAINER), "create container must work");
+
+   vector<unsigned char> contents = make_contents(100);
+   size_t position = 0;
+   ObjectSource source = [&](unsigned char* buffer, size_t max_bytes) -> int64_t {
+      size_t num_bytes = min(max_bytes, contents.size() - position);
+      memcpy(buffer, contents.data() + position, num_bytes);
+      position += num_bytes;
+      return num_bytes;
+   };
+
+   flaky->m_failures = 1;
+   requireFalse(rss->put_object_stream(CONTAINER, OBJECT, source),
+                "put stream must fail once its source was read");
+   require(flaky->m_calls == 1, "read source must not be sent again");
+}
+
+void TestRetryingStorageSystem::test_hedged_range() {
+   TEST_CASE("test_hedged_range");
+   string test_dir = "/tmp/test_cpp_retrying_hedged_range";
+   FSTestCase test_case(*this, test_dir);
+   FlakyStorageSystem* flaky = new FlakyStorageSystem(test_dir);
+   unique_ptr<RetryingStorageSystem> rss(make_retrying(flaky, 1, true));
+   require(rss->enter(), "enter must return true");
+   require(rss->create_container(CONTAINER), "create container must work");
+   vector<unsigned char> contents = make_contents(4096);
+   require(rss->put_object(CONTAINER, OBJECT, contents), "put must work");
+
+   vector<unsigned char> received;
+   ObjectSink sink = [&](const unsigned char* data, size_t num_bytes) {
+      received.insert(received.end(), data, data + num_bytes);
+      return true;
+   };
+   for (size_t i = 0; i < RetryingStorageSystem::MIN_HEDGE_SAMPLES; ++i) {
+      received.clear();
+      require(rss->get_object_range(CONTAINER, OBJECT, 0, 1024, sink) == 1024,
+              "range read must work");
+   }
+
+   // the first copy stalls, so the hedge must answer
+   flaky->m_calls = 0;
+   flaky->m_slow_reads = 1;
+   received.clear();
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   int64_t bytes_read = rss->get_object_range(CONTAINER, OBJECT, 1024, 1024, sink);
+   double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   require(bytes_read == 1024, "hedged range must be read");
+   require(received == vector<unsigned char>(contents.begin() + 1024,
+                                             contents.begin() + 2048),
+           "hedged range must be delivered once");
+   require(elapsed < 1.0, "hedged range must not wait for the slow copy");
+   require(flaky->m_calls == 2, "slow read must be hedged");
+   rss->exit();
+}
+
+void TestRetryingStorageSystem::test_hedged_get_object() {
+   TEST_CASE("test_hedged_get_object");
+   string test_dir = "/tmp/test_cpp_retrying_hedged_get_object";
+   FSTestCase test_case(*this, test_dir);
+   FlakyStorageSystem* flaky = new FlakyStorageSystem(OSUtils::pathJoin(test_dir, "storage"));
+   unique_ptr<RetryingStorageSystem> rss(make_retrying(flaky, 1, true));
+   require(rss->enter(), "enter must return true");
+   require(rss->create_container(CONTAINER), "create container must work");
+   require(rss->put_object(CONTAINER, OBJECT, make_contents(4096)), "put must work");
+
+   string local_file = OSUtils::pathJoin(test_dir, "song.flac");
+   for (size_t i = 0; i < RetryingStorageSystem::MIN_HEDGE_SAMPLES; ++i) {
+      require(rss->get_object(CONTAINER, OBJECT, local_file) == 4096,
+              "get object must work");
+   }
+
+   flaky->m_calls = 0;
+   flaky->m_slow_reads = 1;
+   Utils::file_delete(local_file);
+   require(rss->get_object(CONTAINER, OBJECT, local_file) == 4096,
+           "hedged get object must work");
+   require(flaky->m_calls == 2, "slow get object must be hedged");
+   require(Utils::get_file_size(local_file) == 4096, "winning copy must be kept");
+
+   // the losing copy's download is cleaned up once it finishes
+   rss->exit();
+   require(Utils::file_exists(local_file), "downloaded file must remain");
+   vector<string> hedge_files;
+   for (const auto& file_name : OSUtils::listFilesInDirectory(test_dir)) {
+      if (file_name.find(".hedge") != string::npos) {
+         hedge_files.push_back(file_name);
+      }
+   }
+   require(hedge_files.empty(), "hedge copies must be deleted or renamed");
+}
+
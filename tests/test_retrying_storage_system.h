@@ -0,0 +1,25 @@
+#ifndef TEST_RETRYING_STORAGE_SYSTEM_H
+#define TEST_RETRYING_STORAGE_SYSTEM_H
+
+#include "TestSuite.h"
+
+
+class TestRetryingStorageSystem : public chaudiere::TestSuite {
+protected:
+   void runTests();
+
+   void test_latency_window();
+   void test_retry_put();
+   void test_max_attempts();
+   void test_range_resume();
+   void test_put_stream_not_resent();
+   void test_hedged_range();
+   void test_hedged_get_object();
+
+public:
+   TestRetryingStorageSystem();
+
+};
+
+#endif
+
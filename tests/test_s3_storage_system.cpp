@@ -1,4 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+
 #include "test_s3_storage_system.h"
+#include "s3_storage_system.h"
+#include "utils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+// These tests run against a local S3-compatible server (e.g., MinIO).
+// The endpoint and credentials default to a stock MinIO install and
+// can be overridden with S3_TEST_HOST, S3_TEST_ACCESS_KEY and
+// S3_TEST_SECRET_KEY. When no server is reachable the tests are skipped.
+
+static const string TEST_CONTAINER = "test-cpp-s3storagesystem";
+
+static string env_or_default(const char* env_name, const string& default_value) {
+   const char* value = getenv(env_name);
+   if (value != nullptr && value[0] != '\0') {
+      return string(value);
+   }
+   return default_value;
+}
+
+static S3StorageSystem* new_s3_storage_system() {
+   return new S3StorageSystem(env_or_default("S3_TEST_ACCESS_KEY", "minioadmin"),
+                              env_or_default("S3_TEST_SECRET_KEY", "minioadmin"),
+                              "http",
+                              env_or_default("S3_TEST_HOST", "localhost:9000"),
+                              "",
+                              false);
+}
+
+// returns a connected storage system with an empty test container,
+// or nullptr if no server is available
+static S3StorageSystem* connect_s3_storage_system() {
+   S3StorageSystem* s3 = new_s3_storage_system();
+   if (!s3->enter()) {
+      printf("skipping: no S3 server available\n");
+      delete s3;
+      return nullptr;
+   }
+
+   if (s3->has_container(TEST_CONTAINER)) {
+      for (const auto& object_name : s3->list_container_contents(TEST_CONTAINER)) {
+         s3->delete_object(TEST_CONTAINER, object_name);
+      }
+      s3->delete_container(TEST_CONTAINER);
+   }
+
+   return s3;
+}
+
+static void cleanup_s3_storage_system(S3StorageSystem* s3) {
+   for (const auto& object_name : s3->list_container_contents(TEST_CONTAINER)) {
+      s3->delete_object(TEST_CONTAINER, object_name);
+   }
+   s3->delete_container(TEST_CONTAINER);
+   s3->exit();
+   delete s3;
+}
+
 
 TestS3StorageSystem::TestS3StorageSystem() :
    TestSuite("TestS3StorageSystem") {
@@ -15,55 +79,211 @@ void TestS3StorageSystem::runTests() {
    test_put_object();
    test_delete_object();
    test_get_object();
+   test_put_object_multipart();
 }
 
 void TestS3StorageSystem::test_enter() {
    TEST_CASE("test_enter");
-   //TODO: implement test_enter
+   unique_ptr<S3StorageSystem> s3(new_s3_storage_system());
+   if (!s3->enter()) {
+      printf("skipping: no S3 server available\n");
+      return;
+   }
+   require(s3->enter(), "enter must be repeatable");
+   s3->exit();
 }
 
 void TestS3StorageSystem::test_exit() {
    TEST_CASE("test_exit");
-   //TODO: implement test_exit
+   unique_ptr<S3StorageSystem> s3(new_s3_storage_system());
+   s3->exit();
+   if (s3->enter()) {
+      s3->exit();
+      requireFalse(s3->create_container(TEST_CONTAINER),
+                   "operations must fail after exit");
+   }
 }
 
 void TestS3StorageSystem::test_list_account_containers() {
    TEST_CASE("test_list_account_containers");
-   //TODO: implement test_list_account_containers
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   vector<string> before = s3->list_account_containers();
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+   vector<string> after = s3->list_account_containers();
+   require(after.size() == before.size() + 1, "created container must be listed");
+   cleanup_s3_storage_system(s3);
 }
 
 void TestS3StorageSystem::test_create_container() {
    TEST_CASE("test_create_container");
-   //TODO: implement test_create_container
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+   require(s3->has_container(TEST_CONTAINER), "created container must be known");
+   requireFalse(s3->create_container(TEST_CONTAINER),
+                "create of existing container must fail");
+   cleanup_s3_storage_system(s3);
 }
 
 void TestS3StorageSystem::test_delete_container() {
    TEST_CASE("test_delete_container");
-   //TODO: implement test_delete_container
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   requireFalse(s3->delete_container(TEST_CONTAINER),
+                "delete of missing container must fail");
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+   require(s3->delete_container(TEST_CONTAINER), "delete container must work");
+   requireFalse(s3->has_container(TEST_CONTAINER),
+                "deleted container must not be known");
+   cleanup_s3_storage_system(s3);
 }
 
 void TestS3StorageSystem::test_list_container_contents() {
    TEST_CASE("test_list_container_contents");
-   //TODO: implement test_list_container_contents
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+   require(s3->list_container_contents(TEST_CONTAINER).empty(),
+           "new container must be empty");
+   const string data = "abcdefghijklmnopqrstuvwxyz";
+   vector<unsigned char> contents(data.begin(), data.end());
+   require(s3->put_object(TEST_CONTAINER, "a", contents), "put object must work");
+   require(s3->put_object(TEST_CONTAINER, "b", contents), "put object must work");
+   require(s3->list_container_contents(TEST_CONTAINER).size() == 2,
+           "stored objects must be listed");
+   cleanup_s3_storage_system(s3);
 }
 
 void TestS3StorageSystem::test_get_object_metadata() {
    TEST_CASE("test_get_object_metadata");
-   //TODO: implement test_get_object_metadata
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+   const string data = "abcdefghijklmnopqrstuvwxyz";
+   vector<unsigned char> contents(data.begin(), data.end());
+   PropertySet headers;
+   headers.add("artist", new StrPropertyValue("Steely Dan"));
+   require(s3->put_object(TEST_CONTAINER, "song", contents, &headers),
+           "put object must work");
+   PropertySet props;
+   require(s3->get_object_metadata(TEST_CONTAINER, "song", props),
+           "get object metadata must work");
+   require(props.get_ulong_value(PropertySet::PROP_CONTENT_LENGTH) == data.length(),
+           "content length must match");
+   requireStringEquals("Steely Dan", props.get_string_value("artist"),
+                       "user metadata must round trip");
+   PropertySet missing_props;
+   requireFalse(s3->get_object_metadata(TEST_CONTAINER, "missing", missing_props),
+                "metadata of missing object must fail");
+   cleanup_s3_storage_system(s3);
 }
 
 void TestS3StorageSystem::test_put_object() {
    TEST_CASE("test_put_object");
-   //TODO: implement test_put_object
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+   const string data = "abcdefghijklmnopqrstuvwxyz";
+   vector<unsigned char> contents(data.begin(), data.end());
+   require(s3->put_object(TEST_CONTAINER, "abc", contents), "put object must work");
+   vector<unsigned char> empty_contents;
+   requireFalse(s3->put_object(TEST_CONTAINER, "empty", empty_contents),
+                "put of empty object must fail");
+
+   const string file_path = "/tmp/test_cpp_s3storagesystem_put_object.txt";
+   require(Utils::file_write_all_text(file_path, data), "write test file");
+   require(s3->put_object_from_file(TEST_CONTAINER, "from-file", file_path),
+           "put object from file must work");
+   Utils::file_delete(file_path);
+   cleanup_s3_storage_system(s3);
 }
 
 void TestS3StorageSystem::test_delete_object() {
    TEST_CASE("test_delete_object");
-   //TODO: implement test_delete_object
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+   const string data = "abcdefghijklmnopqrstuvwxyz";
+   vector<unsigned char> contents(data.begin(), data.end());
+   require(s3->put_object(TEST_CONTAINER, "abc", contents), "put object must work");
+   require(s3->delete_object(TEST_CONTAINER, "abc"), "delete object must work");
+   require(s3->list_container_contents(TEST_CONTAINER).empty(),
+           "deleted object must not be listed");
+   cleanup_s3_storage_system(s3);
 }
 
 void TestS3StorageSystem::test_get_object() {
    TEST_CASE("test_get_object");
-   //TODO: implement test_get_object
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+   const string data = "abcdefghijklmnopqrstuvwxyz";
+   vector<unsigned char> contents(data.begin(), data.end());
+   require(s3->put_object(TEST_CONTAINER, "abc", contents), "put object must work");
+
+   const string file_path = "/tmp/test_cpp_s3storagesystem_get_object.txt";
+   require(s3->get_object(TEST_CONTAINER, "abc", file_path) == (int64_t) data.length(),
+           "get object must return object size");
+   string file_text;
+   require(Utils::file_read_all_text(file_path, file_text), "read retrieved file");
+   requireStringEquals(data, file_text, "retrieved contents must match");
+   Utils::file_delete(file_path);
+
+   require(s3->get_object(TEST_CONTAINER, "missing", file_path) == 0,
+           "get of missing object must return 0");
+   requireFalse(Utils::file_exists(file_path),
+                "failed get must not leave a file behind");
+   cleanup_s3_storage_system(s3);
 }
 
+void TestS3StorageSystem::test_put_object_multipart() {
+   TEST_CASE("test_put_object_multipart");
+   S3StorageSystem* s3 = connect_s3_storage_system();
+   if (s3 == nullptr) {
+      return;
+   }
+   require(s3->create_container(TEST_CONTAINER), "create container must work");
+
+   // 3 parts of minimum size, the last one short
+   const size_t part_size = 5 * 1024 * 1024;
+   s3->set_multipart_part_size(part_size);
+   s3->set_multipart_concurrency(2);
+
+   const string file_path = "/tmp/test_cpp_s3storagesystem_multipart.bin";
+   vector<unsigned char> file_contents(part_size * 2 + 12345);
+   for (size_t i = 0; i < file_contents.size(); i++) {
+      file_contents[i] = (unsigned char) (i % 251);
+   }
+   require(Utils::file_write_all_bytes(file_path, file_contents), "write test file");
+
+   require(s3->put_object_from_file(TEST_CONTAINER, "multipart", file_path),
+           "multipart put must work");
+
+   const string get_path = "/tmp/test_cpp_s3storagesystem_multipart_get.bin";
+   require(s3->get_object(TEST_CONTAINER, "multipart", get_path) == (int64_t) file_contents.size(),
+           "multipart object must be complete");
+   vector<unsigned char> retrieved;
+   require(Utils::file_read_all_bytes(get_path, retrieved), "read retrieved file");
+   require(retrieved == file_contents, "parts must be assembled in order");
+
+   Utils::file_delete(file_path);
+   Utils::file_delete(get_path);
+   cleanup_s3_storage_system(s3);
+}
@@ -19,6 +19,7 @@ protected:
    void test_put_object();
    void test_delete_object();
    void test_get_object();
+   void test_put_object_multipart();
 
 public:
    TestS3StorageSystem();
@@ -0,0 +1,167 @@
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "test_song_cache_index.h"
+#include "song_cache_index.h"
+#include "fs_test_case.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+TestSongCacheIndex::TestSongCacheIndex() :
+   TestSuite("TestSongCacheIndex") {
+}
+
+void TestSongCacheIndex::runTests() {
+   test_get_state();
+   test_set_state();
+   test_begin_download();
+   test_count();
+   test_reconcile();
+   test_get_bytes_cached();
+   test_evict();
+   test_save_and_load();
+}
+
+void TestSongCacheIndex::test_get_state() {
+   TEST_CASE("test_get_state");
+   SongCacheIndex index;
+   require(index.get_state("song-a") == SongCacheIndex::NOT_PRESENT,
+           "unknown song must be not present");
+   requireFalse(index.is_downloaded("song-a"), "unknown song not downloaded");
+   requireFalse(index.is_downloading("song-a"), "unknown song not downloading");
+}
+
+void TestSongCacheIndex::test_set_state() {
+   TEST_CASE("test_set_state");
+   SongCacheIndex index;
+   index.set_state("song-a", SongCacheIndex::DOWNLOADING);
+   require(index.is_downloading("song-a"), "song must be downloading");
+   index.set_state("song-a", SongCacheIndex::DOWNLOADED);
+   require(index.is_downloaded("song-a"), "song must be downloaded");
+   requireFalse(index.is_downloading("song-a"), "song no longer downloading");
+   index.set_state("song-a", SongCacheIndex::PLAYED);
+   require(index.get_state("song-a") == SongCacheIndex::PLAYED,
+           "song must be played");
+}
+
+void TestSongCacheIndex::test_begin_download() {
+   TEST_CASE("test_begin_download");
+   SongCacheIndex index;
+   require(index.begin_download("song-a"), "first begin must succeed");
+   requireFalse(index.begin_download("song-a"), "song already downloading");
+   index.set_state("song-a", SongCacheIndex::DOWNLOADED);
+   requireFalse(index.begin_download("song-a"), "song already downloaded");
+   index.set_state("song-a", SongCacheIndex::PLAYED);
+   require(index.begin_download("song-a"), "played song may download again");
+}
+
+void TestSongCacheIndex::test_count() {
+   TEST_CASE("test_count");
+   SongCacheIndex index;
+   require(index.count(SongCacheIndex::DOWNLOADED) == 0, "empty index");
+   index.set_state("song-a", SongCacheIndex::DOWNLOADED);
+   index.set_state("song-b", SongCacheIndex::DOWNLOADED);
+   index.set_state("song-c", SongCacheIndex::DOWNLOADING);
+   require(index.count(SongCacheIndex::DOWNLOADED) == 2, "2 downloaded");
+   require(index.count(SongCacheIndex::DOWNLOADING) == 1, "1 downloading");
+}
+
+void TestSongCacheIndex::test_reconcile() {
+   TEST_CASE("test_reconcile");
+   string test_dir = "/tmp/test_cpp_songcacheindex_reconcile";
+   FSTestCase test_case(*this, test_dir);
+
+   require(Utils::file_write_all_text(OSUtils::pathJoin(test_dir, "song-a"), "a"),
+           "write song-a");
+   require(Utils::file_write_all_text(OSUtils::pathJoin(test_dir, "song-b"), "b"),
+           "write song-b");
+   require(OSUtils::createDirectory(OSUtils::pathJoin(test_dir, "subdir")),
+           "create subdir");
+
+   SongCacheIndex index;
+   index.set_state("song-c", SongCacheIndex::DOWNLOADED);
+   index.reconcile(test_dir);
+
+   require(index.is_downloaded("song-a"), "song-a found on disk");
+   require(index.is_downloaded("song-b"), "song-b found on disk");
+   requireFalse(index.is_downloaded("song-c"), "song-c not on disk");
+   require(index.get_state("subdir") == SongCacheIndex::NOT_PRESENT,
+           "directories are not songs");
+   require(index.count(SongCacheIndex::DOWNLOADED) == 2, "2 downloaded");
+}
+
+void TestSongCacheIndex::test_get_bytes_cached() {
+   TEST_CASE("test_get_bytes_cached");
+   SongCacheIndex index;
+   require(index.get_bytes_cached() == 0, "empty index");
+   index.set_downloaded("song-a", 100);
+   index.set_downloaded("song-b", 50);
+   require(index.get_bytes_cached() == 150, "2 songs cached");
+   index.set_downloaded("song-a", 120);
+   require(index.get_bytes_cached() == 170, "re-download replaces size");
+   index.set_state("song-b", SongCacheIndex::NOT_PRESENT);
+   require(index.get_bytes_cached() == 120, "removed song not counted");
+}
+
+void TestSongCacheIndex::test_evict() {
+   TEST_CASE("test_evict");
+   SongCacheIndex index;
+   index.set_downloaded("song-a", 100);
+   index.set_downloaded("song-b", 100);
+   index.set_downloaded("song-c", 100);
+   index.set_downloaded("song-d", 100);
+   index.touch("song-a");
+
+   unordered_set<string> pinned;
+   require(index.evict(400, pinned).empty(), "within budget");
+
+   // song-b is least recently used but pinned, so song-c goes first
+   pinned.insert("song-b");
+   vector<string> evicted = index.evict(200, pinned);
+   require(evicted.size() == 2, "2 songs evicted");
+   require(evicted[0] == "song-c", "song-c evicted first");
+   require(evicted[1] == "song-d", "song-d evicted second");
+   require(index.is_downloaded("song-a"), "recently used song kept");
+   require(index.is_downloaded("song-b"), "pinned song kept");
+   require(index.get_bytes_cached() == 200, "within budget after eviction");
+}
+
+void TestSongCacheIndex::test_save_and_load() {
+   TEST_CASE("test_save_and_load");
+   string test_dir = "/tmp/test_cpp_songcacheindex_save_load";
+   FSTestCase test_case(*this, test_dir);
+
+   require(Utils::file_write_all_text(OSUtils::pathJoin(test_dir, "song-a"), "aaaa"),
+           "write song-a");
+   require(Utils::file_write_all_text(OSUtils::pathJoin(test_dir, "song-b"), "bb"),
+           "write song-b");
+
+   {
+      SongCacheIndex index;
+      index.set_downloaded("song-a", 4);
+      index.set_downloaded("song-b", 2);
+      index.touch("song-a");
+      require(index.save(test_dir), "save must succeed");
+   }
+
+   // a partial download and a file that changed size since the save
+   require(Utils::file_write_all_text(OSUtils::pathJoin(test_dir, "song-c"), "c"),
+           "write song-c");
+   require(Utils::file_write_all_text(OSUtils::pathJoin(test_dir, "song-b"), "b"),
+           "rewrite song-b");
+
+   SongCacheIndex index;
+   require(index.load(test_dir), "load must succeed");
+   require(index.is_downloaded("song-a"), "song-a restored");
+   requireFalse(index.is_downloaded("song-b"), "resized song-b dropped");
+   requireFalse(index.is_downloaded("song-c"), "unknown song-c dropped");
+   requireFalse(Utils::file_exists(OSUtils::pathJoin(test_dir, "song-b")),
+                "song-b deleted");
+   requireFalse(Utils::file_exists(OSUtils::pathJoin(test_dir, "song-c")),
+                "song-c deleted");
+   require(index.get_bytes_cached() == 4, "only song-a cached");
+}
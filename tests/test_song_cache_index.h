@@ -0,0 +1,25 @@
+#ifndef TEST_SONG_CACHE_INDEX_H
+#define TEST_SONG_CACHE_INDEX_H
+
+#include "TestSuite.h"
+
+
+class TestSongCacheIndex : public chaudiere::TestSuite {
+protected:
+   void runTests();
+
+   void test_get_state();
+   void test_set_state();
+   void test_begin_download();
+   void test_count();
+   void test_reconcile();
+   void test_get_bytes_cached();
+   void test_evict();
+   void test_save_and_load();
+
+public:
+   TestSongCacheIndex();
+
+};
+
+#endif
@@ -0,0 +1,302 @@
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "test_song_importer.h"
+#include "song_importer.h"
+#include "fs_storage_system.h"
+#include "fs_test_case.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+static const int NUM_TEST_SONGS = 12;
+
+// FSStorageSystem that can't take concurrent writes
+class SerialFSStorageSystem : public FSStorageSystem {
+public:
+   SerialFSStorageSystem(const string& root_dir) :
+      FSStorageSystem(root_dir, false) {
+   }
+
+   bool supports_concurrent_writes() const {
+      return false;
+   }
+};
+
+static string write_song_file(const string& dir, int song_number) {
+   string file_name = "The-Artist--The-Album--Song-" +
+                      to_string(song_number) + ".flac";
+   string file_path = OSUtils::pathJoin(dir, file_name);
+   string contents;
+   for (int i = 0; i <= song_number; ++i) {
+      contents += "contents of song " + to_string(song_number) + "\n";
+   }
+   Utils::file_write_all_text(file_path, contents);
+   return file_path;
+}
+
+static SongMetadata song_for_file(const string& file_path) {
+   string file_name = file_path.substr(file_path.rfind('/') + 1);
+   SongMetadata song;
+   song.set_file_uid(file_name);
+   song.set_object_name(file_name);
+   song.set_container_name("songs");
+   song.set_origin_file_size(Utils::get_file_size(file_path));
+   return song;
+}
+
+TestSongImporter::TestSongImporter() :
+   TestSuite("TestSongImporter") {
+}
+
+void TestSongImporter::runTests() {
+   test_import();
+   test_import_single_worker();
+   test_metadata_store_failure();
+   test_metadata_commit();
+   test_metadata_commit_failure();
+   test_missing_file();
+}
+
+void TestSongImporter::test_import() {
+   TEST_CASE("test_import");
+   string test_dir = "/tmp/test_cpp_song_importer_import";
+   FSTestCase fs_test_case(*this, test_dir);
+   string import_dir = OSUtils::pathJoin(test_dir, "import");
+   string storage_dir = OSUtils::pathJoin(test_dir, "storage");
+   require(OSUtils::createDirectory(import_dir), "create import dir");
+
+   FSStorageSystem fs(storage_dir, false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("songs"), "create container must work");
+
+   mutex stored_mutex;
+   vector<SongMetadata> stored_songs;
+   JukeboxOptions options;
+   options.set_import_workers(4);
+   SongImporter importer(fs, options, [&](const SongMetadata& song) -> bool {
+      lock_guard<mutex> lock(stored_mutex);
+      stored_songs.push_back(song);
+      return true;
+   });
+   int progress_count = 0;
+   importer.set_progress_callback([&](const SongMetadata& song, bool imported) {
+      ++progress_count;
+   });
+
+   require(importer.get_num_upload_workers() == 4, "upload workers");
+   require(importer.start(), "start must succeed");
+   vector<string> file_paths;
+   for (int i = 0; i < NUM_TEST_SONGS; ++i) {
+      file_paths.push_back(write_song_file(import_dir, i));
+      require(importer.add(song_for_file(file_paths.back()), file_paths.back()),
+              "add must succeed");
+   }
+   importer.finish();
+
+   require(importer.get_import_count() == NUM_TEST_SONGS, "import count");
+   require(progress_count == NUM_TEST_SONGS, "progress count");
+   require(stored_songs.size() == (size_t) NUM_TEST_SONGS, "stored songs");
+
+   int64_t total_bytes = 0;
+   for (const auto& file_path : file_paths) {
+      total_bytes += Utils::get_file_size(file_path);
+   }
+   require(importer.get_upload_bytes() == total_bytes, "upload bytes");
+
+   for (const auto& song : stored_songs) {
+      string file_path = OSUtils::pathJoin(import_dir, song.get_object_name());
+      string object_path = OSUtils::pathJoin(OSUtils::pathJoin(storage_dir, "songs"),
+                                             song.get_object_name());
+      require(Utils::file_exists(object_path), "object must be stored");
+      require(song.get_stored_file_size() == (unsigned long) Utils::get_file_size(file_path),
+              "stored file size must match");
+      requireStringEquals(Utils::md5_for_file(file_path), song.get_md5_hash(),
+                          "hash must match file contents");
+   }
+   fs.exit();
+}
+
+void TestSongImporter::test_import_single_worker() {
+   TEST_CASE("test_import_single_worker");
+   string test_dir = "/tmp/test_cpp_song_importer_single_worker";
+   FSTestCase fs_test_case(*this, test_dir);
+   string import_dir = OSUtils::pathJoin(test_dir, "import");
+   string storage_dir = OSUtils::pathJoin(test_dir, "storage");
+   require(OSUtils::createDirectory(import_dir), "create import dir");
+
+   SerialFSStorageSystem fs(storage_dir);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("songs"), "create container must work");
+
+   JukeboxOptions options;
+   options.set_import_workers(4);
+   SongImporter importer(fs, options, [](const SongMetadata& song) -> bool {
+      return true;
+   });
+
+   require(importer.get_num_upload_workers() == 1,
+           "serial storage gets one upload worker");
+   require(importer.start(), "start must succeed");
+   for (int i = 0; i < NUM_TEST_SONGS; ++i) {
+      string file_path = write_song_file(import_dir, i);
+      require(importer.add(song_for_file(file_path), file_path),
+              "add must succeed");
+   }
+   importer.finish();
+
+   require(importer.get_import_count() == NUM_TEST_SONGS, "import count");
+   require(fs.list_container_contents("songs").size() == (size_t) NUM_TEST_SONGS,
+           "all songs stored");
+   fs.exit();
+}
+
+void TestSongImporter::test_metadata_store_failure() {
+   TEST_CASE("test_metadata_store_failure");
+   string test_dir = "/tmp/test_cpp_song_importer_store_failure";
+   FSTestCase fs_test_case(*this, test_dir);
+   string import_dir = OSUtils::pathJoin(test_dir, "import");
+   string storage_dir = OSUtils::pathJoin(test_dir, "storage");
+   require(OSUtils::createDirectory(import_dir), "create import dir");
+
+   FSStorageSystem fs(storage_dir, false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("songs"), "create container must work");
+
+   JukeboxOptions options;
+   SongImporter importer(fs, options, [](const SongMetadata& song) -> bool {
+      return false;
+   });
+
+   require(importer.start(), "start must succeed");
+   for (int i = 0; i < 3; ++i) {
+      string file_path = write_song_file(import_dir, i);
+      require(importer.add(song_for_file(file_path), file_path),
+              "add must succeed");
+   }
+   importer.finish();
+
+   require(importer.get_import_count() == 0, "nothing imported");
+   require(fs.list_container_contents("songs").empty(),
+           "objects without metadata must be deleted");
+   fs.exit();
+}
+
+void TestSongImporter::test_metadata_commit() {
+   TEST_CASE("test_metadata_commit");
+   string test_dir = "/tmp/test_cpp_song_importer_commit";
+   FSTestCase fs_test_case(*this, test_dir);
+   string import_dir = OSUtils::pathJoin(test_dir, "import");
+   string storage_dir = OSUtils::pathJoin(test_dir, "storage");
+   require(OSUtils::createDirectory(import_dir), "create import dir");
+
+   FSStorageSystem fs(storage_dir, false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("songs"), "create container must work");
+
+   int uncommitted_count = 0;
+   vector<int> batch_sizes;
+   JukeboxOptions options;
+   SongImporter importer(fs, options, [&](const SongMetadata& song) -> bool {
+      ++uncommitted_count;
+      return true;
+   });
+   importer.set_metadata_commit([&]() -> bool {
+      batch_sizes.push_back(uncommitted_count);
+      uncommitted_count = 0;
+      return true;
+   }, 5);
+
+   require(importer.start(), "start must succeed");
+   for (int i = 0; i < NUM_TEST_SONGS; ++i) {
+      string file_path = write_song_file(import_dir, i);
+      require(importer.add(song_for_file(file_path), file_path),
+              "add must succeed");
+   }
+   importer.finish();
+
+   require(importer.get_import_count() == NUM_TEST_SONGS, "import count");
+   require(batch_sizes.size() == 3, "full batches plus the remainder");
+   require(batch_sizes.size() == 3 && batch_sizes[0] == 5 &&
+           batch_sizes[1] == 5 && batch_sizes[2] == 2,
+           "batch sizes");
+   fs.exit();
+}
+
+void TestSongImporter::test_metadata_commit_failure() {
+   TEST_CASE("test_metadata_commit_failure");
+   string test_dir = "/tmp/test_cpp_song_importer_commit_failure";
+   FSTestCase fs_test_case(*this, test_dir);
+   string import_dir = OSUtils::pathJoin(test_dir, "import");
+   string storage_dir = OSUtils::pathJoin(test_dir, "storage");
+   require(OSUtils::createDirectory(import_dir), "create import dir");
+
+   FSStorageSystem fs(storage_dir, false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("songs"), "create container must work");
+
+   int commit_count = 0;
+   JukeboxOptions options;
+   SongImporter importer(fs, options, [](const SongMetadata& song) -> bool {
+      return true;
+   });
+   // the first batch commits, the remainder doesn't
+   importer.set_metadata_commit([&]() -> bool {
+      return ++commit_count == 1;
+   }, 5);
+
+   require(importer.start(), "start must succeed");
+   for (int i = 0; i < 8; ++i) {
+      string file_path = write_song_file(import_dir, i);
+      require(importer.add(song_for_file(file_path), file_path),
+              "add must succeed");
+   }
+   importer.finish();
+
+   require(importer.get_import_count() == 5, "only the committed batch is imported");
+   require(fs.list_container_contents("songs").size() == 5,
+           "objects from the failed batch must be deleted");
+   fs.exit();
+}
+
+void TestSongImporter::test_missing_file() {
+   TEST_CASE("test_missing_file");
+   string test_dir = "/tmp/test_cpp_song_importer_missing_file";
+   FSTestCase fs_test_case(*this, test_dir);
+   string storage_dir = OSUtils::pathJoin(test_dir, "storage");
+
+   FSStorageSystem fs(storage_dir, false);
+   require(fs.enter(), "enter must return true");
+   require(fs.create_container("songs"), "create container must work");
+
+   int store_count = 0;
+   int failed_count = 0;
+   JukeboxOptions options;
+   SongImporter importer(fs, options, [&](const SongMetadata& song) -> bool {
+      ++store_count;
+      return true;
+   });
+   importer.set_progress_callback([&](const SongMetadata& song, bool imported) {
+      if (!imported) {
+         ++failed_count;
+      }
+   });
+
+   string file_path = OSUtils::pathJoin(test_dir, "Artist--Album--Missing.flac");
+   SongMetadata song;
+   song.set_file_uid("Artist--Album--Missing.flac");
+   song.set_object_name("Artist--Album--Missing.flac");
+   song.set_container_name("songs");
+
+   require(importer.start(), "start must succeed");
+   require(importer.add(song, file_path), "add must succeed");
+   importer.finish();
+
+   require(importer.get_import_count() == 0, "nothing imported");
+   require(store_count == 0, "metadata not stored");
+   require(failed_count == 1, "failure reported through progress");
+   fs.exit();
+}
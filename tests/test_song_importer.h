@@ -0,0 +1,24 @@
+#ifndef TEST_SONG_IMPORTER_H
+#define TEST_SONG_IMPORTER_H
+
+#include "TestSuite.h"
+
+
+class TestSongImporter : public chaudiere::TestSuite {
+protected:
+   void runTests();
+
+   void test_import();
+   void test_import_single_worker();
+   void test_metadata_store_failure();
+   void test_metadata_commit();
+   void test_metadata_commit_failure();
+   void test_missing_file();
+
+public:
+   TestSongImporter();
+
+};
+
+#endif
+
@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+
+#include "test_stats_registry.h"
+#include "stats_registry.h"
+#include "fs_test_case.h"
+#include "utils.h"
+#include "OSUtils.h"
+
+using namespace std;
+using namespace chaudiere;
+
+TestStatsRegistry::TestStatsRegistry() :
+   TestSuite("TestStatsRegistry") {
+}
+
+void TestStatsRegistry::runTests() {
+   test_counters_and_gauges();
+   test_prometheus_format();
+   test_json_format();
+   test_exporter();
+}
+
+void TestStatsRegistry::test_counters_and_gauges() {
+   TEST_CASE("test_counters_and_gauges");
+   StatsRegistry stats;
+   stats.define("songs_total", StatsRegistry::COUNTER, "Songs");
+   stats.define("queue_depth", StatsRegistry::GAUGE, "Queue depth");
+
+   require(stats.get("songs_total") == 0.0, "new metric must be 0");
+   stats.add("songs_total");
+   stats.add("songs_total", 2.5);
+   require(stats.get("songs_total") == 3.5, "add must accumulate");
+
+   stats.set("queue_depth", 7);
+   stats.set("queue_depth", 3);
+   require(stats.get("queue_depth") == 3.0, "set must replace");
+
+   stats.add("undefined_total");
+   stats.set("undefined", 1.0);
+   require(stats.get("undefined_total") == 0.0, "undefined metric must be ignored");
+   requireFalse(stats.to_prometheus().find("undefined") != string::npos,
+                "undefined metric must not be reported");
+
+   stats.define("songs_total", StatsRegistry::COUNTER, "Songs played");
+   require(stats.get("songs_total") == 3.5, "redefining must keep the value");
+}
+
+void TestStatsRegistry::test_prometheus_format() {
+   TEST_CASE("test_prometheus_format");
+   StatsRegistry stats;
+   stats.define("jb_bytes_total", StatsRegistry::COUNTER, "Bytes moved");
+   stats.define("jb_ratio", StatsRegistry::GAUGE, "Hit ratio");
+   stats.add("jb_bytes_total", 123456789012.0);
+   stats.set("jb_ratio", 0.25);
+
+   string expected =
+      "# HELP jb_bytes_total Bytes moved\n"
+      "# TYPE jb_bytes_total counter\n"
+      "jb_bytes_total 123456789012\n"
+      "# HELP jb_ratio Hit ratio\n"
+      "# TYPE jb_ratio gauge\n"
+      "jb_ratio 0.25\n";
+   requireStringEquals(expected, stats.to_prometheus(), "prometheus text");
+}
+
+void TestStatsRegistry::test_json_format() {
+   TEST_CASE("test_json_format");
+   StatsRegistry stats;
+   stats.define("jb_songs_total", StatsRegistry::COUNTER, "Songs");
+   stats.define("jb_depth", StatsRegistry::GAUGE, "Depth");
+   stats.add("jb_songs_total", 4);
+   stats.set("jb_depth", 2);
+
+   string json = stats.to_json();
+   require(json.find("\"timestamp\": ") != string::npos, "json must have timestamp");
+   require(json.find("\"jb_songs_total\": 4,\n") != string::npos, "json must have counter");
+   require(json.find("\"jb_depth\": 2\n}") != string::npos, "json must have gauge last");
+   require(json[0] == '{', "json must be an object");
+}
+
+void TestStatsRegistry::test_exporter() {
+   TEST_CASE("test_exporter");
+   string test_dir = "/tmp/test_cpp_stats_registry_exporter";
+   FSTestCase test_case(*this, test_dir);
+   OSUtils::createDirectory(test_dir);
+   string prom_file = OSUtils::pathJoin(test_dir, "jukebox.prom");
+   string json_file = OSUtils::pathJoin(test_dir, "jukebox.json");
+
+   StatsRegistry stats;
+   stats.define("jb_plays_total", StatsRegistry::COUNTER, "Plays");
+
+   StatsExporter exporter(stats, prom_file, json_file, 60.0);
+   require(exporter.start(), "exporter must start");
+   stats.add("jb_plays_total", 5);
+   exporter.stop();
+
+   // the final write has the latest values
+   string prom_text;
+   require(Utils::file_read_all_text(prom_file, prom_text), "prometheus file must exist");
+   require(prom_text.find("jb_plays_total 5\n") != string::npos,
+           "prometheus file must have final value");
+   string json_text;
+   require(Utils::file_read_all_text(json_file, json_text), "json file must exist");
+   require(json_text.find("\"jb_plays_total\": 5") != string::npos,
+           "json file must have final value");
+
+   vector<string> files = OSUtils::listFilesInDirectory(test_dir);
+   require(files.size() == 2, "temporary files must not be left behind");
+
+   requireFalse(StatsRegistry::write_atomically(
+                   OSUtils::pathJoin(test_dir, "missing/jukebox.prom"), "x"),
+                "write to missing directory must fail");
+}
+
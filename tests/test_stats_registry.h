@@ -0,0 +1,22 @@
+#ifndef TEST_STATS_REGISTRY_H
+#define TEST_STATS_REGISTRY_H
+
+#include "TestSuite.h"
+
+
+class TestStatsRegistry : public chaudiere::TestSuite {
+protected:
+   void runTests();
+
+   void test_counters_and_gauges();
+   void test_prometheus_format();
+   void test_json_format();
+   void test_exporter();
+
+public:
+   TestStatsRegistry();
+
+};
+
+#endif
+
@@ -34,8 +34,9 @@ protected:
    void test_file_read_all_bytes();
    void test_file_read_all_text();
    void test_file_read_lines();
+   void test_file_copy();
    void test_directory_delete_directory();
-   //void test_md5_for_file();
+   void test_md5_for_file();
 
 public:
    TestUtils();
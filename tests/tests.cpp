@@ -7,6 +7,14 @@
 #include "test_s3_storage_system.h"
 #include "test_fs_storage_system.h"
 #include "test_jukebox.h"
+#include "test_song_cache_index.h"
+#include "test_content_hash.h"
+#include "test_song_importer.h"
+#include "test_metadata_sync.h"
+#include "test_retrying_storage_system.h"
+#include "test_metered_storage_system.h"
+#include "test_stats_registry.h"
+#include "test_library_generator.h"
 
 
 void Tests::run() {
@@ -30,6 +38,30 @@ void Tests::run() {
 
    TestJukebox test_jb;
    test_jb.run();
+
+   TestSongCacheIndex test_sci;
+   test_sci.run();
+
+   TestContentHash test_ch;
+   test_ch.run();
+
+   TestSongImporter test_si;
+   test_si.run();
+
+   TestMetadataSync test_ms;
+   test_ms.run();
+
+   TestRetryingStorageSystem test_rss;
+   test_rss.run();
+
+   TestMeteredStorageSystem test_mss;
+   test_mss.run();
+
+   TestStatsRegistry test_sr;
+   test_sr.run();
+
+   TestLibraryGenerator test_lg;
+   test_lg.run();
 }
 
 int main(int argc, char* argv[]) {